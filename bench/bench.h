@@ -0,0 +1,64 @@
+/// \internal @file bench.h
+/// @brief Timing and reporting helpers shared by the benchmark suites
+
+#ifndef TINY_DNS_BENCH_H
+#define TINY_DNS_BENCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+struct bench_result {
+    const char *name;
+    uint64_t messages;
+    uint64_t records;
+    uint64_t bytes;
+    uint64_t elapsed_ns;
+};
+
+/// @brief Body of a benchmark case. Runs the operation once and reports what it touched.
+///
+/// @param context Case specific state
+/// @param records Output: number of records produced by this run
+/// @param bytes Output: number of message bytes processed by this run
+///
+/// @return 0 on success, anything else aborts the case
+typedef int (*bench_fn)(void *context, uint64_t *records, uint64_t *bytes);
+
+/// @brief Monotonic clock in nanoseconds
+uint64_t bench_now_ns(void);
+
+/// @brief Returns true if a case named @name was selected on the command line
+bool bench_selected(const char *name);
+
+/// @brief Repeatedly run @fn until the configured minimum run time elapses, then report.
+///
+/// @param name Case name as printed in the report
+/// @param fn Case body
+/// @param context Passed through to @fn
+///
+/// @return 0 on success, the first non-zero return of @fn otherwise
+int bench_run(const char *name, bench_fn fn, void *context);
+
+/// @brief Same as bench_run, but also hand the results back to the caller
+///     @res is zeroed if the case wasn't selected.
+int bench_measure(const char *name, bench_fn fn, void *context, struct bench_result *res);
+
+/// @brief Print one line of results in the common report format
+void bench_report(const struct bench_result *res);
+
+/// @brief Sink for computed values so the optimizer can't discard the work being timed
+extern volatile uint64_t bench_sink;
+
+// Each suite returns the number of its cases that failed, a setup that failed counting as one
+int bench_suite_parse(void);
+int bench_suite_adversarial(void);
+int bench_suite_index(void);
+int bench_suite_build(void);
+int bench_suite_cache(void);
+// Only built along with the resolver, which provides the transport it measures
+int bench_suite_udp(void);
+int bench_suite_startup(void);
+int bench_suite_prefetch(void);
+
+#endif  // TINY_DNS_BENCH_H
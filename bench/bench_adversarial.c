@@ -0,0 +1,81 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "corpus.h"
+#include "tiny_dns.h"
+
+// Iterate until the parser either finishes or rejects the message, as a resolver would
+static int bench_iter_adversarial(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    uint64_t count = 0;
+    while (tiny_dns_iter_yield(&iter, &rr, &section) == TINY_DNS_ERR_NONE) {
+        bench_sink += rr.name.len;
+        count++;
+    }
+
+    if (count != msg->records) {
+        return -1;
+    }
+
+    *records = count;
+    *bytes = msg->len;
+    return 0;
+}
+
+// Cost is compared per message, since that's what a sender of crafted packets pays for, whatever
+// their size
+static double ns_per_msg(const struct bench_result *res) {
+    return (double)res->elapsed_ns / (double)res->messages;
+}
+
+int bench_suite_adversarial(void) {
+    char name[64];
+    int failed = 0;
+
+    // Baseline: normal traffic through the same entry point
+    const struct corpus_msg *corpus = corpus_get();
+    double normal = 0;
+    size_t normal_count = 0;
+    for (size_t i = 0; i < CORPUS_COUNT; i++) {
+        struct bench_result res;
+        snprintf(name, sizeof(name), "adversarial/baseline/%s", corpus[i].name);
+        if (bench_measure(name, bench_iter_adversarial, (void *)&corpus[i], &res) != 0) {
+            failed++;
+        } else if (res.messages) {
+            normal += ns_per_msg(&res);
+            normal_count++;
+        }
+    }
+
+    const struct corpus_msg *adversarial = corpus_adversarial_get();
+    double worst = 0;
+    const char *worst_name = NULL;
+    for (size_t i = 0; i < ADVERSARIAL_COUNT; i++) {
+        struct bench_result res;
+        snprintf(name, sizeof(name), "adversarial/%s", adversarial[i].name);
+        if (bench_measure(name, bench_iter_adversarial, (void *)&adversarial[i], &res) != 0) {
+            failed++;
+        } else if (res.messages && ns_per_msg(&res) > worst) {
+            worst = ns_per_msg(&res);
+            worst_name = adversarial[i].name;
+        }
+    }
+
+    if (normal_count && worst_name) {
+        normal /= (double)normal_count;
+        printf("adversarial worst case: %s at %.1f ns/msg, %.1fx the %.1f ns/msg of normal "
+               "traffic\n",
+               worst_name, worst, worst / normal, normal);
+    }
+
+    return failed;
+}
@@ -0,0 +1,112 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "corpus.h"
+#include "tiny_dns.h"
+
+#define BUILD_MAX_RECORDS 64
+
+// A corpus message decoded once, to be written back out by the builder
+struct build_case {
+    struct tiny_dns_header header;
+    struct tiny_dns_name qname;
+    uint16_t qtype;
+    struct tiny_dns_rr rrs[BUILD_MAX_RECORDS];
+    enum tiny_dns_section sections[BUILD_MAX_RECORDS];
+    size_t count;
+    size_t last_len;
+};
+
+static int build_case_init(struct build_case *bc, const struct corpus_msg *msg) {
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, (void *)msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bc->header = iter.header;
+
+    // Every corpus message has a single question right after the header
+    struct tiny_dns_name_view qname = { (const char *)msg->data, msg->len, 12 };
+    err = tiny_dns_name_view_decode(&qname, &bc->qname);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+    size_t qtype_at = 12 + (bc->qname.len ? bc->qname.len + 1 : 1);
+    bc->qtype = (uint16_t)((msg->data[qtype_at] << 8) | msg->data[qtype_at + 1]);
+
+    bc->count = 0;
+    while (bc->count < BUILD_MAX_RECORDS &&
+           (err = tiny_dns_iter_yield(&iter, &bc->rrs[bc->count], &bc->sections[bc->count])) ==
+               TINY_DNS_ERR_NONE) {
+        bc->count++;
+    }
+
+    return bc->count == msg->records ? 0 : -1;
+}
+
+static int bench_build_response(void *context, uint64_t *records, uint64_t *bytes) {
+    struct build_case *bc = context;
+
+    uint8_t buffer[CORPUS_MSG_MAX];
+    struct tiny_dns_builder builder;
+    tiny_dns_err err = tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &bc->header);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    err = tiny_dns_builder_question(&builder, bc->qname.name, bc->qtype, CLASS_IN);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    for (size_t i = 0; i < bc->count; i++) {
+        err = tiny_dns_builder_rr(&builder, bc->sections[i], &bc->rrs[i]);
+        if (err != TINY_DNS_ERR_NONE) {
+            return err;
+        }
+    }
+
+    size_t len;
+    err = tiny_dns_builder_finish(&builder, &len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bench_sink += buffer[len - 1];
+    bc->last_len = len;
+    *records = bc->count;
+    *bytes = len;
+    return 0;
+}
+
+int bench_suite_build(void) {
+    const struct corpus_msg *corpus = corpus_get();
+    static struct build_case cases[CORPUS_COUNT];
+    int failed = 0;
+
+    for (size_t i = 0; i < CORPUS_COUNT; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "build_response/%s", corpus[i].name);
+        if (!bench_selected(name)) {
+            continue;
+        }
+
+        int err = build_case_init(&cases[i], &corpus[i]);
+        if (err) {
+            fprintf(stderr, "%s: failed to decode corpus with %d\n", name, err);
+            failed++;
+            continue;
+        }
+
+        struct bench_result res;
+        if (bench_measure(name, bench_build_response, &cases[i], &res) != 0) {
+            failed++;
+        } else {
+            printf("%-40s %12zu bytes, corpus message is %zu bytes\n", "", cases[i].last_len,
+                   corpus[i].len);
+        }
+    }
+
+    return failed;
+}
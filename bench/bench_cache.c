@@ -0,0 +1,275 @@
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "bench.h"
+#include "tiny_dns.h"
+
+// Names looked up, and entries the cache is sized for. The insert case cycles through twice as
+// many names as fit, so every insert past the first round evicts.
+#define CACHE_NAMES   8192
+#define CACHE_ENTRIES 4096
+#define CACHE_MEM     (CACHE_ENTRIES * (TINY_DNS_CACHE_MSG_MAX + 64))
+
+// Operations per case run, so the per call cost isn't lost in the harness
+#define CACHE_BATCH 256
+
+// Threads the shared cache cases scale up to, and operations each thread runs per case run.
+// One operation in CACHE_MT_WRITE_EVERY is an insert, the rest are lookups of cached names.
+#define CACHE_MT_THREADS     32
+#define CACHE_MT_OPS         4096
+#define CACHE_MT_WRITE_EVERY 16
+#define CACHE_MT_SHARDS      16
+
+struct cache_case {
+    struct tiny_dns_cache cache;
+    size_t next;
+    struct tiny_dns_query_template keys[CACHE_NAMES];
+    uint8_t responses[CACHE_NAMES][96];
+    uint16_t response_len[CACHE_NAMES];
+    char mem[CACHE_MEM];
+};
+
+static struct tiny_dns_name_view key_view(const struct cache_case *cc, size_t i) {
+    struct tiny_dns_name_view view = { (const char *)cc->keys[i].msg, cc->keys[i].len, 12 };
+    return view;
+}
+
+// Looks up names from @base on: the cached ones when @base is 0, which must all hit, otherwise
+// names that were never inserted, which must all miss
+static int cache_lookup(struct cache_case *cc, size_t base, size_t span, uint64_t *records,
+                        uint64_t *bytes) {
+    uint8_t buffer[TINY_DNS_CACHE_MSG_MAX];
+    uint64_t total = 0;
+    tiny_dns_err expect = base == 0 ? TINY_DNS_ERR_NONE : TINY_DNS_ERR_NOT_FOUND;
+
+    for (size_t i = 0; i < CACHE_BATCH; i++) {
+        size_t n = base + cc->next++ % span;
+        struct tiny_dns_name_view view = key_view(cc, n);
+        size_t len = sizeof(buffer);
+        tiny_dns_err err = tiny_dns_cache_lookup(&cc->cache, &view, RR_TYPE_A, CLASS_IN, 1000,
+                                                 buffer, &len, NULL);
+        if (err != expect) {
+            return err ? err : -1;
+        }
+        total += err == TINY_DNS_ERR_NONE ? len : 0;
+    }
+
+    bench_sink += total;
+    *records = CACHE_BATCH;
+    *bytes = total;
+    return 0;
+}
+
+static int bench_cache_hit(void *context, uint64_t *records, uint64_t *bytes) {
+    return cache_lookup(context, 0, CACHE_ENTRIES / 2, records, bytes);
+}
+
+static int bench_cache_miss(void *context, uint64_t *records, uint64_t *bytes) {
+    return cache_lookup(context, CACHE_ENTRIES, CACHE_NAMES - CACHE_ENTRIES, records, bytes);
+}
+
+static int bench_cache_insert(void *context, uint64_t *records, uint64_t *bytes) {
+    struct cache_case *cc = context;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < CACHE_BATCH; i++) {
+        size_t n = cc->next++ % CACHE_NAMES;
+        tiny_dns_err err =
+            tiny_dns_cache_insert(&cc->cache, cc->responses[n], cc->response_len[n], 1000);
+        if (err != TINY_DNS_ERR_NONE) {
+            return err;
+        }
+        total += cc->response_len[n];
+    }
+
+    *records = CACHE_BATCH;
+    *bytes = total;
+    return 0;
+}
+
+static int build_response(struct cache_case *cc, size_t i, const char *name) {
+    struct tiny_dns_header header = { .id = 1, .flags = { .qr = true, .rd = true, .ra = true } };
+    struct tiny_dns_builder builder;
+    struct tiny_dns_rr rr = { .atype = RR_TYPE_A, .aclass = CLASS_IN, .ttl = 300 };
+    strcpy(rr.name.name, name);
+    memcpy(rr.rdata.rr_a, &i, sizeof(rr.rdata.rr_a));
+
+    size_t len;
+    if (tiny_dns_builder_init(&builder, cc->responses[i], sizeof(cc->responses[i]), &header) ||
+        tiny_dns_builder_question(&builder, name, RR_TYPE_A, CLASS_IN) ||
+        tiny_dns_builder_rr(&builder, SECTION_ANSWER, &rr) ||
+        tiny_dns_builder_finish(&builder, &len)) {
+        return -1;
+    }
+
+    cc->response_len[i] = (uint16_t)len;
+    return 0;
+}
+
+// Fills the cache with the first half of the names it can hold, leaving room so nothing evicts
+static int cache_fill(struct cache_case *cc) {
+    if (tiny_dns_cache_init(&cc->cache, cc->mem, sizeof(cc->mem)) != TINY_DNS_ERR_NONE ||
+        tiny_dns_cache_capacity(&cc->cache) < CACHE_ENTRIES / 2) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < CACHE_ENTRIES / 2; i++) {
+        if (tiny_dns_cache_insert(&cc->cache, cc->responses[i], cc->response_len[i], 1000)) {
+            return -1;
+        }
+    }
+
+    cc->next = 0;
+    return 0;
+}
+
+// The same cache shared by threads, either one struct tiny_dns_cache behind a mutex or a sharded
+// one that reads without locking
+struct cache_mt_case {
+    const struct cache_case *cc;
+    size_t threads;
+    bool sharded;
+    pthread_mutex_t lock;
+    struct tiny_dns_cache cache;
+    struct tiny_dns_shard_cache shard_cache;
+};
+
+struct cache_mt_thread {
+    struct cache_mt_case *mt;
+    size_t index;
+    int err;
+    uint64_t bytes;
+};
+
+static tiny_dns_err cache_mt_op(struct cache_mt_case *mt, size_t n, bool write, uint8_t *buffer,
+                                size_t *len) {
+    const struct cache_case *cc = mt->cc;
+    struct tiny_dns_name_view view = key_view(cc, n);
+    tiny_dns_err err;
+
+    if (mt->sharded) {
+        return write ? tiny_dns_shard_cache_insert(&mt->shard_cache, cc->responses[n],
+                                                   cc->response_len[n], 1000)
+                     : tiny_dns_shard_cache_lookup(&mt->shard_cache, &view, RR_TYPE_A, CLASS_IN,
+                                                   1000, buffer, len, NULL, NULL);
+    }
+
+    pthread_mutex_lock(&mt->lock);
+    err = write ? tiny_dns_cache_insert(&mt->cache, cc->responses[n], cc->response_len[n], 1000)
+                : tiny_dns_cache_lookup(&mt->cache, &view, RR_TYPE_A, CLASS_IN, 1000, buffer, len,
+                                        NULL);
+    pthread_mutex_unlock(&mt->lock);
+    return err;
+}
+
+static void *cache_mt_thread(void *arg) {
+    struct cache_mt_thread *t = arg;
+    uint8_t buffer[TINY_DNS_CACHE_MSG_MAX];
+
+    // Threads start at different names so they don't walk the same entries in lock step
+    for (size_t i = 0; i < CACHE_MT_OPS; i++) {
+        size_t n = (t->index * 977 + i) % (CACHE_ENTRIES / 2);
+        size_t len = sizeof(buffer);
+        tiny_dns_err err = cache_mt_op(t->mt, n, i % CACHE_MT_WRITE_EVERY == 0, buffer, &len);
+        // Lookups may miss on a name a writer is replacing, which isn't a failure
+        if (err != TINY_DNS_ERR_NONE && err != TINY_DNS_ERR_NOT_FOUND) {
+            t->err = err;
+            break;
+        }
+        t->bytes += err == TINY_DNS_ERR_NONE ? len : 0;
+    }
+
+    return NULL;
+}
+
+static int bench_cache_mt(void *context, uint64_t *records, uint64_t *bytes) {
+    struct cache_mt_case *mt = context;
+    pthread_t ids[CACHE_MT_THREADS];
+    struct cache_mt_thread threads[CACHE_MT_THREADS] = { { 0 } };
+    size_t started = 0;
+    int err = 0;
+
+    for (; started < mt->threads; started++) {
+        threads[started].mt = mt;
+        threads[started].index = started;
+        if (pthread_create(&ids[started], NULL, cache_mt_thread, &threads[started]) != 0) {
+            err = -1;
+            break;
+        }
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(ids[i], NULL);
+        err = err ? err : threads[i].err;
+        total += threads[i].bytes;
+    }
+
+    bench_sink += total;
+    *records = (uint64_t)started * CACHE_MT_OPS;
+    *bytes = total;
+    return err;
+}
+
+// Runs the shared cases for each thread count, first with the mutex then sharded
+static int cache_mt_suite(const struct cache_case *cc) {
+    static struct cache_mt_case mt;
+    static char mem[CACHE_MEM];
+    int failed = 0;
+
+    mt.cc = cc;
+    pthread_mutex_init(&mt.lock, NULL);
+
+    for (int sharded = 0; sharded < 2; sharded++) {
+        mt.sharded = sharded;
+        tiny_dns_err err = sharded
+                               ? tiny_dns_shard_cache_init(&mt.shard_cache, mem, sizeof(mem),
+                                                           CACHE_MT_SHARDS)
+                               : tiny_dns_cache_init(&mt.cache, mem, sizeof(mem));
+        for (size_t i = 0; !err && i < CACHE_ENTRIES / 2; i++) {
+            err = cache_mt_op(&mt, i, true, NULL, NULL);
+        }
+        if (err) {
+            fprintf(stderr, "cache bench setup failed\n");
+            failed++;
+            break;
+        }
+
+        for (mt.threads = 1; mt.threads <= CACHE_MT_THREADS; mt.threads *= 2) {
+            char name[64];
+            snprintf(name, sizeof(name), "cache_mt/%s/threads_%zu", sharded ? "sharded" : "locked",
+                     mt.threads);
+            failed += bench_run(name, bench_cache_mt, &mt) != 0;
+        }
+    }
+
+    pthread_mutex_destroy(&mt.lock);
+    return failed;
+}
+
+int bench_suite_cache(void) {
+    static struct cache_case cc;
+
+    for (size_t i = 0; i < CACHE_NAMES; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "host%zu.service.example.com", i);
+        if (tiny_dns_query_prepare(&cc.keys[i], name, RR_TYPE_A) != TINY_DNS_ERR_NONE ||
+            build_response(&cc, i, name) != 0) {
+            fprintf(stderr, "cache bench setup failed\n");
+            return 1;
+        }
+    }
+
+    if (cache_fill(&cc) != 0) {
+        fprintf(stderr, "cache bench setup failed\n");
+        return 1;
+    }
+
+    int failed = 0;
+    failed += bench_run("cache/lookup_hit", bench_cache_hit, &cc) != 0;
+    failed += bench_run("cache/lookup_miss", bench_cache_miss, &cc) != 0;
+    failed += bench_run("cache/insert_evict", bench_cache_insert, &cc) != 0;
+
+    return failed + cache_mt_suite(&cc);
+}
@@ -0,0 +1,99 @@
+#include <stdio.h>
+
+#include "bench.h"
+#include "corpus.h"
+#include "tiny_dns.h"
+
+#define INDEX_CAPACITY 64
+
+// The SRV glue lookup both cases below perform: the 3rd additional record
+#define GLUE_RECORD 3
+
+static int bench_index_build(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    struct tiny_dns_index_entry entries[INDEX_CAPACITY];
+    struct tiny_dns_index index;
+    tiny_dns_err err = tiny_dns_index_build(&index, msg->data, msg->len, entries, INDEX_CAPACITY);
+    if (err != TINY_DNS_ERR_NONE || index.count != msg->records) {
+        return err ? err : -1;
+    }
+
+    bench_sink += entries[index.count - 1].rdata_offset;
+    *records = index.count;
+    *bytes = msg->len;
+    return 0;
+}
+
+static int bench_glue_index(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    struct tiny_dns_index_entry entries[INDEX_CAPACITY];
+    struct tiny_dns_index index;
+    tiny_dns_err err = tiny_dns_index_build(&index, msg->data, msg->len, entries, INDEX_CAPACITY);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    const struct tiny_dns_index_entry *entry =
+        tiny_dns_index_get(&index, SECTION_ADDITIONAL, GLUE_RECORD);
+    if (!entry) {
+        return -1;
+    }
+
+    struct tiny_dns_rr rr;
+    err = tiny_dns_index_parse(&index, entry, &rr);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bench_sink += rr.rdata.rr_a[3];
+    *records = 1;
+    *bytes = msg->len;
+    return 0;
+}
+
+static int bench_glue_iter(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    size_t additional = 0;
+    while ((err = tiny_dns_iter_yield(&iter, &rr, &section)) == TINY_DNS_ERR_NONE) {
+        if (section == SECTION_ADDITIONAL && additional++ == GLUE_RECORD) {
+            break;
+        }
+    }
+
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bench_sink += rr.rdata.rr_a[3];
+    *records = 1;
+    *bytes = msg->len;
+    return 0;
+}
+
+int bench_suite_index(void) {
+    const struct corpus_msg *corpus = corpus_get();
+    int failed = 0;
+
+    for (size_t i = 0; i < CORPUS_COUNT; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "index_build/%s", corpus[i].name);
+        failed += bench_run(name, bench_index_build, (void *)&corpus[i]) != 0;
+    }
+
+    void *srv = (void *)&corpus[CORPUS_SRV_LARGE];
+    failed += bench_run("srv_glue/index", bench_glue_index, srv) != 0;
+    failed += bench_run("srv_glue/iter_yield", bench_glue_iter, srv) != 0;
+
+    return failed;
+}
@@ -0,0 +1,366 @@
+#include <stdio.h>
+#include <strings.h>
+
+#include "bench.h"
+#include "corpus.h"
+#include "label.h"
+#include "tiny_dns.h"
+
+static int bench_build_query(void *context, uint64_t *records, uint64_t *bytes) {
+    (void)context;
+
+    uint8_t buffer[512];
+    size_t len = sizeof(buffer);
+    tiny_dns_err err = tiny_dns_build_query(buffer, &len, 0xdb42, "www.example.com", RR_TYPE_A);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bench_sink += buffer[len - 1];
+    *records = 1;
+    *bytes = len;
+    return 0;
+}
+
+static int bench_build_query_prepared(void *context, uint64_t *records, uint64_t *bytes) {
+    const struct tiny_dns_query_template *tmpl = context;
+
+    uint8_t buffer[512];
+    size_t len = sizeof(buffer);
+    tiny_dns_err err = tiny_dns_query_render(tmpl, buffer, &len, 0xdb42);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bench_sink += buffer[len - 1];
+    *records = 1;
+    *bytes = len;
+    return 0;
+}
+
+static int name_encode(int (*fn)(IOWriter *, const char *), const char *name, uint64_t *records,
+                       uint64_t *bytes) {
+    char wire[NAME_MAX_WIRE_LEN];
+    IOWriter wr;
+    io_writer_init(&wr, wire, sizeof(wire));
+
+    int len = fn(&wr, name);
+    if (len < 0) {
+        return len;
+    }
+
+    bench_sink += (uint8_t)wire[len - 1] + (uint8_t)wire[0];
+    *records = 1;
+    *bytes = (uint64_t)len;
+    return 0;
+}
+
+static int bench_name_encode(void *context, uint64_t *records, uint64_t *bytes) {
+    return name_encode(tiny_dns_label_encode, context, records, bytes);
+}
+
+static int bench_name_encode_scalar(void *context, uint64_t *records, uint64_t *bytes) {
+    return name_encode(tiny_dns_label_encode_scalar, context, records, bytes);
+}
+
+// Same name in two messages, differing in case
+struct name_pair {
+    struct tiny_dns_name_view a;
+    struct tiny_dns_name_view b;
+};
+
+static int bench_name_wire_eq(void *context, uint64_t *records, uint64_t *bytes) {
+    const struct name_pair *pair = context;
+
+    if (!tiny_dns_name_wire_eq(&pair->a, &pair->b)) {
+        return -1;
+    }
+
+    *records = 1;
+    *bytes = 0;
+    return 0;
+}
+
+static int bench_name_wire_hash(void *context, uint64_t *records, uint64_t *bytes) {
+    const struct name_pair *pair = context;
+
+    uint64_t hash;
+    tiny_dns_err err = tiny_dns_name_wire_hash(&pair->a, &hash);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bench_sink += hash;
+    *records = 1;
+    *bytes = 0;
+    return 0;
+}
+
+// What callers had to do before: decode both names, then compare the text
+static int bench_name_decode_cmp(void *context, uint64_t *records, uint64_t *bytes) {
+    const struct name_pair *pair = context;
+
+    struct tiny_dns_name a;
+    struct tiny_dns_name b;
+    tiny_dns_err err = tiny_dns_name_view_decode(&pair->a, &a);
+    if (err == TINY_DNS_ERR_NONE) {
+        err = tiny_dns_name_view_decode(&pair->b, &b);
+    }
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    if (strcasecmp(a.name, b.name) != 0) {
+        return -1;
+    }
+
+    *records = 1;
+    *bytes = 0;
+    return 0;
+}
+
+static int bench_request_parse(void *context, uint64_t *records, uint64_t *bytes) {
+    const struct tiny_dns_query_template *tmpl = context;
+
+    struct tiny_dns_request req;
+    struct tiny_dns_question_view question;
+    tiny_dns_err err = tiny_dns_request_parse(&req, tmpl->msg, tmpl->len, &question, 1);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bench_sink += question.qtype + question.qname_wire_len;
+    *records = 1;
+    *bytes = tmpl->len;
+    return 0;
+}
+
+static int bench_iter_init(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    bench_sink += iter.header.ancount;
+    *records = 0;
+    *bytes = msg->len;
+    return 0;
+}
+
+static int iter_yield_all(struct corpus_msg *msg, uint32_t flags, uint64_t *records,
+                          uint64_t *bytes) {
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+    tiny_dns_iter_set_flags(&iter, flags);
+
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    uint64_t count = 0;
+    while ((err = tiny_dns_iter_yield(&iter, &rr, &section)) == TINY_DNS_ERR_NONE) {
+        bench_sink += rr.rdlength + rr.name.len;
+        count++;
+    }
+
+    if (err != TINY_DNS_ERR_NO_BUF || count != msg->records) {
+        return err ? err : -1;
+    }
+
+    *records = count;
+    *bytes = msg->len;
+    return 0;
+}
+
+static int bench_iter_yield(void *context, uint64_t *records, uint64_t *bytes) {
+    return iter_yield_all(context, 0, records, bytes);
+}
+
+static int bench_iter_yield_nomemo(void *context, uint64_t *records, uint64_t *bytes) {
+    return iter_yield_all(context, TINY_DNS_ITER_NO_MEMO, records, bytes);
+}
+
+static int bench_iter_yield_lazy(void *context, uint64_t *records, uint64_t *bytes) {
+    return iter_yield_all(context, TINY_DNS_ITER_LAZY_NAMES, records, bytes);
+}
+
+static int bench_iter_yield_compact(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    struct tiny_dns_rr_compact rr;
+    enum tiny_dns_section section;
+    uint64_t count = 0;
+    while ((err = tiny_dns_iter_yield_compact(&iter, &rr, &section)) == TINY_DNS_ERR_NONE) {
+        bench_sink += rr.rdlength + rr.owner;
+        count++;
+    }
+
+    if (err != TINY_DNS_ERR_NO_BUF || count != msg->records) {
+        return err ? err : -1;
+    }
+
+    *records = count;
+    *bytes = msg->len;
+    return 0;
+}
+
+static int bench_iter_materialize(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    // One reusable block per worker; a response never needs more than a few times its own size
+    static uint64_t mem[4 * CORPUS_MSG_MAX];
+    struct tiny_dns_arena arena;
+    tiny_dns_arena_init(&arena, mem, sizeof(mem));
+
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    struct tiny_dns_rr_arena *rrs;
+    size_t count;
+    err = tiny_dns_iter_materialize(&iter, &arena, &rrs, &count);
+    if (err != TINY_DNS_ERR_NONE || count != msg->records) {
+        return err ? err : -1;
+    }
+
+    bench_sink += arena.len;
+    *records = count;
+    *bytes = msg->len;
+    return 0;
+}
+
+static void count_rr(struct tiny_dns_iter *iter, const struct tiny_dns_rr *rr,
+                     enum tiny_dns_section section, void *context) {
+    (void)iter;
+    (void)section;
+
+    uint64_t *count = context;
+    bench_sink += rr->rdlength;
+    (*count)++;
+}
+
+static int bench_iter_foreach(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    uint64_t count = 0;
+    err = tiny_dns_iter_foreach(&iter, count_rr, &count);
+    if (err != TINY_DNS_ERR_NONE || count != msg->records) {
+        return err ? err : -1;
+    }
+
+    *records = count;
+    *bytes = msg->len;
+    return 0;
+}
+
+// Most callers only want addresses; everything else should cost no more than a skip
+static int bench_iter_filtered(void *context, uint64_t *records, uint64_t *bytes) {
+    struct corpus_msg *msg = context;
+
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg->data, msg->len);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    static const uint16_t addresses[] = { RR_TYPE_A, RR_TYPE_AAAA };
+    struct tiny_dns_filter filter = { .types = addresses, .type_count = 2 };
+
+    uint64_t count = 0;
+    err = tiny_dns_iter_foreach_filtered(&iter, &filter, count_rr, &count);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    *records = count;
+    *bytes = msg->len;
+    return 0;
+}
+
+int bench_suite_parse(void) {
+    int failed = 0;
+    failed += bench_run("build_query", bench_build_query, NULL) != 0;
+
+    struct tiny_dns_query_template tmpl;
+    if (tiny_dns_query_prepare(&tmpl, "www.example.com", RR_TYPE_A) == TINY_DNS_ERR_NONE) {
+        failed += bench_run("build_query/prepared", bench_build_query_prepared, &tmpl) != 0;
+        failed += bench_run("request_parse", bench_request_parse, &tmpl) != 0;
+    }
+
+    const char *long_name = "_xmpp-server._tcp.conference.chat.eu-west-1.internal.corp.example.com";
+    const char *long_upper =
+        "_XMPP-SERVER._TCP.Conference.Chat.EU-West-1.Internal.Corp.Example.COM";
+    struct tiny_dns_query_template lower;
+    struct tiny_dns_query_template upper;
+    if (tiny_dns_query_prepare(&lower, long_name, RR_TYPE_SRV) == TINY_DNS_ERR_NONE &&
+        tiny_dns_query_prepare(&upper, long_upper, RR_TYPE_SRV) == TINY_DNS_ERR_NONE) {
+        // The question name directly follows the 12 byte header
+        struct name_pair pair = {
+            { (const char *)lower.msg, lower.len, 12 },
+            { (const char *)upper.msg, upper.len, 12 },
+        };
+        failed += bench_run("name_wire_eq", bench_name_wire_eq, &pair) != 0;
+        failed += bench_run("name_wire_hash", bench_name_wire_hash, &pair) != 0;
+        failed += bench_run("name_decode_cmp", bench_name_decode_cmp, &pair) != 0;
+    }
+
+    const struct {
+        const char *name;
+        const char *text;
+    } names[] = {
+        { "short", "www.example.com" },
+        { "long", "_xmpp-server._tcp.conference.chat.eu-west-1.internal.corp.example.com" },
+    };
+
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "name_encode/%s", names[i].name);
+        failed += bench_run(name, bench_name_encode, (void *)names[i].text) != 0;
+        snprintf(name, sizeof(name), "name_encode/scalar/%s", names[i].name);
+        failed += bench_run(name, bench_name_encode_scalar, (void *)names[i].text) != 0;
+    }
+
+    const struct corpus_msg *corpus = corpus_get();
+
+    const struct {
+        const char *prefix;
+        bench_fn fn;
+    } cases[] = {
+        { "iter_init", bench_iter_init },
+        { "iter_yield", bench_iter_yield },
+        { "iter_yield_nomemo", bench_iter_yield_nomemo },
+        { "iter_yield_lazy", bench_iter_yield_lazy },
+        { "iter_yield_compact", bench_iter_yield_compact },
+        { "iter_materialize", bench_iter_materialize },
+        { "iter_foreach", bench_iter_foreach },
+        { "iter_filtered", bench_iter_filtered },
+    };
+
+    for (size_t c = 0; c < sizeof(cases) / sizeof(cases[0]); c++) {
+        for (size_t i = 0; i < CORPUS_COUNT; i++) {
+            char name[64];
+            snprintf(name, sizeof(name), "%s/%s", cases[c].prefix, corpus[i].name);
+            failed += bench_run(name, cases[c].fn, (void *)&corpus[i]) != 0;
+        }
+    }
+
+    return failed;
+}
@@ -0,0 +1,276 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "pool.h"
+#include "prefetch.h"
+#include "tiny_dns.h"
+
+// Names looked up, lookups per case run, and their TTL. Each run is one second on the cache's
+// clock, so every name is looked up a few times a second and expires every few seconds.
+#define PREFETCH_NAMES   256
+#define PREFETCH_LOOKUPS 1024
+#define PREFETCH_TTL     10
+#define PREFETCH_MEM     (PREFETCH_NAMES * 2 * (TINY_DNS_CACHE_MSG_MAX + 64))
+
+// Lookup latencies kept per case, enough for the percentiles to settle
+#define PREFETCH_SAMPLES (1 << 20)
+
+// Per lookup latency of a cache in front of a stand-in upstream on loopback, with and without
+// prefetching. Without it, a name that expired is fetched while the lookup waits. With it, a hot
+// name is refreshed in the background once it's in the last fifth of its TTL, after the lookup
+// that noticed has its answer. Loopback answers in microseconds, so the gap between the two tails
+// is smaller than it would be in front of a real upstream.
+struct prefetch_case {
+    struct tiny_dns_cache cache;
+    uint64_t now;
+    size_t next;
+    int server;
+    struct tiny_dns_udp_pool pool;
+    struct tiny_dns_udp_pool_socket sockets[1];
+    struct tiny_dns_resolver res;
+    struct tiny_dns_resolver_query *buckets[PREFETCH_NAMES];
+    struct tiny_dns_prefetcher pf;
+    struct tiny_dns_prefetch_slot slots[PREFETCH_NAMES];
+    size_t sample_count;
+    uint32_t samples[PREFETCH_SAMPLES];
+    struct tiny_dns_query_template keys[PREFETCH_NAMES];
+    char names[PREFETCH_NAMES][32];
+    uint8_t responses[PREFETCH_NAMES][96];
+    uint16_t response_len[PREFETCH_NAMES];
+    char mem[PREFETCH_MEM];
+};
+
+// Answer the next query waiting at the stand-in upstream with the response for its name, which
+// is host<n>.example.com, under the query's ID
+static int upstream_answer(struct prefetch_case *pc, int flags) {
+    uint8_t query[TINY_DNS_QUERY_MAX_LEN];
+    struct sockaddr_storage from;
+    socklen_t from_len = sizeof(from);
+    ssize_t n = recvfrom(pc->server, query, sizeof(query) - 1, flags, (struct sockaddr *)&from,
+                         &from_len);
+    if (n < 18) {
+        return -1;
+    }
+
+    // The digits follow the label length and "host"
+    query[n] = 0;
+    size_t i = strtoul((const char *)query + 17, NULL, 10) % PREFETCH_NAMES;
+    uint8_t *msg = pc->responses[i];
+    memcpy(msg, query, 2);
+    return sendto(pc->server, msg, pc->response_len[i], 0, (struct sockaddr *)&from, from_len) ==
+                   pc->response_len[i]
+               ? 0
+               : -1;
+}
+
+// Ask the upstream for name @i while the lookup waits, and cache the answer
+static int prefetch_fetch(struct prefetch_case *pc, size_t i) {
+    uint8_t buf[TINY_DNS_CACHE_MSG_MAX];
+    struct tiny_dns_udp_pool_socket *sock = tiny_dns_udp_pool_lease(&pc->pool, 0);
+    ssize_t len = (ssize_t)pc->keys[i].len;
+    if (!sock || send(sock->fd, pc->keys[i].msg, pc->keys[i].len, 0) != len ||
+        upstream_answer(pc, 0) != 0) {
+        return -1;
+    }
+
+    ssize_t n = recv(sock->fd, buf, sizeof(buf), 0);
+    tiny_dns_udp_pool_release(&pc->pool, sock, n >= 0);
+    if (n < 0 || tiny_dns_cache_insert(&pc->cache, buf, (size_t)n, pc->now) != TINY_DNS_ERR_NONE) {
+        return -1;
+    }
+
+    return (int)n;
+}
+
+static int bench_prefetch(void *context, uint64_t *records, uint64_t *bytes) {
+    struct prefetch_case *pc = context;
+    uint8_t buf[TINY_DNS_CACHE_MSG_MAX];
+    uint64_t total = 0;
+
+    for (size_t l = 0; l < PREFETCH_LOOKUPS; l++) {
+        size_t i = pc->next++ % PREFETCH_NAMES;
+        struct tiny_dns_name_view view = { (const char *)pc->keys[i].msg, pc->keys[i].len, 12 };
+        struct tiny_dns_cache_hit hit = { 0 };
+        size_t len = sizeof(buf);
+
+        uint64_t start = bench_now_ns();
+        tiny_dns_err err = tiny_dns_cache_lookup(&pc->cache, &view, RR_TYPE_A, CLASS_IN, pc->now,
+                                                 buf, &len, &hit);
+        int n = err == TINY_DNS_ERR_NONE ? (int)len : err;
+        if (err == TINY_DNS_ERR_NOT_FOUND) {
+            n = prefetch_fetch(pc, i);
+        }
+        uint64_t elapsed = bench_now_ns() - start;
+
+        if (n < 0) {
+            return n;
+        } else if (pc->sample_count < PREFETCH_SAMPLES) {
+            pc->samples[pc->sample_count++] = elapsed > UINT32_MAX ? UINT32_MAX : (uint32_t)elapsed;
+        }
+        total += (uint64_t)n;
+
+        // The lookup has its answer, the refresh is on the resolver's time
+        if (hit.prefetch) {
+            tiny_dns_prefetcher_refresh(&pc->pf, pc->names[i], RR_TYPE_A, pc->now);
+        }
+    }
+
+    // The upstream answers the refreshes and the resolver stores them, before the clock ticks
+    while (tiny_dns_prefetcher_in_flight(&pc->pf) > 0) {
+        while (upstream_answer(pc, MSG_DONTWAIT) == 0) {
+        }
+        if (tiny_dns_resolver_poll(&pc->res, 1) < 0) {
+            return -1;
+        }
+    }
+    pc->now++;
+
+    bench_sink += total;
+    *records = PREFETCH_LOOKUPS;
+    *bytes = total;
+    return 0;
+}
+
+static int compare_samples(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Report latency percentiles of the lookups in a case's runs, one line each
+static void prefetch_report(struct prefetch_case *pc, const char *mode) {
+    static const struct {
+        const char *name;
+        uint32_t per_mille;
+    } points[] = { { "p50", 500 }, { "p99", 990 }, { "p999", 999 } };
+
+    if (pc->sample_count == 0) {
+        return;
+    }
+
+    qsort(pc->samples, pc->sample_count, sizeof(pc->samples[0]), compare_samples);
+    for (size_t p = 0; p < sizeof(points) / sizeof(points[0]); p++) {
+        char name[64];
+        snprintf(name, sizeof(name), "prefetch/%s/%s", mode, points[p].name);
+        struct bench_result res = { .name = name, .messages = 1, .records = 1 };
+        res.elapsed_ns = pc->samples[pc->sample_count * points[p].per_mille / 1000];
+        bench_report(&res);
+    }
+}
+
+static int build_response(struct prefetch_case *pc, size_t i) {
+    struct tiny_dns_header header = { .flags = { .qr = true, .rd = true, .ra = true } };
+    struct tiny_dns_builder builder;
+    struct tiny_dns_rr rr = { .atype = RR_TYPE_A, .aclass = CLASS_IN, .ttl = PREFETCH_TTL };
+    strcpy(rr.name.name, pc->names[i]);
+    memcpy(rr.rdata.rr_a, &i, sizeof(rr.rdata.rr_a));
+
+    size_t len;
+    if (tiny_dns_builder_init(&builder, pc->responses[i], sizeof(pc->responses[i]), &header) ||
+        tiny_dns_builder_question(&builder, pc->names[i], RR_TYPE_A, CLASS_IN) ||
+        tiny_dns_builder_rr(&builder, SECTION_ANSWER, &rr) ||
+        tiny_dns_builder_finish(&builder, &len)) {
+        return -1;
+    }
+
+    pc->response_len[i] = (uint16_t)len;
+    return 0;
+}
+
+static int prefetch_upstream(struct prefetch_case *pc) {
+    struct sockaddr_in addr = { .sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK) };
+    socklen_t len = sizeof(addr);
+    pc->server = socket(AF_INET, SOCK_DGRAM, 0);
+    if (pc->server < 0 || bind(pc->server, (struct sockaddr *)&addr, len) < 0 ||
+        getsockname(pc->server, (struct sockaddr *)&addr, &len) < 0) {
+        return -1;
+    }
+
+    struct tiny_dns_udp_upstream upstream = { .addr_len = len };
+    memcpy(&upstream.addr, &addr, len);
+    struct tiny_dns_udp_pool_config pool_config = { .upstreams = &upstream, .upstream_count = 1 };
+    if (tiny_dns_udp_pool_init(&pc->pool, &pool_config, pc->sockets, 1) != TINY_DNS_ERR_NONE) {
+        return -1;
+    }
+
+    struct tiny_dns_resolver_config config = { .server_len = len, .timeout_ms = 1000,
+                                               .attempts = 1 };
+    memcpy(&config.server, &addr, len);
+    if (tiny_dns_resolver_init(&pc->res, &config, pc->buckets, PREFETCH_NAMES) !=
+        TINY_DNS_ERR_NONE) {
+        tiny_dns_udp_pool_close(&pc->pool);
+        return -1;
+    }
+
+    return 0;
+}
+
+// Start from a cache holding every name, prefetching or not
+static int prefetch_fill(struct prefetch_case *pc, bool prefetch) {
+    struct tiny_dns_cache_prefetch policy = { .min_hits = prefetch ? 2 : 0, .percent = 20 };
+    if (tiny_dns_cache_init(&pc->cache, pc->mem, sizeof(pc->mem)) != TINY_DNS_ERR_NONE ||
+        tiny_dns_prefetcher_init(&pc->pf, &pc->res, &pc->cache, pc->slots, PREFETCH_NAMES) !=
+            TINY_DNS_ERR_NONE) {
+        return -1;
+    }
+    tiny_dns_cache_set_prefetch(&pc->cache, &policy);
+
+    pc->now = 1000;
+    pc->next = 0;
+    pc->sample_count = 0;
+    for (size_t i = 0; i < PREFETCH_NAMES; i++) {
+        if (tiny_dns_cache_insert(&pc->cache, pc->responses[i], pc->response_len[i], pc->now)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+int bench_suite_prefetch(void) {
+    static struct prefetch_case pc;
+
+    // Setting up opens sockets, so skip it unless a case will run
+    const char *cases[] = { "prefetch/off/lookup", "prefetch/on/lookup" };
+    if (!bench_selected(cases[0]) && !bench_selected(cases[1])) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < PREFETCH_NAMES; i++) {
+        snprintf(pc.names[i], sizeof(pc.names[i]), "host%zu.example.com", i);
+        if (tiny_dns_query_prepare(&pc.keys[i], pc.names[i], RR_TYPE_A) != TINY_DNS_ERR_NONE ||
+            build_response(&pc, i) != 0) {
+            fprintf(stderr, "prefetch bench setup failed\n");
+            return 1;
+        }
+    }
+
+    if (prefetch_upstream(&pc) != 0) {
+        perror("prefetch bench upstream");
+        return 1;
+    }
+
+    int failed = 0;
+    for (int on = 0; on < 2; on++) {
+        if (prefetch_fill(&pc, on) != 0) {
+            fprintf(stderr, "prefetch bench setup failed\n");
+            failed++;
+            break;
+        } else if (bench_run(cases[on], bench_prefetch, &pc) != 0) {
+            failed++;
+        } else {
+            prefetch_report(&pc, on ? "on" : "off");
+        }
+    }
+
+    tiny_dns_resolver_close(&pc.res);
+    tiny_dns_udp_pool_close(&pc.pool);
+    close(pc.server);
+    return failed;
+}
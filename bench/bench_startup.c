@@ -0,0 +1,227 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "pool.h"
+#include "snapshot.h"
+#include "tiny_dns.h"
+
+// Names the previous run had cached, and memory for a cache that holds them all
+#define STARTUP_NAMES 100000
+#define STARTUP_MEM   (STARTUP_NAMES * (TINY_DNS_CACHE_MSG_MAX + 64))
+
+// Round trip to the stand-in upstream: a recursive resolver on the local network answering from
+// its own cache. One that has to recurse itself takes tens of milliseconds.
+#define STARTUP_UPSTREAM_RTT_US 1000
+
+// Names the cold all_names case asks for. Each costs a round trip, so all of them would take
+// minutes a run for the same time per name.
+#define STARTUP_COLD_NAMES 1000
+
+// A process starting up and answering its first lookup, or a lookup for every name the previous
+// run had cached. Cold starts with an empty cache and asks a stand-in upstream on loopback, which
+// holds each answer back for STARTUP_UPSTREAM_RTT_US. Warm maps the previous run's snapshot and
+// answers from it.
+struct startup_case {
+    struct tiny_dns_cache cache;
+    size_t names;
+    int server;
+    struct sockaddr_in addr;
+    struct tiny_dns_udp_pool pool;
+    struct tiny_dns_udp_pool_socket sockets[1];
+    char path[64];
+    uint8_t responses[STARTUP_NAMES][96];
+    uint16_t response_len[STARTUP_NAMES];
+    char name_buf[STARTUP_NAMES][32];
+    char mem[STARTUP_MEM];
+};
+
+// Look up name @i in @cache, asking the upstream and caching the answer on a miss
+static int startup_answer(struct startup_case *sc, struct tiny_dns_cache *cache, size_t i,
+                          bool may_miss) {
+    uint8_t query[TINY_DNS_QUERY_MAX_LEN];
+    uint8_t buf[TINY_DNS_CACHE_MSG_MAX];
+    size_t len = sizeof(query);
+    if (tiny_dns_build_query(query, &len, (uint16_t)i, sc->name_buf[i], RR_TYPE_A)) {
+        return -1;
+    }
+
+    struct tiny_dns_name_view view = { (const char *)query, len, 12 };
+    size_t buf_len = sizeof(buf);
+    tiny_dns_err err =
+        tiny_dns_cache_lookup(cache, &view, RR_TYPE_A, CLASS_IN, 1000, buf, &buf_len, NULL);
+    if (err == TINY_DNS_ERR_NONE) {
+        return (int)buf_len;
+    } else if (err != TINY_DNS_ERR_NOT_FOUND || !may_miss) {
+        return err ? err : -1;
+    }
+
+    struct tiny_dns_udp_pool_socket *sock = tiny_dns_udp_pool_lease(&sc->pool, 0);
+    if (!sock || send(sock->fd, query, len, 0) != (ssize_t)len) {
+        return -1;
+    }
+
+    struct sockaddr_storage from;
+    socklen_t from_len = sizeof(from);
+    struct timespec rtt = { 0, STARTUP_UPSTREAM_RTT_US * 1000L };
+    if (recvfrom(sc->server, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len) < 0 ||
+        nanosleep(&rtt, NULL) != 0 ||
+        sendto(sc->server, sc->responses[i], sc->response_len[i], 0, (struct sockaddr *)&from,
+               from_len) != sc->response_len[i]) {
+        return -1;
+    }
+
+    ssize_t n = recv(sock->fd, buf, sizeof(buf), 0);
+    tiny_dns_udp_pool_release(&sc->pool, sock, n >= 0);
+    if (n < 0 || tiny_dns_cache_insert(cache, buf, (size_t)n, 1000) != TINY_DNS_ERR_NONE) {
+        return -1;
+    }
+
+    return (int)n;
+}
+
+static int startup_names(struct startup_case *sc, struct tiny_dns_cache *cache, bool may_miss,
+                         uint64_t *records, uint64_t *bytes) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < sc->names; i++) {
+        int len = startup_answer(sc, cache, i, may_miss);
+        if (len < 0) {
+            return len;
+        }
+        total += (uint64_t)len;
+    }
+
+    bench_sink += total;
+    *records = sc->names;
+    *bytes = total;
+    return 0;
+}
+
+static int bench_startup_cold(void *context, uint64_t *records, uint64_t *bytes) {
+    struct startup_case *sc = context;
+    struct tiny_dns_cache cache;
+    if (tiny_dns_cache_init(&cache, sc->mem, sizeof(sc->mem)) != TINY_DNS_ERR_NONE) {
+        return -1;
+    }
+
+    return startup_names(sc, &cache, true, records, bytes);
+}
+
+static int bench_startup_warm(void *context, uint64_t *records, uint64_t *bytes) {
+    struct startup_case *sc = context;
+    struct tiny_dns_cache_file file = { 0 };
+    tiny_dns_err err = tiny_dns_cache_open_file(&file, sc->path, 1000, 0);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    // Every name was saved, so none of them should have to go upstream
+    int ret = startup_names(sc, &file.cache, false, records, bytes);
+    tiny_dns_cache_close_file(&file);
+    return ret;
+}
+
+static int build_response(struct startup_case *sc, size_t i) {
+    struct tiny_dns_header header = { .id = (uint16_t)i, .flags = { .qr = true, .rd = true } };
+    struct tiny_dns_builder builder;
+    struct tiny_dns_rr rr = { .atype = RR_TYPE_A, .aclass = CLASS_IN, .ttl = 300 };
+    strcpy(rr.name.name, sc->name_buf[i]);
+    memcpy(rr.rdata.rr_a, &i, sizeof(rr.rdata.rr_a));
+
+    size_t len;
+    if (tiny_dns_builder_init(&builder, sc->responses[i], sizeof(sc->responses[i]), &header) ||
+        tiny_dns_builder_question(&builder, sc->name_buf[i], RR_TYPE_A, CLASS_IN) ||
+        tiny_dns_builder_rr(&builder, SECTION_ANSWER, &rr) ||
+        tiny_dns_builder_finish(&builder, &len)) {
+        return -1;
+    }
+
+    sc->response_len[i] = (uint16_t)len;
+    return 0;
+}
+
+// The previous run: every name answered once and cached, then saved on the way out
+static int startup_snapshot(struct startup_case *sc) {
+    if (tiny_dns_cache_init(&sc->cache, sc->mem, sizeof(sc->mem)) != TINY_DNS_ERR_NONE ||
+        tiny_dns_cache_capacity(&sc->cache) < STARTUP_NAMES) {
+        return -1;
+    }
+
+    for (size_t i = 0; i < STARTUP_NAMES; i++) {
+        if (tiny_dns_cache_insert(&sc->cache, sc->responses[i], sc->response_len[i], 1000)) {
+            return -1;
+        }
+    }
+
+    snprintf(sc->path, sizeof(sc->path), "/tmp/tiny_dns_bench_snapshot.%d", (int)getpid());
+    return tiny_dns_cache_save_file(&sc->cache, sc->path, 1000, 0) == TINY_DNS_ERR_NONE ? 0 : -1;
+}
+
+static int startup_upstream(struct startup_case *sc) {
+    socklen_t len = sizeof(sc->addr);
+    sc->addr.sin_family = AF_INET;
+    sc->addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    sc->server = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sc->server < 0 || bind(sc->server, (struct sockaddr *)&sc->addr, len) < 0 ||
+        getsockname(sc->server, (struct sockaddr *)&sc->addr, &len) < 0) {
+        return -1;
+    }
+
+    struct tiny_dns_udp_upstream upstream = { .addr_len = len };
+    memcpy(&upstream.addr, &sc->addr, len);
+    struct tiny_dns_udp_pool_config config = { .upstreams = &upstream, .upstream_count = 1 };
+    return tiny_dns_udp_pool_init(&sc->pool, &config, sc->sockets, 1) == TINY_DNS_ERR_NONE ? 0
+                                                                                           : -1;
+}
+
+int bench_suite_startup(void) {
+    static struct startup_case sc;
+
+    // Setting up writes a snapshot of every name, so skip it unless a case will run
+    const char *cases[] = { "startup/cold/first_answer", "startup/warm/first_answer",
+                            "startup/cold/all_names", "startup/warm/all_names" };
+    bool selected = false;
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        selected = selected || bench_selected(cases[i]);
+    }
+    if (!selected) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < STARTUP_NAMES; i++) {
+        snprintf(sc.name_buf[i], sizeof(sc.name_buf[i]), "host%zu.service.example.com", i);
+        if (build_response(&sc, i) != 0) {
+            fprintf(stderr, "startup bench setup failed\n");
+            return 1;
+        }
+    }
+
+    if (startup_upstream(&sc) != 0) {
+        perror("startup bench upstream");
+        return 1;
+    } else if (startup_snapshot(&sc) != 0) {
+        fprintf(stderr, "startup bench snapshot failed\n");
+        tiny_dns_udp_pool_close(&sc.pool);
+        close(sc.server);
+        return 1;
+    }
+
+    int failed = 0;
+    sc.names = 1;
+    failed += bench_run(cases[0], bench_startup_cold, &sc) != 0;
+    failed += bench_run(cases[1], bench_startup_warm, &sc) != 0;
+    sc.names = STARTUP_COLD_NAMES;
+    failed += bench_run(cases[2], bench_startup_cold, &sc) != 0;
+    sc.names = STARTUP_NAMES;
+    failed += bench_run(cases[3], bench_startup_warm, &sc) != 0;
+
+    unlink(sc.path);
+    tiny_dns_udp_pool_close(&sc.pool);
+    close(sc.server);
+    return failed;
+}
@@ -0,0 +1,368 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "bench.h"
+#include "pool.h"
+#include "resolver.h"
+#include "tiny_dns.h"
+#include "udp.h"
+
+#define UDP_BATCH_MAX  64
+#define UDP_MSG_MAX    512
+#define UDP_NAME_COUNT UDP_BATCH_MAX
+
+// A client and a stand-in server connected to each other on loopback. The server answers by
+// echoing each query with the QR bit set, so the time measured is almost all transport.
+struct udp_case {
+    int client;
+    int server;
+    size_t batch;
+    const char *names[UDP_NAME_COUNT];
+    struct tiny_dns_udp_msg queries[UDP_BATCH_MAX];
+    struct tiny_dns_udp_msg responses[UDP_BATCH_MAX];
+    struct tiny_dns_iter iters[UDP_BATCH_MAX];
+    tiny_dns_err errs[UDP_BATCH_MAX];
+    uint8_t query_buf[UDP_BATCH_MAX][UDP_MSG_MAX];
+    uint8_t response_buf[UDP_BATCH_MAX][UDP_MSG_MAX];
+    char name_buf[UDP_NAME_COUNT][32];
+};
+
+// Receive exactly @count messages. Loopback delivers during the send, so they are already queued.
+static int recv_all(int fd, struct tiny_dns_udp_msg *msgs, size_t count) {
+    size_t received = 0;
+    while (received < count) {
+        int n = tiny_dns_udp_recv(fd, &msgs[received], count - received);
+        if (n <= 0) {
+            return n < 0 ? n : -1;
+        }
+        received += (size_t)n;
+    }
+
+    return 0;
+}
+
+static int bench_udp_roundtrip(void *context, uint64_t *records, uint64_t *bytes) {
+    struct udp_case *uc = context;
+    size_t n = uc->batch;
+
+    tiny_dns_err err = tiny_dns_udp_build_queries(uc->queries, uc->names, n, 1, RR_TYPE_A);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    if (tiny_dns_udp_send(uc->client, uc->queries, n) != (int)n) {
+        return -1;
+    }
+
+    // Server side: the received queries become the responses
+    int ret = recv_all(uc->server, uc->responses, n);
+    if (ret != 0) {
+        return ret;
+    }
+    for (size_t i = 0; i < n; i++) {
+        uc->responses[i].data[2] |= 0x80;
+        uc->responses[i].peer_len = 0;
+    }
+    if (tiny_dns_udp_send(uc->server, uc->responses, n) != (int)n) {
+        return -1;
+    }
+
+    ret = recv_all(uc->client, uc->responses, n);
+    if (ret != 0) {
+        return ret;
+    }
+
+    if (tiny_dns_udp_parse_responses(uc->responses, uc->iters, uc->errs, n) != n) {
+        return -1;
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += uc->queries[i].len + uc->responses[i].len;
+    }
+
+    bench_sink += uc->iters[n - 1].header.id;
+    *records = n;
+    *bytes = total;
+    return 0;
+}
+
+static int connected_pair(int *client, int *server) {
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+
+    struct sockaddr_in client_addr;
+    *client = socket(AF_INET, SOCK_DGRAM, 0);
+    *server = socket(AF_INET, SOCK_DGRAM, 0);
+    if (*client < 0 || *server < 0 || bind(*server, (struct sockaddr *)&addr, len) < 0 ||
+        bind(*client, (struct sockaddr *)&addr, len) < 0) {
+        return -1;
+    }
+
+    socklen_t client_len = sizeof(client_addr);
+    if (getsockname(*server, (struct sockaddr *)&addr, &len) < 0 ||
+        getsockname(*client, (struct sockaddr *)&client_addr, &client_len) < 0 ||
+        connect(*client, (struct sockaddr *)&addr, len) < 0 ||
+        connect(*server, (struct sockaddr *)&client_addr, client_len) < 0) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// The resolver against the same echoing server, so the backends can be compared on equal terms
+struct resolver_case {
+    struct tiny_dns_resolver res;
+    int server;
+    size_t batch;
+    size_t answered;
+    const char *const *names;
+    void *contexts[UDP_BATCH_MAX];
+    struct tiny_dns_resolver_query queries[UDP_BATCH_MAX];
+    struct tiny_dns_resolver_query *buckets[UDP_BATCH_MAX * 2];
+    struct tiny_dns_udp_msg echo[UDP_BATCH_MAX];
+    uint8_t echo_buf[UDP_BATCH_MAX][UDP_MSG_MAX];
+};
+
+static void resolver_answered(struct tiny_dns_resolver_query *query, tiny_dns_err err,
+                              const uint8_t *response, size_t len, void *context) {
+    struct resolver_case *rc = context;
+    (void)query;
+    (void)response;
+
+    if (err == TINY_DNS_ERR_NONE) {
+        rc->answered++;
+        bench_sink += len;
+    }
+}
+
+static int bench_resolver_roundtrip(void *context, uint64_t *records, uint64_t *bytes) {
+    struct resolver_case *rc = context;
+    size_t n = rc->batch;
+
+    rc->answered = 0;
+    tiny_dns_err err = tiny_dns_resolver_submit_batch(&rc->res, rc->queries, rc->names, n,
+                                                      RR_TYPE_A, resolver_answered, rc->contexts);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    int ret = recv_all(rc->server, rc->echo, n);
+    if (ret != 0) {
+        return ret;
+    }
+
+    uint64_t total = 0;
+    for (size_t i = 0; i < n; i++) {
+        rc->echo[i].data[2] |= 0x80;
+        total += 2 * rc->echo[i].len;
+    }
+    if (tiny_dns_udp_send(rc->server, rc->echo, n) != (int)n) {
+        return -1;
+    }
+
+    while (rc->answered < n) {
+        if (tiny_dns_resolver_poll(&rc->res, 1000) <= 0) {
+            return -1;
+        }
+    }
+
+    *records = n;
+    *bytes = total;
+    return 0;
+}
+
+static int bench_resolver(struct udp_case *uc, enum tiny_dns_resolver_backend backend,
+                          const char *backend_name) {
+    static struct resolver_case rc;
+
+    struct sockaddr_in addr = { 0 };
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+
+    rc.server = socket(AF_INET, SOCK_DGRAM, 0);
+    if (rc.server < 0 || bind(rc.server, (struct sockaddr *)&addr, len) < 0 ||
+        getsockname(rc.server, (struct sockaddr *)&addr, &len) < 0) {
+        perror("resolver bench socket");
+        return 1;
+    }
+
+    struct tiny_dns_resolver_config config = {
+        .server_len = len,
+        .timeout_ms = 1000,
+        .attempts = 1,
+        .backend = backend,
+    };
+    memcpy(&config.server, &addr, len);
+    tiny_dns_err err = tiny_dns_resolver_init(&rc.res, &config, rc.buckets,
+                                              sizeof(rc.buckets) / sizeof(rc.buckets[0]));
+    if (err != TINY_DNS_ERR_NONE) {
+        // The io_uring backend is optional at build time and may be refused by the kernel
+        close(rc.server);
+        return 0;
+    }
+
+    rc.names = uc->names;
+    for (size_t i = 0; i < UDP_BATCH_MAX; i++) {
+        rc.contexts[i] = &rc;
+        rc.echo[i].data = rc.echo_buf[i];
+        rc.echo[i].capacity = UDP_MSG_MAX;
+    }
+
+    int failed = 0;
+    const size_t batches[] = { 1, 8, 32, 64 };
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        char name[64];
+        snprintf(name, sizeof(name), "resolver_roundtrip/%s/batch_%zu", backend_name, batches[b]);
+        rc.batch = batches[b];
+        failed += bench_run(name, bench_resolver_roundtrip, &rc) != 0;
+    }
+
+    tiny_dns_resolver_close(&rc.res);
+    close(rc.server);
+    return failed;
+}
+
+// One synchronous lookup at a time against the echoing server, with a socket opened per lookup
+// or leased from a pool
+struct lookup_case {
+    int server;
+    struct sockaddr_in addr;
+    struct tiny_dns_udp_pool pool;
+    struct tiny_dns_udp_pool_socket sockets[4];
+    uint8_t query[UDP_MSG_MAX];
+    size_t query_len;
+};
+
+static int lookup_echo(struct lookup_case *lc, int fd) {
+    uint8_t buf[UDP_MSG_MAX];
+    if (send(fd, lc->query, lc->query_len, 0) != (ssize_t)lc->query_len) {
+        return -1;
+    }
+
+    struct sockaddr_storage from;
+    socklen_t from_len = sizeof(from);
+    ssize_t len = recvfrom(lc->server, buf, sizeof(buf), 0, (struct sockaddr *)&from, &from_len);
+    if (len < 0) {
+        return -1;
+    }
+    buf[2] |= 0x80;
+    if (sendto(lc->server, buf, (size_t)len, 0, (struct sockaddr *)&from, from_len) != len) {
+        return -1;
+    }
+
+    len = recv(fd, buf, sizeof(buf), 0);
+    if (len < 0) {
+        return -1;
+    }
+
+    bench_sink += buf[0];
+    return (int)len;
+}
+
+static int bench_lookup_socket(void *context, uint64_t *records, uint64_t *bytes) {
+    struct lookup_case *lc = context;
+
+    int fd = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&lc->addr, sizeof(lc->addr)) < 0) {
+        return -1;
+    }
+    int len = lookup_echo(lc, fd);
+    close(fd);
+
+    *records = 1;
+    *bytes = (uint64_t)len;
+    return len < 0 ? len : 0;
+}
+
+static int bench_lookup_pool(void *context, uint64_t *records, uint64_t *bytes) {
+    struct lookup_case *lc = context;
+
+    struct tiny_dns_udp_pool_socket *sock = tiny_dns_udp_pool_lease(&lc->pool, 0);
+    if (!sock) {
+        return -1;
+    }
+    int len = lookup_echo(lc, sock->fd);
+    tiny_dns_udp_pool_release(&lc->pool, sock, len >= 0);
+
+    *records = 1;
+    *bytes = (uint64_t)len;
+    return len < 0 ? len : 0;
+}
+
+static int bench_lookup(void) {
+    static struct lookup_case lc;
+
+    socklen_t len = sizeof(lc.addr);
+    lc.addr.sin_family = AF_INET;
+    lc.addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    lc.server = socket(AF_INET, SOCK_DGRAM, 0);
+    if (lc.server < 0 || bind(lc.server, (struct sockaddr *)&lc.addr, len) < 0 ||
+        getsockname(lc.server, (struct sockaddr *)&lc.addr, &len) < 0) {
+        perror("lookup bench socket");
+        return 1;
+    }
+
+    lc.query_len = sizeof(lc.query);
+    struct tiny_dns_udp_upstream upstream = { .addr_len = len };
+    memcpy(&upstream.addr, &lc.addr, len);
+    struct tiny_dns_udp_pool_config config = { .upstreams = &upstream, .upstream_count = 1 };
+    if (tiny_dns_build_query(lc.query, &lc.query_len, 1, "www.example.com", RR_TYPE_A) !=
+            TINY_DNS_ERR_NONE ||
+        tiny_dns_udp_pool_init(&lc.pool, &config, lc.sockets, 4) != TINY_DNS_ERR_NONE) {
+        close(lc.server);
+        return 1;
+    }
+
+    int failed = 0;
+    failed += bench_run("udp_lookup/socket_per_query", bench_lookup_socket, &lc) != 0;
+    failed += bench_run("udp_lookup/pool", bench_lookup_pool, &lc) != 0;
+
+    tiny_dns_udp_pool_close(&lc.pool);
+    close(lc.server);
+    return failed;
+}
+
+int bench_suite_udp(void) {
+    static struct udp_case uc;
+
+    if (connected_pair(&uc.client, &uc.server) != 0) {
+        perror("udp bench sockets");
+        return 1;
+    }
+
+    for (size_t i = 0; i < UDP_BATCH_MAX; i++) {
+        snprintf(uc.name_buf[i], sizeof(uc.name_buf[i]), "host%zu.example.com", i);
+        uc.names[i] = uc.name_buf[i];
+        uc.queries[i].data = uc.query_buf[i];
+        uc.queries[i].capacity = UDP_MSG_MAX;
+        uc.queries[i].peer_len = 0;
+        uc.responses[i].data = uc.response_buf[i];
+        uc.responses[i].capacity = UDP_MSG_MAX;
+    }
+
+    // Batch size 1 is the one system call per packet baseline
+    int failed = 0;
+    const size_t batches[] = { 1, 8, 32, 64 };
+    for (size_t b = 0; b < sizeof(batches) / sizeof(batches[0]); b++) {
+        char name[64];
+        snprintf(name, sizeof(name), "udp_roundtrip/batch_%zu", batches[b]);
+        uc.batch = batches[b];
+        failed += bench_run(name, bench_udp_roundtrip, &uc) != 0;
+    }
+
+    failed += bench_resolver(&uc, TINY_DNS_RESOLVER_EPOLL, "epoll");
+    failed += bench_resolver(&uc, TINY_DNS_RESOLVER_IO_URING, "io_uring");
+    failed += bench_lookup();
+
+    close(uc.client);
+    close(uc.server);
+    return failed;
+}
@@ -0,0 +1,381 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "corpus.h"
+#include "io.h"
+#include "label.h"
+#include "tiny_dns.h"
+
+// The question name always directly follows the 12 byte header
+#define QNAME_OFFSET 12
+#define NO_SUFFIX    -1
+
+#define ANCOUNT_OFFSET 6
+
+// Opaque type used to smuggle name fragments into a message
+#define RR_TYPE_OPAQUE 0xFF00
+
+static struct corpus_msg corpus[CORPUS_COUNT];
+static struct corpus_msg adversarial[ADVERSARIAL_COUNT];
+
+static size_t put_header(IOWriter *wr, uint16_t ancount, uint16_t nscount, uint16_t arcount) {
+    io_writer_put_u16(wr, 0x1234);
+    // QR, RD, RA, NOERROR
+    io_writer_put_u16(wr, 0x8180);
+    io_writer_put_u16(wr, 1);
+    io_writer_put_u16(wr, ancount);
+    io_writer_put_u16(wr, nscount);
+    io_writer_put_u16(wr, arcount);
+    return wr->len;
+}
+
+// Write the dotted labels of @text followed by a pointer to @suffix, or the root label if @suffix
+// is NO_SUFFIX. Returns the offset the name was written at.
+static size_t put_name(IOWriter *wr, const char *text, int suffix) {
+    size_t start = wr->len;
+
+    while (text && *text) {
+        const char *dot = strchr(text, '.');
+        size_t len = dot ? (size_t)(dot - text) : strlen(text);
+        uint8_t prefix = (uint8_t)len;
+        io_writer_put(wr, &prefix, 1);
+        io_writer_put(wr, text, len);
+        text += len + (dot ? 1 : 0);
+    }
+
+    if (suffix == NO_SUFFIX) {
+        io_writer_put(wr, "", 1);
+    } else {
+        io_writer_put_u16(wr, 0xC000 | (uint16_t)suffix);
+    }
+
+    return start;
+}
+
+static void put_question(IOWriter *wr, const char *qname, enum tiny_dns_rr_type qtype) {
+    put_name(wr, qname, NO_SUFFIX);
+    io_writer_put_u16(wr, qtype);
+    io_writer_put_u16(wr, CLASS_IN);
+}
+
+static void put_rr_fixed(IOWriter *wr, enum tiny_dns_rr_type atype, uint32_t ttl) {
+    io_writer_put_u16(wr, atype);
+    io_writer_put_u16(wr, CLASS_IN);
+    io_writer_put_u32(wr, ttl);
+}
+
+static void put_rr(IOWriter *wr, size_t owner, enum tiny_dns_rr_type atype, const void *rdata,
+                   uint16_t rdlength) {
+    io_writer_put_u16(wr, 0xC000 | (uint16_t)owner);
+    put_rr_fixed(wr, atype, 300);
+    io_writer_put_u16(wr, rdlength);
+    io_writer_put(wr, rdata, rdlength);
+}
+
+// Reserve the rdlength field, to be patched by end_rdata once the rdata is written
+static size_t begin_rdata(IOWriter *wr) {
+    size_t rdlength_at = wr->len;
+    io_writer_put_u16(wr, 0);
+    return rdlength_at;
+}
+
+static void patch_u16(IOWriter *wr, size_t offset, uint16_t value) {
+    wr->base[offset] = (char)(value >> 8);
+    wr->base[offset + 1] = (char)(value & 0xFF);
+}
+
+static void end_rdata(IOWriter *wr, size_t rdlength_at) {
+    patch_u16(wr, rdlength_at, (uint16_t)(wr->len - rdlength_at - 2));
+}
+
+static void finish(struct corpus_msg *msg, const char *name, IOWriter *wr, size_t records) {
+    msg->name = name;
+    msg->len = wr->len;
+    msg->records = records;
+}
+
+static void build_a_aaaa(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, sizeof(msg->data));
+
+    put_header(&wr, 32, 0, 0);
+    put_question(&wr, "www.example.com", RR_TYPE_A);
+
+    for (uint8_t i = 0; i < 16; i++) {
+        uint8_t a[4] = { 192, 0, 2, i };
+        put_rr(&wr, QNAME_OFFSET, RR_TYPE_A, a, sizeof(a));
+    }
+
+    for (uint8_t i = 0; i < 16; i++) {
+        uint8_t aaaa[16] = { 0x20, 0x01, 0x0d, 0xb8 };
+        aaaa[15] = i;
+        put_rr(&wr, QNAME_OFFSET, RR_TYPE_AAAA, aaaa, sizeof(aaaa));
+    }
+
+    finish(msg, "a_aaaa", &wr, 32);
+}
+
+static void build_cname_chain(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, sizeof(msg->data));
+
+    const size_t hops = 12;
+    const size_t addrs = 4;
+
+    put_header(&wr, (uint16_t)(hops + addrs), 0, 0);
+    put_question(&wr, "www.example.com", RR_TYPE_A);
+
+    // "example.com" suffix of the question name
+    const int suffix = QNAME_OFFSET + 4;
+    size_t owner = QNAME_OFFSET;
+
+    for (size_t i = 0; i < hops; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), "hop%zu.cdn", i);
+
+        io_writer_put_u16(&wr, 0xC000 | (uint16_t)owner);
+        put_rr_fixed(&wr, RR_TYPE_CNAME, 300);
+        size_t rdlength_at = begin_rdata(&wr);
+        owner = put_name(&wr, label, suffix);
+        end_rdata(&wr, rdlength_at);
+    }
+
+    for (uint8_t i = 0; i < addrs; i++) {
+        uint8_t a[4] = { 198, 51, 100, i };
+        put_rr(&wr, owner, RR_TYPE_A, a, sizeof(a));
+    }
+
+    finish(msg, "cname_chain", &wr, hops + addrs);
+}
+
+static void build_srv_large(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, sizeof(msg->data));
+
+    const size_t targets = 24;
+
+    put_header(&wr, (uint16_t)targets, 0, (uint16_t)targets);
+    put_question(&wr, "_svc._tcp.example.com", RR_TYPE_SRV);
+
+    // "example.com" suffix of the question name
+    const int suffix = QNAME_OFFSET + 5 + 5;
+    size_t target_at[24];
+
+    for (size_t i = 0; i < targets; i++) {
+        char label[16];
+        snprintf(label, sizeof(label), "node%02zu", i);
+
+        io_writer_put_u16(&wr, 0xC000 | QNAME_OFFSET);
+        put_rr_fixed(&wr, RR_TYPE_SRV, 60);
+        size_t rdlength_at = begin_rdata(&wr);
+        io_writer_put_u16(&wr, 10);
+        io_writer_put_u16(&wr, (uint16_t)(i * 5));
+        io_writer_put_u16(&wr, 8080);
+        target_at[i] = put_name(&wr, label, suffix);
+        end_rdata(&wr, rdlength_at);
+    }
+
+    // Glue
+    for (size_t i = 0; i < targets; i++) {
+        uint8_t a[4] = { 203, 0, 113, (uint8_t)i };
+        put_rr(&wr, target_at[i], RR_TYPE_A, a, sizeof(a));
+    }
+
+    finish(msg, "srv_large", &wr, targets * 2);
+}
+
+static void build_deep_compression(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, sizeof(msg->data));
+
+    const size_t depth = 24;
+    const size_t repeats = 8;
+
+    put_header(&wr, (uint16_t)(depth + repeats), 0, 0);
+    put_question(&wr, "a.example.com", RR_TYPE_A);
+
+    // Every owner name is a single label followed by a pointer to the previous owner name, so the
+    // nth record is reached through n pointer hops.
+    size_t prev = QNAME_OFFSET;
+    for (size_t i = 0; i < depth; i++) {
+        char label[8];
+        snprintf(label, sizeof(label), "l%02zu", i);
+
+        size_t owner = put_name(&wr, label, (int)prev);
+        put_rr_fixed(&wr, RR_TYPE_A, 300);
+        io_writer_put_u16(&wr, 4);
+        uint8_t a[4] = { 10, 0, 0, (uint8_t)i };
+        io_writer_put(&wr, a, sizeof(a));
+        prev = owner;
+    }
+
+    for (uint8_t i = 0; i < repeats; i++) {
+        uint8_t a[4] = { 10, 0, 1, i };
+        put_rr(&wr, prev, RR_TYPE_A, a, sizeof(a));
+    }
+
+    finish(msg, "deep_compression", &wr, depth + repeats);
+}
+
+static void build_txt(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, sizeof(msg->data));
+
+    const size_t records = 16;
+
+    put_header(&wr, (uint16_t)records, 0, 0);
+    put_question(&wr, "txt.example.com", RR_TYPE_TXT);
+
+    for (size_t i = 0; i < records; i++) {
+        char txt[121];
+        txt[0] = 120;
+        for (size_t j = 1; j < sizeof(txt); j++) {
+            txt[j] = (char)('a' + (i + j) % 26);
+        }
+        put_rr(&wr, QNAME_OFFSET, RR_TYPE_TXT, txt, sizeof(txt));
+    }
+
+    finish(msg, "txt", &wr, records);
+}
+
+const struct corpus_msg *corpus_get(void) {
+    static bool built = false;
+    if (!built) {
+        build_a_aaaa(&corpus[CORPUS_A_AAAA]);
+        build_cname_chain(&corpus[CORPUS_CNAME_CHAIN]);
+        build_srv_large(&corpus[CORPUS_SRV_LARGE]);
+        build_deep_compression(&corpus[CORPUS_DEEP_COMPRESSION]);
+        build_txt(&corpus[CORPUS_TXT]);
+        built = true;
+    }
+
+    return corpus;
+}
+
+static void build_self_pointer(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, CORPUS_ADVERSARIAL_MAX);
+
+    put_header(&wr, 1, 0, 0);
+    put_question(&wr, "www.example.com", RR_TYPE_A);
+
+    uint16_t owner = (uint16_t)wr.len;
+    io_writer_put_u16(&wr, 0xC000 | owner);
+    put_rr_fixed(&wr, RR_TYPE_A, 300);
+    io_writer_put_u16(&wr, 4);
+    io_writer_put_u32(&wr, 0xC0000201);
+
+    finish(msg, "self_pointer", &wr, 0);
+}
+
+static void build_mutual_pointers(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, CORPUS_ADVERSARIAL_MAX);
+
+    put_header(&wr, 2, 0, 0);
+    put_question(&wr, "www.example.com", RR_TYPE_A);
+
+    // Two owner names pointing at each other
+    size_t first = wr.len;
+    size_t second = first + 2 + 10 + 4;
+    for (size_t i = 0; i < 2; i++) {
+        io_writer_put_u16(&wr, 0xC000 | (uint16_t)(i == 0 ? second : first));
+        put_rr_fixed(&wr, RR_TYPE_A, 300);
+        io_writer_put_u16(&wr, 4);
+        io_writer_put_u32(&wr, 0xC0000201);
+    }
+
+    finish(msg, "mutual_pointers", &wr, 0);
+}
+
+static void build_hop_chain(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, CORPUS_ADVERSARIAL_MAX);
+
+    const size_t hops = LABEL_MAX_PTR_HOPS - 1;
+    const size_t targets = 9;
+    const size_t rr_len = 2 + 10 + 4;
+
+    put_header(&wr, 0, 0, 0);
+    put_question(&wr, "www.example.com", RR_TYPE_A);
+
+    // A single label followed by a chain of pointers, each pointing at the previous one
+    io_writer_put_u16(&wr, 0xC000 | QNAME_OFFSET);
+    put_rr_fixed(&wr, RR_TYPE_OPAQUE, 300);
+    size_t rdlength_at = begin_rdata(&wr);
+    size_t prev = put_name(&wr, "x", NO_SUFFIX);
+    size_t chain[LABEL_MAX_PTR_HOPS];
+    for (size_t i = 0; i < hops; i++) {
+        chain[i] = wr.len;
+        io_writer_put_u16(&wr, 0xC000 | (uint16_t)prev);
+        prev = chain[i];
+    }
+    end_rdata(&wr, rdlength_at);
+
+    // Owners cycle through more chain ends than the memo has slots, so every lookup misses
+    size_t records = 1;
+    for (size_t i = 0; wr.len + rr_len <= CORPUS_ADVERSARIAL_MAX; i++) {
+        uint8_t a[4] = { 192, 0, 2, (uint8_t)i };
+        put_rr(&wr, chain[hops - 1 - i % targets], RR_TYPE_A, a, sizeof(a));
+        records++;
+    }
+
+    patch_u16(&wr, ANCOUNT_OFFSET, (uint16_t)records);
+    finish(msg, "hop_chain", &wr, records);
+}
+
+static void build_long_names(struct corpus_msg *msg) {
+    IOWriter wr;
+    io_writer_init(&wr, msg->data, CORPUS_ADVERSARIAL_MAX);
+
+    const size_t rr_len = 2 + 10 + 4;
+
+    put_header(&wr, 0, 0, 0);
+    put_question(&wr, "www.example.com", RR_TYPE_A);
+
+    // Three 63 octet labels, then two different final labels bringing each name to 255 octets
+    io_writer_put_u16(&wr, 0xC000 | QNAME_OFFSET);
+    put_rr_fixed(&wr, RR_TYPE_OPAQUE, 300);
+    size_t rdlength_at = begin_rdata(&wr);
+
+    char label[LABEL_MAX_LEN + 1];
+    int prev = NO_SUFFIX;
+    for (size_t i = 0; i < 3; i++) {
+        memset(label, 'a' + (char)i, LABEL_MAX_LEN);
+        label[LABEL_MAX_LEN] = '\0';
+        prev = (int)put_name(&wr, label, prev);
+    }
+
+    size_t longest[2];
+    for (size_t i = 0; i < 2; i++) {
+        memset(label, 'x' + (char)i, LABEL_MAX_LEN - 2);
+        label[LABEL_MAX_LEN - 2] = '\0';
+        longest[i] = put_name(&wr, label, prev);
+    }
+    end_rdata(&wr, rdlength_at);
+
+    // Alternate between the two, so each suffix evicts the other from the memo
+    size_t records = 1;
+    for (size_t i = 0; wr.len + rr_len <= CORPUS_ADVERSARIAL_MAX; i++) {
+        uint8_t a[4] = { 192, 0, 2, (uint8_t)i };
+        put_rr(&wr, longest[i % 2], RR_TYPE_A, a, sizeof(a));
+        records++;
+    }
+
+    patch_u16(&wr, ANCOUNT_OFFSET, (uint16_t)records);
+    finish(msg, "long_names", &wr, records);
+}
+
+const struct corpus_msg *corpus_adversarial_get(void) {
+    static bool built = false;
+    if (!built) {
+        build_self_pointer(&adversarial[ADVERSARIAL_SELF_POINTER]);
+        build_mutual_pointers(&adversarial[ADVERSARIAL_MUTUAL_POINTERS]);
+        build_hop_chain(&adversarial[ADVERSARIAL_HOP_CHAIN]);
+        build_long_names(&adversarial[ADVERSARIAL_LONG_NAMES]);
+        built = true;
+    }
+
+    return adversarial;
+}
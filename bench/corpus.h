@@ -0,0 +1,52 @@
+/// \internal @file corpus.h
+/// @brief Synthesized DNS responses used as benchmark input
+
+#ifndef TINY_DNS_BENCH_CORPUS_H
+#define TINY_DNS_BENCH_CORPUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CORPUS_MSG_MAX 4096
+
+struct corpus_msg {
+    const char *name;
+    uint8_t data[CORPUS_MSG_MAX];
+    size_t len;
+    // Total RRs across answer, authority and additional sections
+    size_t records;
+};
+
+enum corpus_id {
+    CORPUS_A_AAAA = 0,
+    CORPUS_CNAME_CHAIN,
+    CORPUS_SRV_LARGE,
+    CORPUS_DEEP_COMPRESSION,
+    CORPUS_TXT,
+    CORPUS_COUNT,
+};
+
+// Adversarial messages stay within the classic UDP limit, like an attacker's would
+#define CORPUS_ADVERSARIAL_MAX 512
+
+enum corpus_adversarial_id {
+    ADVERSARIAL_SELF_POINTER = 0,
+    ADVERSARIAL_MUTUAL_POINTERS,
+    ADVERSARIAL_HOP_CHAIN,
+    ADVERSARIAL_LONG_NAMES,
+    ADVERSARIAL_COUNT,
+};
+
+/// @brief Build the corpus. Output is deterministic, so results are comparable between runs.
+///
+/// @return The corpus, indexed by enum corpus_id
+const struct corpus_msg *corpus_get(void);
+
+/// @brief Build messages crafted to maximize decompression work per byte
+///     For these, corpus_msg.records counts the records a bounded parser accepts before it
+///     rejects the message.
+///
+/// @return The adversarial corpus, indexed by enum corpus_adversarial_id
+const struct corpus_msg *corpus_adversarial_get(void);
+
+#endif  // TINY_DNS_BENCH_CORPUS_H
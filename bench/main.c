@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+
+#define DEFAULT_MIN_TIME_MS 200
+
+volatile uint64_t bench_sink;
+
+static uint64_t min_time_ns = DEFAULT_MIN_TIME_MS * 1000000ull;
+static char **filters;
+static int filter_count;
+
+uint64_t bench_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+bool bench_selected(const char *name) {
+    if (filter_count == 0) {
+        return true;
+    }
+
+    for (int i = 0; i < filter_count; i++) {
+        if (strstr(name, filters[i])) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int bench_run(const char *name, bench_fn fn, void *context) {
+    struct bench_result res;
+    return bench_measure(name, fn, context, &res);
+}
+
+int bench_measure(const char *name, bench_fn fn, void *context, struct bench_result *out) {
+    struct bench_result res = { .name = name };
+    *out = res;
+
+    if (!bench_selected(name)) {
+        return 0;
+    }
+
+    uint64_t records = 0;
+    uint64_t bytes = 0;
+
+    // Warm up caches and catch broken cases before timing anything
+    int err = fn(context, &records, &bytes);
+    if (err) {
+        fprintf(stderr, "%s: failed with %d\n", name, err);
+        return err;
+    }
+
+    uint64_t batch = 1;
+    uint64_t start = bench_now_ns();
+    while (res.elapsed_ns < min_time_ns) {
+        for (uint64_t i = 0; i < batch; i++) {
+            records = 0;
+            bytes = 0;
+            err = fn(context, &records, &bytes);
+            if (err) {
+                fprintf(stderr, "%s: failed with %d\n", name, err);
+                return err;
+            }
+
+            res.records += records;
+            res.bytes += bytes;
+        }
+
+        res.messages += batch;
+        res.elapsed_ns = bench_now_ns() - start;
+        batch *= 2;
+    }
+
+    bench_report(&res);
+    *out = res;
+    return 0;
+}
+
+void bench_report(const struct bench_result *res) {
+    double seconds = (double)res->elapsed_ns / 1e9;
+    double ns_per_msg = (double)res->elapsed_ns / (double)res->messages;
+    double records_per_sec = (double)res->records / seconds;
+    double mbytes_per_sec = (double)res->bytes / seconds / 1e6;
+
+    printf("%-40s %12.1f ns/msg %14.0f rec/s %10.1f MB/s\n", res->name, ns_per_msg, records_per_sec,
+           mbytes_per_sec);
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "usage: %s [-t min_time_ms] [filter...]\n", prog);
+    fprintf(stderr, "  Runs every case whose name contains any of the filters, or all cases.\n");
+}
+
+int main(int argc, char *argv[]) {
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; i++) {
+        if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            min_time_ns = strtoull(argv[++i], NULL, 10) * 1000000ull;
+        } else {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    filters = &argv[i];
+    filter_count = argc - i;
+
+    int failed = 0;
+    failed += bench_suite_parse();
+    failed += bench_suite_adversarial();
+    failed += bench_suite_index();
+    failed += bench_suite_build();
+    failed += bench_suite_cache();
+#ifdef TINY_DNS_BENCH_UDP
+    failed += bench_suite_udp();
+    failed += bench_suite_startup();
+    failed += bench_suite_prefetch();
+#endif
+
+    if (failed) {
+        fprintf(stderr, "%d case%s failed\n", failed, failed == 1 ? "" : "s");
+        return 1;
+    }
+    return 0;
+}
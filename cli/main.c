@@ -3,6 +3,7 @@
 #include <ctype.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
@@ -10,6 +11,10 @@
 
 #include "tiny_dns.h"
 
+#ifdef TINY_DNS_CLI_POOL
+    #include "pool.h"
+#endif
+
 void hexdump(const char *label, const void *data, size_t len) {
     const uint8_t *buf = data;
     printf("%s\n", label);
@@ -25,47 +30,146 @@ void hexdump(const char *label, const void *data, size_t len) {
     printf("\n");
 }
 
-static ssize_t query_send_recv(uint8_t *buffer, size_t len, size_t max, const char *server) {
-    int udp = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
-    if (udp < 0) {
-        perror("socket");
-        return -errno;
+#define SERVERS_MAX     4
+#define RECV_TIMEOUT_MS 2000
+
+// Sockets per nameserver. The pool is opened once in main, so every lookup leases from it.
+#define POOL_SOCKETS_PER_SERVER 2
+
+struct servers {
+    const char **names;
+    struct sockaddr_in addrs[SERVERS_MAX];
+    size_t count;
+#ifdef TINY_DNS_CLI_POOL
+    struct tiny_dns_udp_pool pool;
+    struct tiny_dns_udp_pool_socket sockets[SERVERS_MAX * POOL_SOCKETS_PER_SERVER];
+#endif
+};
+
+static int servers_open(struct servers *servers, const char *nameservers[]) {
+    servers->names = nameservers;
+    servers->count = 0;
+    for (; nameservers[servers->count] != NULL && servers->count < SERVERS_MAX; servers->count++) {
+        struct sockaddr_in *addr = &servers->addrs[servers->count];
+        memset(addr, 0, sizeof(*addr));
+        addr->sin_family = AF_INET;
+        addr->sin_port = htons(53);
+        if (inet_pton(AF_INET, nameservers[servers->count], &addr->sin_addr) != 1) {
+            fprintf(stderr, "bad nameserver address: %s\n", nameservers[servers->count]);
+            return -1;
+        }
     }
 
-    struct sockaddr_in addr = { 0 };
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(53);
-    if (inet_pton(AF_INET, server, &addr.sin_addr) != 1) {
-        perror("inet_pton");
-        return -errno;
+#ifdef TINY_DNS_CLI_POOL
+    struct tiny_dns_udp_upstream upstreams[SERVERS_MAX];
+    for (size_t i = 0; i < servers->count; i++) {
+        memset(&upstreams[i], 0, sizeof(upstreams[i]));
+        memcpy(&upstreams[i].addr, &servers->addrs[i], sizeof(servers->addrs[i]));
+        upstreams[i].addr_len = sizeof(servers->addrs[i]);
+    }
+
+    struct tiny_dns_udp_pool_config config = {
+        .upstreams = upstreams,
+        .upstream_count = servers->count,
+        .recv_timeout_ms = RECV_TIMEOUT_MS,
+    };
+    tiny_dns_err err = tiny_dns_udp_pool_init(&servers->pool, &config, servers->sockets,
+                                              servers->count * POOL_SOCKETS_PER_SERVER);
+    if (err != TINY_DNS_ERR_NONE) {
+        printf("socket pool err: %d\n", err);
+        return -1;
     }
+#endif
 
-    ssize_t err = sendto(udp, buffer, len, 0, (struct sockaddr *)&addr, sizeof(addr));
-    if (err < 0) {
-        perror("sendto");
+    return 0;
+}
+
+static void servers_close(struct servers *servers) {
+#ifdef TINY_DNS_CLI_POOL
+    tiny_dns_udp_pool_close(&servers->pool);
+#else
+    (void)servers;
+#endif
+}
+
+// Send @query on the connected @fd and wait for the reply carrying its ID. Anything else that
+// arrives, a late answer to an earlier query or a spoofing attempt, is dropped.
+static ssize_t exchange(int fd, const uint8_t *query, size_t len, uint8_t *response, size_t max) {
+    if (send(fd, query, len, 0) < 0) {
+        perror("send");
         return -errno;
     }
 
-    err = recvfrom(udp, buffer, max, 0, NULL, 0);
-    if (err < 0) {
-        perror("recvfrom");
+    for (;;) {
+        ssize_t n = recv(fd, response, max, 0);
+        if (n < 0) {
+            perror("recv");
+            return -errno;
+        }
+
+        if (n >= 2 && response[0] == query[0] && response[1] == query[1]) {
+            return n;
+        }
+        fprintf(stderr, "dropping reply with mismatched ID\n");
+    }
+}
+
+#ifdef TINY_DNS_CLI_POOL
+static ssize_t query_send_recv(struct servers *servers, size_t server, const uint8_t *query,
+                               size_t len, uint8_t *response, size_t max) {
+    struct tiny_dns_udp_pool_socket *sock = tiny_dns_udp_pool_lease(&servers->pool, server);
+    if (!sock) {
+        fprintf(stderr, "no socket available\n");
+        return -EAGAIN;
+    }
+
+    ssize_t err = exchange(sock->fd, query, len, response, max);
+
+    // A socket that timed out or failed is reopened on a fresh port
+    tiny_dns_udp_pool_release(&servers->pool, sock, err >= 0);
+
+    return err;
+}
+#else
+// Without the resolver library there's no pool, so each lookup opens a socket of its own
+static ssize_t query_send_recv(struct servers *servers, size_t server, const uint8_t *query,
+                               size_t len, uint8_t *response, size_t max) {
+    int udp = socket(PF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (udp < 0) {
+        perror("socket");
         return -errno;
     }
 
+    struct timeval timeout = {
+        .tv_sec = RECV_TIMEOUT_MS / 1000,
+        .tv_usec = (RECV_TIMEOUT_MS % 1000) * 1000,
+    };
+    ssize_t err;
+    if (setsockopt(udp, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0 ||
+        connect(udp, (const struct sockaddr *)&servers->addrs[server],
+                sizeof(servers->addrs[server])) < 0) {
+        perror("connect");
+        err = -errno;
+    } else {
+        err = exchange(udp, query, len, response, max);
+    }
+
     close(udp);
 
     return err;
 }
+#endif
 
-static int resolve_query(const char *nameservers[], uint8_t *buffer, size_t *len, size_t max) {
-    hexdump("Query------------", buffer, *len);
+static int resolve_query(struct servers *servers, const uint8_t *query, size_t query_len,
+                         uint8_t *buffer, size_t *len) {
+    hexdump("Query------------", query, query_len);
 
-    size_t query_len = *len;
+    size_t max = *len;
     *len = 0;
 
-    for (const char *srv = nameservers[0]; srv != NULL; srv++) {
-        printf("Querying server %s\n", srv);
-        ssize_t err = query_send_recv(buffer, query_len, max, srv);
+    for (size_t i = 0; i < servers->count; i++) {
+        printf("Querying server %s\n", servers->names[i]);
+        ssize_t err = query_send_recv(servers, i, query, query_len, buffer, max);
         if (err < 0) {
             continue;
         }
@@ -76,7 +180,7 @@ static int resolve_query(const char *nameservers[], uint8_t *buffer, size_t *len
 
     hexdump("Response------------", buffer, *len);
 
-    return 0;
+    return *len > 0 ? 0 : -1;
 }
 
 static enum tiny_dns_rr_type rr_type_from_str(const char *str) {
@@ -86,6 +190,8 @@ static enum tiny_dns_rr_type rr_type_from_str(const char *str) {
         return RR_TYPE_TXT;
     } else if (strcmp(str, "srv") == 0 || strcmp(str, "SRV") == 0) {
         return RR_TYPE_SRV;
+    } else if (strcmp(str, "soa") == 0 || strcmp(str, "SOA") == 0) {
+        return RR_TYPE_SOA;
     }
 
     return RR_TYPE_A;
@@ -127,6 +233,19 @@ static void rr_foreach(struct tiny_dns_iter *iter, const struct tiny_dns_rr *rr,
         case RR_TYPE_CNAME:
             printf("RR CNAME: %s\n", rr->rdata.rr_cname.name);
             break;
+        case RR_TYPE_SOA: {
+            struct tiny_dns_name mname;
+            struct tiny_dns_name rname;
+            if (tiny_dns_name_view_decode(&rr->rdata.rr_soa.mname, &mname) < 0 ||
+                tiny_dns_name_view_decode(&rr->rdata.rr_soa.rname, &rname) < 0) {
+                printf("RR SOA: <invalid>\n");
+                break;
+            }
+            printf("RR SOA: %s %s %u %u %u %u %u\n", mname.name, rname.name,
+                   rr->rdata.rr_soa.serial, rr->rdata.rr_soa.refresh, rr->rdata.rr_soa.retry,
+                   rr->rdata.rr_soa.expire, rr->rdata.rr_soa.minimum);
+            break;
+        }
         case RR_TYPE_SRV:
             printf("RR SRV: %u %u %u %s\n", rr->rdata.rr_srv.priority, rr->rdata.rr_srv.weight,
                    rr->rdata.rr_srv.port, rr->rdata.rr_srv.target.name);
@@ -142,6 +261,8 @@ static void rr_foreach(struct tiny_dns_iter *iter, const struct tiny_dns_rr *rr,
 }
 
 int main(int argc, char *argv[]) {
+    static struct servers servers;
+    uint8_t query[512] = { 0 };
     uint8_t buffer[512] = { 0 };
 
     enum tiny_dns_rr_type qtype = RR_TYPE_A;
@@ -149,8 +270,8 @@ int main(int argc, char *argv[]) {
         qtype = rr_type_from_str(argv[3]);
     }
 
-    size_t len = sizeof(buffer);
-    tiny_dns_err err = tiny_dns_build_query(buffer, &len, 0xdb42, argv[2], qtype);
+    size_t query_len = sizeof(query);
+    tiny_dns_err err = tiny_dns_build_query(query, &query_len, 0xdb42, argv[2], qtype);
     if (err != TINY_DNS_ERR_NONE) {
         printf("build query err: %d\n", err);
         return 1;
@@ -161,7 +282,17 @@ int main(int argc, char *argv[]) {
         NULL,
     };
 
-    resolve_query(nameservers, buffer, &len, sizeof(buffer));
+    if (servers_open(&servers, nameservers) < 0) {
+        return 1;
+    }
+
+    size_t len = sizeof(buffer);
+    int ret = resolve_query(&servers, query, query_len, buffer, &len);
+    servers_close(&servers);
+    if (ret < 0) {
+        printf("no response\n");
+        return 1;
+    }
 
     struct tiny_dns_iter iter;
     err = tiny_dns_iter_init(&iter, buffer, len);
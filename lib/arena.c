@@ -0,0 +1,260 @@
+#include <string.h>
+
+#include "label.h"
+#include "rdata.h"
+#include "tiny_dns.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+// Root label, type, class, TTL and rdlength
+#define RR_MIN_LEN 11
+
+// Enough for every member of struct tiny_dns_rr_arena on the platforms we target
+#define ARENA_RECORD_ALIGN 8
+
+void tiny_dns_arena_init(struct tiny_dns_arena *arena, void *mem, size_t capacity) {
+    arena->base = mem;
+    arena->capacity = capacity;
+    arena->len = 0;
+}
+
+void tiny_dns_arena_reset(struct tiny_dns_arena *arena) {
+    arena->len = 0;
+}
+
+static void *arena_alloc(struct tiny_dns_arena *arena, size_t len) {
+    if (len > arena->capacity - arena->len) {
+        return NULL;
+    }
+
+    void *mem = arena->base + arena->len;
+    arena->len += len;
+    return mem;
+}
+
+// Decode the name at the current position of rdr straight into the arena
+static tiny_dns_err arena_name(struct tiny_dns_arena *arena, IOReader *rdr,
+                               struct tiny_dns_label_memo *memo,
+                               struct tiny_dns_arena_name *name) {
+    IOWriter wr;
+    io_writer_init(&wr, arena->base + arena->len, arena->capacity - arena->len);
+
+    int err = tiny_dns_label_parse_memo(&wr, rdr, memo);
+    if (err == IO_BUF_TOO_SMALL) {
+        return TINY_DNS_ERR_NO_SPACE;
+    } else if (err < IO_SUCCESS) {
+        return err;
+    }
+
+    // The output is the name with a leading dot and the root label as NUL terminator, except for
+    // the root name, which is the NUL terminator alone.
+    size_t len = wr.len > 1 ? wr.len - 2 : 0;
+    if (len > 0) {
+        memmove(wr.base, wr.base + 1, len + 1);
+    }
+
+    name->name = wr.base;
+    name->len = (uint16_t)len;
+    arena->len += len + 1;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+static tiny_dns_err arena_copy(struct tiny_dns_arena *arena, IOReader *span, const char **data,
+                               size_t len) {
+    const char *raw;
+    int err = io_reader_get_raw(span, &raw, len);
+    if (err < IO_SUCCESS || (size_t)err != len) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    char *copy = arena_alloc(arena, len);
+    if (!copy && len > 0) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    memcpy(copy, raw, len);
+    *data = copy;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+static tiny_dns_err arena_rdata(struct tiny_dns_arena *arena, IOReader *span,
+                                struct tiny_dns_label_memo *memo, struct tiny_dns_rr_arena *rr) {
+    int err = TINY_DNS_ERR_NONE;
+    switch (rr->atype) {
+        case RR_TYPE_A:
+            if (rr->rdlength != sizeof(rr->rdata.rr_a)) {
+                return TINY_DNS_ERR_INVALID;
+            }
+            memcpy(rr->rdata.rr_a, span->ptr, sizeof(rr->rdata.rr_a));
+            break;
+        case RR_TYPE_AAAA:
+            if (rr->rdlength != sizeof(rr->rdata.rr_aaaa)) {
+                return TINY_DNS_ERR_INVALID;
+            }
+            memcpy(rr->rdata.rr_aaaa, span->ptr, sizeof(rr->rdata.rr_aaaa));
+            break;
+        case RR_TYPE_CNAME:
+            err = arena_name(arena, span, memo, &rr->rdata.rr_cname);
+            break;
+        case RR_TYPE_SOA:
+            err = arena_name(arena, span, memo, &rr->rdata.rr_soa.mname);
+            if (!IS_ERR(err)) {
+                err = arena_name(arena, span, memo, &rr->rdata.rr_soa.rname);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u32(span, &rr->rdata.rr_soa.serial);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u32(span, &rr->rdata.rr_soa.refresh);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u32(span, &rr->rdata.rr_soa.retry);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u32(span, &rr->rdata.rr_soa.expire);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u32(span, &rr->rdata.rr_soa.minimum);
+            }
+            break;
+        case RR_TYPE_SRV:
+            err = io_reader_get_u16(span, &rr->rdata.rr_srv.priority);
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u16(span, &rr->rdata.rr_srv.weight);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u16(span, &rr->rdata.rr_srv.port);
+            }
+            if (!IS_ERR(err)) {
+                err = arena_name(arena, span, memo, &rr->rdata.rr_srv.target);
+            }
+            break;
+        case RR_TYPE_TXT:
+            err = io_reader_get(span, &rr->rdata.rr_txt.len, 1);
+            if (!IS_ERR(err)) {
+                err = arena_copy(arena, span, &rr->rdata.rr_txt.txt, rr->rdata.rr_txt.len);
+            }
+            break;
+        default:
+            rr->rdata.unknown.len = rr->rdlength;
+            err = arena_copy(arena, span, &rr->rdata.unknown.data, rr->rdlength);
+            break;
+    }
+
+    // Truncated rdata is malformed, not the end of the message
+    return err == IO_BUF_EMPTY ? TINY_DNS_ERR_INVALID : err;
+}
+
+static tiny_dns_err arena_rr(struct tiny_dns_iter *iter, struct tiny_dns_arena *arena,
+                             struct tiny_dns_rr_arena *rr) {
+    struct tiny_dns_label_memo *memo = (iter->flags & TINY_DNS_ITER_NO_MEMO) ? NULL : &iter->memo;
+    IOReader *buf = &iter->buf;
+
+    // Running out of message is only the end of the records between them. A record cut short
+    // anywhere, rdata included, is malformed.
+    if (buf->remaining == 0) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    tiny_dns_err err = arena_name(arena, buf, memo, &rr->name);
+    if (!IS_ERR(err)) {
+        err = io_reader_get_u16(buf, &rr->atype);
+    }
+    if (!IS_ERR(err)) {
+        err = io_reader_get_u16(buf, &rr->aclass);
+    }
+    if (!IS_ERR(err)) {
+        err = io_reader_get_u32(buf, &rr->ttl);
+    }
+    if (!IS_ERR(err)) {
+        err = io_reader_get_u16(buf, &rr->rdlength);
+    }
+
+    if (err == IO_BUF_EMPTY) {
+        return TINY_DNS_ERR_INVALID;
+    } else if (IS_ERR(err)) {
+        return err;
+    }
+
+    // Confine rdata to rdlength, so a name inside can't run past it
+    IOReader span = *buf;
+    span.remaining = rr->rdlength;
+    err = io_reader_skip(buf, rr->rdlength);
+    if (IS_ERR(err)) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    return arena_rdata(arena, &span, memo, rr);
+}
+
+tiny_dns_err tiny_dns_iter_yield_arena(struct tiny_dns_iter *iter, struct tiny_dns_arena *arena,
+                                       struct tiny_dns_rr_arena *rr) {
+    IOReader start = iter->buf;
+    size_t arena_len = arena->len;
+
+    tiny_dns_err err = arena_rr(iter, arena, rr);
+    if (err == TINY_DNS_ERR_NO_SPACE) {
+        iter->buf = start;
+        arena->len = arena_len;
+        return err;
+    } else if (IS_ERR(err)) {
+        return err;
+    }
+
+    enum tiny_dns_section section;
+    tiny_dns_iter_advance(iter, &section);
+    rr->section = (uint8_t)section;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_iter_materialize(struct tiny_dns_iter *iter, struct tiny_dns_arena *arena,
+                                       struct tiny_dns_rr_arena **records, size_t *count) {
+    // The header counts can't be trusted, but no record is shorter than RR_MIN_LEN
+    size_t claimed = (size_t)iter->ancount + iter->nscount + iter->arcount;
+    size_t room = iter->buf.remaining / RR_MIN_LEN;
+    size_t max = claimed < room ? claimed : room;
+
+    // Put back the records already read on failure, so the caller can retry from the start
+    IOReader start = iter->buf;
+    uint16_t counts[] = { iter->ancount, iter->nscount, iter->arcount };
+    size_t arena_len = arena->len;
+    size_t misalign = (uintptr_t)(arena->base + arena->len) % ARENA_RECORD_ALIGN;
+    if (misalign && !arena_alloc(arena, ARENA_RECORD_ALIGN - misalign)) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    struct tiny_dns_rr_arena *rrs = arena_alloc(arena, max * sizeof(*rrs));
+    if (!rrs) {
+        arena->len = arena_len;
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    size_t n = 0;
+    tiny_dns_err err = TINY_DNS_ERR_NONE;
+    for (; n < max; n++) {
+        err = tiny_dns_iter_yield_arena(iter, arena, &rrs[n]);
+        if (err != TINY_DNS_ERR_NONE) {
+            break;
+        }
+    }
+
+    // NO_BUF is only returned between records, once the packet is exhausted, so iteration
+    // succeeded
+    if (err == TINY_DNS_ERR_NO_BUF) {
+        err = TINY_DNS_ERR_NONE;
+    } else if (IS_ERR(err)) {
+        iter->buf = start;
+        iter->ancount = counts[0];
+        iter->nscount = counts[1];
+        iter->arcount = counts[2];
+        arena->len = arena_len;
+        return err;
+    }
+
+    *records = rrs;
+    *count = n;
+    return err;
+}
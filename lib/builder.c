@@ -0,0 +1,334 @@
+#include <string.h>
+
+#include "label.h"
+#include "rdata.h"
+#include "tiny_dns.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+#define DNS_HEADER_SIZE 12
+
+// Pointers have 14 bits of offset
+#define MAX_PTR_OFFSET 0x3FFF
+
+// Returns the length of name, without a trailing dot, or -1 if it can't be encoded
+static int name_text_len(const char *name) {
+    size_t len = strlen(name);
+    if (len > 0 && name[len - 1] == '.') {
+        len--;
+    }
+
+    if (len > NAME_MAX_LEN) {
+        return -1;
+    }
+
+    size_t label_len = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (name[i] != '.') {
+            label_len++;
+        } else if (label_len == 0) {
+            return -1;
+        } else {
+            label_len = 0;
+        }
+
+        if (label_len > LABEL_MAX_LEN) {
+            return -1;
+        }
+    }
+
+    // A lone "." is the root name, but "a." with the dot stripped must not end in an empty label
+    if (len > 0 && label_len == 0) {
+        return -1;
+    }
+
+    return (int)len;
+}
+
+// Offset of a name already in the message equal to suffix, which is dotted text
+static bool builder_lookup(const struct tiny_dns_builder *builder, const char *suffix,
+                           uint16_t *offset) {
+    for (size_t i = 0; i < builder->name_count; i++) {
+        struct tiny_dns_name_view view = { builder->buf.base, builder->buf.len, builder->names[i] };
+        if (tiny_dns_name_view_eq(&view, suffix)) {
+            *offset = builder->names[i];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static tiny_dns_err builder_name(struct tiny_dns_builder *builder, const char *name,
+                                 bool compress) {
+    int len = name_text_len(name);
+    if (len < 0) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    // Offsets of the labels written inline, which become new compression targets once the name
+    // is complete
+    uint16_t written[TINY_DNS_BUILDER_NAMES];
+    size_t written_count = 0;
+
+    tiny_dns_err err = TINY_DNS_ERR_NONE;
+    int pos = 0;
+    while (pos < len) {
+        uint16_t target;
+        if (compress && builder_lookup(builder, &name[pos], &target)) {
+            err = io_writer_put_u16(&builder->buf, 0xC000 | target);
+            break;
+        }
+
+        const char *dot = memchr(&name[pos], '.', (size_t)(len - pos));
+        int label_len = dot ? (int)(dot - &name[pos]) : len - pos;
+
+        size_t offset = builder->buf.len;
+        uint8_t prefix = (uint8_t)label_len;
+        err = io_writer_put(&builder->buf, &prefix, 1);
+        if (!IS_ERR(err)) {
+            err = io_writer_put(&builder->buf, &name[pos], (size_t)label_len);
+        }
+        if (IS_ERR(err)) {
+            break;
+        }
+
+        bool room = builder->name_count + written_count < TINY_DNS_BUILDER_NAMES;
+        if (room && offset <= MAX_PTR_OFFSET) {
+            written[written_count++] = (uint16_t)offset;
+        }
+
+        pos += label_len + 1;
+    }
+
+    // Reached the end of the name without finding a pointer
+    if (!IS_ERR(err) && pos >= len) {
+        err = io_writer_put(&builder->buf, "", 1);
+    }
+
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    memcpy(&builder->names[builder->name_count], written, written_count * sizeof(written[0]));
+    builder->name_count += written_count;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+// Decode @view and write it, compressed
+static tiny_dns_err builder_name_view(struct tiny_dns_builder *builder,
+                                      const struct tiny_dns_name_view *view) {
+    struct tiny_dns_name name;
+    tiny_dns_err err = tiny_dns_name_view_decode(view, &name);
+    if (IS_ERR(err)) {
+        return TINY_DNS_ERR_INVALID;
+    }
+    return builder_name(builder, name.name, true);
+}
+
+static tiny_dns_err builder_rdata(struct tiny_dns_builder *builder, const struct tiny_dns_rr *rr) {
+    IOWriter *buf = &builder->buf;
+    int err;
+    switch (rr->atype) {
+        case RR_TYPE_A:
+            return io_writer_put(buf, rr->rdata.rr_a, sizeof(rr->rdata.rr_a));
+        case RR_TYPE_AAAA:
+            return io_writer_put(buf, rr->rdata.rr_aaaa, sizeof(rr->rdata.rr_aaaa));
+        case RR_TYPE_CNAME:
+            return builder_name(builder, rr->rdata.rr_cname.name, true);
+        case RR_TYPE_SOA:
+            err = builder_name_view(builder, &rr->rdata.rr_soa.mname);
+            if (!IS_ERR(err)) {
+                err = builder_name_view(builder, &rr->rdata.rr_soa.rname);
+            }
+            if (!IS_ERR(err)) {
+                err = io_writer_put_u32(buf, rr->rdata.rr_soa.serial);
+            }
+            if (!IS_ERR(err)) {
+                err = io_writer_put_u32(buf, rr->rdata.rr_soa.refresh);
+            }
+            if (!IS_ERR(err)) {
+                err = io_writer_put_u32(buf, rr->rdata.rr_soa.retry);
+            }
+            if (!IS_ERR(err)) {
+                err = io_writer_put_u32(buf, rr->rdata.rr_soa.expire);
+            }
+            if (!IS_ERR(err)) {
+                err = io_writer_put_u32(buf, rr->rdata.rr_soa.minimum);
+            }
+            return err;
+        case RR_TYPE_SRV:
+            err = io_writer_put_u16(buf, rr->rdata.rr_srv.priority);
+            if (!IS_ERR(err)) {
+                err = io_writer_put_u16(buf, rr->rdata.rr_srv.weight);
+            }
+            if (!IS_ERR(err)) {
+                err = io_writer_put_u16(buf, rr->rdata.rr_srv.port);
+            }
+            if (!IS_ERR(err)) {
+                err = builder_name(builder, rr->rdata.rr_srv.target.name, false);
+            }
+            return err;
+        case RR_TYPE_TXT:
+            err = io_writer_put(buf, &rr->rdata.rr_txt.len, 1);
+            if (!IS_ERR(err)) {
+                err = io_writer_put(buf, rr->rdata.rr_txt.txt, rr->rdata.rr_txt.len);
+            }
+            return err;
+        default:
+            if (rr->rdata.unknown.len > UINT16_MAX) {
+                return TINY_DNS_ERR_INVALID;
+            }
+            return io_writer_put(buf, rr->rdata.unknown.data, rr->rdata.unknown.len);
+    }
+}
+
+static tiny_dns_err builder_write_rr(struct tiny_dns_builder *builder,
+                                     const struct tiny_dns_rr *rr) {
+    IOWriter *buf = &builder->buf;
+
+    tiny_dns_err err = builder_name(builder, rr->name.name, true);
+    if (!IS_ERR(err)) {
+        err = io_writer_put_u16(buf, rr->atype);
+    }
+    if (!IS_ERR(err)) {
+        err = io_writer_put_u16(buf, rr->aclass);
+    }
+    if (!IS_ERR(err)) {
+        err = io_writer_put_u32(buf, rr->ttl);
+    }
+
+    // rdlength is patched once the rdata, with its possibly compressed names, is written
+    size_t rdlength_offset = buf->len;
+    if (!IS_ERR(err)) {
+        err = io_writer_put_u16(buf, 0);
+    }
+    if (!IS_ERR(err)) {
+        err = builder_rdata(builder, rr);
+    }
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    size_t rdlength = buf->len - rdlength_offset - sizeof(uint16_t);
+    if (rdlength > UINT16_MAX) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    buf->base[rdlength_offset] = (char)(rdlength >> 8);
+    buf->base[rdlength_offset + 1] = (char)rdlength;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+// Undo everything written since the snapshot, so a failed append leaves a valid message
+static void builder_rollback(struct tiny_dns_builder *builder, size_t len, size_t name_count) {
+    builder->buf.ptr = builder->buf.base + len;
+    builder->buf.len = len;
+    builder->name_count = name_count;
+}
+
+tiny_dns_err tiny_dns_builder_init(struct tiny_dns_builder *builder, void *buffer, size_t capacity,
+                                   const struct tiny_dns_header *header) {
+    if (!builder || !buffer || !header) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    if (capacity < DNS_HEADER_SIZE) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    builder->header = *header;
+    builder->header.qdcount = 0;
+    builder->header.ancount = 0;
+    builder->header.nscount = 0;
+    builder->header.arcount = 0;
+    builder->stage = 0;
+    builder->name_count = 0;
+
+    // The header is only written on finish, once the counts are known
+    io_writer_init(&builder->buf, buffer, capacity);
+    builder->buf.ptr += DNS_HEADER_SIZE;
+    builder->buf.len = DNS_HEADER_SIZE;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_builder_question(struct tiny_dns_builder *builder, const char *name,
+                                       uint16_t qtype, uint16_t qclass) {
+    if (!name || builder->stage != 0 || builder->header.qdcount == UINT16_MAX) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    size_t len = builder->buf.len;
+    size_t name_count = builder->name_count;
+
+    tiny_dns_err err = builder_name(builder, name, true);
+    if (!IS_ERR(err)) {
+        err = io_writer_put_u16(&builder->buf, qtype);
+    }
+    if (!IS_ERR(err)) {
+        err = io_writer_put_u16(&builder->buf, qclass);
+    }
+
+    if (IS_ERR(err)) {
+        builder_rollback(builder, len, name_count);
+        return err;
+    }
+
+    builder->header.qdcount++;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_builder_rr(struct tiny_dns_builder *builder, enum tiny_dns_section section,
+                                 const struct tiny_dns_rr *rr) {
+    uint16_t *count;
+    switch (section) {
+        case SECTION_ANSWER:
+            count = &builder->header.ancount;
+            break;
+        case SECTION_AUTHORITY:
+            count = &builder->header.nscount;
+            break;
+        case SECTION_ADDITIONAL:
+            count = &builder->header.arcount;
+            break;
+        default:
+            return TINY_DNS_ERR_INVALID;
+    }
+
+    uint8_t stage = (uint8_t)(section + 1);
+    if (!rr || stage < builder->stage || *count == UINT16_MAX) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    size_t len = builder->buf.len;
+    size_t name_count = builder->name_count;
+
+    tiny_dns_err err = builder_write_rr(builder, rr);
+    if (IS_ERR(err)) {
+        builder_rollback(builder, len, name_count);
+        return err;
+    }
+
+    builder->stage = stage;
+    (*count)++;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_builder_finish(struct tiny_dns_builder *builder, size_t *len) {
+    IOWriter header;
+    io_writer_init(&header, builder->buf.base, DNS_HEADER_SIZE);
+
+    tiny_dns_err err = tiny_dns_encode_header(&header, &builder->header);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    *len = builder->buf.len;
+
+    return TINY_DNS_ERR_NONE;
+}
@@ -0,0 +1,1099 @@
+#include <errno.h>
+#include <pthread.h>
+#include <string.h>
+
+#include "label.h"
+#include "tiny_dns.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+#define DNS_HEADER_SIZE 12
+
+// Bytes of qtype and qclass following the question name
+#define QUESTION_TAIL_LEN 4
+
+// Chains link entries by index + 1, so 0 can end them
+#define NO_ENTRY 0
+
+struct tiny_dns_cache_region {
+    uint32_t capacity;
+    uint32_t bucket_mask;
+    // Entries handed out so far. Until the cache fills up, new entries come from here.
+    uint32_t used;
+    // CLOCK hand, the next entry to consider for eviction
+    uint32_t hand;
+    // Set on a cache restored from a snapshot, whose chains are each checked the first time
+    // they're walked. The checked bits after the buckets record which ones have been.
+    uint32_t unchecked;
+    // Added to the caller's time to get the clock expiry times are on. Only a restored snapshot
+    // sets it, so the entries needn't be rewritten for the new process's clock.
+    uint64_t clock_offset;
+    struct tiny_dns_cache_prefetch prefetch;
+    struct tiny_dns_cache_stale stale;
+    struct tiny_dns_cache_stats stats;
+};
+
+struct tiny_dns_cache_entry {
+    // Absolute time the response expires at
+    uint64_t expires;
+    // Time from which a stale hit may ask for a refresh again
+    uint64_t retry;
+    // Low bits of the key hash, which also pick the bucket
+    uint32_t hash;
+    uint32_t next;
+    // TTL the response was stored with, which the time left is measured against for prefetching
+    uint32_t ttl;
+    // Length of msg, 0 while the entry is free
+    uint16_t len;
+    uint16_t qtype;
+    uint16_t qclass;
+    // Lookups since the entry was stored, only counted until it's hot enough to prefetch
+    uint16_t hits;
+    // Set by lookups, cleared by the CLOCK hand
+    uint8_t referenced;
+    // Set once a lookup has asked the caller to refresh the entry
+    uint8_t prefetched;
+    uint8_t msg[TINY_DNS_CACHE_MSG_MAX];
+};
+
+// Lookups of a shared cache read entries and chains while a writer may be changing them, and the
+// seqlock only tells afterwards whether what they read was torn. So every field they read is
+// loaded and stored whole, with relaxed atomics, which compile to plain moves.
+#define LOAD(_p)      __atomic_load_n(_p, __ATOMIC_RELAXED)
+#define STORE(_p, _v) __atomic_store_n(_p, _v, __ATOMIC_RELAXED)
+
+// Alignment of the region header and the entries within the caller's memory
+#define CACHE_ALIGN 8
+
+static size_t align_up(size_t n) {
+    return (n + CACHE_ALIGN - 1) & ~(size_t)(CACHE_ALIGN - 1);
+}
+
+static uint32_t round_pow2(uint32_t n) {
+    uint32_t p = 1;
+    while (p < n) {
+        p <<= 1;
+    }
+    return p;
+}
+
+// Bytes of checked bits for @bucket_count buckets
+static size_t checked_size(uint32_t bucket_count) {
+    return ((size_t)bucket_count + 63) / 64 * sizeof(uint64_t);
+}
+
+// Bytes needed for @capacity entries, with a bucket per entry rounded up to a power of two and a
+// checked bit per bucket
+static size_t region_size(uint32_t capacity) {
+    return align_up(sizeof(struct tiny_dns_cache_region)) +
+           align_up(round_pow2(capacity) * sizeof(uint32_t)) + checked_size(round_pow2(capacity)) +
+           capacity * sizeof(struct tiny_dns_cache_entry);
+}
+
+// The checked bits follow the buckets
+static uint64_t *checked_bits(const struct tiny_dns_cache *cache) {
+    return (uint64_t *)((char *)cache->buckets +
+                        align_up(((size_t)cache->region->bucket_mask + 1) * sizeof(uint32_t)));
+}
+
+static tiny_dns_err key_hash(const struct tiny_dns_name_view *qname, uint16_t qtype,
+                             uint16_t qclass, uint64_t *hash) {
+    tiny_dns_err err = tiny_dns_name_wire_hash(qname, hash);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    // Mix in the type and class, then fold the high bits down so both halves are well mixed
+    uint64_t h = *hash ^ (((uint64_t)qtype << 16 | qclass) * 0x9E3779B97F4A7C15ull);
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 32;
+    *hash = h;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+// The caller's @now on the clock the entries' expiry times are on
+static uint64_t cache_now(const struct tiny_dns_cache *cache, uint64_t now) {
+    return now + cache->region->clock_offset;
+}
+
+// Whether an entry expiring at @expires can't be served at @now, not even stale
+static bool entry_dead(const struct tiny_dns_cache_region *region, uint64_t expires,
+                       uint64_t now) {
+    return expires + region->stale.max_stale <= now;
+}
+
+// Copy a response into or out of an entry a byte at a time, for the same reason
+static void msg_store(uint8_t *dst, const uint8_t *src, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        STORE(&dst[i], src[i]);
+    }
+}
+
+static void msg_load(uint8_t *dst, const uint8_t *src, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        dst[i] = LOAD(&src[i]);
+    }
+}
+
+static struct tiny_dns_cache_entry *entry_at(const struct tiny_dns_cache *cache, uint32_t link) {
+    return &cache->entries[link - 1];
+}
+
+static bool entry_matches(const struct tiny_dns_cache_entry *entry, uint32_t hash,
+                          const struct tiny_dns_name_view *qname, uint16_t qtype,
+                          uint16_t qclass) {
+    if (entry->hash != hash || entry->qtype != qtype || entry->qclass != qclass) {
+        return false;
+    }
+
+    struct tiny_dns_name_view ours = { (const char *)entry->msg, entry->len, DNS_HEADER_SIZE };
+    return tiny_dns_name_wire_eq(&ours, qname);
+}
+
+// Check the chain in @bucket of a restored cache the first time it's walked, so nothing in a
+// damaged snapshot can send the cache outside its memory or around a chain forever. Every link
+// has to point at an entry handed out before, with a sane length, whose hash belongs in @bucket.
+// A damaged chain is dropped, leaving its entries for the CLOCK hand to reuse.
+static void check_chain(struct tiny_dns_cache *cache, uint32_t bucket) {
+    struct tiny_dns_cache_region *region = cache->region;
+    uint64_t *checked = checked_bits(cache);
+    uint64_t bit = 1ull << (bucket % 64);
+    if (!region->unchecked || (checked[bucket / 64] & bit)) {
+        return;
+    }
+    checked[bucket / 64] |= bit;
+
+    // An entry is on at most one chain, so none can be longer than the cache
+    uint32_t steps = 0;
+    for (uint32_t link = cache->buckets[bucket]; link != NO_ENTRY;) {
+        if (link > region->used || ++steps > region->used) {
+            cache->buckets[bucket] = NO_ENTRY;
+            return;
+        }
+
+        const struct tiny_dns_cache_entry *entry = entry_at(cache, link);
+        if (entry->len <= DNS_HEADER_SIZE || entry->len > TINY_DNS_CACHE_MSG_MAX ||
+            (entry->hash & region->bucket_mask) != bucket) {
+            cache->buckets[bucket] = NO_ENTRY;
+            return;
+        }
+        link = entry->next;
+    }
+}
+
+// Link pointing at the entry for the key, or at the end of its chain if there's none
+static uint32_t *find_link(struct tiny_dns_cache *cache, uint64_t hash,
+                           const struct tiny_dns_name_view *qname, uint16_t qtype,
+                           uint16_t qclass) {
+    check_chain(cache, (uint32_t)(hash & cache->region->bucket_mask));
+    uint32_t *link = &cache->buckets[hash & cache->region->bucket_mask];
+    while (*link != NO_ENTRY &&
+           !entry_matches(entry_at(cache, *link), (uint32_t)hash, qname, qtype, qclass)) {
+        link = &entry_at(cache, *link)->next;
+    }
+    return link;
+}
+
+static void unlink_entry(struct tiny_dns_cache *cache, uint32_t index) {
+    struct tiny_dns_cache_entry *entry = &cache->entries[index];
+
+    check_chain(cache, entry->hash & cache->region->bucket_mask);
+    uint32_t *link = &cache->buckets[entry->hash & cache->region->bucket_mask];
+    while (*link != NO_ENTRY && *link != index + 1) {
+        link = &entry_at(cache, *link)->next;
+    }
+    if (*link != NO_ENTRY) {
+        STORE(link, entry->next);
+    }
+
+    STORE(&entry->len, 0);
+}
+
+// Pick an entry to reuse: a never used one while there are any, then whatever the CLOCK hand
+// settles on. Every referenced entry it passes gets a second chance, so at most two sweeps.
+static uint32_t claim_entry(struct tiny_dns_cache *cache, uint64_t now) {
+    struct tiny_dns_cache_region *region = cache->region;
+    if (region->used < region->capacity) {
+        return region->used++;
+    }
+
+    for (;;) {
+        uint32_t index = region->hand;
+        region->hand = index + 1 < region->capacity ? index + 1 : 0;
+
+        struct tiny_dns_cache_entry *entry = &cache->entries[index];
+        if (entry->len == 0) {
+            return index;
+        }
+
+        bool expired = entry_dead(region, entry->expires, now);
+        if (expired || !LOAD(&entry->referenced)) {
+            if (!expired) {
+                region->stats.evictions++;
+            }
+            unlink_entry(cache, index);
+            return index;
+        }
+
+        STORE(&entry->referenced, 0);
+    }
+}
+
+// RFC 2181 section 8: a TTL with the most significant bit set is to be treated as zero
+static uint32_t wire_ttl(uint32_t ttl) {
+    return ttl & 0x80000000u ? 0 : ttl;
+}
+
+// Smallest TTL among the answers, capped at TINY_DNS_CACHE_TTL_MAX, or 0 if the response shouldn't
+// be cached. NXDOMAIN and NODATA responses are cached as in RFC 2308, for the SOA's minimum or its
+// own TTL, whichever is smaller, and not at all without an SOA in the authority section.
+static tiny_dns_err response_ttl(struct tiny_dns_iter *iter, uint32_t *ttl) {
+    enum tiny_dns_rcode rcode = iter->header.flags.rcode;
+    bool negative = rcode == RCODE_NXDOMAIN || iter->header.ancount == 0;
+    if (iter->header.flags.tc || (rcode != RCODE_NOERROR && rcode != RCODE_NXDOMAIN)) {
+        *ttl = 0;
+        return TINY_DNS_ERR_NONE;
+    }
+
+    // Every record is walked, so a stored response is known to be well formed when served
+    uint32_t min = UINT32_MAX;
+    uint32_t soa = 0;
+    size_t records = (size_t)iter->header.ancount + iter->header.nscount + iter->header.arcount;
+    for (size_t i = 0; i < records; i++) {
+        struct tiny_dns_rr_compact rr;
+        enum tiny_dns_section section;
+        tiny_dns_err err = tiny_dns_iter_yield_compact(iter, &rr, &section);
+        if (IS_ERR(err)) {
+            // Running out of records before the counts say so is a truncated message
+            return err == TINY_DNS_ERR_NO_BUF ? TINY_DNS_ERR_INVALID : err;
+        }
+
+        uint32_t rr_ttl = wire_ttl(rr.ttl);
+        if (section == SECTION_ANSWER && rr_ttl < min) {
+            min = rr_ttl;
+        } else if (section == SECTION_AUTHORITY && rr.atype == RR_TYPE_SOA && soa == 0) {
+            uint32_t minimum = wire_ttl(rr.rdata.rr_soa.minimum);
+            soa = rr_ttl < minimum ? rr_ttl : minimum;
+            soa = soa < TINY_DNS_CACHE_NEGATIVE_TTL_MAX ? soa : TINY_DNS_CACHE_NEGATIVE_TTL_MAX;
+        }
+    }
+
+    // A CNAME chain ending in NXDOMAIN lives no longer than its answers either
+    if (negative) {
+        min = soa < min ? soa : min;
+    }
+
+    *ttl = min < TINY_DNS_CACHE_TTL_MAX ? min : TINY_DNS_CACHE_TTL_MAX;
+    return TINY_DNS_ERR_NONE;
+}
+
+// A response checked and keyed, ready to be stored
+struct cache_item {
+    const void *msg;
+    size_t len;
+    uint64_t hash;
+    uint32_t ttl;
+    uint16_t qtype;
+    uint16_t qclass;
+};
+
+static tiny_dns_err item_prepare(struct cache_item *item, const void *msg, size_t len) {
+    // The iterator never writes to the message
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, (void *)msg, len);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    if (!iter.header.flags.qr || iter.header.qdcount != 1) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    }
+
+    size_t question_end = len - iter.buf.remaining;
+    const uint8_t *tail = (const uint8_t *)msg + question_end - QUESTION_TAIL_LEN;
+    item->qtype = (uint16_t)(tail[0] << 8 | tail[1]);
+    item->qclass = (uint16_t)(tail[2] << 8 | tail[3]);
+
+    item->ttl = 0;
+    err = response_ttl(&iter, &item->ttl);
+    if (IS_ERR(err)) {
+        return err;
+    } else if (item->ttl == 0) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    } else if (len > TINY_DNS_CACHE_MSG_MAX) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    item->msg = msg;
+    item->len = len;
+    struct tiny_dns_name_view qname = { msg, len, DNS_HEADER_SIZE };
+    return key_hash(&qname, item->qtype, item->qclass, &item->hash);
+}
+
+static void item_store(struct tiny_dns_cache *cache, const struct cache_item *item, uint64_t now) {
+    now = cache_now(cache, now);
+    struct tiny_dns_name_view qname = { item->msg, item->len, DNS_HEADER_SIZE };
+
+    // Replace in place, keeping the entry's position in its chain
+    uint32_t *link = find_link(cache, item->hash, &qname, item->qtype, item->qclass);
+    struct tiny_dns_cache_entry *entry;
+    if (*link != NO_ENTRY) {
+        entry = entry_at(cache, *link);
+    } else {
+        uint32_t index = claim_entry(cache, now);
+        entry = &cache->entries[index];
+
+        // Claiming may have unlinked an entry from this very chain
+        uint32_t *bucket = &cache->buckets[item->hash & cache->region->bucket_mask];
+        STORE(&entry->next, *bucket);
+        STORE(bucket, index + 1);
+    }
+
+    STORE(&entry->expires, now + item->ttl);
+    STORE(&entry->retry, 0);
+    STORE(&entry->hash, (uint32_t)item->hash);
+    STORE(&entry->ttl, item->ttl);
+    STORE(&entry->qtype, item->qtype);
+    STORE(&entry->qclass, item->qclass);
+    STORE(&entry->hits, 0);
+    STORE(&entry->referenced, 0);
+    STORE(&entry->prefetched, 0);
+    STORE(&entry->len, (uint16_t)item->len);
+    msg_store(entry->msg, item->msg, item->len);
+
+    cache->region->stats.inserts++;
+}
+
+// Point @cache at the region, buckets and entries for @capacity entries at aligned @base
+static void cache_place(struct tiny_dns_cache *cache, char *base, uint32_t capacity) {
+    cache->region = (struct tiny_dns_cache_region *)base;
+    cache->buckets = (uint32_t *)(base + align_up(sizeof(struct tiny_dns_cache_region)));
+    uint32_t bucket_count = round_pow2(capacity);
+    cache->entries = (struct tiny_dns_cache_entry *)((char *)cache->buckets +
+                                                     align_up(bucket_count * sizeof(uint32_t)) +
+                                                     checked_size(bucket_count));
+}
+
+// Point @cache at the layout of @size bytes at @mem, which holds @capacity entries. The memory
+// itself is left untouched.
+static tiny_dns_err cache_layout(struct tiny_dns_cache *cache, void *mem, size_t size,
+                                 uint32_t *capacity) {
+    size_t skew = align_up((uintptr_t)mem) - (uintptr_t)mem;
+    if (size < skew) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+    size -= skew;
+
+    // A bucket rounds up to at most two per entry, so this is close; back off until it fits
+    size_t estimate = size / (sizeof(struct tiny_dns_cache_entry) + 2 * sizeof(uint32_t));
+    uint32_t n = estimate < UINT32_MAX ? (uint32_t)estimate + 1 : UINT32_MAX;
+    while (n > 0 && region_size(n) > size) {
+        n--;
+    }
+    if (n == 0) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    cache_place(cache, (char *)mem + skew, n);
+    *capacity = n;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_cache_init(struct tiny_dns_cache *cache, void *mem, size_t size) {
+    if (!cache || !mem) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    struct tiny_dns_cache layout;
+    uint32_t capacity;
+    tiny_dns_err err = cache_layout(&layout, mem, size, &capacity);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    uint32_t bucket_count = round_pow2(capacity);
+    memset(layout.region, 0, sizeof(*layout.region));
+    layout.region->capacity = capacity;
+    layout.region->bucket_mask = bucket_count - 1;
+    memset(layout.buckets, 0, bucket_count * sizeof(uint32_t));
+    memset(checked_bits(&layout), 0, checked_size(bucket_count));
+    *cache = layout;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+size_t tiny_dns_cache_capacity(const struct tiny_dns_cache *cache) {
+    return cache->region->capacity;
+}
+
+tiny_dns_err tiny_dns_cache_insert(struct tiny_dns_cache *cache, const void *msg, size_t len,
+                                   uint64_t now) {
+    if (!cache || !msg) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    struct cache_item item;
+    tiny_dns_err err = item_prepare(&item, msg, len);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    item_store(cache, &item, now);
+
+    return TINY_DNS_ERR_NONE;
+}
+
+// Count a hit with @left seconds to go on @entry, and tell whether it's now due for a refresh: hot,
+// into the last part of its TTL, and not handed out for refresh before. Lookups of a shared cache
+// call this without a lock, so every access is atomic. A hit racing a writer reusing the entry
+// may count towards the new response, which only makes its prefetch early or late.
+static bool entry_hit(const struct tiny_dns_cache_region *region,
+                      struct tiny_dns_cache_entry *entry, uint64_t left) {
+    uint16_t min_hits = region->prefetch.min_hits;
+    if (min_hits == 0) {
+        return false;
+    }
+
+    // Stop counting once hot, so readers of a hot entry don't keep writing its cache line
+    uint16_t hits = LOAD(&entry->hits);
+    if (hits < min_hits) {
+        STORE(&entry->hits, hits + 1);
+        return false;
+    }
+
+    uint64_t ttl = LOAD(&entry->ttl);
+    return left * 100 < ttl * region->prefetch.percent && !LOAD(&entry->prefetched) &&
+           !__atomic_exchange_n(&entry->prefetched, 1, __ATOMIC_RELAXED);
+}
+
+// TTL of stale answers, and seconds between their refreshes
+static uint32_t stale_ttl(const struct tiny_dns_cache_region *region) {
+    return region->stale.ttl > 0 ? region->stale.ttl : 1;
+}
+
+// Tell whether a stale hit on @entry at @now should ask for a refresh, which it does at most once
+// per stale TTL. Racing lookups of a shared cache agree on which of them asks.
+static bool entry_stale_hit(const struct tiny_dns_cache_region *region,
+                            struct tiny_dns_cache_entry *entry, uint64_t now) {
+    uint64_t retry = LOAD(&entry->retry);
+    return now >= retry &&
+           __atomic_compare_exchange_n(&entry->retry, &retry, now + stale_ttl(region), false,
+                                       __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+}
+
+// Rewrite the TTL of every record in @msg, a response copied out of an entry, as it's handed out.
+// A live response's records lose the @age seconds it has been cached for, and none outlives the
+// @left the entry has; a stale one's all get @left, the stale TTL. The OPT record's TTL holds EDNS
+// flags, and is left alone. The message was walked the same way when it was stored.
+static void msg_age(uint8_t *msg, size_t len, bool stale, uint32_t age, uint32_t left) {
+    IOReader rdr;
+    io_reader_init(&rdr, msg, len);
+    if (io_reader_skip(&rdr, DNS_HEADER_SIZE) < 0 || tiny_dns_label_skip(&rdr) < 0 ||
+        io_reader_skip(&rdr, QUESTION_TAIL_LEN) < 0) {
+        return;
+    }
+
+    size_t records = (size_t)(msg[6] << 8 | msg[7]) + (size_t)(msg[8] << 8 | msg[9]) +
+                     (size_t)(msg[10] << 8 | msg[11]);
+    for (size_t i = 0; i < records; i++) {
+        // Type, class, TTL and rdlength follow the owner name
+        if (tiny_dns_label_skip(&rdr) < 0 || rdr.remaining < 10) {
+            return;
+        }
+
+        uint8_t *rr = msg + (len - rdr.remaining);
+        if ((rr[0] << 8 | rr[1]) != RR_TYPE_OPT) {
+            uint32_t ttl = wire_ttl((uint32_t)rr[4] << 24 | (uint32_t)rr[5] << 16 |
+                                    (uint32_t)rr[6] << 8 | rr[7]);
+            ttl = ttl > age ? ttl - age : 0;
+            ttl = stale || ttl > left ? left : ttl;
+            rr[4] = (uint8_t)(ttl >> 24);
+            rr[5] = (uint8_t)(ttl >> 16);
+            rr[6] = (uint8_t)(ttl >> 8);
+            rr[7] = (uint8_t)ttl;
+        }
+
+        if (io_reader_skip(&rdr, 10 + (size_t)(rr[8] << 8 | rr[9])) < 0) {
+            return;
+        }
+    }
+}
+
+// Count a hit on @entry, which was stored with @ttl and expires at @expires, age the TTLs of @msg,
+// the @len bytes of response copied out of it, and fill in @hit if given
+static void entry_found(const struct tiny_dns_cache_region *region,
+                        struct tiny_dns_cache_entry *entry, uint32_t ttl, uint64_t expires,
+                        uint64_t now, uint8_t *msg, size_t len, struct tiny_dns_cache_hit *hit,
+                        struct tiny_dns_cache_stats *stats) {
+    bool stale = expires <= now;
+    bool prefetch = stale ? entry_stale_hit(region, entry, now)
+                          : entry_hit(region, entry, expires - now);
+    uint32_t left = stale ? stale_ttl(region) : (uint32_t)(expires - now);
+    msg_age(msg, len, stale, !stale && ttl > left ? ttl - left : 0, left);
+    if (hit) {
+        hit->ttl = left;
+        hit->prefetch = prefetch;
+        hit->stale = stale;
+        // Only NOERROR and NXDOMAIN are stored, so no answers or NXDOMAIN is a negative response
+        hit->negative = (msg[3] & 0x0F) == RCODE_NXDOMAIN || (msg[6] == 0 && msg[7] == 0);
+    }
+    if (stats) {
+        stats->hits++;
+        stats->prefetches += prefetch;
+        stats->stale += stale;
+    }
+}
+
+tiny_dns_err tiny_dns_cache_lookup(struct tiny_dns_cache *cache,
+                                   const struct tiny_dns_name_view *qname, uint16_t qtype,
+                                   uint16_t qclass, uint64_t now, void *buffer, size_t *len,
+                                   struct tiny_dns_cache_hit *hit) {
+    uint64_t hash;
+    if (IS_ERR(key_hash(qname, qtype, qclass, &hash))) {
+        cache->region->stats.misses++;
+        return TINY_DNS_ERR_NOT_FOUND;
+    }
+
+    now = cache_now(cache, now);
+    uint32_t link = *find_link(cache, hash, qname, qtype, qclass);
+    struct tiny_dns_cache_entry *entry = link != NO_ENTRY ? entry_at(cache, link) : NULL;
+    if (!entry || entry_dead(cache->region, entry->expires, now)) {
+        cache->region->stats.misses++;
+        return TINY_DNS_ERR_NOT_FOUND;
+    }
+
+    if (entry->len > *len) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    memcpy(buffer, entry->msg, entry->len);
+    *len = entry->len;
+
+    STORE(&entry->referenced, 1);
+    entry_found(cache->region, entry, entry->ttl, entry->expires, now, buffer, entry->len, hit,
+                &cache->region->stats);
+
+    return TINY_DNS_ERR_NONE;
+}
+
+void tiny_dns_cache_remove(struct tiny_dns_cache *cache, const struct tiny_dns_name_view *qname,
+                           uint16_t qtype, uint16_t qclass) {
+    uint64_t hash;
+    if (IS_ERR(key_hash(qname, qtype, qclass, &hash))) {
+        return;
+    }
+
+    uint32_t *link = find_link(cache, hash, qname, qtype, qclass);
+    if (*link != NO_ENTRY) {
+        struct tiny_dns_cache_entry *entry = entry_at(cache, *link);
+        STORE(link, entry->next);
+        STORE(&entry->len, 0);
+    }
+}
+
+void tiny_dns_cache_stats(const struct tiny_dns_cache *cache, struct tiny_dns_cache_stats *stats) {
+    *stats = cache->region->stats;
+}
+
+void tiny_dns_cache_set_prefetch(struct tiny_dns_cache *cache,
+                                 const struct tiny_dns_cache_prefetch *prefetch) {
+    cache->region->prefetch = *prefetch;
+}
+
+void tiny_dns_cache_set_stale(struct tiny_dns_cache *cache,
+                              const struct tiny_dns_cache_stale *stale) {
+    cache->region->stale = *stale;
+}
+
+// Identifies a snapshot and the layout of the image following it. Entries keep their expiry times
+// as saved; restoring moves the cache's clock offset instead, so it doesn't write to them.
+// Version 2 added the prefetch policy and hit counts, version 3 serving stale.
+#define SNAPSHOT_MAGIC   0x534E4454u
+#define SNAPSHOT_VERSION 3
+
+struct snapshot_header {
+    uint32_t magic;
+    uint32_t version;
+    // Catches builds with a different TINY_DNS_CACHE_MSG_MAX
+    uint32_t entry_size;
+    uint32_t capacity;
+    // The time on the cache's clock and the caller's wall clock when the snapshot was taken
+    uint64_t saved_now;
+    uint64_t saved_wall;
+    uint8_t pad[64 - 4 * sizeof(uint32_t) - 2 * sizeof(uint64_t)];
+};
+
+// The region, buckets and entries are contiguous, so the image is a straight copy of them
+static size_t cache_image_size(const struct tiny_dns_cache *cache) {
+    return region_size(cache->region->capacity);
+}
+
+size_t tiny_dns_cache_snapshot_size(const struct tiny_dns_cache *cache) {
+    return sizeof(struct snapshot_header) + cache_image_size(cache);
+}
+
+tiny_dns_err tiny_dns_cache_snapshot(const struct tiny_dns_cache *cache, uint64_t now,
+                                     uint64_t wall, void *out, size_t size) {
+    if (!cache || !out) {
+        return TINY_DNS_ERR_INVALID;
+    } else if (size < tiny_dns_cache_snapshot_size(cache)) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    struct snapshot_header header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.entry_size = sizeof(struct tiny_dns_cache_entry);
+    header.capacity = cache->region->capacity;
+    header.saved_now = cache_now(cache, now);
+    header.saved_wall = wall;
+
+    memcpy(out, &header, sizeof(header));
+    memcpy((char *)out + sizeof(header), cache->region, cache_image_size(cache));
+
+    return TINY_DNS_ERR_NONE;
+}
+
+// Check the region of a restored cache. Chains are checked as they're first walked, so the first
+// lookup doesn't wait for all of them, and those never walked aren't even paged in.
+static tiny_dns_err check_region(const struct tiny_dns_cache *cache, uint32_t capacity) {
+    const struct tiny_dns_cache_region *region = cache->region;
+    if (region->capacity != capacity || region->bucket_mask != round_pow2(capacity) - 1 ||
+        region->used > capacity || region->hand >= capacity) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_cache_restore(struct tiny_dns_cache *cache, void *snapshot, size_t size,
+                                    uint64_t now, uint64_t wall) {
+    if (!cache || !snapshot || (uintptr_t)snapshot % CACHE_ALIGN != 0) {
+        return TINY_DNS_ERR_INVALID;
+    } else if (size < sizeof(struct snapshot_header)) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    struct snapshot_header header;
+    memcpy(&header, snapshot, sizeof(header));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.entry_size != sizeof(struct tiny_dns_cache_entry)) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    } else if (header.capacity == 0 ||
+               header.capacity > (size - sizeof(header)) / sizeof(struct tiny_dns_cache_entry) ||
+               size - sizeof(header) < region_size(header.capacity)) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    // The header keeps the image aligned
+    struct tiny_dns_cache layout;
+    cache_place(&layout, (char *)snapshot + sizeof(header), header.capacity);
+
+    tiny_dns_err err = check_region(&layout, header.capacity);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    // A bit per bucket, so clearing them copies a page per 32768 buckets at most
+    layout.region->unchecked = 1;
+    memset(checked_bits(&layout), 0, checked_size(layout.region->bucket_mask + 1));
+
+    // Pick up the cache's clock where the snapshot left it, plus the time it sat unused. Entries
+    // keep what was left of their TTLs less that time, and those that ran out meanwhile are
+    // expired, for the CLOCK hand to reuse.
+    uint64_t elapsed = wall > header.saved_wall ? wall - header.saved_wall : 0;
+    layout.region->clock_offset = header.saved_now + elapsed - now;
+
+    *cache = layout;
+    return TINY_DNS_ERR_NONE;
+}
+
+// Shards are padded out to their own cache lines, so writers to one don't slow readers of another
+#define CACHE_LINE 64
+
+#if defined(__x86_64__) || defined(__i386__)
+    #define CPU_RELAX() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+    #define CPU_RELAX() __asm__ __volatile__("yield")
+#else
+    #define CPU_RELAX() ((void)0)
+#endif
+
+// A writer that dies holding the lock hands it to the next one as EOWNERDEAD, even from another
+// process, rather than leaving it held for good
+struct tiny_dns_cache_shard {
+    pthread_mutex_t lock;
+    // Odd while a writer is changing the shard
+    uint32_t seq;
+    uint8_t pad[CACHE_LINE - (sizeof(pthread_mutex_t) + sizeof(uint32_t)) % CACHE_LINE];
+};
+
+static size_t align_line(size_t n) {
+    return (n + CACHE_LINE - 1) & ~(size_t)(CACHE_LINE - 1);
+}
+
+// Empty @cache in place, keeping its layout, clock, policies and counters. Entries are handed out
+// afresh from the first, so whatever they hold is never looked at again.
+static void cache_clear(const struct tiny_dns_cache *cache) {
+    struct tiny_dns_cache_region *region = cache->region;
+    for (uint32_t i = 0; i <= region->bucket_mask; i++) {
+        STORE(&cache->buckets[i], NO_ENTRY);
+    }
+    region->used = 0;
+    region->hand = 0;
+    region->unchecked = 0;
+}
+
+// Take @shard's lock and mark the shard as being written. A writer that died holding the lock may
+// have left the shard half changed, so it's emptied before anyone else writes to it. The sequence
+// it left odd stays odd until this writer is done.
+static tiny_dns_err shard_lock(const struct tiny_dns_shard_cache *cache, size_t shard) {
+    struct tiny_dns_cache_shard *sync = &cache->sync[shard];
+    int err = pthread_mutex_lock(&sync->lock);
+    if (err != 0 && err != EOWNERDEAD) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    uint32_t seq = __atomic_load_n(&sync->seq, __ATOMIC_RELAXED);
+    if (!(seq & 1)) {
+        __atomic_store_n(&sync->seq, seq + 1, __ATOMIC_RELAXED);
+    }
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (err == EOWNERDEAD) {
+        cache_clear(&cache->shards[shard]);
+        pthread_mutex_consistent(&sync->lock);
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+static void shard_unlock(const struct tiny_dns_shard_cache *cache, size_t shard) {
+    struct tiny_dns_cache_shard *sync = &cache->sync[shard];
+    __atomic_store_n(&sync->seq, sync->seq + 1, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&sync->lock);
+}
+
+// Find the entry for a key and copy its response to @buffer, while a writer may be changing the
+// shard. Nothing read here is trusted until the caller has checked the sequence: every field is
+// loaded atomically, every value that indexes memory is loaded once and bounds checked, and the
+// walk can't loop forever. The name isn't compared here, since the copy is only known to be whole
+// afterwards.
+static tiny_dns_err probe_racy(const struct tiny_dns_cache *cache, uint64_t hash, uint16_t qtype,
+                               uint16_t qclass, void *buffer, size_t *len, uint32_t *ttl,
+                               uint64_t *expires, uint32_t *found) {
+    uint32_t capacity = cache->region->capacity;
+    uint32_t link = LOAD(&cache->buckets[hash & cache->region->bucket_mask]);
+
+    for (uint32_t steps = 0; link != NO_ENTRY && link <= capacity && steps < capacity; steps++) {
+        const struct tiny_dns_cache_entry *entry = entry_at(cache, link);
+        if (LOAD(&entry->hash) == (uint32_t)hash && LOAD(&entry->qtype) == qtype &&
+            LOAD(&entry->qclass) == qclass) {
+            size_t n = LOAD(&entry->len);
+            if (n == 0 || n > TINY_DNS_CACHE_MSG_MAX) {
+                return TINY_DNS_ERR_NOT_FOUND;
+            } else if (n > *len) {
+                return TINY_DNS_ERR_NO_BUF;
+            }
+
+            msg_load(buffer, entry->msg, n);
+            *len = n;
+            *ttl = LOAD(&entry->ttl);
+            *expires = LOAD(&entry->expires);
+            *found = link;
+            return TINY_DNS_ERR_NONE;
+        }
+
+        link = LOAD(&entry->next);
+    }
+
+    return TINY_DNS_ERR_NOT_FOUND;
+}
+
+static size_t shard_of(const struct tiny_dns_shard_cache *cache, uint64_t hash) {
+    // The low bits pick the bucket within the shard
+    return (size_t)(hash >> 32) & cache->shard_mask;
+}
+
+// Identifies memory holding a sharded cache, so other processes mapping it can tell whether it's
+// one they understand. The magic is written last, once everything else is laid out. Version 2
+// added the clock offset and the checked bits, version 3 the prefetch policy and hit counts,
+// version 4 serving stale.
+#define SHARD_CACHE_MAGIC   0x544E4443u
+#define SHARD_CACHE_VERSION 4
+
+struct shard_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t shard_count;
+    // Catches builds with a different TINY_DNS_CACHE_MSG_MAX
+    uint32_t entry_size;
+    uint64_t shard_size;
+    uint8_t pad[CACHE_LINE - 4 * sizeof(uint32_t) - sizeof(uint64_t)];
+};
+
+// Header, then a cache line of sync per shard, then the shards themselves
+static size_t shard_head_size(size_t shard_count) {
+    return sizeof(struct shard_cache_header) + shard_count * sizeof(struct tiny_dns_cache_shard);
+}
+
+tiny_dns_err tiny_dns_shard_cache_init(struct tiny_dns_shard_cache *cache, void *mem, size_t size,
+                                       size_t shard_count) {
+    if (!cache || !mem || shard_count == 0 || shard_count > TINY_DNS_CACHE_SHARDS_MAX ||
+        (shard_count & (shard_count - 1))) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    size_t skew = align_line((uintptr_t)mem) - (uintptr_t)mem;
+    size_t head = shard_head_size(shard_count);
+    if (size < skew + head) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+    size_t shard_size = ((size - skew - head) / shard_count) & ~(size_t)(CACHE_LINE - 1);
+
+    char *base = (char *)mem + skew;
+    struct shard_cache_header *header = (struct shard_cache_header *)base;
+    memset(base, 0, head);
+    cache->sync = (struct tiny_dns_cache_shard *)(base + sizeof(*header));
+    cache->shard_mask = (uint32_t)(shard_count - 1);
+
+    for (size_t i = 0; i < shard_count; i++) {
+        tiny_dns_err err = tiny_dns_cache_init(&cache->shards[i], base + head + i * shard_size,
+                                               shard_size);
+        if (IS_ERR(err)) {
+            return err;
+        }
+    }
+
+    // Shared between processes, and taken over from whichever of them dies holding it
+    pthread_mutexattr_t attr;
+    if (pthread_mutexattr_init(&attr) != 0) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    }
+    bool ok = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED) == 0 &&
+              pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST) == 0;
+    for (size_t i = 0; ok && i < shard_count; i++) {
+        ok = pthread_mutex_init(&cache->sync[i].lock, &attr) == 0;
+    }
+    pthread_mutexattr_destroy(&attr);
+    if (!ok) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    }
+
+    header->version = SHARD_CACHE_VERSION;
+    header->shard_count = (uint32_t)shard_count;
+    header->entry_size = sizeof(struct tiny_dns_cache_entry);
+    header->shard_size = shard_size;
+    __atomic_store_n(&header->magic, SHARD_CACHE_MAGIC, __ATOMIC_RELEASE);
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_shard_cache_attach(struct tiny_dns_shard_cache *cache, void *mem,
+                                         size_t size) {
+    if (!cache || !mem) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    size_t skew = align_line((uintptr_t)mem) - (uintptr_t)mem;
+    if (size < skew + sizeof(struct shard_cache_header)) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    char *base = (char *)mem + skew;
+    const struct shard_cache_header *header = (const struct shard_cache_header *)base;
+    uint32_t magic = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE);
+    if (magic == 0) {
+        return TINY_DNS_ERR_NOT_FOUND;
+    } else if (magic != SHARD_CACHE_MAGIC || header->version != SHARD_CACHE_VERSION ||
+               header->entry_size != sizeof(struct tiny_dns_cache_entry)) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    }
+
+    // Whoever laid this out may have been given a different size, but every shard has to be here
+    size_t shard_count = header->shard_count;
+    size_t shard_size = header->shard_size;
+    if (shard_count == 0 || shard_count > TINY_DNS_CACHE_SHARDS_MAX ||
+        (shard_count & (shard_count - 1)) || shard_size > size ||
+        size - skew < shard_head_size(shard_count) + shard_count * shard_size) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    // Writers index entries by these without checking, so they have to agree with the layout
+    size_t head = shard_head_size(shard_count);
+    for (size_t i = 0; i < shard_count; i++) {
+        struct tiny_dns_cache *shard = &cache->shards[i];
+        uint32_t capacity;
+        tiny_dns_err err = cache_layout(shard, base + head + i * shard_size, shard_size, &capacity);
+        if (IS_ERR(err)) {
+            return TINY_DNS_ERR_INVALID;
+        }
+
+        if (IS_ERR(check_region(shard, capacity))) {
+            return TINY_DNS_ERR_INVALID;
+        }
+    }
+
+    cache->sync = (struct tiny_dns_cache_shard *)(base + sizeof(*header));
+    cache->shard_mask = (uint32_t)(shard_count - 1);
+
+    return TINY_DNS_ERR_NONE;
+}
+
+size_t tiny_dns_shard_cache_capacity(const struct tiny_dns_shard_cache *cache) {
+    size_t capacity = 0;
+    for (size_t i = 0; i <= cache->shard_mask; i++) {
+        capacity += tiny_dns_cache_capacity(&cache->shards[i]);
+    }
+    return capacity;
+}
+
+tiny_dns_err tiny_dns_shard_cache_insert(struct tiny_dns_shard_cache *cache, const void *msg,
+                                         size_t len, uint64_t now) {
+    if (!cache || !msg) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    // Validation and hashing are the expensive part, and need no lock
+    struct cache_item item;
+    tiny_dns_err err = item_prepare(&item, msg, len);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    size_t shard = shard_of(cache, item.hash);
+    err = shard_lock(cache, shard);
+    if (IS_ERR(err)) {
+        return err;
+    }
+    item_store(&cache->shards[shard], &item, now);
+    shard_unlock(cache, shard);
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_shard_cache_lookup(struct tiny_dns_shard_cache *cache,
+                                         const struct tiny_dns_name_view *qname, uint16_t qtype,
+                                         uint16_t qclass, uint64_t now, void *buffer, size_t *len,
+                                         struct tiny_dns_cache_hit *hit,
+                                         struct tiny_dns_cache_stats *stats) {
+    uint64_t hash;
+    tiny_dns_err err = key_hash(qname, qtype, qclass, &hash);
+    if (IS_ERR(err)) {
+        if (stats) {
+            stats->misses++;
+        }
+        return TINY_DNS_ERR_NOT_FOUND;
+    }
+
+    size_t shard = shard_of(cache, hash);
+    struct tiny_dns_cache_shard *sync = &cache->sync[shard];
+    now = cache_now(&cache->shards[shard], now);
+    size_t capacity = *len;
+    size_t copied;
+    uint32_t ttl = 0;
+    uint64_t expires = 0;
+    uint32_t found = NO_ENTRY;
+
+    // A writer that died mid-update leaves the sequence odd for good, and a busy shard can keep
+    // changing under the reader, so after so many tries the lookup gives up and misses
+    for (uint32_t spins = 0;; spins++) {
+        if (spins == TINY_DNS_SHARD_CACHE_READ_SPINS) {
+            err = TINY_DNS_ERR_NOT_FOUND;
+            break;
+        }
+
+        uint32_t seq = __atomic_load_n(&sync->seq, __ATOMIC_ACQUIRE);
+        if (seq & 1) {
+            CPU_RELAX();
+            continue;
+        }
+
+        copied = capacity;
+        err = probe_racy(&cache->shards[shard], hash, qtype, qclass, buffer, &copied, &ttl,
+                         &expires, &found);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&sync->seq, __ATOMIC_RELAXED) == seq) {
+            break;
+        }
+    }
+
+    // The copy is known to be whole now. The probe only took the first entry with the same type,
+    // class and hash bits, so on the rare collision the name differs and this is reported as a
+    // miss rather than walking on.
+    if (err == TINY_DNS_ERR_NONE) {
+        struct tiny_dns_name_view ours = { buffer, copied, DNS_HEADER_SIZE };
+        if (entry_dead(cache->shards[shard].region, expires, now) ||
+            !tiny_dns_name_wire_eq(&ours, qname)) {
+            err = TINY_DNS_ERR_NOT_FOUND;
+        }
+    }
+
+    if (err == TINY_DNS_ERR_NO_BUF) {
+        return err;
+    } else if (err != TINY_DNS_ERR_NONE) {
+        if (stats) {
+            stats->misses++;
+        }
+        return TINY_DNS_ERR_NOT_FOUND;
+    }
+
+    // The entry may have been reused since, in which case a stranger gets a second chance. Only
+    // writing when the bit is clear keeps hot entries' cache lines shared between readers.
+    struct tiny_dns_cache_entry *entry = entry_at(&cache->shards[shard], found);
+    if (!LOAD(&entry->referenced)) {
+        STORE(&entry->referenced, 1);
+    }
+    *len = copied;
+    entry_found(cache->shards[shard].region, entry, ttl, expires, now, buffer, copied, hit, stats);
+
+    return TINY_DNS_ERR_NONE;
+}
+
+void tiny_dns_shard_cache_remove(struct tiny_dns_shard_cache *cache,
+                                 const struct tiny_dns_name_view *qname, uint16_t qtype,
+                                 uint16_t qclass) {
+    uint64_t hash;
+    if (IS_ERR(key_hash(qname, qtype, qclass, &hash))) {
+        return;
+    }
+
+    size_t shard = shard_of(cache, hash);
+    if (IS_ERR(shard_lock(cache, shard))) {
+        return;
+    }
+    tiny_dns_cache_remove(&cache->shards[shard], qname, qtype, qclass);
+    shard_unlock(cache, shard);
+}
+
+void tiny_dns_shard_cache_stats(const struct tiny_dns_shard_cache *cache,
+                                struct tiny_dns_cache_stats *stats) {
+    memset(stats, 0, sizeof(*stats));
+    for (size_t i = 0; i <= cache->shard_mask; i++) {
+        if (IS_ERR(shard_lock(cache, i))) {
+            continue;
+        }
+        stats->inserts += cache->shards[i].region->stats.inserts;
+        stats->evictions += cache->shards[i].region->stats.evictions;
+        shard_unlock(cache, i);
+    }
+}
+
+void tiny_dns_shard_cache_set_prefetch(struct tiny_dns_shard_cache *cache,
+                                       const struct tiny_dns_cache_prefetch *prefetch) {
+    for (size_t i = 0; i <= cache->shard_mask; i++) {
+        tiny_dns_cache_set_prefetch(&cache->shards[i], prefetch);
+    }
+}
+
+void tiny_dns_shard_cache_set_stale(struct tiny_dns_shard_cache *cache,
+                                    const struct tiny_dns_cache_stale *stale) {
+    for (size_t i = 0; i <= cache->shard_mask; i++) {
+        tiny_dns_cache_set_stale(&cache->shards[i], stale);
+    }
+}
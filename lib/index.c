@@ -0,0 +1,211 @@
+#include "label.h"
+#include "rdata.h"
+#include "tiny_dns.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+#define CHECKED_TARGETS 4
+
+// Pointer targets whose names were already walked. Most owner names are a bare pointer to the
+// question or to a previous owner, so this saves walking the same name over and over.
+struct checked_targets {
+    uint16_t offsets[CHECKED_TARGETS];
+    size_t next;
+};
+
+static tiny_dns_err check_owner(struct checked_targets *checked, IOReader *buf, uint16_t offset) {
+    const uint8_t *raw = (const uint8_t *)buf->ptr;
+    bool bare_ptr = buf->remaining >= 2 && (raw[0] & 0xC0) == 0xC0;
+    uint16_t target = bare_ptr ? (uint16_t)(((raw[0] & 0x3F) << 8) | raw[1]) : 0;
+
+    if (bare_ptr) {
+        size_t count = checked->next < CHECKED_TARGETS ? checked->next : CHECKED_TARGETS;
+        for (size_t i = 0; i < count; i++) {
+            if (checked->offsets[i] == target) {
+                return TINY_DNS_ERR_NONE;
+            }
+        }
+    }
+
+    // Walk the whole name, pointers included, so it can later be decoded without checks
+    struct tiny_dns_name_view owner = { buf->base, offset + buf->remaining, offset };
+    int err = tiny_dns_name_view_len(&owner);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    if (bare_ptr) {
+        checked->offsets[checked->next++ % CHECKED_TARGETS] = target;
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+static tiny_dns_err index_rr(struct tiny_dns_index_entry *entry, IOReader *buf,
+                             struct checked_targets *checked) {
+    entry->offset = (uint16_t)(buf->ptr - buf->base);
+
+    tiny_dns_err err = check_owner(checked, buf, entry->offset);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    err = tiny_dns_label_skip(buf);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    err = io_reader_get_u16(buf, &entry->atype);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    err = io_reader_get_u16(buf, &entry->aclass);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    err = io_reader_get_u32(buf, &entry->ttl);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    err = io_reader_get_u16(buf, &entry->rdlength);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    entry->rdata_offset = (uint16_t)(buf->ptr - buf->base);
+    err = io_reader_skip(buf, entry->rdlength);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_index_build(struct tiny_dns_index *index, const void *data, size_t len,
+                                  struct tiny_dns_index_entry *entries, size_t capacity) {
+    if (!index || !data || (!entries && capacity)) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    // Offsets are stored in 16 bits
+    if (len > UINT16_MAX) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    index->msg = data;
+    index->msg_len = len;
+    index->entries = entries;
+    index->count = 0;
+
+    IOReader buf;
+    io_reader_init(&buf, data, len);
+
+    tiny_dns_err err = tiny_dns_parse_header(&index->header, &buf);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    err = tiny_dns_discard_questions(index->header.qdcount, &buf);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    const uint16_t counts[] = {
+        [SECTION_ANSWER] = index->header.ancount,
+        [SECTION_AUTHORITY] = index->header.nscount,
+        [SECTION_ADDITIONAL] = index->header.arcount,
+    };
+
+    if ((size_t)counts[0] + counts[1] + counts[2] > capacity) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    struct checked_targets checked = { { 0 }, 0 };
+    for (uint8_t section = SECTION_ANSWER; section <= SECTION_ADDITIONAL; section++) {
+        for (uint16_t i = 0; i < counts[section]; i++) {
+            struct tiny_dns_index_entry *entry = &entries[index->count];
+            err = index_rr(entry, &buf, &checked);
+            if (IS_ERR(err)) {
+                return err;
+            }
+
+            entry->section = section;
+            index->count++;
+        }
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+size_t tiny_dns_index_count(const struct tiny_dns_index *index, enum tiny_dns_section section) {
+    switch (section) {
+        case SECTION_ANSWER:
+            return index->header.ancount;
+        case SECTION_AUTHORITY:
+            return index->header.nscount;
+        case SECTION_ADDITIONAL:
+            return index->header.arcount;
+    }
+
+    return 0;
+}
+
+static size_t section_start(const struct tiny_dns_index *index, enum tiny_dns_section section) {
+    size_t start = 0;
+    for (int s = SECTION_ANSWER; s < (int)section; s++) {
+        start += tiny_dns_index_count(index, (enum tiny_dns_section)s);
+    }
+    return start;
+}
+
+const struct tiny_dns_index_entry *tiny_dns_index_get(const struct tiny_dns_index *index,
+                                                      enum tiny_dns_section section, size_t n) {
+    if (n >= tiny_dns_index_count(index, section)) {
+        return NULL;
+    }
+
+    return &index->entries[section_start(index, section) + n];
+}
+
+const struct tiny_dns_index_entry *tiny_dns_index_find(const struct tiny_dns_index *index,
+                                                       enum tiny_dns_section section,
+                                                       uint16_t atype, size_t *pos) {
+    const struct tiny_dns_index_entry *entries = &index->entries[section_start(index, section)];
+    size_t count = tiny_dns_index_count(index, section);
+
+    for (; *pos < count; (*pos)++) {
+        if (entries[*pos].atype == atype) {
+            return &entries[(*pos)++];
+        }
+    }
+
+    return NULL;
+}
+
+tiny_dns_err tiny_dns_index_parse(const struct tiny_dns_index *index,
+                                  const struct tiny_dns_index_entry *entry,
+                                  struct tiny_dns_rr *rr) {
+    rr->owner.msg = index->msg;
+    rr->owner.msg_len = index->msg_len;
+    rr->owner.offset = entry->offset;
+
+    tiny_dns_err err = tiny_dns_name_view_decode(&rr->owner, &rr->name);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    rr->atype = entry->atype;
+    rr->aclass = entry->aclass;
+    rr->ttl = entry->ttl;
+    rr->rdlength = entry->rdlength;
+
+    // Confine the rdata parser to the rdata, with the message as base for compression pointers
+    IOReader rdata;
+    io_reader_init(&rdata, index->msg + entry->rdata_offset, entry->rdlength);
+    rdata.base = index->msg;
+
+    return tiny_dns_parse_rdata(&rdata, rr, NULL);
+}
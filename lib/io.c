@@ -33,6 +33,16 @@ int io_reader_get_raw(IOReader *rdr, const char **ptr, size_t len) {
     return consumed;
 }
 
+int io_reader_skip(IOReader *rdr, size_t len) {
+    if (len > rdr->remaining) {
+        return IO_BUF_EMPTY;
+    }
+
+    rdr->ptr += len;
+    rdr->remaining -= len;
+    return (int)len;
+}
+
 int io_reader_get(IOReader *rdr, void *dest, size_t len) {
     const char *raw;
     int err = io_reader_get_raw(rdr, &raw, len);
@@ -61,6 +61,15 @@ int io_reader_peek_raw(IOReader *rdr, const char **ptr, size_t len);
 /// @return <0 on error
 int io_reader_get_raw(IOReader *rdr, const char **ptr, size_t len);
 
+/// @brief Consume exactly @len bytes from the reader without looking at them
+///
+/// @param rdr Pointer to reader in question
+/// @param len Number of bytes to skip
+///
+/// @return Number of bytes consumed on success
+/// @return IO_BUF_EMPTY if fewer than @len bytes remain. Nothing is consumed in that case.
+int io_reader_skip(IOReader *rdr, size_t len);
+
 /// @brief Copy @len bytes from the reader into @dest
 ///
 /// @param rdr Pointer to reader in question
@@ -77,9 +86,13 @@ int io_reader_get(IOReader *rdr, void *dest, size_t len);
 /// @param data Caller's pointer where the number will be copied
 ///
 /// @return Number of bytes consumed on success
-/// @return <0 on error
+/// @return IO_BUF_EMPTY if fewer than 2 bytes remain. Nothing is consumed in that case.
 static inline int io_reader_get_u16(IOReader *rdr, uint16_t *data) {
     uint8_t bytes[sizeof(*data)];
+    if (rdr->remaining < sizeof(bytes)) {
+        return IO_BUF_EMPTY;
+    }
+
     int err = io_reader_get(rdr, bytes, sizeof(bytes));
     *data = bytes[0] << 8 | bytes[1];
     return err;
@@ -91,9 +104,13 @@ static inline int io_reader_get_u16(IOReader *rdr, uint16_t *data) {
 /// @param data Caller's pointer where the number will be copied
 ///
 /// @return Number of bytes consumed on success
-/// @return <0 on error
+/// @return IO_BUF_EMPTY if fewer than 4 bytes remain. Nothing is consumed in that case.
 static inline int io_reader_get_u32(IOReader *rdr, uint32_t *data) {
     uint8_t bytes[sizeof(*data)];
+    if (rdr->remaining < sizeof(bytes)) {
+        return IO_BUF_EMPTY;
+    }
+
     int err = io_reader_get(rdr, bytes, sizeof(bytes));
     *data = bytes[0] << 24 | bytes[1] << 16 | bytes[2] << 8 | bytes[3];
     return err;
@@ -3,13 +3,13 @@
 #include <stdint.h>
 #include <string.h>
 
-enum {
-    LABEL_INVALID_PTR = -22,
-    LABEL_SUCCESS = 0,
-};
-
 static inline bool is_label_ptr(const char *peek) {
-    return *peek & 0xC0;
+    return (*peek & 0xC0) == 0xC0;
+}
+
+// The 0x40 and 0x80 label types are reserved (RFC 6891 deprecated the only one ever defined)
+static inline bool is_label_reserved(const char *peek) {
+    return (*peek & 0xC0) && !is_label_ptr(peek);
 }
 
 static inline size_t label_ptr_offset(const char ptr[2]) {
@@ -18,7 +18,81 @@ static inline size_t label_ptr_offset(const char ptr[2]) {
     return (offset_hi << 8) | offset_lo;
 }
 
+void tiny_dns_label_memo_init(struct tiny_dns_label_memo *memo) {
+    memo->count = 0;
+    memo->pool_len = 0;
+}
+
+static int memo_lookup(const struct tiny_dns_label_memo *memo, size_t target) {
+    for (uint16_t i = 0; i < memo->count; i++) {
+        if (memo->slots[i].target == target) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+static void memo_insert(struct tiny_dns_label_memo *memo, size_t target, const char *suffix,
+                        size_t len) {
+    if (len > sizeof(memo->pool)) {
+        return;
+    }
+
+    // Once full, start over. Later names tend to point at recently decoded ones.
+    if (memo->count == TINY_DNS_LABEL_MEMO_SLOTS ||
+        len > sizeof(memo->pool) - (size_t)memo->pool_len) {
+        tiny_dns_label_memo_init(memo);
+    }
+
+    memo->slots[memo->count].target = (uint16_t)target;
+    memo->slots[memo->count].start = memo->pool_len;
+    memo->slots[memo->count].len = (uint16_t)len;
+    memo->count++;
+
+    memcpy(&memo->pool[memo->pool_len], suffix, len);
+    memo->pool_len += (uint16_t)len;
+}
+
+// Decode the run of uncompressed labels at the position of @rdr, up to the next root label, pointer
+// or reserved label type. The decoded form of a label is its wire form with the length octet
+// replaced by a dot, so the whole run is copied at once and the dots patched in afterwards.
+// @budget is what's left of NAME_MAX_WIRE_LEN for this name, including its root label.
+static int label_run(IOWriter *wr, IOReader *rdr, size_t budget) {
+    const uint8_t *raw = (const uint8_t *)rdr->ptr;
+
+    size_t run = 0;
+    while (run < rdr->remaining && raw[run] != 0 && !(raw[run] & 0xC0)) {
+        size_t label_len = raw[run];
+        if (run + 1 + label_len + 1 > budget) {
+            return LABEL_TOO_LONG;
+        } else if (run + 1 + label_len > rdr->remaining) {
+            return IO_BUF_EMPTY;
+        }
+
+        run += 1 + label_len;
+    }
+
+    void *claim;
+    int err = io_writer_claim(wr, &claim, run);
+    if (err < IO_SUCCESS) {
+        return err;
+    }
+
+    char *out = (char *)claim;
+    memcpy(out, raw, run);
+    for (size_t i = 0; i < run; i += 1 + raw[i]) {
+        out[i] = '.';
+    }
+
+    return io_reader_skip(rdr, run);
+}
+
 int tiny_dns_label_parse(IOWriter *wr, IOReader *rdr) {
+    return tiny_dns_label_parse_memo(wr, rdr, NULL);
+}
+
+int tiny_dns_label_parse_memo(IOWriter *wr, IOReader *rdr, struct tiny_dns_label_memo *memo) {
     const char *origin = rdr->base;
 
     IOReader slicer;
@@ -26,55 +100,244 @@ int tiny_dns_label_parse(IOWriter *wr, IOReader *rdr) {
 
     int err = 0;
 
+    // The decoded form is exactly as long as the wire form: one dot per length octet and the NUL
+    // for the root label. Bounding it and the pointer hops bounds the work done per name.
+    const size_t start_len = wr->len;
+    size_t hops = 0;
+
+    // Where the suffix behind the first compression pointer starts in @wr, if there is one
+    bool memo_pending = false;
+    size_t memo_target = 0;
+    size_t memo_mark = 0;
+
     while (true) {
         const char *raw;
-        err = io_reader_get_raw(active, &raw, 1);
+        err = io_reader_peek_raw(active, &raw, 1);
         if (err < IO_SUCCESS) {
             break;
         }
 
         // Root label
         if (*raw == 0) {
+            io_reader_skip(active, 1);
             err = io_writer_put(wr, raw, 1);
             if (err > IO_SUCCESS) {
                 err = (int)wr->len;
+                if (memo_pending) {
+                    memo_insert(memo, memo_target, wr->base + memo_mark, wr->len - memo_mark);
+                }
             }
             break;
         }
 
         if (is_label_ptr(raw)) {
-            char ptr[2] = { *raw, 0 };
-            err = io_reader_get(active, &ptr[1], 1);
+            char ptr[2];
+            err = io_reader_get(active, ptr, sizeof(ptr));
             if (err < IO_SUCCESS) {
                 break;
+            } else if (err != sizeof(ptr)) {
+                err = IO_BUF_EMPTY;
+                break;
             }
 
+            // A pointer may only refer to a prior occurrence of a name. Since the slice followed
+            // below ends where the pointer starts, every hop moves strictly backwards.
             size_t ptr_offset = label_ptr_offset(ptr);
-            const char *label = origin + ptr_offset;
-            size_t current_offset = active->ptr - origin;
-            size_t label_len = current_offset - ptr_offset;
+            size_t ptr_start = (size_t)(active->ptr - origin) - sizeof(ptr);
+            if (ptr_offset >= ptr_start || ++hops > LABEL_MAX_PTR_HOPS) {
+                err = LABEL_INVALID_PTR;
+                break;
+            }
+
+            if (memo && active == rdr) {
+                int slot = memo_lookup(memo, ptr_offset);
+                if (slot >= 0) {
+                    size_t len = memo->slots[slot].len;
+                    if (wr->len - start_len + len > NAME_MAX_WIRE_LEN) {
+                        err = LABEL_TOO_LONG;
+                        break;
+                    }
 
-            io_reader_init(&slicer, label, label_len);
+                    err = io_writer_put(wr, &memo->pool[memo->slots[slot].start], len);
+                    if (err > IO_SUCCESS) {
+                        err = (int)wr->len;
+                    }
+                    break;
+                }
+
+                memo_pending = true;
+                memo_target = ptr_offset;
+                memo_mark = wr->len;
+            }
+
+            io_reader_init(&slicer, origin + ptr_offset, ptr_start - ptr_offset);
             active = &slicer;
             continue;
         }
 
-        int label_len = (int)*raw;
-        err = io_writer_put(wr, ".", 1);
+        if (is_label_reserved(raw)) {
+            err = LABEL_INVALID;
+            break;
+        }
+
+        err = label_run(wr, active, NAME_MAX_WIRE_LEN - (wr->len - start_len));
         if (err < IO_SUCCESS) {
             break;
         }
+    }
 
-        err = io_reader_get_raw(active, &raw, (size_t)label_len);
+    return err;
+}
+
+int tiny_dns_label_skip(IOReader *rdr) {
+    size_t start = rdr->remaining;
+    size_t wire_len = 0;
+
+    while (true) {
+        const char *raw;
+        int err = io_reader_get_raw(rdr, &raw, 1);
         if (err < IO_SUCCESS) {
+            return err;
+        }
+
+        // Root label
+        if (*raw == 0) {
             break;
         }
 
-        err = io_writer_put(wr, raw, (size_t)label_len);
+        // A pointer always ends the name, skip its second octet and stop
+        if (is_label_ptr(raw)) {
+            err = io_reader_skip(rdr, 1);
+            if (err < IO_SUCCESS) {
+                return err;
+            }
+            break;
+        }
+
+        if (is_label_reserved(raw)) {
+            return LABEL_INVALID;
+        }
+
+        size_t label_len = (uint8_t)*raw;
+        wire_len += 1 + label_len;
+        if (wire_len + 1 > NAME_MAX_WIRE_LEN) {
+            return LABEL_TOO_LONG;
+        }
+
+        err = io_reader_skip(rdr, label_len);
         if (err < IO_SUCCESS) {
+            return err;
+        }
+    }
+
+    return (int)(start - rdr->remaining);
+}
+
+void tiny_dns_label_cursor_init(LabelCursor *cur, const char *msg, size_t msg_len, size_t offset) {
+    cur->msg = msg;
+    cur->msg_len = msg_len;
+    cur->offset = offset;
+    cur->hops = 0;
+    cur->wire_len = 0;
+    cur->done = false;
+}
+
+// Follow compression pointers until @cur is at a length octet
+static int cursor_follow(LabelCursor *cur) {
+    while (true) {
+        if (cur->offset >= cur->msg_len) {
+            return IO_BUF_EMPTY;
+        }
+
+        const char *raw = cur->msg + cur->offset;
+        if (!is_label_ptr(raw)) {
+            return LABEL_SUCCESS;
+        }
+
+        if (cur->offset + 1 >= cur->msg_len) {
+            return IO_BUF_EMPTY;
+        }
+
+        // Only follow pointers to earlier parts of the message, so the walk always terminates
+        size_t ptr_offset = label_ptr_offset(raw);
+        if (ptr_offset >= cur->offset || ++cur->hops > LABEL_MAX_PTR_HOPS) {
+            return LABEL_INVALID_PTR;
+        }
+
+        cur->offset = ptr_offset;
+    }
+}
+
+int tiny_dns_label_next(LabelCursor *cur, const char **label) {
+    int err = cursor_follow(cur);
+    if (err < LABEL_SUCCESS) {
+        return err;
+    }
+
+    if (is_label_reserved(cur->msg + cur->offset)) {
+        return LABEL_INVALID;
+    }
+
+    size_t label_len = (uint8_t)cur->msg[cur->offset];
+    if (cur->offset + 1 + label_len > cur->msg_len) {
+        return IO_BUF_EMPTY;
+    }
+
+    // Count the root label right away, so a name that ends exactly at the limit is accepted
+    if (label_len > 0 && cur->wire_len + 1 + label_len + 1 > NAME_MAX_WIRE_LEN) {
+        return LABEL_TOO_LONG;
+    }
+
+    *label = cur->msg + cur->offset + 1;
+    if (label_len > 0) {
+        cur->offset += 1 + label_len;
+        cur->wire_len += 1 + label_len;
+    }
+
+    return (int)label_len;
+}
+
+int tiny_dns_label_span(LabelCursor *cur, const char **span) {
+    if (cur->done) {
+        return 0;
+    }
+
+    int err = cursor_follow(cur);
+    if (err < LABEL_SUCCESS) {
+        return err;
+    }
+
+    size_t start = cur->offset;
+    size_t pos = start;
+    while (true) {
+        if (pos >= cur->msg_len) {
+            return IO_BUF_EMPTY;
+        }
+
+        const char *raw = cur->msg + pos;
+        if (*raw == 0) {
+            pos++;
+            cur->wire_len++;
+            cur->done = true;
+            break;
+        } else if (is_label_ptr(raw)) {
             break;
+        } else if (is_label_reserved(raw)) {
+            return LABEL_INVALID;
+        }
+
+        size_t label_len = (uint8_t)*raw;
+        if (pos + 1 + label_len > cur->msg_len) {
+            return IO_BUF_EMPTY;
+        } else if (cur->wire_len + 1 + label_len + 1 > NAME_MAX_WIRE_LEN) {
+            return LABEL_TOO_LONG;
         }
+
+        pos += 1 + label_len;
+        cur->wire_len += 1 + label_len;
     }
 
-    return err;
+    *span = cur->msg + start;
+    cur->offset = pos;
+    return (int)(pos - start);
 }
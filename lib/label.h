@@ -1,7 +1,10 @@
 #ifndef TINY_DNS_LABEL_H
 #define TINY_DNS_LABEL_H
 
+#include <stdbool.h>
+
 #include "io.h"
+#include "tiny_dns.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -10,8 +13,110 @@ extern "C" {
 #define NAME_MAX_LEN  253
 #define LABEL_MAX_LEN 63
 
+// Length of a name on the wire, including length octets and the root label
+#define NAME_MAX_WIRE_LEN 255
+
+// Compression pointers followed per name before giving up. Legitimate names need at most one hop
+// per label, and real messages rarely nest more than a handful.
+#define LABEL_MAX_PTR_HOPS 64
+
+enum {
+    LABEL_TOO_LONG = -24,
+    LABEL_INVALID = -23,
+    LABEL_INVALID_PTR = -22,
+    LABEL_SUCCESS = 0,
+};
+
+/// @brief Empty @memo, e.g. before parsing a new message
+void tiny_dns_label_memo_init(struct tiny_dns_label_memo *memo);
+
+/// @brief Decode the name at the current position of @rdr into @dest, following compression
+///     pointers. The work done is bounded: pointers must point strictly backwards, at most
+///     LABEL_MAX_PTR_HOPS of them are followed, and the name may not exceed NAME_MAX_WIRE_LEN.
+///
+/// @param dest Destination for the decoded name: a dot per label, followed by a NUL
+/// @param rdr Reader positioned at the start of a name
+///
+/// @return Length of the decoded name on success
+/// @return LABEL_INVALID_PTR for forward, self referencing or too deeply chained pointers
+/// @return LABEL_INVALID for reserved label types
+/// @return LABEL_TOO_LONG if the name exceeds NAME_MAX_WIRE_LEN
+/// @return <0 on other errors
 int tiny_dns_label_parse(IOWriter *dest, IOReader *rdr);
 
+/// @brief Like tiny_dns_label_parse, but reuse suffixes already decoded from the same message
+///     The first compression pointer of the name is looked up in @memo. On a hit the decoded
+///     suffix is copied in one go; on a miss it is decoded as usual and added to @memo.
+///
+/// @param dest Destination for the decoded name
+/// @param rdr Reader positioned at the start of a name
+/// @param memo Memo for the message wrapped by @rdr. May be NULL.
+///
+/// @return Length of the decoded name on success
+/// @return <0 on error
+int tiny_dns_label_parse_memo(IOWriter *dest, IOReader *rdr, struct tiny_dns_label_memo *memo);
+
+/// @brief Write the wire form of the dotted name @text to @wr
+///     Dots are found, length octets written and the label and name limits checked in a single
+///     pass, using SSE2, AVX2 or NEON when the build targets them. A trailing dot is accepted, and
+///     both "" and "." encode the root name.
+///
+/// @param wr Destination for the length prefixed labels and the root label
+/// @param text NUL terminated, dotted name
+///
+/// @return Length of the wire form on success
+/// @return LABEL_INVALID for empty labels
+/// @return LABEL_TOO_LONG if a label exceeds LABEL_MAX_LEN or the name NAME_MAX_WIRE_LEN
+/// @return IO_BUF_TOO_SMALL if @wr can't hold the wire form. Nothing is written in that case.
+int tiny_dns_label_encode(IOWriter *wr, const char *text);
+
+/// @brief Portable implementation of tiny_dns_label_encode, which it falls back to
+int tiny_dns_label_encode_scalar(IOWriter *wr, const char *text);
+
+/// @brief Advance @rdr past a name without copying it
+///     Stops after the root label or after the first compression pointer, since the bytes the
+///     pointer refers to belong to a different part of the message.
+///
+/// @param rdr Reader positioned at the start of a name
+///
+/// @return Number of bytes consumed on success
+/// @return <0 on error
+int tiny_dns_label_skip(IOReader *rdr);
+
+/// @brief Cursor over the labels of a possibly compressed name inside a message
+typedef struct {
+    const char *msg;
+    size_t msg_len;
+    size_t offset;
+    size_t hops;
+    size_t wire_len;
+    bool done;
+} LabelCursor;
+
+/// @brief Position @cur at the name starting at @offset into @msg
+void tiny_dns_label_cursor_init(LabelCursor *cur, const char *msg, size_t msg_len, size_t offset);
+
+/// @brief Step to the next label of the name, following compression pointers
+///
+/// @param cur Cursor in question
+/// @param label Caller's pointer, set to the first byte of the label
+///
+/// @return Length of the label on success, 0 when the root label is reached
+/// @return <0 on error
+int tiny_dns_label_next(LabelCursor *cur, const char **label);
+
+/// @brief Step over the next contiguous stretch of the name's wire form, following compression
+///     pointers. A span is a run of length octets and labels up to the next pointer, or up to and
+///     including the root label. Concatenated, the spans are the uncompressed wire form.
+///     Don't mix with tiny_dns_label_next on the same cursor.
+///
+/// @param cur Cursor in question
+/// @param span Caller's pointer, set to the first byte of the span
+///
+/// @return Length of the span on success, 0 once the root label has been returned
+/// @return <0 on error
+int tiny_dns_label_span(LabelCursor *cur, const char **span);
+
 #ifdef __cplusplus
 }
 #endif
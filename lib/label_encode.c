@@ -0,0 +1,181 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "label.h"
+
+// The vector kernel is picked from what the compiler targets. Build with -march=native (see the
+// TINY_DNS_NATIVE option) to get AVX2 on x86, SSE2 is the x86-64 baseline and NEON the AArch64 one.
+#if !defined(TINY_DNS_NO_SIMD) && defined(__AVX2__)
+    #include <immintrin.h>
+    #define ENCODE_VECTOR 32
+#elif !defined(TINY_DNS_NO_SIMD) && defined(__SSE2__)
+    #include <emmintrin.h>
+    #define ENCODE_VECTOR 16
+#elif !defined(TINY_DNS_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    #include <arm_neon.h>
+    #define ENCODE_VECTOR 16
+#endif
+
+// Room for the wire form of the longest name the scan accepts, including a partial last chunk
+#define ENCODE_SCAN_LIMIT (NAME_MAX_WIRE_LEN + 1)
+
+// Shared tail of both encoders: a delimiter was found at text index @i, and the current label
+// starts at @start. The wire form is being built in @out, where text index i lives at out[i + 1].
+// Returns 1 when the name is complete, 0 to keep going, <0 on error.
+static inline int encode_delimiter(char *out, const char *text, size_t i, size_t *start,
+                                   size_t *wire_len) {
+    size_t label_len = i - *start;
+
+    if (text[i] == '.') {
+        if (label_len == 0) {
+            // "." alone is the root name, any other empty label is malformed
+            if (i == 0 && text[1] == '\0') {
+                out[0] = 0;
+                *wire_len = 1;
+                return 1;
+            }
+            return LABEL_INVALID;
+        }
+    } else if (label_len == 0) {
+        // The empty name is the root name too, otherwise this follows a trailing dot, whose slot
+        // becomes the root label
+        out[*start] = 0;
+        *wire_len = i == 0 ? 1 : i + 1;
+        return *wire_len > NAME_MAX_WIRE_LEN ? LABEL_TOO_LONG : 1;
+    }
+
+    if (label_len > LABEL_MAX_LEN) {
+        return LABEL_TOO_LONG;
+    }
+
+    out[*start] = (char)label_len;
+    *start = i + 1;
+
+    if (text[i] == '\0') {
+        out[i + 1] = 0;
+        *wire_len = i + 2;
+        return *wire_len > NAME_MAX_WIRE_LEN ? LABEL_TOO_LONG : 1;
+    }
+
+    return 0;
+}
+
+static int encode_put(IOWriter *wr, const char *wire, size_t wire_len) {
+    int err = io_writer_put(wr, wire, wire_len);
+    return err < IO_SUCCESS ? err : (int)wire_len;
+}
+
+int tiny_dns_label_encode_scalar(IOWriter *wr, const char *text) {
+    char out[ENCODE_SCAN_LIMIT + 1];
+    size_t start = 0;
+    size_t wire_len = 0;
+
+    for (size_t i = 0; i < ENCODE_SCAN_LIMIT; i++) {
+        out[i + 1] = text[i];
+        if (text[i] != '.' && text[i] != '\0') {
+            continue;
+        }
+
+        int done = encode_delimiter(out, text, i, &start, &wire_len);
+        if (done < 0) {
+            return done;
+        } else if (done) {
+            return encode_put(wr, out, wire_len);
+        }
+    }
+
+    return LABEL_TOO_LONG;
+}
+
+#ifdef ENCODE_VECTOR
+
+    // Mask bits per byte of text: x86 movemask yields one bit per byte, the NEON narrowing trick
+    // yields four.
+    #if defined(__AVX2__) || defined(__SSE2__)
+        #define MASK_BITS_PER_BYTE 1
+    #else
+        #define MASK_BITS_PER_BYTE 4
+    #endif
+
+    #if defined(__has_attribute)
+        #if __has_attribute(no_sanitize_address)
+            #define ENCODE_NO_ASAN __attribute__((no_sanitize_address))
+        #endif
+    #endif
+    #ifndef ENCODE_NO_ASAN
+        #define ENCODE_NO_ASAN
+    #endif
+
+// Chunks are loaded from aligned addresses, so they never cross into another page, but they do
+// read past the NUL terminator. That is harmless, but an instrumented build would report it.
+
+// Copies the chunk at @p to @dest and returns a mask of its dots and NULs
+ENCODE_NO_ASAN static inline uint64_t scan_chunk(const char *p, char *dest) {
+    #if defined(__AVX2__)
+    __m256i v = _mm256_load_si256((const __m256i *)p);
+    _mm256_storeu_si256((__m256i *)dest, v);
+    __m256i delim = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('.')),
+                                    _mm256_cmpeq_epi8(v, _mm256_setzero_si256()));
+    return (uint32_t)_mm256_movemask_epi8(delim);
+    #elif defined(__SSE2__)
+    __m128i v = _mm_load_si128((const __m128i *)p);
+    _mm_storeu_si128((__m128i *)dest, v);
+    __m128i delim = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('.')),
+                                 _mm_cmpeq_epi8(v, _mm_setzero_si128()));
+    return (uint32_t)_mm_movemask_epi8(delim);
+    #else
+    uint8x16_t v = vld1q_u8((const uint8_t *)p);
+    vst1q_u8((uint8_t *)dest, v);
+    uint8x16_t delim = vorrq_u8(vceqq_u8(v, vdupq_n_u8('.')), vceqq_u8(v, vdupq_n_u8(0)));
+    uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(delim), 4);
+    return vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+    #endif
+}
+
+ENCODE_NO_ASAN
+int tiny_dns_label_encode(IOWriter *wr, const char *text) {
+    // The first chunk starts up to ENCODE_VECTOR - 1 bytes before the text, and the last one may
+    // extend ENCODE_VECTOR bytes past the limit
+    char scratch[ENCODE_VECTOR + 1 + ENCODE_SCAN_LIMIT + ENCODE_VECTOR];
+    char *out = scratch + ENCODE_VECTOR;
+
+    size_t misalign = (uintptr_t)text % ENCODE_VECTOR;
+    const char *p = text - misalign;
+
+    // Delimiters before the start of the text belong to something else
+    uint64_t mask = scan_chunk(p, out + 1 - misalign);
+    mask &= ~(uint64_t)0 << (misalign * MASK_BITS_PER_BYTE);
+
+    size_t start = 0;
+    size_t wire_len = 0;
+    for (size_t chunk = 0;;) {
+        while (mask) {
+            size_t i = chunk + (size_t)__builtin_ctzll(mask) / MASK_BITS_PER_BYTE - misalign;
+            int done = encode_delimiter(out, text, i, &start, &wire_len);
+            if (done < 0) {
+                return done;
+            } else if (done) {
+                return encode_put(wr, out, wire_len);
+            }
+
+            // Clear every bit belonging to this byte
+            mask &= ~(uint64_t)0 << (((i + misalign - chunk) + 1) * MASK_BITS_PER_BYTE - 1) << 1;
+        }
+
+        chunk += ENCODE_VECTOR;
+        if (chunk - misalign >= ENCODE_SCAN_LIMIT) {
+            return LABEL_TOO_LONG;
+        }
+
+        mask = scan_chunk(p + chunk, out + 1 + chunk - misalign);
+    }
+}
+
+#else
+
+int tiny_dns_label_encode(IOWriter *wr, const char *text) {
+    return tiny_dns_label_encode_scalar(wr, text);
+}
+
+#endif
@@ -0,0 +1,247 @@
+#include <string.h>
+
+#include "label.h"
+#include "rdata.h"
+#include "tiny_dns.h"
+
+#if !defined(TINY_DNS_NO_SIMD) && defined(__SSE2__)
+    #include <emmintrin.h>
+    #define NAME_VECTOR_SSE2
+#elif !defined(TINY_DNS_NO_SIMD) && (defined(__ARM_NEON) || defined(__ARM_NEON__))
+    #include <arm_neon.h>
+    #define NAME_VECTOR_NEON
+#endif
+
+#define SWAR_ONES 0x0101010101010101ull
+#define SWAR_HIGH 0x8080808080808080ull
+
+// Multiplier of the name hash, the 64 bit golden ratio
+#define HASH_K 0x9E3779B97F4A7C15ull
+
+static inline char ascii_lower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+// Lower case eight ASCII letters at once. Bytes with the high bit set are left alone.
+static inline uint64_t swar_lower(uint64_t x) {
+    uint64_t low7 = x & ~SWAR_HIGH;
+    uint64_t ge_a = low7 + (0x80 - 'A') * SWAR_ONES;
+    uint64_t gt_z = low7 + (0x7F - 'Z') * SWAR_ONES;
+    uint64_t upper = (ge_a ^ gt_z) & ~x & SWAR_HIGH;
+    return x | (upper >> 2);
+}
+
+static inline uint64_t load_u64(const char *p) {
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+#if defined(NAME_VECTOR_SSE2)
+static inline __m128i vector_lower(__m128i v) {
+    // Signed compares, so bytes >= 0x80 are below 'A' and stay as they are
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('Z' + 1)));
+    return _mm_or_si128(v, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+
+static inline bool vector_case_eq(const char *a, const char *b) {
+    __m128i va = vector_lower(_mm_loadu_si128((const __m128i *)a));
+    __m128i vb = vector_lower(_mm_loadu_si128((const __m128i *)b));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)) == 0xFFFF;
+}
+#elif defined(NAME_VECTOR_NEON)
+static inline uint8x16_t vector_lower(uint8x16_t v) {
+    uint8x16_t upper = vcleq_u8(vsubq_u8(v, vdupq_n_u8('A')), vdupq_n_u8('Z' - 'A'));
+    return vorrq_u8(v, vandq_u8(upper, vdupq_n_u8(0x20)));
+}
+
+static inline bool vector_case_eq(const char *a, const char *b) {
+    uint8x16_t va = vector_lower(vld1q_u8((const uint8_t *)a));
+    uint8x16_t vb = vector_lower(vld1q_u8((const uint8_t *)b));
+    return vminvq_u8(vceqq_u8(va, vb)) == 0xFF;
+}
+#endif
+
+// Compare @len bytes of two names, ignoring ASCII case
+static bool wire_case_eq(const char *a, const char *b, size_t len) {
+    size_t i = 0;
+#if defined(NAME_VECTOR_SSE2) || defined(NAME_VECTOR_NEON)
+    for (; i + 16 <= len; i += 16) {
+        if (!vector_case_eq(&a[i], &b[i])) {
+            return false;
+        }
+    }
+#endif
+    for (; i + 8 <= len; i += 8) {
+        if (swar_lower(load_u64(&a[i])) != swar_lower(load_u64(&b[i]))) {
+            return false;
+        }
+    }
+    for (; i < len; i++) {
+        if (ascii_lower(a[i]) != ascii_lower(b[i])) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+static inline uint64_t hash_mix(uint64_t h, uint64_t v) {
+    return (((h << 5) | (h >> 59)) ^ v) * HASH_K;
+}
+
+tiny_dns_err tiny_dns_name_view_decode(const struct tiny_dns_name_view *view,
+                                       struct tiny_dns_name *name) {
+    if (!view || !name || view->offset >= view->msg_len) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    IOReader rdr;
+    io_reader_init(&rdr, view->msg, view->msg_len);
+    rdr.ptr += view->offset;
+    rdr.remaining -= view->offset;
+
+    return tiny_dns_name_decode(name, &rdr, NULL);
+}
+
+int tiny_dns_name_view_len(const struct tiny_dns_name_view *view) {
+    LabelCursor cur;
+    tiny_dns_label_cursor_init(&cur, view->msg, view->msg_len, view->offset);
+
+    int len = 0;
+    const char *label;
+    int label_len;
+    while ((label_len = tiny_dns_label_next(&cur, &label)) > 0) {
+        // Every label but the first is preceded by a dot
+        len += label_len + (len > 0 ? 1 : 0);
+    }
+
+    return label_len < 0 ? label_len : len;
+}
+
+bool tiny_dns_name_view_eq(const struct tiny_dns_name_view *view, const char *name) {
+    LabelCursor cur;
+    tiny_dns_label_cursor_init(&cur, view->msg, view->msg_len, view->offset);
+
+    // "." is the root name in text form
+    if (name[0] == '.' && name[1] == '\0') {
+        name++;
+    }
+
+    const char *label;
+    int label_len;
+    while ((label_len = tiny_dns_label_next(&cur, &label)) > 0) {
+        for (int i = 0; i < label_len; i++) {
+            if (name[i] == '\0' || ascii_lower(label[i]) != ascii_lower(name[i])) {
+                return false;
+            }
+        }
+
+        name += label_len;
+        if (*name == '.') {
+            name++;
+        } else if (*name != '\0') {
+            return false;
+        }
+    }
+
+    return label_len == 0 && *name == '\0';
+}
+
+// Both functions below work on the uncompressed wire form, span by span. Length octets are at most
+// 63 and the root label is 0, so folding case over them leaves them untouched and labels needn't
+// be picked apart.
+
+bool tiny_dns_name_wire_eq(const struct tiny_dns_name_view *a, const struct tiny_dns_name_view *b) {
+    LabelCursor cur_a;
+    LabelCursor cur_b;
+    tiny_dns_label_cursor_init(&cur_a, a->msg, a->msg_len, a->offset);
+    tiny_dns_label_cursor_init(&cur_b, b->msg, b->msg_len, b->offset);
+
+    const char *span_a = NULL;
+    const char *span_b = NULL;
+    int len_a = 0;
+    int len_b = 0;
+    while (true) {
+        if (len_a == 0 && len_b == 0) {
+            if (cur_a.done || cur_b.done) {
+                return cur_a.done && cur_b.done;
+            }
+
+            // Both names continue with the very same bytes, typically through pointers to one
+            // suffix
+            if (cur_a.msg == cur_b.msg && cur_a.offset == cur_b.offset) {
+                return true;
+            }
+        }
+
+        // Spans end wherever either name has a pointer, so they rarely line up
+        if (len_a == 0 && (len_a = tiny_dns_label_span(&cur_a, &span_a)) <= 0) {
+            return false;
+        }
+        if (len_b == 0 && (len_b = tiny_dns_label_span(&cur_b, &span_b)) <= 0) {
+            return false;
+        }
+
+        int len = len_a < len_b ? len_a : len_b;
+        if (!wire_case_eq(span_a, span_b, (size_t)len)) {
+            return false;
+        }
+
+        span_a += len;
+        span_b += len;
+        len_a -= len;
+        len_b -= len;
+    }
+}
+
+tiny_dns_err tiny_dns_name_wire_hash(const struct tiny_dns_name_view *view, uint64_t *hash) {
+    LabelCursor cur;
+    tiny_dns_label_cursor_init(&cur, view->msg, view->msg_len, view->offset);
+
+    // Hashed a word at a time. Words straddling two spans are put together in @carry, so how the
+    // name is compressed doesn't change the result.
+    uint64_t h = 0;
+    char carry[8];
+    size_t carried = 0;
+
+    const char *span;
+    int span_len;
+    while ((span_len = tiny_dns_label_span(&cur, &span)) > 0) {
+        size_t len = (size_t)span_len;
+        size_t i = 0;
+
+        if (carried > 0) {
+            i = sizeof(carry) - carried < len ? sizeof(carry) - carried : len;
+            memcpy(&carry[carried], span, i);
+            carried += i;
+            if (carried < sizeof(carry)) {
+                continue;
+            }
+
+            h = hash_mix(h, swar_lower(load_u64(carry)));
+            carried = 0;
+        }
+
+        for (; i + 8 <= len; i += 8) {
+            h = hash_mix(h, swar_lower(load_u64(&span[i])));
+        }
+
+        carried = len - i;
+        memcpy(carry, &span[i], carried);
+    }
+
+    if (span_len < 0) {
+        return span_len == IO_BUF_EMPTY ? TINY_DNS_ERR_INVALID : span_len;
+    }
+
+    if (carried > 0) {
+        memset(&carry[carried], 0, sizeof(carry) - carried);
+        h = hash_mix(h, swar_lower(load_u64(carry)));
+    }
+
+    h = hash_mix(h, cur.wire_len);
+    *hash = h ^ (h >> 32);
+    return TINY_DNS_ERR_NONE;
+}
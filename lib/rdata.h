@@ -7,17 +7,41 @@
 extern "C" {
 #endif
 
-tiny_dns_err tiny_dns_name_decode(struct tiny_dns_name *name, IOReader *rdr);
+tiny_dns_err tiny_dns_encode_header(IOWriter *buffer, const struct tiny_dns_header *hdr);
 
-tiny_dns_err tiny_dns_parse_rdata_a(IOReader *buf, struct tiny_dns_rr *rr);
+tiny_dns_err tiny_dns_parse_header(struct tiny_dns_header *hdr, IOReader *buf);
 
-tiny_dns_err tiny_dns_parse_rdata_aaaa(IOReader *buf, struct tiny_dns_rr *rr);
+tiny_dns_err tiny_dns_discard_questions(uint16_t qdcount, IOReader *buf);
 
-tiny_dns_err tiny_dns_parse_rdata_cname(IOReader *buf, struct tiny_dns_rr *rr);
+/// @brief Account for the record that was just read from \p iter and report its section
+void tiny_dns_iter_advance(struct tiny_dns_iter *iter, enum tiny_dns_section *section);
 
-tiny_dns_err tiny_dns_parse_rdata_srv(IOReader *buf, struct tiny_dns_rr *rr);
+/// @brief Decode the rdata of \p rr, whose type and rdlength are already filled in
+tiny_dns_err tiny_dns_parse_rdata(IOReader *buf, struct tiny_dns_rr *rr,
+                                  struct tiny_dns_label_memo *memo);
 
-tiny_dns_err tiny_dns_parse_rdata_txt(IOReader *buf, struct tiny_dns_rr *rr);
+/// @brief Decode the name at the current position of \p rdr into \p name
+///     \p memo may be NULL, otherwise suffixes are reused from and added to it.
+tiny_dns_err tiny_dns_name_decode(struct tiny_dns_name *name, IOReader *rdr,
+                                  struct tiny_dns_label_memo *memo);
+
+tiny_dns_err tiny_dns_parse_rdata_a(IOReader *buf, struct tiny_dns_rr *rr,
+                                    struct tiny_dns_label_memo *memo);
+
+tiny_dns_err tiny_dns_parse_rdata_aaaa(IOReader *buf, struct tiny_dns_rr *rr,
+                                       struct tiny_dns_label_memo *memo);
+
+tiny_dns_err tiny_dns_parse_rdata_cname(IOReader *buf, struct tiny_dns_rr *rr,
+                                        struct tiny_dns_label_memo *memo);
+
+tiny_dns_err tiny_dns_parse_rdata_soa(IOReader *buf, struct tiny_dns_rr *rr,
+                                      struct tiny_dns_label_memo *memo);
+
+tiny_dns_err tiny_dns_parse_rdata_srv(IOReader *buf, struct tiny_dns_rr *rr,
+                                      struct tiny_dns_label_memo *memo);
+
+tiny_dns_err tiny_dns_parse_rdata_txt(IOReader *buf, struct tiny_dns_rr *rr,
+                                      struct tiny_dns_label_memo *memo);
 
 #ifdef __cplusplus
 }
@@ -1,5 +1,12 @@
 #include "tiny_dns.h"
 
-tiny_dns_err tiny_dns_parse_rdata_a(IOReader *buf, struct tiny_dns_rr *rr) {
+tiny_dns_err tiny_dns_parse_rdata_a(IOReader *buf, struct tiny_dns_rr *rr,
+                                    struct tiny_dns_label_memo *memo) {
+    (void)memo;
+
+    if (rr->rdlength != sizeof(rr->rdata.rr_a)) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
     return io_reader_get(buf, rr->rdata.rr_a, rr->rdlength);
 }
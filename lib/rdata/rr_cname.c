@@ -4,7 +4,8 @@
 #include "rdata.h"
 #include "tiny_dns.h"
 
-tiny_dns_err tiny_dns_parse_rdata_cname(IOReader *buf, struct tiny_dns_rr *rr) {
+tiny_dns_err tiny_dns_parse_rdata_cname(IOReader *buf, struct tiny_dns_rr *rr,
+                                        struct tiny_dns_label_memo *memo) {
     const char *raw;
     int err = io_reader_get_raw(buf, &raw, rr->rdlength);
     if (err < IO_SUCCESS) {
@@ -15,7 +16,7 @@ tiny_dns_err tiny_dns_parse_rdata_cname(IOReader *buf, struct tiny_dns_rr *rr) {
     io_reader_init(&cname, raw, (size_t)err);
     cname.base = buf->base;
 
-    err = tiny_dns_name_decode(&rr->rdata.rr_cname, &cname);
+    err = tiny_dns_name_decode(&rr->rdata.rr_cname, &cname, memo);
     if (err < TINY_DNS_ERR_NONE) {
         return err;
     }
@@ -0,0 +1,54 @@
+#include "io.h"
+#include "label.h"
+#include "rdata.h"
+#include "tiny_dns.h"
+
+// Check the name at the start of @soa, point @view at it and step over it
+static tiny_dns_err soa_name(IOReader *soa, size_t msg_len, struct tiny_dns_name_view *view) {
+    view->msg = soa->base;
+    view->msg_len = msg_len;
+    view->offset = (uint16_t)(soa->ptr - soa->base);
+
+    int err = tiny_dns_name_view_len(view);
+    if (err >= 0) {
+        err = tiny_dns_label_skip(soa);
+    }
+    return err < 0 ? err : TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_parse_rdata_soa(IOReader *buf, struct tiny_dns_rr *rr,
+                                      struct tiny_dns_label_memo *memo) {
+    (void)memo;
+
+    size_t msg_len = (size_t)(buf->ptr - buf->base) + buf->remaining;
+    const char *raw;
+    int err = io_reader_get_raw(buf, &raw, rr->rdlength);
+    if (err < IO_SUCCESS) {
+        return err;
+    }
+
+    // Keep the names and numbers within the rdata, with the message as base for pointers
+    IOReader soa;
+    io_reader_init(&soa, raw, (size_t)err);
+    soa.base = buf->base;
+
+    struct tiny_dns_soa *out = &rr->rdata.rr_soa;
+    err = soa_name(&soa, msg_len, &out->mname);
+    if (err < TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    err = soa_name(&soa, msg_len, &out->rname);
+    if (err < TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    uint32_t *fields[] = { &out->serial, &out->refresh, &out->retry, &out->expire, &out->minimum };
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++) {
+        if (io_reader_get_u32(&soa, fields[i]) < IO_SUCCESS) {
+            return TINY_DNS_ERR_INVALID;
+        }
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
@@ -2,7 +2,8 @@
 #include "rdata.h"
 #include "tiny_dns.h"
 
-tiny_dns_err tiny_dns_parse_rdata_srv(IOReader *buf, struct tiny_dns_rr *rr) {
+tiny_dns_err tiny_dns_parse_rdata_srv(IOReader *buf, struct tiny_dns_rr *rr,
+                                      struct tiny_dns_label_memo *memo) {
     int err = io_reader_get_u16(buf, &rr->rdata.rr_srv.priority);
     if (err < IO_SUCCESS) {
         return err;
@@ -18,5 +19,5 @@ tiny_dns_err tiny_dns_parse_rdata_srv(IOReader *buf, struct tiny_dns_rr *rr) {
         return err;
     }
 
-    return tiny_dns_name_decode(&rr->rdata.rr_srv.target, buf);
+    return tiny_dns_name_decode(&rr->rdata.rr_srv.target, buf, memo);
 }
@@ -1,6 +1,9 @@
 #include "tiny_dns.h"
 
-tiny_dns_err tiny_dns_parse_rdata_txt(IOReader *buf, struct tiny_dns_rr *rr) {
+tiny_dns_err tiny_dns_parse_rdata_txt(IOReader *buf, struct tiny_dns_rr *rr,
+                                      struct tiny_dns_label_memo *memo) {
+    (void)memo;
+
     char prefix;
     tiny_dns_err err = io_reader_get(buf, &prefix, 1);
     if (err < TINY_DNS_ERR_NONE) {
@@ -0,0 +1,96 @@
+#include "label.h"
+#include "rdata.h"
+#include "tiny_dns.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+#define DNS_HEADER_SIZE 12
+
+// Validate the name at the reader's position in a single walk, then step over it
+static tiny_dns_err question_name(IOReader *buf, struct tiny_dns_question_view *q) {
+    size_t msg_len = (size_t)(buf->ptr - buf->base) + buf->remaining;
+    size_t offset = (size_t)(buf->ptr - buf->base);
+
+    LabelCursor cur;
+    tiny_dns_label_cursor_init(&cur, buf->base, msg_len, offset);
+
+    // The name ends in the message at its first pointer, or at its root label if it has none
+    size_t end = 0;
+    while (true) {
+        size_t at = cur.offset;
+        const char *label;
+        int label_len = tiny_dns_label_next(&cur, &label);
+        if (label_len < 0) {
+            return label_len == IO_BUF_EMPTY ? TINY_DNS_ERR_INVALID : label_len;
+        }
+
+        if (end == 0 && cur.hops > 0) {
+            end = at + 2;
+        }
+
+        if (label_len == 0) {
+            if (end == 0) {
+                end = at + 1;
+            }
+            break;
+        }
+    }
+
+    q->qname.msg = buf->base;
+    q->qname.msg_len = msg_len;
+    q->qname.offset = (uint16_t)offset;
+    q->qname_wire_len = (uint16_t)(end - offset);
+
+    return io_reader_skip(buf, end - offset) < IO_SUCCESS ? TINY_DNS_ERR_INVALID
+                                                         : TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_request_parse(struct tiny_dns_request *req, const void *data, size_t len,
+                                    struct tiny_dns_question_view *questions, size_t capacity) {
+    if (!req || !data || len < DNS_HEADER_SIZE) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    IOReader buf;
+    io_reader_init(&buf, data, len);
+
+    tiny_dns_err err = tiny_dns_parse_header(&req->header, &buf);
+    if (IS_ERR(err)) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    req->msg = data;
+    req->msg_len = len;
+    req->questions_end = DNS_HEADER_SIZE;
+
+    if (req->header.flags.qr) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    if (req->header.flags.opcode != OPCODE_QUERY) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    }
+
+    if (req->header.qdcount > capacity) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    for (uint16_t i = 0; i < req->header.qdcount; i++) {
+        err = question_name(&buf, &questions[i]);
+        if (IS_ERR(err)) {
+            return err;
+        }
+
+        err = io_reader_get_u16(&buf, &questions[i].qtype);
+        if (!IS_ERR(err)) {
+            err = io_reader_get_u16(&buf, &questions[i].qclass);
+        }
+        if (IS_ERR(err)) {
+            return TINY_DNS_ERR_INVALID;
+        }
+    }
+
+    req->questions_end = (uint16_t)(buf.ptr - buf.base);
+
+    return TINY_DNS_ERR_NONE;
+}
@@ -51,7 +51,7 @@ static int encode_header_flags(IOWriter *buf, const struct tiny_dns_flags *flags
     return io_writer_put_u16(buf, bits);
 }
 
-static tiny_dns_err tiny_dns_encode_header(IOWriter *buffer, const struct tiny_dns_header *hdr) {
+tiny_dns_err tiny_dns_encode_header(IOWriter *buffer, const struct tiny_dns_header *hdr) {
     tiny_dns_err err = io_writer_put_u16(buffer, hdr->id);
     if (IS_ERR(err)) {
         return err;
@@ -86,37 +86,15 @@ static tiny_dns_err tiny_dns_encode_header(IOWriter *buffer, const struct tiny_d
 }
 
 static tiny_dns_err tiny_dns_name_encode(IOWriter *buf, const char *name) {
-    // leading length byte + string + null term
-    size_t reserve_len = strlen(name) + 2;
-
-    void *claim_raw;
-    int err = io_writer_claim(buf, &claim_raw, reserve_len);
-    if (err < IO_SUCCESS) {
-        return err;
-    }
-    char *claim = claim_raw;
-
     // Domain names are composed of "labels".
     // Each label is separated by a "." in human-readable form.
     // In the DNS message, a label is proceeded by a single octet representing its
     // length, including the first label. Labels also have a null terminator.
-    char *length_index = claim;
-    claim++;
-
-    // Include the null terminator, but not the leading byte
-    size_t name_length = reserve_len - 1;
-    memcpy(claim, name, name_length);
-
-    for (size_t i = 0, j = 0; i < name_length; i++) {
-        if (claim[i] == '.') {
-            *length_index = (uint8_t)j;
-            length_index = &claim[i];
-            j = 0;
-        } else if (claim[i] == '\0') {
-            *length_index = (uint8_t)j;
-        } else {
-            j++;
-        }
+    int err = tiny_dns_label_encode(buf, name);
+    if (err == LABEL_INVALID || err == LABEL_TOO_LONG) {
+        return TINY_DNS_ERR_INVALID;
+    } else if (err < IO_SUCCESS) {
+        return err;
     }
 
     return TINY_DNS_ERR_NONE;
@@ -173,6 +151,54 @@ tiny_dns_err tiny_dns_build_query(void *buffer, size_t *len, uint16_t id, const
     return TINY_DNS_ERR_NONE;
 }
 
+tiny_dns_err tiny_dns_query_prepare(struct tiny_dns_query_template *tmpl, const char *name,
+                                    enum tiny_dns_rr_type qtype) {
+    if (!tmpl || !name) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    size_t len = sizeof(tmpl->msg);
+    tiny_dns_err err = tiny_dns_build_query(tmpl->msg, &len, 0, name, qtype);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    tmpl->len = (uint16_t)len;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_query_render(const struct tiny_dns_query_template *tmpl, void *buffer,
+                                   size_t *len, uint16_t id) {
+    if (*len < tmpl->len) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    uint8_t *out = buffer;
+    memcpy(out, tmpl->msg, tmpl->len);
+    out[0] = (uint8_t)(id >> 8);
+    out[1] = (uint8_t)id;
+
+    *len = tmpl->len;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_query_render_qtype(const struct tiny_dns_query_template *tmpl, void *buffer,
+                                         size_t *len, uint16_t id, uint16_t qtype) {
+    tiny_dns_err err = tiny_dns_query_render(tmpl, buffer, len, id);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    // qtype is followed only by qclass
+    uint8_t *out = (uint8_t *)buffer + tmpl->len - 2 * sizeof(uint16_t);
+    out[0] = (uint8_t)(qtype >> 8);
+    out[1] = (uint8_t)qtype;
+
+    return TINY_DNS_ERR_NONE;
+}
+
 static void decode_flags(struct tiny_dns_flags *flags, uint16_t bits) {
     flags->qr = bits & (1 << 15);
     flags->opcode = (bits >> 11) & 0xF;
@@ -185,7 +211,7 @@ static void decode_flags(struct tiny_dns_flags *flags, uint16_t bits) {
     flags->rcode = bits & 0x0F;
 }
 
-static tiny_dns_err tiny_dns_parse_header(struct tiny_dns_header *hdr, IOReader *buf) {
+tiny_dns_err tiny_dns_parse_header(struct tiny_dns_header *hdr, IOReader *buf) {
     tiny_dns_err err = io_reader_get_u16(buf, &hdr->id);
     if (IS_ERR(err)) {
         return err;
@@ -222,11 +248,12 @@ static tiny_dns_err tiny_dns_parse_header(struct tiny_dns_header *hdr, IOReader
     return TINY_DNS_ERR_NONE;
 }
 
-tiny_dns_err tiny_dns_name_decode(struct tiny_dns_name *name, IOReader *rdr) {
+tiny_dns_err tiny_dns_name_decode(struct tiny_dns_name *name, IOReader *rdr,
+                                  struct tiny_dns_label_memo *memo) {
     IOWriter buf;
     io_writer_init(&buf, name->name, sizeof(name->name));
 
-    int err = tiny_dns_label_parse(&buf, rdr);
+    int err = tiny_dns_label_parse_memo(&buf, rdr, memo);
     if (err < IO_SUCCESS) {
         return err;
     }
@@ -239,9 +266,9 @@ tiny_dns_err tiny_dns_name_decode(struct tiny_dns_name *name, IOReader *rdr) {
 }
 
 static tiny_dns_err tiny_dns_parse_rdata_unknown(IOReader *buf, struct tiny_dns_rr *rr) {
-    const char *raw;
-    int err = io_reader_get_raw(buf, &raw, rr->rdlength);
-    if (err > IO_SUCCESS) {
+    const char *raw = buf->ptr;
+    int err = rr->rdlength ? io_reader_get_raw(buf, &raw, rr->rdlength) : 0;
+    if (err >= IO_SUCCESS) {
         rr->rdata.unknown.data = raw;
         rr->rdata.unknown.len = err;
     }
@@ -249,18 +276,59 @@ static tiny_dns_err tiny_dns_parse_rdata_unknown(IOReader *buf, struct tiny_dns_
     return err;
 }
 
-static tiny_dns_err tiny_dns_parse_rr(struct tiny_dns_rr *rr, IOReader *buf) {
-    tiny_dns_err err = tiny_dns_name_decode(&rr->name, buf);
-    if (IS_ERR(err)) {
-        return err;
+tiny_dns_err tiny_dns_parse_rdata(IOReader *buf, struct tiny_dns_rr *rr,
+                                  struct tiny_dns_label_memo *memo) {
+    tiny_dns_err err;
+    switch (rr->atype) {
+        case RR_TYPE_A:
+            err = tiny_dns_parse_rdata_a(buf, rr, memo);
+            break;
+        case RR_TYPE_AAAA:
+            err = tiny_dns_parse_rdata_aaaa(buf, rr, memo);
+            break;
+        case RR_TYPE_CNAME:
+            err = tiny_dns_parse_rdata_cname(buf, rr, memo);
+            break;
+        case RR_TYPE_SOA:
+            err = tiny_dns_parse_rdata_soa(buf, rr, memo);
+            break;
+        case RR_TYPE_SRV:
+            err = tiny_dns_parse_rdata_srv(buf, rr, memo);
+            break;
+        case RR_TYPE_TXT:
+            err = tiny_dns_parse_rdata_txt(buf, rr, memo);
+            break;
+        default:
+            err = tiny_dns_parse_rdata_unknown(buf, rr);
+            break;
     }
 
-    err = io_reader_get_u16(buf, &rr->atype);
     if (IS_ERR(err)) {
         return err;
     }
 
-    err = io_reader_get_u16(buf, &rr->aclass);
+    return TINY_DNS_ERR_NONE;
+}
+
+static tiny_dns_err parse_rr_owner(struct tiny_dns_rr *rr, IOReader *buf, uint32_t flags,
+                                   struct tiny_dns_label_memo *memo) {
+    rr->owner.msg = buf->base;
+    rr->owner.offset = (uint16_t)(buf->ptr - buf->base);
+    rr->owner.msg_len = rr->owner.offset + buf->remaining;
+
+    if (flags & TINY_DNS_ITER_LAZY_NAMES) {
+        rr->name.name[0] = '\0';
+        rr->name.len = 0;
+        return tiny_dns_label_skip(buf);
+    }
+
+    return tiny_dns_name_decode(&rr->name, buf, memo);
+}
+
+// Everything following the owner name and type
+static tiny_dns_err parse_rr_rest(struct tiny_dns_rr *rr, IOReader *buf,
+                                  struct tiny_dns_label_memo *memo) {
+    tiny_dns_err err = io_reader_get_u16(buf, &rr->aclass);
     if (IS_ERR(err)) {
         return err;
     }
@@ -275,52 +343,35 @@ static tiny_dns_err tiny_dns_parse_rr(struct tiny_dns_rr *rr, IOReader *buf) {
         return err;
     }
 
-    switch (rr->atype) {
-        case RR_TYPE_A:
-            err = tiny_dns_parse_rdata_a(buf, rr);
-            break;
-        case RR_TYPE_AAAA:
-            err = tiny_dns_parse_rdata_aaaa(buf, rr);
-            break;
-        case RR_TYPE_CNAME:
-            err = tiny_dns_parse_rdata_cname(buf, rr);
-            break;
-        case RR_TYPE_SRV:
-            err = tiny_dns_parse_rdata_srv(buf, rr);
-            break;
-        case RR_TYPE_TXT:
-            err = tiny_dns_parse_rdata_txt(buf, rr);
-            break;
-        default:
-            err = tiny_dns_parse_rdata_unknown(buf, rr);
-            break;
+    return tiny_dns_parse_rdata(buf, rr, memo);
+}
+
+static tiny_dns_err tiny_dns_parse_rr(struct tiny_dns_rr *rr, IOReader *buf, uint32_t flags,
+                                      struct tiny_dns_label_memo *memo) {
+    tiny_dns_err err = parse_rr_owner(rr, buf, flags, memo);
+    if (IS_ERR(err)) {
+        return err;
     }
 
+    err = io_reader_get_u16(buf, &rr->atype);
     if (IS_ERR(err)) {
         return err;
     }
 
-    return TINY_DNS_ERR_NONE;
+    return parse_rr_rest(rr, buf, memo);
 }
 
-static tiny_dns_err tiny_dns_discard_questions(uint16_t qdcount, IOReader *buf) {
+tiny_dns_err tiny_dns_discard_questions(uint16_t qdcount, IOReader *buf) {
     tiny_dns_err err = TINY_DNS_ERR_NONE;
 
     for (uint16_t i = 0; i < qdcount; i++) {
-        struct tiny_dns_name discard = { 0 };
-        err = tiny_dns_name_decode(&discard, buf);
+        err = tiny_dns_label_skip(buf);
         if (IS_ERR(err)) {
             break;
         }
 
         // Skip qclass & qtype
-        uint16_t dummy;
-        err = io_reader_get_u16(buf, &dummy);
-        if (IS_ERR(err)) {
-            break;
-        }
-
-        err = io_reader_get_u16(buf, &dummy);
+        err = io_reader_skip(buf, sizeof(uint16_t) * 2);
         if (IS_ERR(err)) {
             break;
         }
@@ -333,6 +384,8 @@ static tiny_dns_err tiny_dns_discard_questions(uint16_t qdcount, IOReader *buf)
 
 tiny_dns_err tiny_dns_iter_init(struct tiny_dns_iter *iter, void *data, size_t len) {
     io_reader_init(&iter->buf, data, len);
+    tiny_dns_label_memo_init(&iter->memo);
+    iter->flags = 0;
 
     tiny_dns_err err = tiny_dns_parse_header(&iter->header, &iter->buf);
     if (IS_ERR(err)) {
@@ -346,29 +399,270 @@ tiny_dns_err tiny_dns_iter_init(struct tiny_dns_iter *iter, void *data, size_t l
     return tiny_dns_discard_questions(iter->header.qdcount, &iter->buf);
 }
 
-tiny_dns_err tiny_dns_iter_yield(struct tiny_dns_iter *iter, struct tiny_dns_rr *rr,
-                                 enum tiny_dns_section *section) {
-    tiny_dns_err err = tiny_dns_parse_rr(rr, &iter->buf);
-    if (err == IO_BUF_EMPTY) {
-        return TINY_DNS_ERR_NO_BUF;
-    } else if (IS_ERR(err)) {
-        return err;
-    }
+void tiny_dns_iter_set_flags(struct tiny_dns_iter *iter, uint32_t flags) {
+    iter->flags = flags;
+}
 
+static bool current_section(const struct tiny_dns_iter *iter, enum tiny_dns_section *section) {
     if (iter->ancount) {
         *section = SECTION_ANSWER;
-        iter->ancount--;
     } else if (iter->nscount) {
         *section = SECTION_AUTHORITY;
-        iter->nscount--;
     } else if (iter->arcount) {
         *section = SECTION_ADDITIONAL;
-        iter->arcount--;
+    } else {
+        return false;
     }
 
+    return true;
+}
+
+static void consume_section(struct tiny_dns_iter *iter, enum tiny_dns_section section) {
+    switch (section) {
+        case SECTION_ANSWER:
+            iter->ancount--;
+            break;
+        case SECTION_AUTHORITY:
+            iter->nscount--;
+            break;
+        case SECTION_ADDITIONAL:
+            iter->arcount--;
+            break;
+    }
+}
+
+void tiny_dns_iter_advance(struct tiny_dns_iter *iter, enum tiny_dns_section *section) {
+    if (current_section(iter, section)) {
+        consume_section(iter, *section);
+    }
+}
+
+tiny_dns_err tiny_dns_iter_yield(struct tiny_dns_iter *iter, struct tiny_dns_rr *rr,
+                                 enum tiny_dns_section *section) {
+    struct tiny_dns_label_memo *memo = (iter->flags & TINY_DNS_ITER_NO_MEMO) ? NULL : &iter->memo;
+    tiny_dns_err err = tiny_dns_parse_rr(rr, &iter->buf, iter->flags, memo);
+    if (err == IO_BUF_EMPTY) {
+        return TINY_DNS_ERR_NO_BUF;
+    } else if (IS_ERR(err)) {
+        return err;
+    }
+
+    tiny_dns_iter_advance(iter, section);
+
     return err;
 }
 
+static bool filter_section(const struct tiny_dns_filter *filter, enum tiny_dns_section section) {
+    return !filter->sections || (filter->sections & TINY_DNS_SECTION_BIT(section));
+}
+
+static bool filter_type(const struct tiny_dns_filter *filter, uint16_t atype) {
+    if (!filter->type_count) {
+        return true;
+    }
+
+    for (size_t i = 0; i < filter->type_count; i++) {
+        if (filter->types[i] == atype) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Step over the remainder of a record, once its owner and type have been read
+static tiny_dns_err skip_rr_rest(IOReader *buf) {
+    // Skip class & TTL
+    tiny_dns_err err = io_reader_skip(buf, sizeof(uint16_t) + sizeof(uint32_t));
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    uint16_t rdlength;
+    err = io_reader_get_u16(buf, &rdlength);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    return io_reader_skip(buf, rdlength);
+}
+
+tiny_dns_err tiny_dns_iter_yield_filtered(struct tiny_dns_iter *iter,
+                                          const struct tiny_dns_filter *filter,
+                                          struct tiny_dns_rr *rr, enum tiny_dns_section *section) {
+    struct tiny_dns_label_memo *memo = (iter->flags & TINY_DNS_ITER_NO_MEMO) ? NULL : &iter->memo;
+
+    enum tiny_dns_section current;
+    while (current_section(iter, &current)) {
+        // The owner is only walked to find the type behind it. It's decoded, into @rr, once the
+        // record is known to match, so records that don't leave @rr and the memo alone.
+        IOReader start = iter->buf;
+        bool match = filter_section(filter, current);
+        uint16_t atype;
+        tiny_dns_err err = tiny_dns_label_skip(&iter->buf);
+        if (!IS_ERR(err)) {
+            err = io_reader_get_u16(&iter->buf, &atype);
+        }
+
+        if (!IS_ERR(err)) {
+            match = match && filter_type(filter, atype);
+            if (match) {
+                iter->buf = start;
+                err = tiny_dns_parse_rr(rr, &iter->buf, iter->flags, memo);
+            } else {
+                err = skip_rr_rest(&iter->buf);
+            }
+        }
+
+        if (err == IO_BUF_EMPTY) {
+            return TINY_DNS_ERR_NO_BUF;
+        } else if (IS_ERR(err)) {
+            return err;
+        }
+
+        consume_section(iter, current);
+        if (match) {
+            *section = current;
+            return TINY_DNS_ERR_NONE;
+        }
+    }
+
+    return TINY_DNS_ERR_NO_BUF;
+}
+
+// Walk the name at the start of span, following pointers, without decoding it
+static tiny_dns_err check_name(const IOReader *span, uint16_t *offset) {
+    *offset = (uint16_t)(span->ptr - span->base);
+
+    struct tiny_dns_name_view view = { span->base, *offset + span->remaining, *offset };
+    int err = tiny_dns_name_view_len(&view);
+    return IS_ERR(err) ? err : TINY_DNS_ERR_NONE;
+}
+
+static tiny_dns_err parse_rdata_compact(IOReader *span, struct tiny_dns_rr_compact *rr) {
+    int err = TINY_DNS_ERR_NONE;
+    switch (rr->atype) {
+        case RR_TYPE_A:
+            if (rr->rdlength != sizeof(rr->rdata.rr_a)) {
+                return TINY_DNS_ERR_INVALID;
+            }
+            memcpy(rr->rdata.rr_a, span->ptr, sizeof(rr->rdata.rr_a));
+            break;
+        case RR_TYPE_AAAA:
+            if (rr->rdlength != sizeof(rr->rdata.rr_aaaa)) {
+                return TINY_DNS_ERR_INVALID;
+            }
+            memcpy(rr->rdata.rr_aaaa, span->ptr, sizeof(rr->rdata.rr_aaaa));
+            break;
+        case RR_TYPE_CNAME:
+            err = check_name(span, &rr->rdata.rr_cname);
+            break;
+        case RR_TYPE_SOA: {
+            uint32_t skipped;
+            err = check_name(span, &rr->rdata.rr_soa.mname);
+            if (!IS_ERR(err)) {
+                err = tiny_dns_label_skip(span);
+            }
+            if (!IS_ERR(err)) {
+                err = check_name(span, &rr->rdata.rr_soa.rname);
+            }
+            if (!IS_ERR(err)) {
+                err = tiny_dns_label_skip(span);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u32(span, &rr->rdata.rr_soa.serial);
+            }
+            for (int i = 0; i < 3 && !IS_ERR(err); i++) {
+                err = io_reader_get_u32(span, &skipped);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u32(span, &rr->rdata.rr_soa.minimum);
+            }
+            break;
+        }
+        case RR_TYPE_SRV:
+            err = io_reader_get_u16(span, &rr->rdata.rr_srv.priority);
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u16(span, &rr->rdata.rr_srv.weight);
+            }
+            if (!IS_ERR(err)) {
+                err = io_reader_get_u16(span, &rr->rdata.rr_srv.port);
+            }
+            if (!IS_ERR(err)) {
+                err = check_name(span, &rr->rdata.rr_srv.target);
+            }
+            break;
+        case RR_TYPE_TXT: {
+            uint8_t len;
+            err = io_reader_get(span, &len, 1);
+            if (!IS_ERR(err) && len > span->remaining) {
+                return TINY_DNS_ERR_INVALID;
+            }
+            rr->rdata.rr_txt.offset = (uint16_t)(span->ptr - span->base);
+            rr->rdata.rr_txt.len = len;
+            break;
+        }
+        default:
+            break;
+    }
+
+    // Truncated rdata is malformed, not the end of the message
+    return err == IO_BUF_EMPTY ? TINY_DNS_ERR_INVALID : err;
+}
+
+tiny_dns_err tiny_dns_iter_yield_compact(struct tiny_dns_iter *iter,
+                                         struct tiny_dns_rr_compact *rr,
+                                         enum tiny_dns_section *section) {
+    IOReader *buf = &iter->buf;
+
+    tiny_dns_err err = check_name(buf, &rr->owner);
+    if (!IS_ERR(err)) {
+        err = tiny_dns_label_skip(buf);
+    }
+    if (!IS_ERR(err)) {
+        err = io_reader_get_u16(buf, &rr->atype);
+    }
+    if (!IS_ERR(err)) {
+        err = io_reader_get_u16(buf, &rr->aclass);
+    }
+    if (!IS_ERR(err)) {
+        err = io_reader_get_u32(buf, &rr->ttl);
+    }
+    if (!IS_ERR(err)) {
+        err = io_reader_get_u16(buf, &rr->rdlength);
+    }
+
+    if (err == IO_BUF_EMPTY) {
+        return TINY_DNS_ERR_NO_BUF;
+    } else if (IS_ERR(err)) {
+        return err;
+    }
+
+    // Rdata is read through a reader confined to rdlength, so a name inside can't run past it
+    rr->rdata_offset = (uint16_t)(buf->ptr - buf->base);
+    IOReader span = *buf;
+    span.remaining = rr->rdlength;
+    err = io_reader_skip(buf, rr->rdlength);
+    if (IS_ERR(err)) {
+        return TINY_DNS_ERR_NO_BUF;
+    }
+
+    err = parse_rdata_compact(&span, rr);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    tiny_dns_iter_advance(iter, section);
+
+    return TINY_DNS_ERR_NONE;
+}
+
+struct tiny_dns_name_view tiny_dns_iter_name(const struct tiny_dns_iter *iter, uint16_t offset) {
+    size_t msg_len = (size_t)(iter->buf.ptr - iter->buf.base) + iter->buf.remaining;
+    struct tiny_dns_name_view view = { iter->buf.base, msg_len, offset };
+    return view;
+}
+
 tiny_dns_err tiny_dns_iter_foreach(struct tiny_dns_iter *iter, tiny_dns_iter_fn foreach_callback,
                                    void *context) {
     struct tiny_dns_rr rr;
@@ -389,3 +683,24 @@ tiny_dns_err tiny_dns_iter_foreach(struct tiny_dns_iter *iter, tiny_dns_iter_fn
 
     return err;
 }
+
+tiny_dns_err tiny_dns_iter_foreach_filtered(struct tiny_dns_iter *iter,
+                                            const struct tiny_dns_filter *filter,
+                                            tiny_dns_iter_fn foreach_callback, void *context) {
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    tiny_dns_err err = tiny_dns_iter_yield_filtered(iter, filter, &rr, &section);
+
+    for (; err == TINY_DNS_ERR_NONE;
+         err = tiny_dns_iter_yield_filtered(iter, filter, &rr, &section)) {
+        if (foreach_callback) {
+            foreach_callback(iter, &rr, section, context);
+        }
+    }
+
+    if (err == TINY_DNS_ERR_NO_BUF) {
+        err = TINY_DNS_ERR_NONE;
+    }
+
+    return err;
+}
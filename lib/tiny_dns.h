@@ -17,6 +17,11 @@ extern "C" {
 #define TINY_DNS_MAX_LABEL_LEN 64
 
 typedef enum {
+    TINY_DNS_ERR_NOT_FOUND = -8,
+    TINY_DNS_ERR_IO = -7,
+    TINY_DNS_ERR_TIMEOUT = -6,
+    TINY_DNS_ERR_UNSUPPORTED = -5,
+    TINY_DNS_ERR_NO_SPACE = -4,
     TINY_DNS_ERR_RCODE = -3,
     TINY_DNS_ERR_NO_BUF = -2,
     TINY_DNS_ERR_INVALID = -1,
@@ -30,9 +35,12 @@ enum tiny_dns_class {
 enum tiny_dns_rr_type {
     RR_TYPE_A = 1,
     RR_TYPE_CNAME = 5,
+    RR_TYPE_SOA = 6,
     RR_TYPE_TXT = 16,
     RR_TYPE_AAAA = 28,
     RR_TYPE_SRV = 33,
+    /// EDNS pseudo-record (RFC 6891), parsed as unknown
+    RR_TYPE_OPT = 41,
 };
 
 enum tiny_dns_opcode {
@@ -83,10 +91,22 @@ struct tiny_dns_header {
 };
 
 struct tiny_dns_name {
-    char name[TINY_DNS_MAX_NAME_LEN];
+    // One spare byte: decoding writes a leading dot before trimming it, so a name of the maximum
+    // wire length needs 255 bytes on the way in.
+    char name[TINY_DNS_MAX_NAME_LEN + 1];
     size_t len;
 };
 
+/// @brief A name referenced in place inside a DNS message
+///     Holding a view costs nothing; the name is only walked when one of the
+///     tiny_dns_name_view_* functions is called. The view is valid as long as the message buffer
+///     is.
+struct tiny_dns_name_view {
+    const char *msg;
+    size_t msg_len;
+    uint16_t offset;
+};
+
 struct tiny_dns_question {
     struct tiny_dns_name qname;
     uint16_t qtype;
@@ -100,6 +120,21 @@ struct tiny_dns_srv {
     struct tiny_dns_name target;
 };
 
+/// @brief SOA rdata. The names are left in the message, like the owner of struct tiny_dns_rr, so
+///     the record isn't any bigger for them; decode them with \a tiny_dns_name_view_decode.
+struct tiny_dns_soa {
+    /// Primary nameserver of the zone
+    struct tiny_dns_name_view mname;
+    /// Mailbox of whoever is responsible for the zone, with its first dot standing for the @
+    struct tiny_dns_name_view rname;
+    uint32_t serial;
+    uint32_t refresh;
+    uint32_t retry;
+    uint32_t expire;
+    /// Caps how long negative answers from the zone may be cached, see RFC 2308
+    uint32_t minimum;
+};
+
 struct tiny_dns_txt {
     const char *txt;
     uint8_t len;
@@ -107,6 +142,7 @@ struct tiny_dns_txt {
 
 struct tiny_dns_rr {
     struct tiny_dns_name name;
+    struct tiny_dns_name_view owner;
     uint16_t atype;
     uint16_t aclass;
     uint32_t ttl;
@@ -115,6 +151,7 @@ struct tiny_dns_rr {
         uint8_t rr_a[4];
         uint8_t rr_aaaa[16];
         struct tiny_dns_name rr_cname;
+        struct tiny_dns_soa rr_soa;
         struct tiny_dns_srv rr_srv;
         struct tiny_dns_txt rr_txt;
         struct {
@@ -133,18 +170,196 @@ struct tiny_dns_rr {
 /// @param qtype Record type to request, usually A or AAAA.
 ///
 /// @return TINY_DNS_ERR_NONE on success
-/// @return TINY_DNS_ERR_INVALID if parameters are NULL
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL, or \p name has empty or overlong labels
 /// @return TINY_DNS_ERR_NO_BUF if \p buffer is too small for the serialized query
 tiny_dns_err tiny_dns_build_query(void *buffer, size_t *len, uint16_t id, const char *name,
                                   enum tiny_dns_rr_type qtype);
 
+/// @brief Longest query \a tiny_dns_build_query can produce: the header, a question for a name of
+///     the maximum length, its qtype and qclass.
+#define TINY_DNS_QUERY_MAX_LEN (12 + TINY_DNS_MAX_NAME_LEN + 2 + 4)
+
+/// @brief A query encoded once by \a tiny_dns_query_prepare and sent many times
+struct tiny_dns_query_template {
+    uint8_t msg[TINY_DNS_QUERY_MAX_LEN];
+    uint16_t len;
+};
+
+/// @brief Encode a query for \p name into \p tmpl, the same way \a tiny_dns_build_query would
+///
+/// @param tmpl Pointer to uninitialized template
+/// @param name Hostname to resolve
+/// @param qtype Record type to request, usually A or AAAA.
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL or \p name can't be encoded
+tiny_dns_err tiny_dns_query_prepare(struct tiny_dns_query_template *tmpl, const char *name,
+                                    enum tiny_dns_rr_type qtype);
+
+/// @brief Copy the query in \p tmpl to \p buffer, with its ID set to \p id
+///
+/// @param tmpl Template filled by \a tiny_dns_query_prepare
+/// @param buffer Destination buffer for the serialized query.
+/// @param len input: size of \p buffer in bytes, output: length of the query in bytes
+/// @param id ID number to use for the query
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_NO_BUF if \p buffer is too small for the query
+tiny_dns_err tiny_dns_query_render(const struct tiny_dns_query_template *tmpl, void *buffer,
+                                   size_t *len, uint16_t id);
+
+/// @brief Same as \a tiny_dns_query_render, but also replace the qtype of the template
+tiny_dns_err tiny_dns_query_render_qtype(const struct tiny_dns_query_template *tmpl, void *buffer,
+                                         size_t *len, uint16_t id, uint16_t qtype);
+
+/// @brief Number of names a struct tiny_dns_builder remembers for compression
+#define TINY_DNS_BUILDER_NAMES 32
+
+/// @brief Appends questions and records to a DNS message in a caller buffer
+///     Names are compressed against the names already in the message. Only the first
+///     TINY_DNS_BUILDER_NAMES names and suffixes written are remembered, and only those within the
+///     first 16KiB of the message can be pointed to.
+struct tiny_dns_builder {
+    /// Written to the message by \a tiny_dns_builder_finish, so the flags may be changed until
+    /// then. The section counts are maintained by the builder.
+    struct tiny_dns_header header;
+    IOWriter buf;
+    // 0 while adding questions, then 1 + the section records are being added to
+    uint8_t stage;
+    uint16_t names[TINY_DNS_BUILDER_NAMES];
+    size_t name_count;
+};
+
+/// @brief Start a message in \p buffer
+///
+/// @param builder Pointer to uninitialized builder
+/// @param buffer Destination buffer for the message
+/// @param capacity Size of \p buffer in bytes
+/// @param header ID and flags of the message. The section counts are ignored.
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL
+/// @return TINY_DNS_ERR_NO_BUF if \p buffer can't hold the header
+tiny_dns_err tiny_dns_builder_init(struct tiny_dns_builder *builder, void *buffer, size_t capacity,
+                                   const struct tiny_dns_header *header);
+
+/// @brief Append a question. All questions must be added before any record.
+///
+/// @param builder Initialized builder
+/// @param name Dotted name, with or without a trailing dot. "." is the root name.
+/// @param qtype Record type of the question
+/// @param qclass Class of the question, usually CLASS_IN
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if records were already added or \p name can't be encoded
+/// @return TINY_DNS_ERR_NO_BUF if the question doesn't fit. The message is left as it was.
+tiny_dns_err tiny_dns_builder_question(struct tiny_dns_builder *builder, const char *name,
+                                       uint16_t qtype, uint16_t qclass);
+
+/// @brief Append a record to \p section
+///     Sections must be filled in message order: answer, authority, then additional.
+///     The owner name is rr->name and rdata is taken from rr->rdata, depending on rr->atype.
+///     rr->rdlength is ignored. Records of types without rdata support are written from
+///     rr->rdata.unknown. The SOA names are decoded from their views and, like the CNAME target,
+///     compressed; the SRV target is not, as RFC 2782 requires, but later names may still point
+///     to it.
+///
+/// @param builder Initialized builder
+/// @param section Section to add the record to
+/// @param rr Record to append
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if \p section comes before one already added to, or a name can't
+///         be encoded
+/// @return TINY_DNS_ERR_NO_BUF if the record doesn't fit. The message is left as it was, so it can
+///         still be finished, e.g. with the TC flag set.
+tiny_dns_err tiny_dns_builder_rr(struct tiny_dns_builder *builder, enum tiny_dns_section section,
+                                 const struct tiny_dns_rr *rr);
+
+/// @brief Write the header and report the length of the message
+///
+/// @param builder Initialized builder
+/// @param len Output: length of the message in bytes
+///
+/// @return TINY_DNS_ERR_NONE on success
+tiny_dns_err tiny_dns_builder_finish(struct tiny_dns_builder *builder, size_t *len);
+
+/// @brief A question referenced in place inside a DNS message
+struct tiny_dns_question_view {
+    struct tiny_dns_name_view qname;
+    /// Bytes the name takes at qname.offset, up to and including its root label or first pointer
+    uint16_t qname_wire_len;
+    uint16_t qtype;
+    uint16_t qclass;
+};
+
+/// @brief A DNS query, as received by a server
+struct tiny_dns_request {
+    struct tiny_dns_header header;
+    const char *msg;
+    size_t msg_len;
+    /// Offset of the first byte after the question section
+    uint16_t questions_end;
+};
+
+/// @brief Parse the header and questions of a query
+///     The header is checked before any name is looked at, so messages that aren't standard queries
+///     are rejected at the cost of reading 12 bytes. Question names are fully validated, but not
+///     decoded; use the tiny_dns_name_view_* functions on them.
+///
+///     Unless TINY_DNS_ERR_INVALID is returned for a message shorter than a header, req->header is
+///     filled in, so the ID and opcode are available to build an error response.
+///
+/// @param req Pointer to uninitialized request
+/// @param data Buffer containing the query. Must outlive \p req and \p questions.
+/// @param len Length of \p data in bytes
+/// @param questions Caller's array to store one view per question in
+/// @param capacity Number of entries available in \p questions
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_UNSUPPORTED if the opcode isn't OPCODE_QUERY
+/// @return TINY_DNS_ERR_NO_BUF if there are more than \p capacity questions
+/// @return <TINY_DNS_ERR_NONE if the message is a response or malformed
+tiny_dns_err tiny_dns_request_parse(struct tiny_dns_request *req, const void *data, size_t len,
+                                    struct tiny_dns_question_view *questions, size_t capacity);
+
+enum tiny_dns_iter_flags {
+    /// Only fill tiny_dns_rr.owner; tiny_dns_rr.name is left empty
+    TINY_DNS_ITER_LAZY_NAMES = 1 << 0,
+    /// Decode every compressed name from scratch instead of reusing already decoded suffixes
+    TINY_DNS_ITER_NO_MEMO = 1 << 1,
+};
+
+#ifndef TINY_DNS_LABEL_MEMO_SLOTS
+    #define TINY_DNS_LABEL_MEMO_SLOTS 8
+#endif
+
+#ifndef TINY_DNS_LABEL_MEMO_POOL_LEN
+    #define TINY_DNS_LABEL_MEMO_POOL_LEN 256
+#endif
+
+/// @brief Decoded name suffixes, keyed by the message offset a compression pointer refers to
+///     Only valid for the message it was filled from. Members are private.
+struct tiny_dns_label_memo {
+    struct {
+        uint16_t target;
+        uint16_t start;
+        uint16_t len;
+    } slots[TINY_DNS_LABEL_MEMO_SLOTS];
+    uint16_t count;
+    uint16_t pool_len;
+    char pool[TINY_DNS_LABEL_MEMO_POOL_LEN];
+};
+
 struct tiny_dns_iter {
     struct tiny_dns_header header;
     uint16_t ancount;
     uint16_t nscount;
     uint16_t arcount;
+    uint32_t flags;
     // TODO hide this detail somehow
     IOReader buf;
+    struct tiny_dns_label_memo memo;
 };
 
 /// @brief Initialize a DNS response iterator over \p data
@@ -162,6 +377,13 @@ struct tiny_dns_iter {
 /// @return <TINY_DNS_ERR_NONE on error. This will be improved in future versions.
 tiny_dns_err tiny_dns_iter_init(struct tiny_dns_iter *iter, void *data, size_t len);
 
+/// @brief Change how \p iter decodes records
+///     \a tiny_dns_iter_init clears all flags, so call this after initializing the iterator.
+///
+/// @param iter Pointer to initialized DNS response iterator
+/// @param flags Bitwise OR of enum tiny_dns_iter_flags values
+void tiny_dns_iter_set_flags(struct tiny_dns_iter *iter, uint32_t flags);
+
 /// @brief Parse the next resource record in wrapped by \p iter
 ///     In general, one should use \a tiny_dns_iter_foreach instead of this function to avoid
 ///     writing boilerplate. However, it is public for lower level use cases that don't want the
@@ -201,6 +423,628 @@ typedef void (*tiny_dns_iter_fn)(struct tiny_dns_iter *iter, const struct tiny_d
 tiny_dns_err tiny_dns_iter_foreach(struct tiny_dns_iter *iter, tiny_dns_iter_fn foreach_callback,
                                    void *context);
 
+/// @brief Bit for section \p _s in tiny_dns_filter.sections
+#define TINY_DNS_SECTION_BIT(_s) (1u << (_s))
+
+/// @brief Selects the records \a tiny_dns_iter_yield_filtered returns
+///     No types or a section mask of 0 match everything, so a zeroed filter selects every record.
+struct tiny_dns_filter {
+    /// Record types to return, any of the 16 bit type space. Must outlive the iteration.
+    const uint16_t *types;
+    size_t type_count;
+    uint8_t sections;
+};
+
+/// @brief Like \a tiny_dns_iter_yield, but only return records selected by \p filter
+///     Records that don't match are stepped over: their owner is only walked to find the type
+///     behind it, not decoded, and their rdata is skipped using its rdlength. \p rr is only
+///     written for the record returned.
+///
+/// @param iter Pointer to DNS response iterator object
+/// @param filter Records to return
+/// @param rr Pointer to an empty resource record, where the next matching record will be stored
+/// @param section Output pointer which will be set to the section of the matching record
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_NO_BUF when there are no more matching records
+/// @return <TINY_DNS_ERR_NONE on error
+tiny_dns_err tiny_dns_iter_yield_filtered(struct tiny_dns_iter *iter,
+                                          const struct tiny_dns_filter *filter,
+                                          struct tiny_dns_rr *rr, enum tiny_dns_section *section);
+
+/// @brief Like \a tiny_dns_iter_foreach, but \p foreach_callback only runs for records selected
+///     by \p filter.
+///
+/// @return TINY_DNS_ERR_NONE when the iterator is exhausted
+/// @return <TINY_DNS_ERR_NONE on any error
+tiny_dns_err tiny_dns_iter_foreach_filtered(struct tiny_dns_iter *iter,
+                                            const struct tiny_dns_filter *filter,
+                                            tiny_dns_iter_fn foreach_callback, void *context);
+
+/// @brief A resource record that refers to its names instead of holding them
+///     Every name is the offset of its first label in the message, see \a tiny_dns_iter_name. The
+///     whole record fits in 32 bytes, compared to over 500 for struct tiny_dns_rr.
+struct tiny_dns_rr_compact {
+    uint16_t owner;
+    uint16_t atype;
+    uint16_t aclass;
+    uint16_t rdlength;
+    uint32_t ttl;
+    uint16_t rdata_offset;
+    union {
+        uint8_t rr_a[4];
+        uint8_t rr_aaaa[16];
+        uint16_t rr_cname;
+        /// Only the numbers that fit. Refresh, retry and expire are the 12 bytes before the
+        /// minimum, at the end of the rdata.
+        struct {
+            uint16_t mname;
+            uint16_t rname;
+            uint32_t serial;
+            uint32_t minimum;
+        } rr_soa;
+        struct {
+            uint16_t priority;
+            uint16_t weight;
+            uint16_t port;
+            uint16_t target;
+        } rr_srv;
+        struct {
+            uint16_t offset;
+            uint8_t len;
+        } rr_txt;
+    } rdata;
+};
+
+/// @brief Like \a tiny_dns_iter_yield, but store the next record in compact form
+///     Names are validated as thoroughly as \a tiny_dns_iter_yield does, but never decoded.
+///     The iterator flags have no effect here.
+///
+/// @param iter Pointer to DNS response iterator object
+/// @param rr Where the next record will be stored
+/// @param section Output pointer which will be set to the current section.
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_NO_BUF when the iterator is exhausted
+/// @return <TINY_DNS_ERR_NONE on error
+tiny_dns_err tiny_dns_iter_yield_compact(struct tiny_dns_iter *iter,
+                                         struct tiny_dns_rr_compact *rr,
+                                         enum tiny_dns_section *section);
+
+/// @brief View of the name at \p offset in the message wrapped by \p iter
+///     Use this to get at the names in a struct tiny_dns_rr_compact.
+struct tiny_dns_name_view tiny_dns_iter_name(const struct tiny_dns_iter *iter, uint16_t offset);
+
+/// @brief Bump allocator over caller provided memory
+///     Nothing is ever freed individually; \a tiny_dns_arena_reset releases everything at once.
+struct tiny_dns_arena {
+    char *base;
+    size_t capacity;
+    size_t len;
+};
+
+/// @brief A dotted, NUL terminated name stored in a struct tiny_dns_arena
+struct tiny_dns_arena_name {
+    const char *name;
+    // Excluding the NUL terminator
+    uint16_t len;
+};
+
+/// @brief A resource record whose names and variable length rdata live in a struct tiny_dns_arena
+///     Unlike struct tiny_dns_rr, it doesn't reference the message at all once decoded.
+struct tiny_dns_rr_arena {
+    struct tiny_dns_arena_name name;
+    uint16_t atype;
+    uint16_t aclass;
+    uint32_t ttl;
+    uint16_t rdlength;
+    uint8_t section;
+    union {
+        uint8_t rr_a[4];
+        uint8_t rr_aaaa[16];
+        struct tiny_dns_arena_name rr_cname;
+        struct {
+            struct tiny_dns_arena_name mname;
+            struct tiny_dns_arena_name rname;
+            uint32_t serial;
+            uint32_t refresh;
+            uint32_t retry;
+            uint32_t expire;
+            uint32_t minimum;
+        } rr_soa;
+        struct {
+            uint16_t priority;
+            uint16_t weight;
+            uint16_t port;
+            struct tiny_dns_arena_name target;
+        } rr_srv;
+        struct {
+            const char *txt;
+            uint8_t len;
+        } rr_txt;
+        struct {
+            const char *data;
+            size_t len;
+        } unknown;
+    } rdata;
+};
+
+/// @brief Initialize \p arena over \p mem
+///
+/// @param arena Pointer to uninitialized arena
+/// @param mem Backing memory, which must outlive everything allocated from \p arena
+/// @param capacity Size of \p mem in bytes
+void tiny_dns_arena_init(struct tiny_dns_arena *arena, void *mem, size_t capacity);
+
+/// @brief Release everything allocated from \p arena, so its memory can be reused
+void tiny_dns_arena_reset(struct tiny_dns_arena *arena);
+
+/// @brief Like \a tiny_dns_iter_yield, but store names and rdata in \p arena
+///     Names take only as many bytes as they need, and TXT and unknown rdata are copied, so the
+///     record stays valid after the message buffer is gone. The iterator flags other than
+///     TINY_DNS_ITER_NO_MEMO have no effect here.
+///
+///     If \p arena fills up, neither \p iter nor \p arena is changed, so the same record can be
+///     retried with a larger or freshly reset arena.
+///
+/// @param iter Pointer to DNS response iterator object
+/// @param arena Arena to store the names and rdata of the record in
+/// @param rr Where the next record will be stored
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_NO_BUF when the iterator is exhausted
+/// @return TINY_DNS_ERR_NO_SPACE if \p arena is too small for the record
+/// @return TINY_DNS_ERR_INVALID if the record, or its rdata, is cut short by the end of the message
+/// @return <TINY_DNS_ERR_NONE on error
+tiny_dns_err tiny_dns_iter_yield_arena(struct tiny_dns_iter *iter, struct tiny_dns_arena *arena,
+                                       struct tiny_dns_rr_arena *rr);
+
+/// @brief Decode every remaining record of \p iter into \p arena
+///     The records themselves are stored in \p arena as well, followed by their names and rdata, so
+///     the whole response ends up in one contiguous block.
+///
+///     On failure, neither \p iter nor \p arena is changed, so after TINY_DNS_ERR_NO_SPACE the
+///     whole response can be materialized again into a larger arena.
+///
+/// @param iter Pointer to DNS response iterator object
+/// @param arena Arena to store the response in
+/// @param records Output: array of decoded records, in message order
+/// @param count Output: number of entries in \p records
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_NO_SPACE if \p arena is too small for the response
+/// @return <TINY_DNS_ERR_NONE if the message is malformed
+tiny_dns_err tiny_dns_iter_materialize(struct tiny_dns_iter *iter, struct tiny_dns_arena *arena,
+                                       struct tiny_dns_rr_arena **records, size_t *count);
+
+struct tiny_dns_index_entry {
+    uint16_t offset;
+    uint16_t atype;
+    uint16_t aclass;
+    uint16_t rdata_offset;
+    uint32_t ttl;
+    uint16_t rdlength;
+    uint8_t section;
+};
+
+/// @brief Random access to the records of a message
+///     Filled by \a tiny_dns_index_build. Entries are stored in message order, so each section is a
+///     contiguous run of entries.
+struct tiny_dns_index {
+    struct tiny_dns_header header;
+    const char *msg;
+    size_t msg_len;
+    struct tiny_dns_index_entry *entries;
+    size_t count;
+};
+
+/// @brief Validate a DNS response and record the location of every resource record in it
+///     Owner names and rdata spans are checked once here, so the accessors below don't need to.
+///     Rdata contents, e.g. a CNAME target, are only checked when the record is parsed.
+///
+/// @param index Pointer to uninitialized index
+/// @param data Buffer containing the DNS response. Must outlive \p index.
+/// @param len Length of \p data in bytes
+/// @param entries Caller's array to store one entry per resource record in
+/// @param capacity Number of entries available in \p entries
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_NO_BUF if the message has more than \p capacity records
+/// @return <TINY_DNS_ERR_NONE if the message is malformed
+tiny_dns_err tiny_dns_index_build(struct tiny_dns_index *index, const void *data, size_t len,
+                                  struct tiny_dns_index_entry *entries, size_t capacity);
+
+/// @brief Number of records in \p section
+size_t tiny_dns_index_count(const struct tiny_dns_index *index, enum tiny_dns_section section);
+
+/// @brief The \p n th record of \p section, or NULL if there is no such record
+const struct tiny_dns_index_entry *tiny_dns_index_get(const struct tiny_dns_index *index,
+                                                      enum tiny_dns_section section, size_t n);
+
+/// @brief Find the next record of type \p atype in \p section
+///     To visit every match, start with \p pos set to 0 and call until NULL is returned.
+///
+/// @param index Built index
+/// @param section Section to search
+/// @param atype Record type to look for
+/// @param pos input: position in \p section to start searching at, output: position after the
+///            returned record
+///
+/// @return The matching record, or NULL if there are no more
+const struct tiny_dns_index_entry *tiny_dns_index_find(const struct tiny_dns_index *index,
+                                                       enum tiny_dns_section section,
+                                                       uint16_t atype, size_t *pos);
+
+/// @brief Fully decode an indexed record, the same way \a tiny_dns_iter_yield would
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return <TINY_DNS_ERR_NONE if the rdata is malformed
+tiny_dns_err tiny_dns_index_parse(const struct tiny_dns_index *index,
+                                  const struct tiny_dns_index_entry *entry,
+                                  struct tiny_dns_rr *rr);
+
+/// @brief Decode the name referenced by \p view
+///
+/// @param view Name to decode
+/// @param name Destination for the dotted, NUL terminated name
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return <TINY_DNS_ERR_NONE if the name is malformed or doesn't fit in \p name
+tiny_dns_err tiny_dns_name_view_decode(const struct tiny_dns_name_view *view,
+                                       struct tiny_dns_name *name);
+
+/// @brief Length of the dotted form of \p view, excluding the NUL terminator
+///
+/// @return Length in bytes on success, 0 for the root name
+/// @return <0 if the name is malformed
+int tiny_dns_name_view_len(const struct tiny_dns_name_view *view);
+
+/// @brief Case-insensitive comparison of \p view against a dotted name
+///     A trailing dot on \p name is accepted, so "example.com" and "example.com." both match.
+///
+/// @return true if the names are equal
+/// @return false if they differ or \p view is malformed
+bool tiny_dns_name_view_eq(const struct tiny_dns_name_view *view, const char *name);
+
+/// @brief Compare two names in place, ignoring ASCII case
+///     Both names are walked label by label, following compression pointers, and neither is
+///     decoded. The views may refer to different messages. Walking stops early once both reach
+///     the same bytes of the same message, so a suffix shared through pointers is not compared.
+///
+/// @return true if the names are equal
+/// @return false if they differ or either is malformed
+bool tiny_dns_name_wire_eq(const struct tiny_dns_name_view *a, const struct tiny_dns_name_view *b);
+
+/// @brief Hash a name in place, ignoring ASCII case
+///     Names that tiny_dns_name_wire_eq considers equal hash the same, however they are
+///     compressed. The hash is meant for in-memory tables and not stable across platforms.
+///
+/// @param view Name to hash
+/// @param hash Output: hash of the name, only written on success
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return <TINY_DNS_ERR_NONE if the name is malformed
+tiny_dns_err tiny_dns_name_wire_hash(const struct tiny_dns_name_view *view, uint64_t *hash);
+
+/// @brief Largest response a struct tiny_dns_cache stores. Every entry reserves this much.
+#ifndef TINY_DNS_CACHE_MSG_MAX
+    #define TINY_DNS_CACHE_MSG_MAX 512
+#endif
+
+/// @brief Longest any response is cached for, whatever its TTLs say. Upstreams can hand out TTLs of
+///     up to 68 years, a week is what common resolvers cap them at.
+#ifndef TINY_DNS_CACHE_TTL_MAX
+    #define TINY_DNS_CACHE_TTL_MAX 604800
+#endif
+
+/// @brief Longest a negative response is cached for, whatever its SOA says. RFC 2308 suggests one
+///     to three hours.
+#ifndef TINY_DNS_CACHE_NEGATIVE_TTL_MAX
+    #define TINY_DNS_CACHE_NEGATIVE_TTL_MAX 10800
+#endif
+
+struct tiny_dns_cache_stats {
+    uint64_t hits;
+    /// Lookups that found nothing, or only an expired entry
+    uint64_t misses;
+    uint64_t inserts;
+    /// Live entries pushed out to make room. Expired entries that are reused aren't counted.
+    uint64_t evictions;
+    /// Hits that asked the caller to refresh the entry, see struct tiny_dns_cache_prefetch
+    uint64_t prefetches;
+    /// Hits answered from an expired entry, see struct tiny_dns_cache_stale. Counted in hits too.
+    uint64_t stale;
+};
+
+/// @brief When a hot entry is refreshed ahead of its expiry
+///     Without prefetching, whichever lookup comes first after a popular entry expires waits for
+///     the upstream. With it, a hit on an entry that has been looked up at least \a min_hits times
+///     and has less than \a percent of its TTL left sets \a prefetch in its struct
+///     tiny_dns_cache_hit, once per entry, for the caller to resolve the question again in the
+///     background and insert the answer before the entry runs out.
+struct tiny_dns_cache_prefetch {
+    /// Lookups an entry needs before it's worth refreshing, 0 to turn prefetching off
+    uint16_t min_hits;
+    /// Share of the TTL, in percent, below which a hot entry is due for refresh
+    uint8_t percent;
+};
+
+/// @brief Serving expired entries while they're refreshed, as in RFC 8767
+///     Without it, an expired entry is a miss, and the lookup waits for the upstream for as long
+///     as it takes to answer or time out. With it, an entry that expired less than \a max_stale
+///     seconds ago is still returned, marked \a stale in its struct tiny_dns_cache_hit and given
+///     \a ttl seconds to live. The first stale hit, and then one every \a ttl seconds, also sets
+///     \a prefetch for the caller to resolve the question again in the background, so an
+///     upstream that's down isn't asked by every lookup.
+struct tiny_dns_cache_stale {
+    /// Seconds past expiry an entry may still be served, 0 to turn serving stale off. RFC 8767
+    /// suggests one to three days.
+    uint32_t max_stale;
+    /// TTL of stale answers, and seconds between their refreshes, at least 1. RFC 8767 suggests 30.
+    uint32_t ttl;
+};
+
+/// @brief What a lookup found, besides the response itself
+struct tiny_dns_cache_hit {
+    /// Seconds the response has left to live, or the stale TTL if it has expired
+    uint32_t ttl;
+    /// The caller should refresh the entry from upstream, see struct tiny_dns_cache_prefetch and
+    /// struct tiny_dns_cache_stale
+    bool prefetch;
+    /// The response has expired, and is served stale
+    bool stale;
+    /// The response is NXDOMAIN or NODATA, and says the question has no answer
+    bool negative;
+};
+
+struct tiny_dns_cache_region;
+struct tiny_dns_cache_entry;
+
+/// @brief Responses keyed on their question, in a fixed block of caller provided memory
+///     Entries hold the whole response and expire with the smallest TTL among its answers, or for
+///     NXDOMAIN and NODATA responses, with the TTL their SOA gives negative answers. When
+///     the cache is full, an expired entry or one that hasn't been looked up since the CLOCK hand
+///     last passed it makes room. Lookups and inserts take constant time on average and never
+///     allocate.
+///
+///     Everything, the entries and the hash table included, lives in the memory given to
+///     \a tiny_dns_cache_init, and refers to other parts of it by index rather than by pointer.
+///     Times are seconds on any clock the caller likes, as long as it's used consistently.
+struct tiny_dns_cache {
+    struct tiny_dns_cache_region *region;
+    uint32_t *buckets;
+    struct tiny_dns_cache_entry *entries;
+};
+
+/// @brief Lay out an empty cache in \p mem
+///
+/// @param cache Pointer to uninitialized cache
+/// @param mem Backing memory, which must outlive \p cache. Need not be aligned.
+/// @param size Size of \p mem in bytes. A little over TINY_DNS_CACHE_MSG_MAX bytes are needed per
+///     entry.
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL
+/// @return TINY_DNS_ERR_NO_SPACE if \p size can't hold a single entry
+tiny_dns_err tiny_dns_cache_init(struct tiny_dns_cache *cache, void *mem, size_t size);
+
+/// @brief Number of responses \p cache can hold
+size_t tiny_dns_cache_capacity(const struct tiny_dns_cache *cache);
+
+/// @brief Store a response, replacing any entry for the same question
+///     Only responses with one question are cached, either with no error and at least one answer,
+///     or NXDOMAIN or NODATA with an SOA in the authority section. Their TTL is the SOA's minimum
+///     or its own TTL, whichever is smaller, up to TINY_DNS_CACHE_NEGATIVE_TTL_MAX. No response
+///     is kept longer than TINY_DNS_CACHE_TTL_MAX, and a TTL with its top bit set counts as 0
+///     (RFC 2181 section 8). Truncated responses and those whose TTL works out to 0 aren't
+///     cached.
+///
+/// @param cache Initialized cache
+/// @param msg Response to store. It's validated and copied.
+/// @param len Length of \p msg in bytes
+/// @param now Current time in seconds
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_UNSUPPORTED if the response isn't one that can be cached
+/// @return TINY_DNS_ERR_NO_SPACE if \p msg is longer than TINY_DNS_CACHE_MSG_MAX
+/// @return <TINY_DNS_ERR_NONE if the message is malformed
+tiny_dns_err tiny_dns_cache_insert(struct tiny_dns_cache *cache, const void *msg, size_t len,
+                                   uint64_t now);
+
+/// @brief Copy out the response cached for a question
+///     The response is returned as received, ID included, except for its TTLs. Every record's
+///     TTL is counted down by the time the response has been cached, and capped at the time the
+///     entry has left, or set to the stale TTL if it's served stale. The OPT record's is left
+///     alone.
+///
+/// @param cache Initialized cache
+/// @param qname Name asked for, e.g. the question of a query
+/// @param qtype Record type asked for
+/// @param qclass Class asked for, usually CLASS_IN
+/// @param now Current time in seconds
+/// @param buffer Destination for the response
+/// @param len input: size of \p buffer in bytes, output: length of the response
+/// @param hit Output: the response's TTL and whether to refresh it, may be NULL. Only written on
+///     a hit.
+///
+/// @return TINY_DNS_ERR_NONE on a hit
+/// @return TINY_DNS_ERR_NOT_FOUND if nothing is cached for the question, or it has expired and
+///     can't be served stale
+/// @return TINY_DNS_ERR_NO_BUF if the response doesn't fit in \p buffer
+tiny_dns_err tiny_dns_cache_lookup(struct tiny_dns_cache *cache,
+                                   const struct tiny_dns_name_view *qname, uint16_t qtype,
+                                   uint16_t qclass, uint64_t now, void *buffer, size_t *len,
+                                   struct tiny_dns_cache_hit *hit);
+
+/// @brief Drop the entry for a question, if there is one
+void tiny_dns_cache_remove(struct tiny_dns_cache *cache, const struct tiny_dns_name_view *qname,
+                           uint16_t qtype, uint16_t qclass);
+
+/// @brief Counters since \a tiny_dns_cache_init
+void tiny_dns_cache_stats(const struct tiny_dns_cache *cache, struct tiny_dns_cache_stats *stats);
+
+/// @brief Change when hot entries are refreshed ahead of expiry. Prefetching starts out off.
+void tiny_dns_cache_set_prefetch(struct tiny_dns_cache *cache,
+                                 const struct tiny_dns_cache_prefetch *prefetch);
+
+/// @brief Change how long expired entries are served for. Serving stale starts out off.
+///     Entries that can still be served are kept like live ones when the cache makes room.
+void tiny_dns_cache_set_stale(struct tiny_dns_cache *cache,
+                              const struct tiny_dns_cache_stale *stale);
+
+/// @brief Bytes \a tiny_dns_cache_snapshot needs for \p cache
+size_t tiny_dns_cache_snapshot_size(const struct tiny_dns_cache *cache);
+
+/// @brief Copy \p cache into \p out, to be restored by a later process
+///     The snapshot is an image of the cache's memory behind a small header, so restoring it
+///     only checks the header and adjusts expiry times. It's only understood by builds for the same
+///     architecture with the same TINY_DNS_CACHE_MSG_MAX.
+///
+/// @param cache Cache to copy
+/// @param now Current time on the clock the cache is used with
+/// @param wall Current time in seconds on a clock that keeps counting across restarts, such as
+///     time(NULL)
+/// @param out Where to write the snapshot
+/// @param size Size of \p out in bytes, at least \a tiny_dns_cache_snapshot_size
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL
+/// @return TINY_DNS_ERR_NO_SPACE if \p out is too small
+tiny_dns_err tiny_dns_cache_snapshot(const struct tiny_dns_cache *cache, uint64_t now,
+                                     uint64_t wall, void *out, size_t size);
+
+/// @brief Use a snapshot taken by \a tiny_dns_cache_snapshot as a cache, in place
+///     Only the header is checked up front. Each chain of entries is checked the first time it's
+///     walked, and one that's damaged is dropped, so its names miss rather than take the cache
+///     outside its memory. Each entry keeps what was left of its TTL when the snapshot was taken,
+///     less the time since by \p wall. No response is parsed again, and the entries aren't
+///     written to, so the snapshot can be a private mapping of a file that's only paged in and
+///     copied where the cache is used.
+///
+/// @param cache Pointer to uninitialized cache
+/// @param snapshot Snapshot, 8 byte aligned. It becomes the cache's backing memory.
+/// @param size Size of \p snapshot in bytes
+/// @param now Current time on the clock the cache will be used with
+/// @param wall Current time on the clock \a tiny_dns_cache_snapshot was given as \p wall
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL or misaligned, or the snapshot's header is
+///     damaged
+/// @return TINY_DNS_ERR_NO_BUF if \p size is too short for the snapshot
+/// @return TINY_DNS_ERR_UNSUPPORTED if \p snapshot isn't one, or is from an incompatible build
+tiny_dns_err tiny_dns_cache_restore(struct tiny_dns_cache *cache, void *snapshot, size_t size,
+                                    uint64_t now, uint64_t wall);
+
+/// @brief Most shards a struct tiny_dns_shard_cache can be split into
+#ifndef TINY_DNS_CACHE_SHARDS_MAX
+    #define TINY_DNS_CACHE_SHARDS_MAX 64
+#endif
+
+/// @brief Most times a lookup in a struct tiny_dns_shard_cache waits for a writer or retries a torn
+///     read before it reports a miss. A few thousand cover any healthy writer.
+#ifndef TINY_DNS_SHARD_CACHE_READ_SPINS
+    #define TINY_DNS_SHARD_CACHE_READ_SPINS 4096
+#endif
+
+struct tiny_dns_cache_shard;
+
+/// @brief A struct tiny_dns_cache split into shards that any number of threads can share
+///     Each question belongs to one shard, picked by its hash. Lookups take no lock: they copy the
+///     response out and retry if a writer changed the shard meanwhile, so readers never wait for
+///     each other and only write shared memory to mark an entry as used. Writers take a lock
+///     per shard, so writers to different shards don't contend either.
+///
+///     Like struct tiny_dns_cache, everything lives in the memory given to
+///     \a tiny_dns_shard_cache_init and is addressed by index, so the memory may be mapped by
+///     several processes at different addresses. Each process points its own struct at it with
+///     \a tiny_dns_shard_cache_attach, and they must all pass the same clock as \p now, for example
+///     CLOCK_MONOTONIC seconds. Writers lock a shard with a robust, process shared mutex. If a
+///     process dies holding one, lookups in that shard miss (see \a tiny_dns_shard_cache_lookup)
+///     until the next insert, removal or \a tiny_dns_shard_cache_stats takes the lock over. That
+///     call empties the shard, which may have been left half changed, and goes on as usual.
+struct tiny_dns_shard_cache {
+    struct tiny_dns_cache_shard *sync;
+    struct tiny_dns_cache shards[TINY_DNS_CACHE_SHARDS_MAX];
+    uint32_t shard_mask;
+};
+
+/// @brief Lay out an empty sharded cache in \p mem
+///
+/// @param cache Pointer to uninitialized cache
+/// @param mem Backing memory, which must outlive \p cache. Need not be aligned.
+/// @param size Size of \p mem in bytes, divided evenly among the shards
+/// @param shard_count Number of shards, a power of two up to TINY_DNS_CACHE_SHARDS_MAX. A few
+///     times the number of writing threads keeps them from contending.
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL or \p shard_count is unsupported
+/// @return TINY_DNS_ERR_NO_SPACE if \p size can't hold an entry per shard
+/// @return TINY_DNS_ERR_UNSUPPORTED if the platform has no robust, process shared mutexes
+tiny_dns_err tiny_dns_shard_cache_init(struct tiny_dns_shard_cache *cache, void *mem, size_t size,
+                                       size_t shard_count);
+
+/// @brief Use a sharded cache already laid out in \p mem, leaving its contents alone
+///     For memory shared with the process that called \a tiny_dns_shard_cache_init, which may
+///     still be using it. The layout is checked, so \p mem only needs to be trusted not to
+///     change it afterwards.
+///
+/// @param cache Pointer to uninitialized cache
+/// @param mem Backing memory, aligned the same way as when it was initialized. Page aligned
+///     mappings always are.
+/// @param size Size of \p mem in bytes
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL, or the layout doesn't fit in \p size
+/// @return TINY_DNS_ERR_NOT_FOUND if \p mem doesn't hold a cache yet, which is zeroed memory
+/// @return TINY_DNS_ERR_UNSUPPORTED if \p mem holds something else, or a cache laid out by an
+///     incompatible version of the library
+tiny_dns_err tiny_dns_shard_cache_attach(struct tiny_dns_shard_cache *cache, void *mem,
+                                         size_t size);
+
+/// @brief Number of responses \p cache can hold, across all shards
+size_t tiny_dns_shard_cache_capacity(const struct tiny_dns_shard_cache *cache);
+
+/// @brief Same as \a tiny_dns_cache_insert. Safe to call from any thread.
+///     Also returns TINY_DNS_ERR_IO, dropping the response, if the shard's lock can't be taken.
+tiny_dns_err tiny_dns_shard_cache_insert(struct tiny_dns_shard_cache *cache, const void *msg,
+                                         size_t len, uint64_t now);
+
+/// @brief Same as \a tiny_dns_cache_lookup, without taking a lock. Safe to call from any thread.
+///     Hits, misses, prefetches and stale hits aren't counted in the shared shards, where every
+///     reader would fight over the counters; they're added to \p stats instead, which should be
+///     per thread.
+///     Hits towards prefetching are counted in the entry, but only until it's hot.
+///     A lookup never waits on writers for long: if the shard stays mid-update or keeps changing
+///     for TINY_DNS_SHARD_CACHE_READ_SPINS tries, for example because a writer died holding it,
+///     the lookup reports a miss.
+///
+/// @param stats Caller's counters to add this lookup to, may be NULL
+tiny_dns_err tiny_dns_shard_cache_lookup(struct tiny_dns_shard_cache *cache,
+                                         const struct tiny_dns_name_view *qname, uint16_t qtype,
+                                         uint16_t qclass, uint64_t now, void *buffer, size_t *len,
+                                         struct tiny_dns_cache_hit *hit,
+                                         struct tiny_dns_cache_stats *stats);
+
+/// @brief Same as \a tiny_dns_cache_remove. Safe to call from any thread.
+void tiny_dns_shard_cache_remove(struct tiny_dns_shard_cache *cache,
+                                 const struct tiny_dns_name_view *qname, uint16_t qtype,
+                                 uint16_t qclass);
+
+/// @brief Inserts and evictions summed over the shards. Hits, misses, prefetches and stale hits
+///     are left at 0, see \a tiny_dns_shard_cache_lookup.
+void tiny_dns_shard_cache_stats(const struct tiny_dns_shard_cache *cache,
+                                struct tiny_dns_cache_stats *stats);
+
+/// @brief Same as \a tiny_dns_cache_set_prefetch, for every shard. Not safe to call while other
+///     threads use the cache.
+void tiny_dns_shard_cache_set_prefetch(struct tiny_dns_shard_cache *cache,
+                                       const struct tiny_dns_cache_prefetch *prefetch);
+
+/// @brief Same as \a tiny_dns_cache_set_stale, for every shard. Not safe to call while other
+///     threads use the cache.
+void tiny_dns_shard_cache_set_stale(struct tiny_dns_shard_cache *cache,
+                                    const struct tiny_dns_cache_stale *stale);
+
 #ifdef __cplusplus
 }
 #endif
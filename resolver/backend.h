@@ -0,0 +1,39 @@
+// Interface between the resolver and the io_uring backend. The epoll backend lives in resolver.c.
+
+#ifndef TINY_DNS_RESOLVER_BACKEND_H
+#define TINY_DNS_RESOLVER_BACKEND_H
+
+#include "resolver.h"
+#include "udp.h"
+
+// Hand a received datagram to the resolver. Returns 1 if it answered a query, whose callback has
+// then been called, 0 if it was dropped.
+int tiny_dns_resolver_on_response(struct tiny_dns_resolver *res, const uint8_t *msg, size_t len);
+
+// Fail the outstanding query with ID id, whose send completed with an error. Returns 1 if its
+// callback was called, 0 if no query has that ID anymore.
+int tiny_dns_resolver_on_send_error(struct tiny_dns_resolver *res, uint16_t id);
+
+#ifdef TINY_DNS_HAVE_IO_URING
+
+// Set up the ring for res->fd, which is open and connected
+tiny_dns_err tiny_dns_uring_init(struct tiny_dns_resolver *res);
+
+void tiny_dns_uring_close(struct tiny_dns_resolver *res);
+
+// Queue and submit a send per message. Returns the number queued, or TINY_DNS_ERR_IO if they
+// couldn't be submitted. A send that then fails outright is reported by tiny_dns_uring_process,
+// through tiny_dns_resolver_on_send_error.
+int tiny_dns_uring_send(struct tiny_dns_resolver *res, struct tiny_dns_udp_msg *msgs,
+                        size_t count);
+
+// Handle completed receives and failed sends without blocking. Returns the number of callbacks
+// called.
+int tiny_dns_uring_process(struct tiny_dns_resolver *res);
+
+// Block until a completion is pending or timeout_ms passes, -1 for no timeout
+tiny_dns_err tiny_dns_uring_wait(struct tiny_dns_resolver *res, int timeout_ms);
+
+#endif
+
+#endif  // TINY_DNS_RESOLVER_BACKEND_H
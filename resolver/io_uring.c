@@ -0,0 +1,365 @@
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+#define URING_ENTRIES 256
+
+// Receive buffers in the ring shared with the kernel, a power of two
+#define URING_BUFS       64
+#define URING_BUF_GROUP  0
+#define URING_FIXED_FILE 0
+
+// user_data of the submissions, to tell completions apart. Sends carry their query's ID above
+// the tag, so a failed one can be traced back.
+#define TAG_RECV  1
+#define TAG_SEND  2
+#define TAG_MASK  0xFF
+#define TAG_SHIFT 8
+
+// There is no libc wrapper for these, and liburing would be a dependency
+static int uring_setup(unsigned int entries, struct io_uring_params *params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int fd, unsigned int to_submit, unsigned int min_complete,
+                       unsigned int flags, void *arg, size_t arg_len) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_len);
+}
+
+static int uring_register(int fd, unsigned int opcode, void *arg, unsigned int count) {
+    return (int)syscall(__NR_io_uring_register, fd, opcode, arg, count);
+}
+
+static int uring_submit(struct tiny_dns_resolver_uring *ring) {
+    while (ring->sq_pending > 0) {
+        int n = uring_enter(ring->ring_fd, ring->sq_pending, 0, 0, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        ring->sq_pending -= (uint32_t)n;
+    }
+
+    return 0;
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct tiny_dns_resolver_uring *ring) {
+    uint32_t tail = *ring->sq_tail;
+    if (tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+        if (uring_submit(ring) < 0 ||
+            tail - __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE) >= ring->sq_entries) {
+            return NULL;
+        }
+    }
+
+    uint32_t index = tail & ring->sq_mask;
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)ring->sqes)[index];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->sq_pending++;
+
+    return sqe;
+}
+
+// Hand buffer @bid back to the kernel
+static void buf_recycle(struct tiny_dns_resolver_uring *ring, uint16_t bid) {
+    struct io_uring_buf_ring *br = ring->buf_ring;
+    struct io_uring_buf *buf = &br->bufs[ring->buf_tail & (URING_BUFS - 1)];
+    buf->addr = (uint64_t)(uintptr_t)(ring->bufs + (size_t)bid * TINY_DNS_RESOLVER_MSG_MAX);
+    buf->len = TINY_DNS_RESOLVER_MSG_MAX;
+    buf->bid = bid;
+    ring->buf_tail++;
+    __atomic_store_n(&br->tail, ring->buf_tail, __ATOMIC_RELEASE);
+}
+
+// One multishot receive keeps completing as datagrams arrive, each in a buffer the kernel picks
+// from the ring. It ends when the buffers run out or on an error, and is then armed again.
+static int arm_recv(struct tiny_dns_resolver_uring *ring) {
+    struct io_uring_sqe *sqe = uring_get_sqe(ring);
+    if (!sqe) {
+        return -1;
+    }
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = URING_FIXED_FILE;
+    sqe->flags = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->buf_group = URING_BUF_GROUP;
+    sqe->user_data = TAG_RECV;
+    ring->recv_armed = true;
+
+    return uring_submit(ring);
+}
+
+static int map_rings(struct tiny_dns_resolver_uring *ring, const struct io_uring_params *params) {
+    ring->sq_ring_len = params->sq_off.array + params->sq_entries * sizeof(uint32_t);
+    ring->cq_ring_len = params->cq_off.cqes + params->cq_entries * sizeof(struct io_uring_cqe);
+    if (params->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring->cq_ring_len > ring->sq_ring_len) {
+            ring->sq_ring_len = ring->cq_ring_len;
+        }
+        ring->cq_ring_len = 0;
+    }
+
+    ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+                         MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    if (ring->sq_ring == MAP_FAILED) {
+        ring->sq_ring = NULL;
+        return -1;
+    }
+
+    ring->cq_ring = ring->sq_ring;
+    if (ring->cq_ring_len > 0) {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_len, PROT_READ | PROT_WRITE,
+                             MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_CQ_RING);
+        if (ring->cq_ring == MAP_FAILED) {
+            ring->cq_ring = NULL;
+            return -1;
+        }
+    }
+
+    ring->sqes_len = params->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      ring->ring_fd, IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED) {
+        ring->sqes = NULL;
+        return -1;
+    }
+
+    char *sq = ring->sq_ring;
+    char *cq = ring->cq_ring;
+    ring->sq_head = (uint32_t *)(sq + params->sq_off.head);
+    ring->sq_tail = (uint32_t *)(sq + params->sq_off.tail);
+    ring->sq_mask = *(uint32_t *)(sq + params->sq_off.ring_mask);
+    ring->sq_array = (uint32_t *)(sq + params->sq_off.array);
+    ring->sq_entries = params->sq_entries;
+    ring->cq_head = (uint32_t *)(cq + params->cq_off.head);
+    ring->cq_tail = (uint32_t *)(cq + params->cq_off.tail);
+    ring->cq_mask = *(uint32_t *)(cq + params->cq_off.ring_mask);
+    ring->cqes = cq + params->cq_off.cqes;
+
+    return 0;
+}
+
+static int setup_buffers(struct tiny_dns_resolver_uring *ring) {
+    size_t ring_len = URING_BUFS * sizeof(struct io_uring_buf);
+    ring->buf_ring_len = ring_len + (size_t)URING_BUFS * TINY_DNS_RESOLVER_MSG_MAX;
+    ring->buf_ring = mmap(NULL, ring->buf_ring_len, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (ring->buf_ring == MAP_FAILED) {
+        ring->buf_ring = NULL;
+        return -1;
+    }
+    ring->bufs = (uint8_t *)ring->buf_ring + ring_len;
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = URING_BUFS;
+    reg.bgid = URING_BUF_GROUP;
+    if (uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        return -1;
+    }
+
+    ring->buf_tail = 0;
+    for (uint16_t bid = 0; bid < URING_BUFS; bid++) {
+        buf_recycle(ring, bid);
+    }
+
+    return 0;
+}
+
+tiny_dns_err tiny_dns_uring_init(struct tiny_dns_resolver *res) {
+    struct tiny_dns_resolver_uring *ring = &res->uring;
+    memset(ring, 0, sizeof(*ring));
+
+    // Completions are only reaped from the thread that waits on them, so the kernel needn't
+    // interrupt it to run them; older kernels don't know the flag
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_COOP_TASKRUN;
+    ring->ring_fd = uring_setup(URING_ENTRIES, &params);
+    if (ring->ring_fd < 0 && errno == EINVAL) {
+        memset(&params, 0, sizeof(params));
+        ring->ring_fd = uring_setup(URING_ENTRIES, &params);
+    }
+    if (ring->ring_fd < 0) {
+        return errno == ENOSYS || errno == EPERM ? TINY_DNS_ERR_UNSUPPORTED : TINY_DNS_ERR_IO;
+    }
+
+    if (map_rings(ring, &params) < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    // Provided buffer rings arrived in 5.19 and multishot recv in 6.0
+    if (setup_buffers(ring) < 0) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    }
+
+    int fds[1] = { res->fd };
+    if (uring_register(ring->ring_fd, IORING_REGISTER_FILES, fds, 1) < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    // Successful sends need no completion at all
+    if (params.features & IORING_FEAT_CQE_SKIP) {
+        ring->sqe_flags = IOSQE_CQE_SKIP_SUCCESS;
+    }
+
+    if (arm_recv(ring) < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+void tiny_dns_uring_close(struct tiny_dns_resolver *res) {
+    struct tiny_dns_resolver_uring *ring = &res->uring;
+    if (ring->ring_fd < 0) {
+        return;
+    }
+
+    // Closing the ring cancels the receive and releases the buffer ring registration
+    close(ring->ring_fd);
+    if (ring->sqes) {
+        munmap(ring->sqes, ring->sqes_len);
+    }
+    if (ring->cq_ring && ring->cq_ring != ring->sq_ring) {
+        munmap(ring->cq_ring, ring->cq_ring_len);
+    }
+    if (ring->sq_ring) {
+        munmap(ring->sq_ring, ring->sq_ring_len);
+    }
+    if (ring->buf_ring) {
+        munmap(ring->buf_ring, ring->buf_ring_len);
+    }
+
+    memset(ring, 0, sizeof(*ring));
+    ring->ring_fd = -1;
+}
+
+int tiny_dns_uring_send(struct tiny_dns_resolver *res, struct tiny_dns_udp_msg *msgs,
+                        size_t count) {
+    struct tiny_dns_resolver_uring *ring = &res->uring;
+
+    // MSG_DONTWAIT keeps the kernel from parking a send until the socket is writable, so every
+    // send completes while being submitted and the messages needn't outlive this call. A full
+    // socket buffer fails the send with EAGAIN, which is left to the retry timer.
+    size_t queued = 0;
+    for (; queued < count; queued++) {
+        struct io_uring_sqe *sqe = uring_get_sqe(ring);
+        if (!sqe) {
+            break;
+        }
+
+        const uint8_t *msg = msgs[queued].data;
+        uint16_t id = (uint16_t)(msg[0] << 8 | msg[1]);
+        sqe->opcode = IORING_OP_SEND;
+        sqe->fd = URING_FIXED_FILE;
+        sqe->flags = IOSQE_FIXED_FILE | ring->sqe_flags;
+        sqe->addr = (uint64_t)(uintptr_t)msg;
+        sqe->len = (uint32_t)msgs[queued].len;
+        sqe->msg_flags = MSG_DONTWAIT;
+        sqe->user_data = TAG_SEND | (uint64_t)id << TAG_SHIFT;
+    }
+
+    if (uring_submit(ring) < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    return (int)queued;
+}
+
+// Like tiny_dns_udp_send, a full socket buffer or the ICMP error of an earlier datagram is left to
+// the retry timer, anything else fails the query
+static bool send_failed(int err) {
+    return err < 0 && err != -EAGAIN && err != -ENOBUFS && err != -ECONNREFUSED && err != -EINTR;
+}
+
+int tiny_dns_uring_process(struct tiny_dns_resolver *res) {
+    struct tiny_dns_resolver_uring *ring = &res->uring;
+    const struct io_uring_cqe *cqes = ring->cqes;
+
+    int calls = 0;
+    for (int budget = TINY_DNS_RESOLVER_RECV_BUDGET; budget > 0; budget--) {
+        uint32_t head = *ring->cq_head;
+        if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+
+        struct io_uring_cqe cqe = cqes[head & ring->cq_mask];
+        __atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+        // Only failed sends complete, unless the kernel lacks IOSQE_CQE_SKIP_SUCCESS
+        if ((cqe.user_data & TAG_MASK) == TAG_SEND) {
+            uint16_t id = (uint16_t)(cqe.user_data >> TAG_SHIFT);
+            if (send_failed(cqe.res)) {
+                calls += tiny_dns_resolver_on_send_error(res, id);
+            }
+            continue;
+        }
+
+        if (!(cqe.flags & IORING_CQE_F_MORE)) {
+            ring->recv_armed = false;
+        }
+
+        if (cqe.res < 0 || !(cqe.flags & IORING_CQE_F_BUFFER)) {
+            continue;
+        }
+
+        // The response is parsed right where the kernel put it. A buffer filled to the brim may
+        // hold a truncated datagram, which can't be told apart, so it's dropped.
+        uint16_t bid = (uint16_t)(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+        const uint8_t *msg = ring->bufs + (size_t)bid * TINY_DNS_RESOLVER_MSG_MAX;
+        if (cqe.res < TINY_DNS_RESOLVER_MSG_MAX) {
+            calls += tiny_dns_resolver_on_response(res, msg, (size_t)cqe.res);
+        } else {
+            res->stats.dropped++;
+        }
+
+        buf_recycle(ring, bid);
+    }
+
+    if (!ring->recv_armed && arm_recv(ring) < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    return calls;
+}
+
+tiny_dns_err tiny_dns_uring_wait(struct tiny_dns_resolver *res, int timeout_ms) {
+    struct tiny_dns_resolver_uring *ring = &res->uring;
+    if (*ring->cq_head != __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE)) {
+        return TINY_DNS_ERR_NONE;
+    }
+
+    struct __kernel_timespec ts = {
+        .tv_sec = timeout_ms / 1000,
+        .tv_nsec = (long long)(timeout_ms % 1000) * 1000000,
+    };
+    struct io_uring_getevents_arg arg;
+    memset(&arg, 0, sizeof(arg));
+    arg.ts = timeout_ms < 0 ? 0 : (uint64_t)(uintptr_t)&ts;
+
+    int n = uring_enter(ring->ring_fd, ring->sq_pending, 1,
+                        IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    if (n < 0 && errno != ETIME && errno != EINTR) {
+        return TINY_DNS_ERR_IO;
+    }
+    if (n > 0) {
+        ring->sq_pending -= (uint32_t)n;
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
@@ -0,0 +1,202 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "pool.h"
+
+// Tries at a random source port before leaving the choice to the kernel, which randomizes too
+#define BIND_ATTEMPTS 8
+
+// Ports below this need privileges or belong to well known services
+#define PORT_MIN 1024
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*, as for query IDs in the resolver
+static uint16_t next_random(struct tiny_dns_udp_pool *pool) {
+    pool->rng ^= pool->rng >> 12;
+    pool->rng ^= pool->rng << 25;
+    pool->rng ^= pool->rng >> 27;
+    return (uint16_t)((pool->rng * 0x2545F4914F6CDD1Dull) >> 48);
+}
+
+static void set_port(struct sockaddr_storage *addr, uint16_t port) {
+    if (addr->ss_family == AF_INET6) {
+        ((struct sockaddr_in6 *)addr)->sin6_port = htons(port);
+    } else {
+        ((struct sockaddr_in *)addr)->sin_port = htons(port);
+    }
+}
+
+static uint16_t get_port(const struct sockaddr_storage *addr) {
+    if (addr->ss_family == AF_INET6) {
+        return ntohs(((const struct sockaddr_in6 *)addr)->sin6_port);
+    }
+    return ntohs(((const struct sockaddr_in *)addr)->sin_port);
+}
+
+// Bind to a random port, falling back to port 0 if the ones drawn are taken
+static int bind_random(struct tiny_dns_udp_pool *pool, int fd, int family) {
+    struct sockaddr_storage local;
+    memset(&local, 0, sizeof(local));
+    local.ss_family = (sa_family_t)family;
+    socklen_t len = family == AF_INET6 ? sizeof(struct sockaddr_in6) : sizeof(struct sockaddr_in);
+
+    for (int i = 0; i < BIND_ATTEMPTS; i++) {
+        uint16_t port = (uint16_t)(PORT_MIN + next_random(pool) % (65536 - PORT_MIN));
+        set_port(&local, port);
+        if (bind(fd, (struct sockaddr *)&local, len) == 0) {
+            return 0;
+        } else if (errno != EADDRINUSE && errno != EACCES) {
+            return -1;
+        }
+    }
+
+    set_port(&local, 0);
+    return bind(fd, (struct sockaddr *)&local, len);
+}
+
+static tiny_dns_err socket_open(struct tiny_dns_udp_pool *pool,
+                                struct tiny_dns_udp_pool_socket *sock) {
+    const struct tiny_dns_udp_upstream *upstream = &pool->upstreams[sock->upstream];
+    int family = upstream->addr.ss_family;
+
+    sock->uses = 0;
+    sock->fd = socket(family, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+    if (sock->fd < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    struct timeval timeout = {
+        .tv_sec = pool->recv_timeout_ms / 1000,
+        .tv_usec = (pool->recv_timeout_ms % 1000) * 1000,
+    };
+    struct sockaddr_storage local;
+    socklen_t local_len = sizeof(local);
+    if ((pool->recv_timeout_ms &&
+         setsockopt(sock->fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout)) < 0) ||
+        bind_random(pool, sock->fd, family) < 0 ||
+        connect(sock->fd, (const struct sockaddr *)&upstream->addr, upstream->addr_len) < 0 ||
+        getsockname(sock->fd, (struct sockaddr *)&local, &local_len) < 0) {
+        close(sock->fd);
+        sock->fd = -1;
+        return TINY_DNS_ERR_IO;
+    }
+
+    sock->port = get_port(&local);
+    pool->stats.opened++;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+static void socket_close(struct tiny_dns_udp_pool_socket *sock) {
+    if (sock->fd >= 0) {
+        close(sock->fd);
+        sock->fd = -1;
+    }
+}
+
+tiny_dns_err tiny_dns_udp_pool_init(struct tiny_dns_udp_pool *pool,
+                                    const struct tiny_dns_udp_pool_config *config,
+                                    struct tiny_dns_udp_pool_socket *sockets, size_t socket_count) {
+    if (!pool || !config || !sockets || config->upstream_count == 0 ||
+        config->upstream_count > TINY_DNS_UDP_POOL_UPSTREAMS_MAX || socket_count == 0 ||
+        socket_count % config->upstream_count != 0) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    for (size_t i = 0; i < config->upstream_count; i++) {
+        const struct tiny_dns_udp_upstream *upstream = &config->upstreams[i];
+        int family = upstream->addr.ss_family;
+        if ((family != AF_INET && family != AF_INET6) || upstream->addr_len == 0 ||
+            upstream->addr_len > sizeof(upstream->addr)) {
+            return TINY_DNS_ERR_INVALID;
+        }
+    }
+
+    memset(pool, 0, sizeof(*pool));
+    memcpy(pool->upstreams, config->upstreams, config->upstream_count * sizeof(*config->upstreams));
+    pool->upstream_count = config->upstream_count;
+    pool->sockets = sockets;
+    pool->socket_count = socket_count;
+    pool->max_uses = config->max_uses;
+    pool->recv_timeout_ms = config->recv_timeout_ms;
+
+    // Seeded like the resolver's IDs. Without getrandom (old kernels, seccomp) ports are drawn
+    // from the clock and pid, and the kernel's own randomization stays behind them
+    if (getrandom(&pool->rng, sizeof(pool->rng), 0) != sizeof(pool->rng)) {
+        pool->rng = now_ns() ^ ((uint64_t)getpid() << 32);
+    }
+    pool->rng |= 1;
+
+    // Sockets are dealt out round robin, so sockets[i] belongs to upstream i % upstream_count
+    for (size_t i = 0; i < socket_count; i++) {
+        sockets[i].fd = -1;
+    }
+    for (size_t i = socket_count; i-- > 0;) {
+        struct tiny_dns_udp_pool_socket *sock = &sockets[i];
+        sock->upstream = (uint16_t)(i % pool->upstream_count);
+        if (socket_open(pool, sock) != TINY_DNS_ERR_NONE) {
+            tiny_dns_udp_pool_close(pool);
+            return TINY_DNS_ERR_IO;
+        }
+
+        sock->next_free = pool->free[sock->upstream];
+        pool->free[sock->upstream] = sock;
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+void tiny_dns_udp_pool_close(struct tiny_dns_udp_pool *pool) {
+    for (size_t i = 0; i < pool->socket_count; i++) {
+        socket_close(&pool->sockets[i]);
+    }
+
+    memset(pool->free, 0, sizeof(pool->free));
+}
+
+struct tiny_dns_udp_pool_socket *tiny_dns_udp_pool_lease(struct tiny_dns_udp_pool *pool,
+                                                         size_t upstream) {
+    if (upstream >= pool->upstream_count) {
+        return NULL;
+    }
+
+    struct tiny_dns_udp_pool_socket *sock = pool->free[upstream];
+    if (!sock) {
+        pool->stats.exhausted++;
+        return NULL;
+    }
+
+    // A socket whose reopen failed on release gets another chance now
+    if (sock->fd < 0 && socket_open(pool, sock) != TINY_DNS_ERR_NONE) {
+        return NULL;
+    }
+
+    pool->free[upstream] = sock->next_free;
+    sock->next_free = NULL;
+    sock->uses++;
+    pool->stats.leases++;
+
+    return sock;
+}
+
+void tiny_dns_udp_pool_release(struct tiny_dns_udp_pool *pool,
+                               struct tiny_dns_udp_pool_socket *sock, bool healthy) {
+    if (!healthy || (pool->max_uses && sock->uses >= pool->max_uses)) {
+        socket_close(sock);
+        // Failing here leaves fd at -1, and the next lease retries
+        if (socket_open(pool, sock) == TINY_DNS_ERR_NONE) {
+            pool->stats.reopened++;
+        }
+    }
+
+    sock->next_free = pool->free[sock->upstream];
+    pool->free[sock->upstream] = sock;
+}
@@ -0,0 +1,117 @@
+/// @file pool.h
+/// @brief Pre-connected UDP sockets per upstream, leased out for synchronous lookups
+///
+/// Opening a socket for every lookup costs a socket, bind, connect and close per query, and
+/// churns through ephemeral ports. The pool opens its sockets once, each bound to its own random
+/// source port and connected to its upstream, so a lookup is just a lease, send, receive and
+/// release. Sockets are reopened on a fresh port after a failure or a set number of uses, which
+/// keeps the port an off-path attacker has to guess moving.
+
+#ifndef TINY_DNS_POOL_H
+#define TINY_DNS_POOL_H
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "tiny_dns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Upstreams a pool can hold
+#ifndef TINY_DNS_UDP_POOL_UPSTREAMS_MAX
+    #define TINY_DNS_UDP_POOL_UPSTREAMS_MAX 8
+#endif
+
+/// @brief A nameserver to open sockets to
+struct tiny_dns_udp_upstream {
+    /// IPv4 or IPv6 address and port
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+};
+
+/// @brief One pooled socket, in storage provided by the caller
+struct tiny_dns_udp_pool_socket {
+    /// Connected socket, or -1 if it couldn't be reopened and will be on the next lease
+    int fd;
+    /// Local port, host byte order
+    uint16_t port;
+    /// Index of the upstream it's connected to
+    uint16_t upstream;
+    /// Leases since the socket was opened
+    uint32_t uses;
+    struct tiny_dns_udp_pool_socket *next_free;
+};
+
+struct tiny_dns_udp_pool_config {
+    const struct tiny_dns_udp_upstream *upstreams;
+    size_t upstream_count;
+    /// Leases before a socket is reopened on a new port, 0 to keep it until it fails
+    uint32_t max_uses;
+    /// Receive timeout set on every socket, 0 to block indefinitely
+    uint32_t recv_timeout_ms;
+};
+
+struct tiny_dns_udp_pool_stats {
+    /// Sockets opened, including reopens
+    uint64_t opened;
+    uint64_t leases;
+    /// Leases refused because every socket for the upstream was out
+    uint64_t exhausted;
+    /// Sockets reopened after a failure or reaching max_uses
+    uint64_t reopened;
+};
+
+struct tiny_dns_udp_pool {
+    struct tiny_dns_udp_upstream upstreams[TINY_DNS_UDP_POOL_UPSTREAMS_MAX];
+    struct tiny_dns_udp_pool_socket *free[TINY_DNS_UDP_POOL_UPSTREAMS_MAX];
+    struct tiny_dns_udp_pool_socket *sockets;
+    size_t socket_count;
+    size_t upstream_count;
+    uint32_t max_uses;
+    uint32_t recv_timeout_ms;
+    uint64_t rng;
+    struct tiny_dns_udp_pool_stats stats;
+};
+
+/// @brief Open and connect every socket of the pool
+///
+/// @param pool Pool to set up
+/// @param config Upstreams and reuse policy. The upstreams are copied.
+/// @param sockets Caller's storage for the sockets, split evenly across the upstreams
+/// @param socket_count Number of entries in \p sockets, a multiple of the upstream count
+///
+/// @return TINY_DNS_ERR_NONE on success, TINY_DNS_ERR_INVALID for a bad config,
+///     TINY_DNS_ERR_IO if a socket couldn't be opened
+tiny_dns_err tiny_dns_udp_pool_init(struct tiny_dns_udp_pool *pool,
+                                    const struct tiny_dns_udp_pool_config *config,
+                                    struct tiny_dns_udp_pool_socket *sockets, size_t socket_count);
+
+/// @brief Close every socket, leased or not
+void tiny_dns_udp_pool_close(struct tiny_dns_udp_pool *pool);
+
+/// @brief Take a socket connected to \p upstream for the duration of one lookup
+///
+/// @return The socket, or NULL if all of the upstream's sockets are leased or it can't be
+///     reopened. Responses must still be matched by ID, since a late answer to an earlier lookup
+///     may be waiting on a reused socket.
+struct tiny_dns_udp_pool_socket *tiny_dns_udp_pool_lease(struct tiny_dns_udp_pool *pool,
+                                                         size_t upstream);
+
+/// @brief Hand a leased socket back
+///
+/// @param pool Pool it was leased from
+/// @param sock Socket to return
+/// @param healthy False after a timeout or a socket error, so it's reopened on a new port
+void tiny_dns_udp_pool_release(struct tiny_dns_udp_pool *pool,
+                               struct tiny_dns_udp_pool_socket *sock, bool healthy);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TINY_DNS_POOL_H
@@ -0,0 +1,79 @@
+#include "prefetch.h"
+
+static void prefetch_done(struct tiny_dns_resolver_query *query, tiny_dns_err err,
+                          const uint8_t *response, size_t len, void *context) {
+    (void)query;
+    struct tiny_dns_prefetch_slot *slot = context;
+    struct tiny_dns_prefetcher *pf = slot->owner;
+
+    // An answer the cache won't take, an error rcode say, leaves the old entry to expire or be
+    // served stale
+    if (err == TINY_DNS_ERR_NONE &&
+        tiny_dns_cache_insert(pf->cache, response, len, slot->now) == TINY_DNS_ERR_NONE) {
+        pf->stats.refreshed++;
+    } else {
+        pf->stats.failed++;
+    }
+
+    slot->next_free = pf->free;
+    pf->free = slot;
+    pf->in_flight--;
+}
+
+tiny_dns_err tiny_dns_prefetcher_init(struct tiny_dns_prefetcher *pf,
+                                      struct tiny_dns_resolver *res, struct tiny_dns_cache *cache,
+                                      struct tiny_dns_prefetch_slot *slots, size_t slot_count) {
+    if (!pf || !res || !cache || !slots || slot_count == 0) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    *pf = (struct tiny_dns_prefetcher){ .res = res, .cache = cache, .slots = slots,
+                                        .slot_count = slot_count };
+    for (size_t i = slot_count; i > 0; i--) {
+        slots[i - 1] = (struct tiny_dns_prefetch_slot){ .owner = pf, .next_free = pf->free };
+        pf->free = &slots[i - 1];
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_prefetcher_refresh(struct tiny_dns_prefetcher *pf, const char *name,
+                                         enum tiny_dns_rr_type qtype, uint64_t now) {
+    if (!pf || !name) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    struct tiny_dns_prefetch_slot *slot = pf->free;
+    if (!slot) {
+        pf->stats.busy++;
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    slot->now = now;
+    tiny_dns_err err = tiny_dns_resolver_submit(pf->res, &slot->query, name, qtype,
+                                                prefetch_done, slot);
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    pf->free = slot->next_free;
+    pf->in_flight++;
+    pf->stats.started++;
+    return TINY_DNS_ERR_NONE;
+}
+
+void tiny_dns_prefetcher_cancel(struct tiny_dns_prefetcher *pf) {
+    for (size_t i = 0; pf->in_flight > 0 && i < pf->slot_count; i++) {
+        struct tiny_dns_prefetch_slot *slot = &pf->slots[i];
+        if (slot->query.active) {
+            tiny_dns_resolver_cancel(pf->res, &slot->query);
+            slot->next_free = pf->free;
+            pf->free = slot;
+            pf->in_flight--;
+        }
+    }
+}
+
+size_t tiny_dns_prefetcher_in_flight(const struct tiny_dns_prefetcher *pf) {
+    return pf->in_flight;
+}
@@ -0,0 +1,100 @@
+/// @file prefetch.h
+/// @brief Refreshing hot cache entries in the background, before they expire
+///
+/// Without it, the first lookup of a popular name after its TTL runs out misses and waits for
+/// the upstream, and so does every other lookup of it until the answer is back. With a prefetch
+/// policy set on the cache, a lookup that flags a hit for prefetching hands the name to the
+/// prefetcher, which asks the upstream through the resolver and replaces the entry when the
+/// answer arrives. Lookups keep hitting the old entry meanwhile, so none of them wait.
+///
+/// Stale hits, with serving stale set on the cache, are flagged the same way, so an expired entry
+/// is refreshed in the background while it's served. Should the upstream be down, the stale entry
+/// stays and a later stale hit asks again.
+
+#ifndef TINY_DNS_PREFETCH_H
+#define TINY_DNS_PREFETCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "resolver.h"
+#include "tiny_dns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct tiny_dns_prefetcher;
+
+/// @brief Caller owned state of one refresh. Members are private.
+struct tiny_dns_prefetch_slot {
+    struct tiny_dns_resolver_query query;
+    struct tiny_dns_prefetcher *owner;
+    struct tiny_dns_prefetch_slot *next_free;
+    // Time the refresh was started, which the answer's TTLs count from
+    uint64_t now;
+};
+
+struct tiny_dns_prefetch_stats {
+    /// Refreshes handed to the resolver
+    uint64_t started;
+    /// Answers stored in the cache
+    uint64_t refreshed;
+    /// Refreshes that timed out, or whose answer the cache wouldn't take
+    uint64_t failed;
+    /// Refreshes not started because every slot was in use
+    uint64_t busy;
+};
+
+struct tiny_dns_prefetcher {
+    struct tiny_dns_resolver *res;
+    struct tiny_dns_cache *cache;
+    struct tiny_dns_prefetch_slot *slots;
+    size_t slot_count;
+    struct tiny_dns_prefetch_slot *free;
+    size_t in_flight;
+    struct tiny_dns_prefetch_stats stats;
+};
+
+/// @brief Set up a prefetcher refreshing entries of \p cache through \p res
+///
+/// @param pf Pointer to uninitialized prefetcher
+/// @param res Resolver to send refreshes with, driven by the caller as usual
+/// @param cache Cache to store answers in. Its prefetch policy is set separately, with
+///     \a tiny_dns_cache_set_prefetch.
+/// @param slots Caller's array of refresh slots. Must outlive \p pf.
+/// @param slot_count Entries in \p slots, the most refreshes outstanding at once
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID for NULL parameters or no slots
+tiny_dns_err tiny_dns_prefetcher_init(struct tiny_dns_prefetcher *pf,
+                                      struct tiny_dns_resolver *res, struct tiny_dns_cache *cache,
+                                      struct tiny_dns_prefetch_slot *slots, size_t slot_count);
+
+/// @brief Start refreshing \p name, for a lookup whose hit was flagged for prefetching
+///     Returns without waiting; the answer is stored from \a tiny_dns_resolver_process, as of
+///     \p now.
+///
+/// @param pf Prefetcher in question
+/// @param name Name that was looked up
+/// @param qtype Type that was looked up
+/// @param now Current time on the cache's clock
+///
+/// @return TINY_DNS_ERR_NONE if the refresh is outstanding
+/// @return TINY_DNS_ERR_NO_SPACE if every slot is in use. The entry stays flagged as refreshed,
+///     so it's looked up from the upstream again once it expires.
+/// @return Anything \a tiny_dns_resolver_submit may return
+tiny_dns_err tiny_dns_prefetcher_refresh(struct tiny_dns_prefetcher *pf, const char *name,
+                                         enum tiny_dns_rr_type qtype, uint64_t now);
+
+/// @brief Cancel every outstanding refresh. Their answers are no longer stored.
+void tiny_dns_prefetcher_cancel(struct tiny_dns_prefetcher *pf);
+
+/// @brief Number of refreshes outstanding
+size_t tiny_dns_prefetcher_in_flight(const struct tiny_dns_prefetcher *pf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TINY_DNS_PREFETCH_H
@@ -0,0 +1,552 @@
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/random.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "backend.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+#define DNS_HEADER_SIZE 12
+
+// Bytes of qtype and qclass following the question name
+#define QUESTION_TAIL_LEN 4
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// xorshift64*, seeded from the kernel. Not cryptographic, but IDs only need to be unpredictable
+// enough that an off-path attacker has to guess among 65536 of them.
+static uint16_t next_id(struct tiny_dns_resolver *res) {
+    res->rng ^= res->rng >> 12;
+    res->rng ^= res->rng << 25;
+    res->rng ^= res->rng >> 27;
+    return (uint16_t)((res->rng * 0x2545F4914F6CDD1Dull) >> 48);
+}
+
+static struct tiny_dns_resolver_query **bucket_of(struct tiny_dns_resolver *res, uint16_t id) {
+    return &res->buckets[id & res->bucket_mask];
+}
+
+static struct tiny_dns_resolver_query *lookup_id(struct tiny_dns_resolver *res, uint16_t id) {
+    struct tiny_dns_resolver_query *query = *bucket_of(res, id);
+    while (query && query->id != id) {
+        query = query->hash_next;
+    }
+    return query;
+}
+
+static void unlink_id(struct tiny_dns_resolver *res, struct tiny_dns_resolver_query *query) {
+    struct tiny_dns_resolver_query **link = bucket_of(res, query->id);
+    while (*link != query) {
+        link = &(*link)->hash_next;
+    }
+    *link = query->hash_next;
+}
+
+static void timer_append(struct tiny_dns_resolver *res, struct tiny_dns_resolver_query *query,
+                         uint64_t now) {
+    query->deadline_ns = now + (uint64_t)res->config.timeout_ms * 1000000ull;
+    query->timer_next = NULL;
+    query->timer_prev = res->timer_tail;
+    if (res->timer_tail) {
+        res->timer_tail->timer_next = query;
+    } else {
+        res->timer_head = query;
+    }
+    res->timer_tail = query;
+}
+
+// Put @query at the front, due at once
+static void timer_prepend(struct tiny_dns_resolver *res, struct tiny_dns_resolver_query *query) {
+    query->deadline_ns = 0;
+    query->timer_prev = NULL;
+    query->timer_next = res->timer_head;
+    if (res->timer_head) {
+        res->timer_head->timer_prev = query;
+    } else {
+        res->timer_tail = query;
+    }
+    res->timer_head = query;
+}
+
+static void timer_remove(struct tiny_dns_resolver *res, struct tiny_dns_resolver_query *query) {
+    if (query->timer_prev) {
+        query->timer_prev->timer_next = query->timer_next;
+    } else {
+        res->timer_head = query->timer_next;
+    }
+
+    if (query->timer_next) {
+        query->timer_next->timer_prev = query->timer_prev;
+    } else {
+        res->timer_tail = query->timer_prev;
+    }
+}
+
+static void release(struct tiny_dns_resolver *res, struct tiny_dns_resolver_query *query) {
+    unlink_id(res, query);
+    timer_remove(res, query);
+    query->active = false;
+    res->in_flight--;
+}
+
+static int io_send(struct tiny_dns_resolver *res, struct tiny_dns_udp_msg *msgs, size_t count) {
+#ifdef TINY_DNS_HAVE_IO_URING
+    if (res->config.backend == TINY_DNS_RESOLVER_IO_URING) {
+        return tiny_dns_uring_send(res, msgs, count);
+    }
+#endif
+    return tiny_dns_udp_send(res->fd, msgs, count);
+}
+
+// Lost datagrams and a full socket buffer are both left to the retry timer
+static tiny_dns_err send_query(struct tiny_dns_resolver *res,
+                               struct tiny_dns_resolver_query *query) {
+    query->attempts++;
+    res->stats.sent++;
+
+    struct tiny_dns_udp_msg msg = { .data = query->msg.msg, .len = query->msg.len };
+    return io_send(res, &msg, 1) < 0 ? TINY_DNS_ERR_IO : TINY_DNS_ERR_NONE;
+}
+
+// A response answers @query if it echoes the ID and the question, and is in fact a response
+static bool response_matches(const struct tiny_dns_resolver_query *query, const uint8_t *msg,
+                             size_t len) {
+    const uint8_t *sent = query->msg.msg;
+    size_t question_end = query->msg.len;
+
+    if (len < question_end || !(msg[2] & 0x80) || msg[4] != 0 || msg[5] != 1) {
+        return false;
+    }
+
+    struct tiny_dns_name_view ours = { (const char *)sent, question_end, DNS_HEADER_SIZE };
+    struct tiny_dns_name_view theirs = { (const char *)msg, len, DNS_HEADER_SIZE };
+    if (!tiny_dns_name_wire_eq(&ours, &theirs)) {
+        return false;
+    }
+
+    // Servers echo the question uncompressed, so qtype and qclass sit where they did in ours
+    return memcmp(&msg[question_end - QUESTION_TAIL_LEN], &sent[question_end - QUESTION_TAIL_LEN],
+                  QUESTION_TAIL_LEN) == 0;
+}
+
+tiny_dns_err tiny_dns_resolver_init(struct tiny_dns_resolver *res,
+                                    const struct tiny_dns_resolver_config *config,
+                                    struct tiny_dns_resolver_query **buckets, size_t bucket_count) {
+    if (!res || !config || !buckets || bucket_count == 0 || (bucket_count & (bucket_count - 1)) ||
+        config->attempts == 0 || config->timeout_ms == 0) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    memset(res, 0, offsetof(struct tiny_dns_resolver, rx));
+    res->config = *config;
+    res->buckets = buckets;
+    res->bucket_mask = bucket_count - 1;
+    memset(buckets, 0, bucket_count * sizeof(*buckets));
+
+    if (getrandom(&res->rng, sizeof(res->rng), 0) != sizeof(res->rng)) {
+        res->rng = now_ns() ^ ((uint64_t)getpid() << 32);
+    }
+    res->rng |= 1;
+
+    res->epoll_fd = -1;
+    res->uring.ring_fd = -1;
+
+#ifndef TINY_DNS_HAVE_IO_URING
+    if (config->backend == TINY_DNS_RESOLVER_IO_URING) {
+        return TINY_DNS_ERR_UNSUPPORTED;
+    }
+#endif
+    if (config->backend != TINY_DNS_RESOLVER_EPOLL &&
+        config->backend != TINY_DNS_RESOLVER_IO_URING) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    res->fd = socket(config->server.ss_family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (res->fd < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    // Best effort: the limit is capped by net.core.rmem_max
+    if (config->rcvbuf > 0) {
+        setsockopt(res->fd, SOL_SOCKET, SO_RCVBUF, &config->rcvbuf, sizeof(config->rcvbuf));
+    }
+
+    if (connect(res->fd, (const struct sockaddr *)&config->server, config->server_len) < 0) {
+        close(res->fd);
+        return TINY_DNS_ERR_IO;
+    }
+
+    tiny_dns_err err = TINY_DNS_ERR_IO;
+#ifdef TINY_DNS_HAVE_IO_URING
+    if (config->backend == TINY_DNS_RESOLVER_IO_URING) {
+        err = tiny_dns_uring_init(res);
+    } else
+#endif
+    {
+        struct epoll_event ev = { .events = EPOLLIN };
+        res->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (res->epoll_fd >= 0 && epoll_ctl(res->epoll_fd, EPOLL_CTL_ADD, res->fd, &ev) == 0) {
+            err = TINY_DNS_ERR_NONE;
+        }
+    }
+
+    if (IS_ERR(err)) {
+        tiny_dns_resolver_close(res);
+    }
+
+    return err;
+}
+
+void tiny_dns_resolver_close(struct tiny_dns_resolver *res) {
+#ifdef TINY_DNS_HAVE_IO_URING
+    tiny_dns_uring_close(res);
+#endif
+    if (res->epoll_fd >= 0) {
+        close(res->epoll_fd);
+    }
+    close(res->fd);
+    res->epoll_fd = -1;
+    res->fd = -1;
+}
+
+// Prepare @query with a fresh ID, but don't track it yet
+static tiny_dns_err prepare_query(struct tiny_dns_resolver *res,
+                                  struct tiny_dns_resolver_query *query, const char *name,
+                                  enum tiny_dns_rr_type qtype) {
+    tiny_dns_err err = tiny_dns_query_prepare(&query->msg, name, qtype);
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    // IDs are unique among outstanding queries, so a response matches at most one
+    uint16_t id;
+    do {
+        id = next_id(res);
+    } while (lookup_id(res, id));
+
+    query->id = id;
+    query->msg.msg[0] = (uint8_t)(id >> 8);
+    query->msg.msg[1] = (uint8_t)id;
+    query->attempts = 0;
+
+    return TINY_DNS_ERR_NONE;
+}
+
+static void track_query(struct tiny_dns_resolver *res, struct tiny_dns_resolver_query *query,
+                        uint64_t now, tiny_dns_resolver_cb cb, void *context) {
+    query->cb = cb;
+    query->context = context;
+
+    struct tiny_dns_resolver_query **bucket = bucket_of(res, query->id);
+    query->hash_next = *bucket;
+    *bucket = query;
+    timer_append(res, query, now);
+    query->active = true;
+    res->in_flight++;
+}
+
+tiny_dns_err tiny_dns_resolver_submit(struct tiny_dns_resolver *res,
+                                      struct tiny_dns_resolver_query *query, const char *name,
+                                      enum tiny_dns_rr_type qtype, tiny_dns_resolver_cb cb,
+                                      void *context) {
+    if (!res || !query || !cb || query->active) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    if (res->in_flight > UINT16_MAX) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    tiny_dns_err err = prepare_query(res, query, name, qtype);
+    if (!IS_ERR(err)) {
+        err = send_query(res, query);
+    }
+    if (IS_ERR(err)) {
+        return err;
+    }
+
+    track_query(res, query, now_ns(), cb, context);
+
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_resolver_submit_batch(struct tiny_dns_resolver *res,
+                                            struct tiny_dns_resolver_query *queries,
+                                            const char *const *names, size_t count,
+                                            enum tiny_dns_rr_type qtype, tiny_dns_resolver_cb cb,
+                                            void *const *contexts) {
+    if (!res || !queries || !names || !cb) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    if (count > (size_t)UINT16_MAX + 1 - res->in_flight) {
+        return TINY_DNS_ERR_NO_SPACE;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        if (queries[i].active) {
+            return TINY_DNS_ERR_INVALID;
+        }
+    }
+
+    // Each query is tracked as soon as it's prepared, so the next one can't pick the same ID
+    uint64_t now = now_ns();
+    for (size_t i = 0; i < count; i++) {
+        tiny_dns_err err = prepare_query(res, &queries[i], names[i], qtype);
+        if (IS_ERR(err)) {
+            while (i-- > 0) {
+                release(res, &queries[i]);
+            }
+            return err;
+        }
+
+        track_query(res, &queries[i], now, cb, contexts ? contexts[i] : NULL);
+    }
+
+    // What doesn't fit in the socket buffer now is due at once, so it goes out from the next call
+    // to tiny_dns_resolver_process without using up an attempt
+    struct tiny_dns_udp_msg msgs[TINY_DNS_UDP_BATCH_MAX];
+    size_t sent = 0;
+    while (sent < count) {
+        size_t batch = count - sent;
+        batch = batch < TINY_DNS_UDP_BATCH_MAX ? batch : TINY_DNS_UDP_BATCH_MAX;
+        for (size_t i = 0; i < batch; i++) {
+            msgs[i].data = queries[sent + i].msg.msg;
+            msgs[i].len = queries[sent + i].msg.len;
+            msgs[i].peer_len = 0;
+        }
+
+        int n = io_send(res, msgs, batch);
+        if (n < 0) {
+            for (size_t i = 0; i < count; i++) {
+                release(res, &queries[i]);
+            }
+            return TINY_DNS_ERR_IO;
+        }
+
+        for (int i = 0; i < n; i++) {
+            queries[sent + (size_t)i].attempts++;
+        }
+        res->stats.sent += (uint64_t)n;
+        sent += (size_t)n;
+
+        if ((size_t)n < batch) {
+            break;
+        }
+    }
+
+    for (size_t i = count; i-- > sent;) {
+        timer_remove(res, &queries[i]);
+        timer_prepend(res, &queries[i]);
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+void tiny_dns_resolver_cancel(struct tiny_dns_resolver *res,
+                              struct tiny_dns_resolver_query *query) {
+    if (query->active) {
+        release(res, query);
+    }
+}
+
+int tiny_dns_resolver_on_response(struct tiny_dns_resolver *res, const uint8_t *msg, size_t len) {
+    struct tiny_dns_resolver_query *query = NULL;
+    if (len >= DNS_HEADER_SIZE) {
+        query = lookup_id(res, (uint16_t)(msg[0] << 8 | msg[1]));
+    }
+
+    if (!query || !response_matches(query, msg, len)) {
+        res->stats.dropped++;
+        return 0;
+    }
+
+    release(res, query);
+    res->stats.answered++;
+    query->cb(query, TINY_DNS_ERR_NONE, msg, len, query->context);
+    return 1;
+}
+
+int tiny_dns_resolver_on_send_error(struct tiny_dns_resolver *res, uint16_t id) {
+    // Failed sends are reaped with the next responses, so the ID is still that of the query sent
+    struct tiny_dns_resolver_query *query = lookup_id(res, id);
+    if (!query) {
+        return 0;
+    }
+
+    release(res, query);
+    query->cb(query, TINY_DNS_ERR_IO, NULL, 0, query->context);
+    return 1;
+}
+
+static int process_responses(struct tiny_dns_resolver *res) {
+#ifdef TINY_DNS_HAVE_IO_URING
+    if (res->config.backend == TINY_DNS_RESOLVER_IO_URING) {
+        return tiny_dns_uring_process(res);
+    }
+#endif
+
+    struct tiny_dns_udp_msg msgs[TINY_DNS_RESOLVER_RECV_BATCH];
+    for (size_t i = 0; i < TINY_DNS_RESOLVER_RECV_BATCH; i++) {
+        msgs[i].data = res->rx[i];
+        msgs[i].capacity = sizeof(res->rx[i]);
+    }
+
+    int calls = 0;
+    for (int budget = TINY_DNS_RESOLVER_RECV_BUDGET; budget > 0;) {
+        int n = tiny_dns_udp_recv(res->fd, msgs, TINY_DNS_RESOLVER_RECV_BATCH);
+        if (n < 0) {
+            return n;
+        }
+
+        for (int i = 0; i < n; i++) {
+            calls += tiny_dns_resolver_on_response(res, msgs[i].data, msgs[i].len);
+        }
+
+        budget -= n;
+        if (n < TINY_DNS_RESOLVER_RECV_BATCH) {
+            break;
+        }
+    }
+
+    return calls;
+}
+
+// Retries are collected and sent in batches. What doesn't fit in the socket buffer is left to the
+// next timer, just like a lost datagram, but a hard error fails the queries that weren't sent.
+struct retry_batch {
+    struct tiny_dns_udp_msg msgs[TINY_DNS_UDP_BATCH_MAX];
+    struct tiny_dns_resolver_query *queries[TINY_DNS_UDP_BATCH_MAX];
+    size_t count;
+};
+
+// Returns the number of callbacks called
+static int retry_flush(struct tiny_dns_resolver *res, struct retry_batch *batch) {
+    if (batch->count == 0) {
+        return 0;
+    }
+
+    size_t count = batch->count;
+    batch->count = 0;
+    if (io_send(res, batch->msgs, count) >= 0) {
+        return 0;
+    }
+
+    // Released before any callback runs, since callbacks may cancel or resubmit the others
+    for (size_t i = 0; i < count; i++) {
+        release(res, batch->queries[i]);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        struct tiny_dns_resolver_query *query = batch->queries[i];
+        query->cb(query, TINY_DNS_ERR_IO, NULL, 0, query->context);
+    }
+
+    return (int)count;
+}
+
+static int process_timers(struct tiny_dns_resolver *res) {
+    uint64_t now = now_ns();
+    struct retry_batch batch;
+    batch.count = 0;
+
+    // Retried queries go to the back with a deadline past now, so this stops in time
+    int calls = 0;
+    while (res->timer_head && res->timer_head->deadline_ns <= now) {
+        struct tiny_dns_resolver_query *query = res->timer_head;
+
+        if (query->attempts < res->config.attempts) {
+            // Queries a batch submit couldn't send yet haven't had a first attempt
+            res->stats.retries += query->attempts > 0;
+            query->attempts++;
+            res->stats.sent++;
+            timer_remove(res, query);
+            timer_append(res, query, now);
+
+            struct tiny_dns_udp_msg *msg = &batch.msgs[batch.count];
+            msg->data = query->msg.msg;
+            msg->len = query->msg.len;
+            msg->peer_len = 0;
+            batch.queries[batch.count++] = query;
+            if (batch.count == TINY_DNS_UDP_BATCH_MAX) {
+                calls += retry_flush(res, &batch);
+            }
+            continue;
+        }
+
+        // The callback may cancel or resubmit queries whose messages are in the batch
+        calls += retry_flush(res, &batch);
+
+        release(res, query);
+        res->stats.timeouts++;
+        query->cb(query, TINY_DNS_ERR_TIMEOUT, NULL, 0, query->context);
+        calls++;
+    }
+
+    calls += retry_flush(res, &batch);
+
+    return calls;
+}
+
+int tiny_dns_resolver_process(struct tiny_dns_resolver *res) {
+    int answered = process_responses(res);
+    if (answered < 0) {
+        return answered;
+    }
+
+    return answered + process_timers(res);
+}
+
+int tiny_dns_resolver_poll(struct tiny_dns_resolver *res, int timeout_ms) {
+    int next = tiny_dns_resolver_timeout_ms(res);
+    if (next >= 0 && (timeout_ms < 0 || next < timeout_ms)) {
+        timeout_ms = next;
+    }
+
+#ifdef TINY_DNS_HAVE_IO_URING
+    if (res->config.backend == TINY_DNS_RESOLVER_IO_URING) {
+        if (IS_ERR(tiny_dns_uring_wait(res, timeout_ms))) {
+            return TINY_DNS_ERR_IO;
+        }
+        return tiny_dns_resolver_process(res);
+    }
+#endif
+
+    struct epoll_event ev;
+    int ready = epoll_wait(res->epoll_fd, &ev, 1, timeout_ms);
+    if (ready < 0 && errno != EINTR) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    return tiny_dns_resolver_process(res);
+}
+
+int tiny_dns_resolver_fd(const struct tiny_dns_resolver *res) {
+    return res->config.backend == TINY_DNS_RESOLVER_IO_URING ? res->uring.ring_fd : res->epoll_fd;
+}
+
+int tiny_dns_resolver_timeout_ms(const struct tiny_dns_resolver *res) {
+    if (!res->timer_head) {
+        return -1;
+    }
+
+    uint64_t now = now_ns();
+    uint64_t deadline = res->timer_head->deadline_ns;
+    if (deadline <= now) {
+        return 0;
+    }
+
+    uint64_t ms = (deadline - now + 999999) / 1000000;
+    return ms > INT32_MAX ? INT32_MAX : (int)ms;
+}
+
+size_t tiny_dns_resolver_in_flight(const struct tiny_dns_resolver *res) {
+    return res->in_flight;
+}
@@ -0,0 +1,255 @@
+/// @file resolver.h
+/// @brief Asynchronous stub resolver over non-blocking UDP, driven by epoll
+///
+/// Built on top of the library, but kept out of it: the library makes no assumptions about the
+/// networking stack, this module is one way of driving it on Linux. Nothing is allocated; the
+/// caller provides a slot per outstanding query and the table used to match responses.
+
+#ifndef TINY_DNS_RESOLVER_H
+#define TINY_DNS_RESOLVER_H
+
+#include <netinet/in.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "tiny_dns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Largest response accepted. Anything longer is truncated by the kernel and then dropped.
+#define TINY_DNS_RESOLVER_MSG_MAX 4096
+
+/// Responses read per call to tiny_dns_resolver_process, so timers get their turn under load
+#define TINY_DNS_RESOLVER_RECV_BUDGET 1024
+
+/// Responses read per system call. Each needs a receive buffer of TINY_DNS_RESOLVER_MSG_MAX
+/// bytes in struct tiny_dns_resolver.
+#ifndef TINY_DNS_RESOLVER_RECV_BATCH
+    #define TINY_DNS_RESOLVER_RECV_BATCH 16
+#endif
+
+struct tiny_dns_resolver_query;
+
+/// @brief Called once per submitted query, when it's answered, times out or fails
+///     The query slot is released before the call, so it may be submitted again right away.
+///
+/// @param query Slot the query was submitted with
+/// @param err TINY_DNS_ERR_NONE with a response, TINY_DNS_ERR_TIMEOUT once every attempt went
+///     unanswered, TINY_DNS_ERR_IO if sending failed outright after submission
+/// @param response The response, only valid during the call. NULL unless \p err is
+///     TINY_DNS_ERR_NONE. Its rcode and TC bit are the caller's to check.
+/// @param len Length of \p response in bytes
+/// @param context As passed to tiny_dns_resolver_submit
+typedef void (*tiny_dns_resolver_cb)(struct tiny_dns_resolver_query *query, tiny_dns_err err,
+                                     const uint8_t *response, size_t len, void *context);
+
+/// @brief Caller owned state of one outstanding query
+///     Must stay put from tiny_dns_resolver_submit until its callback runs or it's cancelled.
+///     Members are private.
+struct tiny_dns_resolver_query {
+    // Prepared query, with the ID of this submission rendered into it
+    struct tiny_dns_query_template msg;
+    uint16_t id;
+    uint8_t attempts;
+    bool active;
+    uint64_t deadline_ns;
+    struct tiny_dns_resolver_query *hash_next;
+    struct tiny_dns_resolver_query *timer_prev;
+    struct tiny_dns_resolver_query *timer_next;
+    tiny_dns_resolver_cb cb;
+    void *context;
+};
+
+enum tiny_dns_resolver_backend {
+    /// epoll and recvmmsg, always available
+    TINY_DNS_RESOLVER_EPOLL = 0,
+    /// io_uring, receiving with multishot recv straight into a buffer ring registered with the
+    /// kernel. Needs a build with TINY_DNS_IO_URING and Linux 6.0 or later. Sends complete
+    /// asynchronously, so one that fails is reported to its callback rather than by the submit.
+    /// Like the epoll backend it only speaks UDP; there is no TCP fallback for truncated answers.
+    TINY_DNS_RESOLVER_IO_URING = 1,
+};
+
+struct tiny_dns_resolver_config {
+    /// Upstream nameserver, IPv4 or IPv6
+    struct sockaddr_storage server;
+    socklen_t server_len;
+    /// Time to wait for an answer before sending again, per attempt
+    uint32_t timeout_ms;
+    /// Sends per query before giving up, at least 1
+    uint8_t attempts;
+    /// Socket receive buffer size, 0 for the system default. Each queued datagram costs about
+    /// 1KB of it whatever its size, so thousands of outstanding queries need more than the default.
+    int rcvbuf;
+    /// How sockets are driven
+    enum tiny_dns_resolver_backend backend;
+};
+
+struct tiny_dns_resolver_stats {
+    uint64_t sent;
+    uint64_t retries;
+    uint64_t timeouts;
+    uint64_t answered;
+    /// Datagrams that matched no outstanding query by ID and question
+    uint64_t dropped;
+};
+
+// State of the io_uring backend, unused otherwise. Declared whether or not the backend is built,
+// so the layout of struct tiny_dns_resolver doesn't depend on build options.
+struct tiny_dns_resolver_uring {
+    int ring_fd;
+    void *sq_ring;
+    size_t sq_ring_len;
+    void *cq_ring;
+    size_t cq_ring_len;
+    void *sqes;
+    size_t sqes_len;
+    uint32_t *sq_head;
+    uint32_t *sq_tail;
+    uint32_t *sq_array;
+    uint32_t sq_mask;
+    uint32_t sq_entries;
+    uint32_t sq_pending;
+    uint32_t *cq_head;
+    uint32_t *cq_tail;
+    uint32_t cq_mask;
+    void *cqes;
+    uint8_t sqe_flags;
+    bool recv_armed;
+    // Ring of receive buffers shared with the kernel, followed by the buffers themselves
+    void *buf_ring;
+    size_t buf_ring_len;
+    uint8_t *bufs;
+    uint16_t buf_tail;
+};
+
+struct tiny_dns_resolver {
+    int epoll_fd;
+    int fd;
+    struct tiny_dns_resolver_config config;
+
+    // Outstanding queries by ID, chained through hash_next
+    struct tiny_dns_resolver_query **buckets;
+    size_t bucket_mask;
+    size_t in_flight;
+
+    // Every attempt waits equally long, so deadlines expire in the order they were set and a
+    // FIFO is all the timer queue needs to be
+    struct tiny_dns_resolver_query *timer_head;
+    struct tiny_dns_resolver_query *timer_tail;
+
+    uint64_t rng;
+    struct tiny_dns_resolver_stats stats;
+    struct tiny_dns_resolver_uring uring;
+    // Receive buffers of the epoll backend
+    uint8_t rx[TINY_DNS_RESOLVER_RECV_BATCH][TINY_DNS_RESOLVER_MSG_MAX];
+};
+
+/// @brief Open a socket connected to the configured nameserver and set up the backend
+///     Connecting means the kernel discards datagrams from any other source. The io_uring
+///     backend maps its rings and receive buffers here, the only memory not provided by the
+///     caller.
+///
+/// @param res Pointer to uninitialized resolver
+/// @param config Nameserver and retry policy, copied
+/// @param buckets Caller's array for matching responses to queries. Must outlive \p res.
+/// @param bucket_count Entries in \p buckets, a power of two. About the number of queries
+///     expected to be outstanding at once is a good size.
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID for a bad config or bucket count
+/// @return TINY_DNS_ERR_UNSUPPORTED if the backend isn't built in or the kernel lacks it
+/// @return TINY_DNS_ERR_IO if the socket or epoll instance couldn't be set up
+tiny_dns_err tiny_dns_resolver_init(struct tiny_dns_resolver *res,
+                                    const struct tiny_dns_resolver_config *config,
+                                    struct tiny_dns_resolver_query **buckets, size_t bucket_count);
+
+/// @brief Close the socket and release the backend
+///     Outstanding queries are abandoned without their callbacks being called.
+void tiny_dns_resolver_close(struct tiny_dns_resolver *res);
+
+/// @brief Send a query for \p name and track it until it's answered or times out
+///
+/// @param res Resolver in question
+/// @param query Caller's slot for the query, which must not be outstanding already
+/// @param name Name to resolve
+/// @param qtype Record type to request
+/// @param cb Called with the outcome, from tiny_dns_resolver_process
+/// @param context Passed through to \p cb
+///
+/// @return TINY_DNS_ERR_NONE if the query is outstanding. Failing to send is retried like a lost
+///     datagram, unless the socket reports a hard error.
+/// @return TINY_DNS_ERR_INVALID for NULL parameters or an invalid name
+/// @return TINY_DNS_ERR_NO_SPACE if all 65536 IDs are in use
+/// @return TINY_DNS_ERR_IO if sending failed outright, with the epoll backend
+tiny_dns_err tiny_dns_resolver_submit(struct tiny_dns_resolver *res,
+                                      struct tiny_dns_resolver_query *query, const char *name,
+                                      enum tiny_dns_rr_type qtype, tiny_dns_resolver_cb cb,
+                                      void *context);
+
+/// @brief Submit \p count queries at once, sent with as few system calls as possible
+///     Either every query is submitted or none is. Queries that don't fit in the socket buffer
+///     are sent from the next \a tiny_dns_resolver_process, which \a tiny_dns_resolver_timeout_ms
+///     reports as due.
+///
+/// @param res Resolver in question
+/// @param queries Caller's slots, one per name, none of them outstanding
+/// @param names Names to resolve
+/// @param count Entries in \p queries and \p names
+/// @param qtype Record type to request for every name
+/// @param cb Called with the outcome of each query
+/// @param contexts Passed through to \p cb, one per query. May be NULL to pass NULL to all.
+///
+/// @return TINY_DNS_ERR_NONE if the queries are outstanding
+/// @return TINY_DNS_ERR_INVALID for NULL parameters, a slot already outstanding or an invalid name
+/// @return TINY_DNS_ERR_NO_SPACE if there aren't enough free IDs
+/// @return TINY_DNS_ERR_IO if sending failed outright, with the epoll backend
+tiny_dns_err tiny_dns_resolver_submit_batch(struct tiny_dns_resolver *res,
+                                            struct tiny_dns_resolver_query *queries,
+                                            const char *const *names, size_t count,
+                                            enum tiny_dns_rr_type qtype, tiny_dns_resolver_cb cb,
+                                            void *const *contexts);
+
+/// @brief Forget an outstanding query without calling its callback
+///     A late response to it is dropped. Does nothing if \p query isn't outstanding.
+void tiny_dns_resolver_cancel(struct tiny_dns_resolver *res, struct tiny_dns_resolver_query *query);
+
+/// @brief Read whatever responses are pending and handle expired timers, without blocking
+///     Use this when \a tiny_dns_resolver_fd is part of the caller's own event loop.
+///
+/// @return Number of callbacks called
+/// @return TINY_DNS_ERR_IO if reading from the socket failed
+int tiny_dns_resolver_process(struct tiny_dns_resolver *res);
+
+/// @brief Wait up to \p timeout_ms for responses or the next timer, then process them
+///
+/// @param res Resolver in question
+/// @param timeout_ms Longest time to block, -1 to wait until something happens
+///
+/// @return Number of callbacks called, 0 if nothing happened in time
+/// @return TINY_DNS_ERR_IO if waiting or reading failed
+int tiny_dns_resolver_poll(struct tiny_dns_resolver *res, int timeout_ms);
+
+/// @brief Readable whenever the resolver has work; for nesting in another poll or epoll set
+///     This is the epoll instance, or the ring itself with the io_uring backend. The ring's
+///     completions are posted as task work of the thread that set it up, which interrupts a wait
+///     in that thread: expect EINTR before the ring turns readable, and wait again.
+int tiny_dns_resolver_fd(const struct tiny_dns_resolver *res);
+
+/// @brief Milliseconds until the next timer expires, rounded up
+///
+/// @return Time to the next deadline, 0 if one is due, -1 with nothing outstanding
+int tiny_dns_resolver_timeout_ms(const struct tiny_dns_resolver *res);
+
+/// @brief Number of queries outstanding
+size_t tiny_dns_resolver_in_flight(const struct tiny_dns_resolver *res);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TINY_DNS_RESOLVER_H
@@ -0,0 +1,75 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shm_cache.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+// Map @fd, sizing it first if it's new, and set up or attach to the cache in it. Called with the
+// file locked, so nobody else is laying it out meanwhile.
+static tiny_dns_err map_locked(struct tiny_dns_shm_cache *shm, int fd, size_t size,
+                               size_t shard_count) {
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    if (st.st_size == 0) {
+        if (ftruncate(fd, (off_t)size) != 0) {
+            return TINY_DNS_ERR_IO;
+        }
+    } else {
+        size = (size_t)st.st_size;
+    }
+
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    // A new file reads as zeroes, and so does one whose creator died before finishing the layout
+    tiny_dns_err err = tiny_dns_shard_cache_attach(&shm->cache, mem, size);
+    if (err == TINY_DNS_ERR_NOT_FOUND) {
+        err = tiny_dns_shard_cache_init(&shm->cache, mem, size, shard_count);
+    }
+    if (IS_ERR(err)) {
+        munmap(mem, size);
+        return err;
+    }
+
+    shm->mem = mem;
+    shm->size = size;
+    return TINY_DNS_ERR_NONE;
+}
+
+tiny_dns_err tiny_dns_shm_cache_open(struct tiny_dns_shm_cache *shm, const char *path, size_t size,
+                                     size_t shard_count) {
+    if (!shm || !path || size == 0) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    tiny_dns_err err = TINY_DNS_ERR_IO;
+    if (flock(fd, LOCK_EX) == 0) {
+        err = map_locked(shm, fd, size, shard_count);
+        flock(fd, LOCK_UN);
+    }
+
+    // The mapping keeps the file alive
+    close(fd);
+    return err;
+}
+
+void tiny_dns_shm_cache_close(struct tiny_dns_shm_cache *shm) {
+    if (shm->mem) {
+        munmap(shm->mem, shm->size);
+        shm->mem = NULL;
+    }
+}
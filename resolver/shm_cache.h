@@ -0,0 +1,53 @@
+/// @file shm_cache.h
+/// @brief A sharded response cache in a file mapped by every process on the host
+///
+/// Pre-forked workers each resolving the same names multiply upstream queries by the number of
+/// workers. Mapping one struct tiny_dns_shard_cache from a shared file instead lets any worker
+/// answer from what another already resolved. The cache addresses everything by index, so each
+/// process can map it wherever it likes, and lookups stay lock free across processes.
+///
+/// The path can be a regular file or one under /dev/shm to keep it out of the page cache
+/// writeback. Workers forked after the parent opens the cache share its mapping as is.
+
+#ifndef TINY_DNS_SHM_CACHE_H
+#define TINY_DNS_SHM_CACHE_H
+
+#include <stddef.h>
+
+#include "tiny_dns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct tiny_dns_shm_cache {
+    struct tiny_dns_shard_cache cache;
+    void *mem;
+    size_t size;
+};
+
+/// @brief Map the cache at \p path, creating it if no process has yet
+///     Creation is serialized with an exclusive flock on the file, so workers racing to open it
+///     end up sharing one cache. A file that already holds a cache keeps its own size and shard
+///     count, and \p size and \p shard_count are ignored.
+///
+/// @param shm Handle to set up
+/// @param path File to map
+/// @param size Size to create the file with, in bytes
+/// @param shard_count Shards to create the cache with, see \a tiny_dns_shard_cache_init
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_IO if the file can't be opened, sized or mapped
+/// @return TINY_DNS_ERR_UNSUPPORTED if the file holds something other than a compatible cache
+/// @return Anything \a tiny_dns_shard_cache_init or \a tiny_dns_shard_cache_attach may return
+tiny_dns_err tiny_dns_shm_cache_open(struct tiny_dns_shm_cache *shm, const char *path, size_t size,
+                                     size_t shard_count);
+
+/// @brief Unmap the cache. The file and its contents stay for other processes.
+void tiny_dns_shm_cache_close(struct tiny_dns_shm_cache *shm);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TINY_DNS_SHM_CACHE_H
@@ -0,0 +1,104 @@
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "snapshot.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+// Write the snapshot through a shared mapping of @fd, so it isn't staged in memory first
+static tiny_dns_err write_snapshot(const struct tiny_dns_cache *cache, int fd, uint64_t now,
+                                   uint64_t wall) {
+    size_t size = tiny_dns_cache_snapshot_size(cache);
+    if (ftruncate(fd, (off_t)size) != 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    tiny_dns_err err = tiny_dns_cache_snapshot(cache, now, wall, mem, size);
+    if (!IS_ERR(err) && msync(mem, size, MS_SYNC) != 0) {
+        err = TINY_DNS_ERR_IO;
+    }
+
+    munmap(mem, size);
+    return err;
+}
+
+tiny_dns_err tiny_dns_cache_save_file(const struct tiny_dns_cache *cache, const char *path,
+                                      uint64_t now, uint64_t wall) {
+    if (!cache || !path) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    char tmp[PATH_MAX];
+    int n = snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    if (n < 0 || (size_t)n >= sizeof(tmp)) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    int fd = open(tmp, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    tiny_dns_err err = write_snapshot(cache, fd, now, wall);
+    close(fd);
+    if (!IS_ERR(err) && rename(tmp, path) != 0) {
+        err = TINY_DNS_ERR_IO;
+    }
+    if (IS_ERR(err)) {
+        unlink(tmp);
+    }
+
+    return err;
+}
+
+tiny_dns_err tiny_dns_cache_open_file(struct tiny_dns_cache_file *file, const char *path,
+                                      uint64_t now, uint64_t wall) {
+    if (!file || !path) {
+        return TINY_DNS_ERR_INVALID;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        close(fd);
+        return TINY_DNS_ERR_IO;
+    }
+
+    // Private and writable: the cache works in place, and only the pages it changes get copied
+    size_t size = (size_t)st.st_size;
+    void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mem == MAP_FAILED) {
+        return TINY_DNS_ERR_IO;
+    }
+
+    tiny_dns_err err = tiny_dns_cache_restore(&file->cache, mem, size, now, wall);
+    if (IS_ERR(err)) {
+        munmap(mem, size);
+        return err;
+    }
+
+    file->mem = mem;
+    file->size = size;
+    return TINY_DNS_ERR_NONE;
+}
+
+void tiny_dns_cache_close_file(struct tiny_dns_cache_file *file) {
+    if (file->mem) {
+        munmap(file->mem, file->size);
+        file->mem = NULL;
+    }
+}
@@ -0,0 +1,65 @@
+/// @file snapshot.h
+/// @brief Cache snapshots in files, for starting warm after a restart
+///
+/// A process that starts with an empty cache pays the full upstream round trip for every name it
+/// looks up first. Saving a snapshot on the way down and mapping it on the way up lets it answer
+/// from the previous run's cache instead, for whatever TTL the entries have left. Restoring only
+/// checks the snapshot's header and rebases expiry times, and chains are checked as they're
+/// walked; the file is mapped privately, so pages are read in as they're touched.
+
+#ifndef TINY_DNS_SNAPSHOT_H
+#define TINY_DNS_SNAPSHOT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "tiny_dns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// @brief A cache restored from a snapshot file, backed by a private mapping of it
+struct tiny_dns_cache_file {
+    struct tiny_dns_cache cache;
+    void *mem;
+    size_t size;
+};
+
+/// @brief Write a snapshot of \p cache to \p path
+///     The snapshot is written next to \p path and renamed over it, so a reader never sees a
+///     partial one.
+///
+/// @param cache Cache to save
+/// @param path File to write
+/// @param now Current time on the clock the cache is used with
+/// @param wall Current time in seconds on a clock that keeps counting across restarts
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_INVALID if parameters are NULL or \p path is too long
+/// @return TINY_DNS_ERR_IO if the file can't be written
+tiny_dns_err tiny_dns_cache_save_file(const struct tiny_dns_cache *cache, const char *path,
+                                      uint64_t now, uint64_t wall);
+
+/// @brief Map the snapshot at \p path and restore the cache from it
+///     The cache is private to the caller: changes to it aren't written back to the file.
+///
+/// @param file Handle to set up
+/// @param path Snapshot written by \a tiny_dns_cache_save_file
+/// @param now Current time on the clock the cache will be used with
+/// @param wall Current time on the clock the snapshot was saved with as \p wall
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return TINY_DNS_ERR_IO if the file can't be opened or mapped
+/// @return Anything \a tiny_dns_cache_restore may return
+tiny_dns_err tiny_dns_cache_open_file(struct tiny_dns_cache_file *file, const char *path,
+                                      uint64_t now, uint64_t wall);
+
+/// @brief Unmap the cache
+void tiny_dns_cache_close_file(struct tiny_dns_cache_file *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TINY_DNS_SNAPSHOT_H
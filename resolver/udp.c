@@ -0,0 +1,121 @@
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "udp.h"
+
+#define IS_ERR(_e) (_e < TINY_DNS_ERR_NONE)
+
+int tiny_dns_udp_send(int fd, struct tiny_dns_udp_msg *msgs, size_t count) {
+    struct mmsghdr hdrs[TINY_DNS_UDP_BATCH_MAX];
+    struct iovec iovs[TINY_DNS_UDP_BATCH_MAX];
+
+    size_t sent = 0;
+    while (sent < count) {
+        size_t batch = count - sent;
+        batch = batch < TINY_DNS_UDP_BATCH_MAX ? batch : TINY_DNS_UDP_BATCH_MAX;
+        for (size_t i = 0; i < batch; i++) {
+            struct tiny_dns_udp_msg *msg = &msgs[sent + i];
+            iovs[i].iov_base = msg->data;
+            iovs[i].iov_len = msg->len;
+            memset(&hdrs[i], 0, sizeof(hdrs[i]));
+            hdrs[i].msg_hdr.msg_iov = &iovs[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+            if (msg->peer_len > 0) {
+                hdrs[i].msg_hdr.msg_name = &msg->peer;
+                hdrs[i].msg_hdr.msg_namelen = msg->peer_len;
+            }
+        }
+
+        int n = sendmmsg(fd, hdrs, (unsigned int)batch, 0);
+        if (n < 0) {
+            // ECONNREFUSED reports an ICMP error for an earlier datagram, nothing was sent
+            if (errno == EINTR || errno == ECONNREFUSED) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || sent > 0) {
+                break;
+            }
+            return TINY_DNS_ERR_IO;
+        }
+
+        sent += (size_t)n;
+        if ((size_t)n < batch) {
+            break;
+        }
+    }
+
+    return (int)sent;
+}
+
+int tiny_dns_udp_recv(int fd, struct tiny_dns_udp_msg *msgs, size_t count) {
+    struct mmsghdr hdrs[TINY_DNS_UDP_BATCH_MAX];
+    struct iovec iovs[TINY_DNS_UDP_BATCH_MAX];
+
+    size_t received = 0;
+    while (received < count) {
+        size_t want = count - received;
+        size_t batch = want < TINY_DNS_UDP_BATCH_MAX ? want : TINY_DNS_UDP_BATCH_MAX;
+        for (size_t i = 0; i < batch; i++) {
+            struct tiny_dns_udp_msg *msg = &msgs[received + i];
+            iovs[i].iov_base = msg->data;
+            iovs[i].iov_len = msg->capacity;
+            memset(&hdrs[i], 0, sizeof(hdrs[i]));
+            hdrs[i].msg_hdr.msg_iov = &iovs[i];
+            hdrs[i].msg_hdr.msg_iovlen = 1;
+            hdrs[i].msg_hdr.msg_name = &msg->peer;
+            hdrs[i].msg_hdr.msg_namelen = sizeof(msg->peer);
+        }
+
+        int n = recvmmsg(fd, hdrs, (unsigned int)batch, MSG_DONTWAIT, NULL);
+        if (n < 0) {
+            if (errno == EINTR || errno == ECONNREFUSED) {
+                continue;
+            } else if (errno == EAGAIN || errno == EWOULDBLOCK || received > 0) {
+                break;
+            }
+            return TINY_DNS_ERR_IO;
+        }
+
+        for (int i = 0; i < n; i++) {
+            struct tiny_dns_udp_msg *msg = &msgs[received + (size_t)i];
+            // A truncated message can't be parsed, so it's dropped
+            bool truncated = hdrs[i].msg_hdr.msg_flags & MSG_TRUNC;
+            msg->len = truncated ? 0 : hdrs[i].msg_len;
+            msg->peer_len = hdrs[i].msg_hdr.msg_namelen;
+        }
+
+        received += (size_t)n;
+        if ((size_t)n < batch) {
+            break;
+        }
+    }
+
+    return (int)received;
+}
+
+tiny_dns_err tiny_dns_udp_build_queries(struct tiny_dns_udp_msg *msgs, const char *const *names,
+                                        size_t count, uint16_t first_id,
+                                        enum tiny_dns_rr_type qtype) {
+    for (size_t i = 0; i < count; i++) {
+        size_t len = msgs[i].capacity;
+        tiny_dns_err err = tiny_dns_build_query(msgs[i].data, &len, (uint16_t)(first_id + i),
+                                                names[i], qtype);
+        if (IS_ERR(err)) {
+            return err;
+        }
+        msgs[i].len = len;
+    }
+
+    return TINY_DNS_ERR_NONE;
+}
+
+size_t tiny_dns_udp_parse_responses(struct tiny_dns_udp_msg *msgs, struct tiny_dns_iter *iters,
+                                    tiny_dns_err *errs, size_t count) {
+    size_t ok = 0;
+    for (size_t i = 0; i < count; i++) {
+        errs[i] = tiny_dns_iter_init(&iters[i], msgs[i].data, msgs[i].len);
+        ok += errs[i] == TINY_DNS_ERR_NONE;
+    }
+
+    return ok;
+}
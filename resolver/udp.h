@@ -0,0 +1,90 @@
+/// @file udp.h
+/// @brief Batched UDP transport: whole vectors of DNS messages per system call
+///
+/// One sendmmsg or recvmmsg moves up to TINY_DNS_UDP_BATCH_MAX datagrams, so the per packet cost
+/// of a system call is shared across the batch. The build and parse helpers work on the same
+/// vectors, so a batch goes from names to the wire and from the wire to iterators in one loop.
+
+#ifndef TINY_DNS_UDP_H
+#define TINY_DNS_UDP_H
+
+#include <netinet/in.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include "tiny_dns.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Datagrams handed to the kernel per system call. Longer vectors are split.
+#define TINY_DNS_UDP_BATCH_MAX 64
+
+/// @brief One datagram of a batch
+struct tiny_dns_udp_msg {
+    /// Message to send, or where to receive one
+    uint8_t *data;
+    /// Length of the message in \p data
+    size_t len;
+    /// Size of \p data, for receiving and building
+    size_t capacity;
+    /// Destination to send to, or the source received from. Ignored when sending on a connected
+    /// socket if \p peer_len is 0.
+    struct sockaddr_storage peer;
+    socklen_t peer_len;
+};
+
+/// @brief Send \p count messages with as few system calls as possible
+///
+/// @param fd UDP socket, usually non-blocking
+/// @param msgs Messages to send
+/// @param count Entries in \p msgs
+///
+/// @return Number of messages sent, from the front of \p msgs. Less than \p count if the socket
+///     buffer filled up.
+/// @return TINY_DNS_ERR_IO if the first send failed for any other reason
+int tiny_dns_udp_send(int fd, struct tiny_dns_udp_msg *msgs, size_t count);
+
+/// @brief Receive up to \p count messages with as few system calls as possible, without blocking
+///     Messages longer than their buffer are returned with len 0 rather than truncated.
+///
+/// @param fd UDP socket
+/// @param msgs Buffers to receive into. data and capacity must be set, len and peer are filled in.
+/// @param count Entries in \p msgs
+///
+/// @return Number of messages received, 0 if none were pending
+/// @return TINY_DNS_ERR_IO if receiving failed
+int tiny_dns_udp_recv(int fd, struct tiny_dns_udp_msg *msgs, size_t count);
+
+/// @brief Build one query per name with \a tiny_dns_build_query, into the buffers of \p msgs
+///
+/// @param msgs Destination messages, data and capacity must be set. len is filled in.
+/// @param names Name to query in each message
+/// @param count Entries in \p msgs and \p names
+/// @param first_id ID of the first query, incremented for each following one
+/// @param qtype Record type to request
+///
+/// @return TINY_DNS_ERR_NONE on success
+/// @return The error of the first query that couldn't be built
+tiny_dns_err tiny_dns_udp_build_queries(struct tiny_dns_udp_msg *msgs, const char *const *names,
+                                        size_t count, uint16_t first_id,
+                                        enum tiny_dns_rr_type qtype);
+
+/// @brief Start an iterator over each of \p count responses with \a tiny_dns_iter_init
+///
+/// @param msgs Received messages. Must outlive \p iters.
+/// @param iters Caller's array of iterators, one per message
+/// @param errs Caller's array, set to the result of tiny_dns_iter_init for each message
+/// @param count Entries in \p msgs, \p iters and \p errs
+///
+/// @return Number of messages that parsed without error
+size_t tiny_dns_udp_parse_responses(struct tiny_dns_udp_msg *msgs, struct tiny_dns_iter *iters,
+                                    tiny_dns_err *errs, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // TINY_DNS_UDP_H
@@ -0,0 +1,218 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "tiny_dns.h"
+
+// Answers: CNAME, A, TXT. Authority: unknown type with rdata. Additional: SRV.
+static std::string make_response() {
+    std::string msg("\x12\x34\x81\x80\x00\x01\x00\x03\x00\x01\x00\x01", 12);
+    msg.append("\x03www\x07"
+               "example\x03"
+               "com",
+               16);
+    msg.push_back('\0');
+    msg.append("\x00\x01\x00\x01", 4);
+    // www.example.com CNAME cdn.example.com, target at offset 45
+    msg.append("\xC0\x0C\x00\x05\x00\x01\x00\x00\x01\x2C\x00\x06\x03"
+               "cdn\xC0\x10",
+               18);
+    msg.append("\xC0\x2D\x00\x01\x00\x01\x00\x00\x00\x3C\x00\x04\xC0\x00\x02\x01", 16);
+    msg.append("\xC0\x2D\x00\x10\x00\x01\x00\x00\x00\x3C\x00\x06\x05hello", 18);
+    msg.append("\xC0\x10\x00\x63\x00\x01\x00\x00\x00\x3C\x00\x03\x01\x02\x03", 15);
+    msg.append("\xC0\x10\x00\x21\x00\x01\x00\x00\x00\x3C\x00\x0A\x00\x0A\x00\x05\x1F\x90\x01"
+               "a\xC0\x10",
+               22);
+    return msg;
+}
+
+TEST(Arena, yield) {
+    std::string msg = make_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    char mem[256];
+    struct tiny_dns_arena arena;
+    tiny_dns_arena_init(&arena, mem, sizeof(mem));
+
+    struct tiny_dns_rr_arena rr;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    ASSERT_EQ(SECTION_ANSWER, rr.section);
+    ASSERT_EQ(RR_TYPE_CNAME, rr.atype);
+    ASSERT_STREQ("www.example.com", rr.name.name);
+    ASSERT_EQ(15, rr.name.len);
+    ASSERT_STREQ("cdn.example.com", rr.rdata.rr_cname.name);
+    ASSERT_EQ(15, rr.rdata.rr_cname.len);
+    // Names are packed back to back, without any reservation
+    ASSERT_EQ(mem, rr.name.name);
+    ASSERT_EQ(mem + 16, rr.rdata.rr_cname.name);
+    ASSERT_EQ(32, arena.len);
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    ASSERT_EQ(RR_TYPE_A, rr.atype);
+    ASSERT_STREQ("cdn.example.com", rr.name.name);
+    ASSERT_EQ(0, memcmp(rr.rdata.rr_a, "\xC0\x00\x02\x01", 4));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    ASSERT_EQ(RR_TYPE_TXT, rr.atype);
+    ASSERT_EQ(5, rr.rdata.rr_txt.len);
+    ASSERT_EQ(0, memcmp("hello", rr.rdata.rr_txt.txt, 5));
+    ASSERT_GE(rr.rdata.rr_txt.txt, mem);
+    ASSERT_LT(rr.rdata.rr_txt.txt, mem + sizeof(mem));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    ASSERT_EQ(SECTION_AUTHORITY, rr.section);
+    ASSERT_STREQ("example.com", rr.name.name);
+    ASSERT_EQ(3, rr.rdata.unknown.len);
+    ASSERT_EQ(0, memcmp("\x01\x02\x03", rr.rdata.unknown.data, 3));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    ASSERT_EQ(SECTION_ADDITIONAL, rr.section);
+    ASSERT_EQ(8080, rr.rdata.rr_srv.port);
+    ASSERT_STREQ("a.example.com", rr.rdata.rr_srv.target.name);
+
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+}
+
+TEST(Arena, no_space_retry) {
+    std::string msg = make_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    // Room for the owner, but not for the CNAME target
+    char mem[24];
+    struct tiny_dns_arena arena;
+    tiny_dns_arena_init(&arena, mem, sizeof(mem));
+
+    struct tiny_dns_rr_arena rr;
+    ASSERT_EQ(TINY_DNS_ERR_NO_SPACE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    ASSERT_EQ(0, arena.len);
+
+    // Nothing was consumed, so the same record comes out of a bigger arena
+    char bigger[64];
+    tiny_dns_arena_init(&arena, bigger, sizeof(bigger));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    ASSERT_EQ(RR_TYPE_CNAME, rr.atype);
+    ASSERT_STREQ("cdn.example.com", rr.rdata.rr_cname.name);
+
+    // After a reset, the arena is reused from the start
+    tiny_dns_arena_reset(&arena);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    ASSERT_EQ(bigger, rr.name.name);
+}
+
+TEST(Arena, materialize) {
+    std::string msg = make_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    alignas(8) char mem[1024];
+    struct tiny_dns_arena arena;
+    tiny_dns_arena_init(&arena, mem, sizeof(mem));
+
+    struct tiny_dns_rr_arena *records;
+    size_t count;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_materialize(&iter, &arena, &records, &count));
+    ASSERT_EQ(5, count);
+
+    // The message is no longer needed
+    msg.assign(msg.size(), '\0');
+
+    ASSERT_EQ(reinterpret_cast<void *>(mem), records);
+    ASSERT_STREQ("www.example.com", records[0].name.name);
+    ASSERT_STREQ("cdn.example.com", records[0].rdata.rr_cname.name);
+    ASSERT_EQ(RR_TYPE_A, records[1].atype);
+    ASSERT_EQ(0, memcmp("hello", records[2].rdata.rr_txt.txt, 5));
+    ASSERT_EQ(SECTION_AUTHORITY, records[3].section);
+    ASSERT_STREQ("a.example.com", records[4].rdata.rr_srv.target.name);
+}
+
+TEST(Arena, materialize_too_small) {
+    std::string msg = make_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    alignas(8) char mem[128];
+    struct tiny_dns_arena arena;
+    tiny_dns_arena_init(&arena, mem, sizeof(mem));
+
+    struct tiny_dns_rr_arena *records;
+    size_t count;
+    ASSERT_EQ(TINY_DNS_ERR_NO_SPACE, tiny_dns_iter_materialize(&iter, &arena, &records, &count));
+    ASSERT_EQ(0, arena.len);
+}
+
+TEST(Arena, materialize_inflated_counts) {
+    // The header claims 65535 answers, but the message holds one
+    std::string msg = make_response();
+    msg[6] = '\xFF';
+    msg[7] = '\xFF';
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    alignas(8) char mem[1024];
+    struct tiny_dns_arena arena;
+    tiny_dns_arena_init(&arena, mem, sizeof(mem));
+
+    struct tiny_dns_rr_arena *records;
+    size_t count;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_materialize(&iter, &arena, &records, &count));
+    ASSERT_EQ(5, count);
+}
+
+TEST(Arena, materialize_truncated) {
+    // The message ends inside the SRV record's rdata, then inside its fixed fields
+    std::string full = make_response();
+    for (size_t cut : { (size_t)2, (size_t)20 }) {
+        std::string msg = full.substr(0, full.size() - cut);
+
+        struct tiny_dns_iter iter;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+        alignas(8) char mem[1024];
+        struct tiny_dns_arena arena;
+        tiny_dns_arena_init(&arena, mem, sizeof(mem));
+
+        // A record cut short is malformed, not the end of the records
+        struct tiny_dns_rr_arena *records;
+        size_t count;
+        ASSERT_EQ(TINY_DNS_ERR_INVALID,
+                  tiny_dns_iter_materialize(&iter, &arena, &records, &count));
+        ASSERT_EQ(0, arena.len);
+
+        struct tiny_dns_rr_arena rr;
+        for (int i = 0; i < 4; i++) {
+            ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+        }
+        ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_iter_yield_arena(&iter, &arena, &rr));
+    }
+}
+
+TEST(Arena, materialize_retry) {
+    std::string msg = make_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    // Room for the records and the CNAME's two names, so the arena fills up at the A record
+    alignas(8) char mem[1024];
+    struct tiny_dns_arena arena;
+    tiny_dns_arena_init(&arena, mem, 5 * sizeof(struct tiny_dns_rr_arena) + 40);
+
+    struct tiny_dns_rr_arena *records;
+    size_t count;
+    ASSERT_EQ(TINY_DNS_ERR_NO_SPACE, tiny_dns_iter_materialize(&iter, &arena, &records, &count));
+    ASSERT_EQ(0, arena.len);
+
+    // Nothing was consumed, so a larger arena gets every record
+    tiny_dns_arena_init(&arena, mem, sizeof(mem));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_materialize(&iter, &arena, &records, &count));
+    ASSERT_EQ(5, count);
+    ASSERT_STREQ("www.example.com", records[0].name.name);
+    ASSERT_STREQ("a.example.com", records[4].rdata.rr_srv.target.name);
+}
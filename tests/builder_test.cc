@@ -0,0 +1,296 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "tiny_dns.h"
+
+static struct tiny_dns_header response_header() {
+    struct tiny_dns_header header = {};
+    header.id = 0x1234;
+    header.flags.qr = true;
+    header.flags.rd = true;
+    header.flags.ra = true;
+    return header;
+}
+
+static struct tiny_dns_rr make_rr(const char *name, uint16_t atype) {
+    struct tiny_dns_rr rr = {};
+    strcpy(rr.name.name, name);
+    rr.atype = atype;
+    rr.aclass = CLASS_IN;
+    rr.ttl = 300;
+    return rr;
+}
+
+static std::vector<struct tiny_dns_rr> parse_all(const char *msg, size_t len,
+                                                 std::vector<enum tiny_dns_section> *sections) {
+    struct tiny_dns_iter iter;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, (void *)msg, len));
+
+    std::vector<struct tiny_dns_rr> rrs;
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    tiny_dns_err err;
+    while ((err = tiny_dns_iter_yield(&iter, &rr, &section)) == TINY_DNS_ERR_NONE) {
+        rrs.push_back(rr);
+        if (sections) {
+            sections->push_back(section);
+        }
+    }
+    EXPECT_EQ(TINY_DNS_ERR_NO_BUF, err);
+
+    return rrs;
+}
+
+TEST(Builder, round_trip) {
+    char buffer[512];
+    struct tiny_dns_header header = response_header();
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_builder_question(&builder, "www.example.com", RR_TYPE_A, CLASS_IN));
+
+    struct tiny_dns_rr cname = make_rr("www.example.com", RR_TYPE_CNAME);
+    strcpy(cname.rdata.rr_cname.name, "cdn.example.com");
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &cname));
+
+    struct tiny_dns_rr a = make_rr("cdn.example.com", RR_TYPE_A);
+    memcpy(a.rdata.rr_a, "\xC0\x00\x02\x01", 4);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &a));
+
+    struct tiny_dns_rr txt = make_rr("example.com.", RR_TYPE_TXT);
+    txt.rdata.rr_txt.txt = "hello";
+    txt.rdata.rr_txt.len = 5;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_AUTHORITY, &txt));
+
+    struct tiny_dns_rr srv = make_rr("_svc._tcp.example.com", RR_TYPE_SRV);
+    srv.rdata.rr_srv.priority = 10;
+    srv.rdata.rr_srv.weight = 5;
+    srv.rdata.rr_srv.port = 8080;
+    strcpy(srv.rdata.rr_srv.target.name, "a.example.com");
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ADDITIONAL, &srv));
+
+    struct tiny_dns_rr aaaa = make_rr("a.example.com", RR_TYPE_AAAA);
+    memset(aaaa.rdata.rr_aaaa, 0x20, 16);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ADDITIONAL, &aaaa));
+
+    struct tiny_dns_rr unknown = make_rr("example.com", 0x63);
+    unknown.rdata.unknown.data = "\x01\x02\x03";
+    unknown.rdata.unknown.len = 3;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ADDITIONAL, &unknown));
+
+    size_t len;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &len));
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, buffer, len));
+    ASSERT_EQ(0x1234, iter.header.id);
+    ASSERT_TRUE(iter.header.flags.qr);
+    ASSERT_TRUE(iter.header.flags.ra);
+    ASSERT_EQ(1, iter.header.qdcount);
+    ASSERT_EQ(2, iter.header.ancount);
+    ASSERT_EQ(1, iter.header.nscount);
+    ASSERT_EQ(3, iter.header.arcount);
+
+    std::vector<enum tiny_dns_section> sections;
+    std::vector<struct tiny_dns_rr> rrs = parse_all(buffer, len, &sections);
+    ASSERT_EQ(6, rrs.size());
+
+    ASSERT_STREQ("www.example.com", rrs[0].name.name);
+    ASSERT_STREQ("cdn.example.com", rrs[0].rdata.rr_cname.name);
+    ASSERT_STREQ("cdn.example.com", rrs[1].name.name);
+    ASSERT_EQ(0, memcmp(rrs[1].rdata.rr_a, "\xC0\x00\x02\x01", 4));
+    ASSERT_EQ(300, rrs[1].ttl);
+    ASSERT_EQ(SECTION_AUTHORITY, sections[2]);
+    ASSERT_STREQ("example.com", rrs[2].name.name);
+    ASSERT_EQ(5, rrs[2].rdata.rr_txt.len);
+    ASSERT_EQ(0, memcmp("hello", rrs[2].rdata.rr_txt.txt, 5));
+    ASSERT_STREQ("_svc._tcp.example.com", rrs[3].name.name);
+    ASSERT_EQ(8080, rrs[3].rdata.rr_srv.port);
+    ASSERT_STREQ("a.example.com", rrs[3].rdata.rr_srv.target.name);
+    ASSERT_STREQ("a.example.com", rrs[4].name.name);
+    ASSERT_EQ(3, rrs[5].rdlength);
+}
+
+TEST(Builder, soa) {
+    char buffer[512];
+    struct tiny_dns_header header = response_header();
+    header.flags.rcode = RCODE_NXDOMAIN;
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_builder_question(&builder, "nope.example.com", RR_TYPE_A, CLASS_IN));
+
+    struct tiny_dns_rr soa = make_rr("example.com", RR_TYPE_SOA);
+    // The names are taken from views, here into their wire form
+    static const char names[] = "\x02" "ns" "\x07" "example" "\x03" "com" "\x00"
+                                "\x0a" "hostmaster" "\xc0\x03";
+    soa.rdata.rr_soa.mname = { names, sizeof(names) - 1, 0 };
+    soa.rdata.rr_soa.rname = { names, sizeof(names) - 1, 16 };
+    soa.rdata.rr_soa.serial = 2024010101;
+    soa.rdata.rr_soa.refresh = 7200;
+    soa.rdata.rr_soa.retry = 3600;
+    soa.rdata.rr_soa.expire = 1209600;
+    soa.rdata.rr_soa.minimum = 60;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_AUTHORITY, &soa));
+
+    // A view of a malformed name is refused and leaves the message as it was
+    struct tiny_dns_rr broken = soa;
+    broken.rdata.rr_soa.rname.offset = 17;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_builder_rr(&builder, SECTION_AUTHORITY, &broken));
+
+    size_t len;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &len));
+
+    std::vector<enum tiny_dns_section> sections;
+    std::vector<struct tiny_dns_rr> rrs = parse_all(buffer, len, &sections);
+    ASSERT_EQ(1, rrs.size());
+    ASSERT_EQ(SECTION_AUTHORITY, sections[0]);
+    ASSERT_EQ(RR_TYPE_SOA, rrs[0].atype);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&rrs[0].rdata.rr_soa.mname, "ns.example.com"));
+    ASSERT_TRUE(tiny_dns_name_view_eq(&rrs[0].rdata.rr_soa.rname, "hostmaster.example.com"));
+    ASSERT_EQ(2024010101u, rrs[0].rdata.rr_soa.serial);
+    ASSERT_EQ(7200u, rrs[0].rdata.rr_soa.refresh);
+    ASSERT_EQ(3600u, rrs[0].rdata.rr_soa.retry);
+    ASSERT_EQ(1209600u, rrs[0].rdata.rr_soa.expire);
+    ASSERT_EQ(60u, rrs[0].rdata.rr_soa.minimum);
+
+    // Both names are compressed against the owner: a label and a pointer each
+    ASSERT_EQ(3 + 2 + 11 + 2 + 20, rrs[0].rdlength);
+
+    // The numbers must all be there
+    buffer[len - rrs[0].rdlength - 1] = (char)(rrs[0].rdlength - 1);
+    struct tiny_dns_iter iter;
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, buffer, len - 1));
+    ASSERT_GT(TINY_DNS_ERR_NONE, tiny_dns_iter_yield(&iter, &rr, &section));
+}
+
+TEST(Builder, compression) {
+    char buffer[512];
+    struct tiny_dns_header header = response_header();
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_builder_question(&builder, "www.example.com", RR_TYPE_A, CLASS_IN));
+
+    // Same name as the question, only differing in case
+    struct tiny_dns_rr a = make_rr("WWW.example.com", RR_TYPE_A);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &a));
+
+    // Shares the example.com suffix
+    struct tiny_dns_rr b = make_rr("mail.example.com", RR_TYPE_A);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &b));
+
+    size_t len;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &len));
+
+    // Question name at offset 12, example.com at 16
+    std::string msg(buffer, len);
+    size_t answer = 12 + 17 + 4;
+    ASSERT_EQ(std::string("\xC0\x0C", 2), msg.substr(answer, 2));
+    size_t second = answer + 2 + 10 + 4;
+    ASSERT_EQ(std::string("\x04mail\xC0\x10", 7), msg.substr(second, 7));
+    ASSERT_EQ(second + 7 + 10 + 4, len);
+
+    std::vector<struct tiny_dns_rr> rrs = parse_all(buffer, len, nullptr);
+    ASSERT_EQ(2, rrs.size());
+    ASSERT_STREQ("www.example.com", rrs[0].name.name);
+    ASSERT_STREQ("mail.example.com", rrs[1].name.name);
+}
+
+TEST(Builder, srv_target_not_compressed) {
+    char buffer[512];
+    struct tiny_dns_header header = response_header();
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_builder_question(&builder, "example.com", RR_TYPE_SRV, CLASS_IN));
+
+    struct tiny_dns_rr srv = make_rr("example.com", RR_TYPE_SRV);
+    strcpy(srv.rdata.rr_srv.target.name, "example.com");
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &srv));
+
+    size_t len;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &len));
+
+    std::vector<struct tiny_dns_rr> rrs = parse_all(buffer, len, nullptr);
+    ASSERT_EQ(1, rrs.size());
+    ASSERT_EQ(6 + 13, rrs[0].rdlength);
+    ASSERT_STREQ("example.com", rrs[0].rdata.rr_srv.target.name);
+}
+
+TEST(Builder, root_name) {
+    char buffer[512];
+    struct tiny_dns_header header = response_header();
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_question(&builder, ".", 2, CLASS_IN));
+
+    size_t len;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &len));
+    ASSERT_EQ(12 + 1 + 4, len);
+    ASSERT_EQ(0, buffer[12]);
+}
+
+TEST(Builder, section_order) {
+    char buffer[512];
+    struct tiny_dns_header header = response_header();
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+
+    struct tiny_dns_rr a = make_rr("example.com", RR_TYPE_A);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_AUTHORITY, &a));
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &a));
+    ASSERT_EQ(TINY_DNS_ERR_INVALID,
+              tiny_dns_builder_question(&builder, "example.com", RR_TYPE_A, CLASS_IN));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ADDITIONAL, &a));
+}
+
+TEST(Builder, invalid_names) {
+    char buffer[512];
+    struct tiny_dns_header header = response_header();
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+
+    const char *names[] = {
+        "..",
+        "www..example.com",
+        ".example.com",
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa.com",
+    };
+    for (const char *name : names) {
+        ASSERT_EQ(TINY_DNS_ERR_INVALID,
+                  tiny_dns_builder_question(&builder, name, RR_TYPE_A, CLASS_IN))
+            << name;
+    }
+}
+
+TEST(Builder, no_buf_rollback) {
+    char buffer[64];
+    struct tiny_dns_header header = response_header();
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_builder_question(&builder, "www.example.com", RR_TYPE_A, CLASS_IN));
+
+    // 16 bytes each with a compressed owner, so only one more fits
+    struct tiny_dns_rr a = make_rr("www.example.com", RR_TYPE_A);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &a));
+
+    // Doesn't fit, and must not leave a partial record or a stale compression target behind
+    struct tiny_dns_rr b = make_rr("other.example.net", RR_TYPE_A);
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &b));
+
+    builder.header.flags.tc = true;
+    size_t len;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &len));
+    ASSERT_EQ(12 + 17 + 4 + 16, len);
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, buffer, len));
+    ASSERT_TRUE(iter.header.flags.tc);
+    ASSERT_EQ(1, parse_all(buffer, len, nullptr).size());
+}
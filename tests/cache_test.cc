@@ -0,0 +1,548 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "responses.h"
+#include "tiny_dns.h"
+
+// NXDOMAIN or NODATA response to a question for @name, with an SOA for example.com in the
+// authority section unless @soa_ttl is 0
+static std::string negative(const char *name, uint16_t qtype, enum tiny_dns_rcode rcode,
+                            uint32_t soa_ttl, uint32_t minimum) {
+    char buffer[512];
+    struct tiny_dns_header header = {};
+    header.flags.qr = true;
+    header.flags.rcode = rcode;
+
+    struct tiny_dns_builder builder;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_question(&builder, name, qtype, CLASS_IN));
+
+    if (soa_ttl) {
+        struct tiny_dns_rr rr = {};
+        strcpy(rr.name.name, "example.com");
+        rr.atype = RR_TYPE_SOA;
+        rr.aclass = CLASS_IN;
+        rr.ttl = soa_ttl;
+        static const char names[] = "\x02" "ns" "\x07" "example" "\x03" "com" "\x00"
+                                    "\x0a" "hostmaster" "\xc0\x03";
+        rr.rdata.rr_soa.mname = { names, sizeof(names) - 1, 0 };
+        rr.rdata.rr_soa.rname = { names, sizeof(names) - 1, 16 };
+        rr.rdata.rr_soa.minimum = minimum;
+        EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_AUTHORITY, &rr));
+    }
+
+    size_t len;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &len));
+    return std::string(buffer, len);
+}
+
+// The question of a query for @name, as a lookup key
+class Key {
+  public:
+    explicit Key(const char *name) {
+        EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl_, name, RR_TYPE_A));
+    }
+
+    struct tiny_dns_name_view view() const {
+        return { reinterpret_cast<const char *>(tmpl_.msg), tmpl_.len, 12 };
+    }
+
+  private:
+    struct tiny_dns_query_template tmpl_;
+};
+
+class Cache : public ::testing::Test {
+  protected:
+    void SetUp() override { init(mem.size()); }
+
+    void init(size_t size) {
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_init(&cache, mem.data(), size));
+    }
+
+    tiny_dns_err insert(const std::string &msg, uint64_t now = 1000) {
+        return tiny_dns_cache_insert(&cache, msg.data(), msg.size(), now);
+    }
+
+    tiny_dns_err lookup(const char *name, uint16_t qtype = RR_TYPE_A, uint64_t now = 1000) {
+        Key key(name);
+        struct tiny_dns_name_view view = key.view();
+        len = sizeof(buffer);
+        return tiny_dns_cache_lookup(&cache, &view, qtype, CLASS_IN, now, buffer, &len, &hit);
+    }
+
+    struct tiny_dns_cache_stats stats() {
+        struct tiny_dns_cache_stats s;
+        tiny_dns_cache_stats(&cache, &s);
+        return s;
+    }
+
+    std::vector<char> mem = std::vector<char>(64 * 1024);
+    struct tiny_dns_cache cache;
+    char buffer[TINY_DNS_CACHE_MSG_MAX];
+    size_t len;
+    struct tiny_dns_cache_hit hit;
+};
+
+TEST_F(Cache, hit) {
+    std::string msg = response("www.example.com", RR_TYPE_A, { 300 });
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com"));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(msg));
+
+    // Handed out with the TTL it has left
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1100));
+    ASSERT_EQ(response("www.example.com", RR_TYPE_A, { 200 }), std::string(buffer, len));
+    ASSERT_EQ(200u, hit.ttl);
+
+    // Names compare without regard to case
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("WWW.Example.COM."));
+
+    struct tiny_dns_cache_stats s = stats();
+    ASSERT_EQ(2u, s.hits);
+    ASSERT_EQ(1u, s.misses);
+    ASSERT_EQ(1u, s.inserts);
+    ASSERT_EQ(0u, s.evictions);
+}
+
+TEST_F(Cache, keyed_on_type) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 300 })));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com", RR_TYPE_AAAA));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("example.com"));
+
+    std::string aaaa = response("www.example.com", RR_TYPE_AAAA, { 60 });
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(aaaa));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_AAAA));
+    ASSERT_EQ(aaaa, std::string(buffer, len));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A));
+    ASSERT_NE(aaaa, std::string(buffer, len));
+}
+
+TEST_F(Cache, smallest_ttl) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 300, 30, 90 })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com"));
+    ASSERT_EQ(30u, hit.ttl);
+}
+
+TEST_F(Cache, ttl_clamped) {
+    // However long the upstream asks for, responses are only kept for so long
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 0x7FFFFFFF })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com"));
+    ASSERT_EQ((uint32_t)TINY_DNS_CACHE_TTL_MAX, hit.ttl);
+
+    // A TTL with the top bit set is 0, so it's not cached rather than kept for a long time
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              insert(response("big.example.com", RR_TYPE_A, { 0x80000000u })));
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              insert(response("big.example.com", RR_TYPE_A, { 300, 0xFFFFFFFFu })));
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              insert(negative("nope.example.com", RR_TYPE_A, RCODE_NXDOMAIN, 0x80000000u, 60)));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("big.example.com"));
+}
+
+// TTL of every record in @msg, in order
+static std::vector<uint32_t> record_ttls(const char *msg, size_t len) {
+    std::vector<char> copy(msg, msg + len);
+    struct tiny_dns_iter iter;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, copy.data(), copy.size()));
+
+    std::vector<uint32_t> ttls;
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    while (tiny_dns_iter_yield(&iter, &rr, &section) == TINY_DNS_ERR_NONE) {
+        ttls.push_back(rr.ttl);
+    }
+    return ttls;
+}
+
+TEST_F(Cache, ttls_aged) {
+    char msg[512];
+    struct tiny_dns_header header = {};
+    header.flags.qr = true;
+    struct tiny_dns_builder builder;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, msg, sizeof(msg), &header));
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_builder_question(&builder, "www.example.com", RR_TYPE_A, CLASS_IN));
+
+    // Two answers, an authority and an additional record, then an OPT whose TTL holds the DO bit
+    const struct {
+        enum tiny_dns_section section;
+        uint16_t atype;
+        uint32_t ttl;
+    } records[] = {
+        { SECTION_ANSWER, RR_TYPE_A, 300 },      { SECTION_ANSWER, RR_TYPE_A, 600 },
+        { SECTION_AUTHORITY, RR_TYPE_A, 3600 },  { SECTION_ADDITIONAL, RR_TYPE_A, 100 },
+        { SECTION_ADDITIONAL, RR_TYPE_OPT, 0x8000 },
+    };
+    for (const auto &record : records) {
+        struct tiny_dns_rr rr = {};
+        strcpy(rr.name.name, record.atype == RR_TYPE_OPT ? "" : "www.example.com");
+        rr.atype = record.atype;
+        rr.aclass = record.atype == RR_TYPE_OPT ? 1232 : CLASS_IN;
+        rr.ttl = record.ttl;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, record.section, &rr));
+    }
+    size_t msg_len;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &msg_len));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(std::string(msg, msg_len)));
+
+    // 100s in, every record has aged by as much, and none outlives the entry's 200s
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1100));
+    ASSERT_EQ(200u, hit.ttl);
+    ASSERT_EQ((std::vector<uint32_t>{ 200, 200, 200, 0, 0x8000 }), record_ttls(buffer, len));
+
+    // Served stale, every record gets the stale TTL
+    struct tiny_dns_cache_stale policy = { 3600, 30 };
+    tiny_dns_cache_set_stale(&cache, &policy);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1400));
+    ASSERT_TRUE(hit.stale);
+    ASSERT_EQ((std::vector<uint32_t>{ 30, 30, 30, 30, 0x8000 }), record_ttls(buffer, len));
+
+    // What's stored is left as it was
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1000));
+    ASSERT_EQ((std::vector<uint32_t>{ 300, 300, 300, 100, 0x8000 }), record_ttls(buffer, len));
+}
+
+TEST_F(Cache, expires) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 30 })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1029));
+    ASSERT_EQ(1u, hit.ttl);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com", RR_TYPE_A, 1030));
+    ASSERT_EQ(1u, stats().misses);
+}
+
+TEST_F(Cache, replace) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 30 })));
+    std::string newer = response("www.example.com", RR_TYPE_A, { 300, 300 });
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(newer, 1010));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1100));
+    ASSERT_EQ(response("www.example.com", RR_TYPE_A, { 210, 210 }), std::string(buffer, len));
+    ASSERT_EQ(210u, hit.ttl);
+
+    Key key("www.example.com");
+    struct tiny_dns_name_view view = key.view();
+    tiny_dns_cache_remove(&cache, &view, RR_TYPE_A, CLASS_IN);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com"));
+}
+
+TEST_F(Cache, negative) {
+    // The SOA's minimum, or its own TTL if that's smaller
+    std::string nxdomain = negative("nope.example.com", RR_TYPE_A, RCODE_NXDOMAIN, 3600, 60);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(nxdomain));
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              insert(negative("www.example.com", RR_TYPE_AAAA, RCODE_NOERROR, 30, 300)));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("nope.example.com"));
+    ASSERT_EQ(negative("nope.example.com", RR_TYPE_A, RCODE_NXDOMAIN, 60, 60),
+              std::string(buffer, len));
+    ASSERT_TRUE(hit.negative);
+    ASSERT_EQ(60u, hit.ttl);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("nope.example.com", RR_TYPE_A, 1060));
+
+    // NODATA is for the type asked about only
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_AAAA));
+    ASSERT_TRUE(hit.negative);
+    ASSERT_EQ(30u, hit.ttl);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com", RR_TYPE_A));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 300 })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A));
+    ASSERT_FALSE(hit.negative);
+
+    // However long the zone asks for, negative answers are only kept for so long
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              insert(negative("long.example.com", RR_TYPE_A, RCODE_NXDOMAIN, 86400, 86400)));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("long.example.com"));
+    ASSERT_EQ((uint32_t)TINY_DNS_CACHE_NEGATIVE_TTL_MAX, hit.ttl);
+
+    // Without an SOA there's nothing to say for how long
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              insert(negative("nope.example.com", RR_TYPE_A, RCODE_NXDOMAIN, 0, 0)));
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              insert(negative("nope.example.com", RR_TYPE_A, RCODE_NXDOMAIN, 3600, 0)));
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              insert(negative("nope.example.com", RR_TYPE_A, RCODE_SERVFAIL, 3600, 60)));
+}
+
+TEST_F(Cache, prefetch) {
+    struct tiny_dns_cache_prefetch policy = { 3, 10 };
+    tiny_dns_cache_set_prefetch(&cache, &policy);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 100 })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("cold.example.com", RR_TYPE_A, { 100 })));
+
+    // Not hot yet, then hot but with most of its TTL left
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1000 + i));
+        ASSERT_FALSE(hit.prefetch);
+    }
+
+    // Flagged once when it enters the last tenth of its TTL, not on every hit after that
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1091));
+    ASSERT_TRUE(hit.prefetch);
+    ASSERT_EQ(9u, hit.ttl);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1092));
+    ASSERT_FALSE(hit.prefetch);
+
+    // A name looked up once isn't worth refreshing
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("cold.example.com", RR_TYPE_A, 1095));
+    ASSERT_FALSE(hit.prefetch);
+    ASSERT_EQ(1u, stats().prefetches);
+
+    // The refreshed answer starts counting again
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 100 }), 1093));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1190));
+    ASSERT_FALSE(hit.prefetch);
+
+    // Off again
+    policy.min_hits = 0;
+    tiny_dns_cache_set_prefetch(&cache, &policy);
+    for (int i = 0; i < 4; i++) {
+        ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1191));
+        ASSERT_FALSE(hit.prefetch);
+    }
+    ASSERT_EQ(1u, stats().prefetches);
+}
+
+TEST_F(Cache, stale) {
+    struct tiny_dns_cache_stale policy = { 3600, 30 };
+    tiny_dns_cache_set_stale(&cache, &policy);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 100 })));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1099));
+    ASSERT_FALSE(hit.stale);
+    ASSERT_EQ(1u, hit.ttl);
+
+    // Served with the stale TTL once expired, asking for a refresh once per stale TTL
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1100));
+    ASSERT_TRUE(hit.stale);
+    ASSERT_TRUE(hit.prefetch);
+    ASSERT_EQ(30u, hit.ttl);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1129));
+    ASSERT_TRUE(hit.stale);
+    ASSERT_FALSE(hit.prefetch);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1130));
+    ASSERT_TRUE(hit.prefetch);
+
+    // Too stale
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 4699));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com", RR_TYPE_A, 4700));
+
+    struct tiny_dns_cache_stats s = stats();
+    ASSERT_EQ(5u, s.hits);
+    ASSERT_EQ(4u, s.stale);
+    ASSERT_EQ(3u, s.prefetches);
+
+    // A refreshed entry is fresh again
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 100 }), 1200));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 1200));
+    ASSERT_FALSE(hit.stale);
+    ASSERT_EQ(100u, hit.ttl);
+
+    // Turned off, expired entries miss again
+    policy.max_stale = 0;
+    tiny_dns_cache_set_stale(&cache, &policy);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com", RR_TYPE_A, 1300));
+}
+
+// Entries that can still be served stale aren't reused ahead of live ones
+TEST_F(Cache, stale_kept) {
+    init(8 * 1024);
+    size_t capacity = tiny_dns_cache_capacity(&cache);
+    struct tiny_dns_cache_stale policy = { 3600, 30 };
+    tiny_dns_cache_set_stale(&cache, &policy);
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("stale.example.com", RR_TYPE_A, { 10 })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("stale.example.com", RR_TYPE_A, 1010));
+    for (size_t i = 1; i < capacity; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response(name.c_str(), RR_TYPE_A, { 300 })));
+    }
+
+    // The stale entry was looked up and the others weren't, so one of them makes room
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("new.example.com", RR_TYPE_A, { 300 }), 1010));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("stale.example.com", RR_TYPE_A, 1010));
+    ASSERT_TRUE(hit.stale);
+    ASSERT_EQ(1u, stats().evictions);
+}
+
+TEST_F(Cache, uncacheable) {
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED, insert(response("www.example.com", RR_TYPE_A, {})));
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED, insert(response("www.example.com", RR_TYPE_A, { 0, 300 })));
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              insert(response("www.example.com", RR_TYPE_A, { 300 }, RCODE_SERVFAIL)));
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              insert(response("www.example.com", RR_TYPE_A, { 300 }, RCODE_NOERROR, true)));
+
+    uint8_t query[64];
+    size_t query_len = sizeof(query);
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_build_query(query, &query_len, 1, "www.example.com", RR_TYPE_A));
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED, tiny_dns_cache_insert(&cache, query, query_len, 1000));
+
+    std::vector<uint32_t> many(40, 300);
+    ASSERT_EQ(TINY_DNS_ERR_NO_SPACE, insert(response("www.example.com", RR_TYPE_A, many)));
+
+    std::string msg = response("www.example.com", RR_TYPE_A, { 300 });
+    ASSERT_GT(TINY_DNS_ERR_NONE, insert(msg.substr(0, msg.size() - 1)));
+
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com"));
+    ASSERT_EQ(0u, stats().inserts);
+}
+
+TEST_F(Cache, small_buffer) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 300 })));
+
+    Key key("www.example.com");
+    struct tiny_dns_name_view view = key.view();
+    len = 20;
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_cache_lookup(&cache, &view, RR_TYPE_A, CLASS_IN, 1000,
+                                                         buffer, &len, NULL));
+}
+
+TEST_F(Cache, clock_eviction) {
+    init(4 * 600);
+    size_t capacity = tiny_dns_cache_capacity(&cache);
+    ASSERT_GE(capacity, 2u);
+
+    std::vector<std::string> names;
+    for (size_t i = 0; i < capacity; i++) {
+        names.push_back("host" + std::to_string(i) + ".example.com");
+        ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response(names[i].c_str(), RR_TYPE_A, { 300 })));
+    }
+
+    // The first entry was looked up, so the hand spares it and takes the second
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(names[0].c_str()));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("new.example.com", RR_TYPE_A, { 300 })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(names[0].c_str()));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(names[1].c_str()));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("new.example.com"));
+    ASSERT_EQ(1u, stats().evictions);
+}
+
+TEST_F(Cache, expired_reused_first) {
+    init(4 * 600);
+    size_t capacity = tiny_dns_cache_capacity(&cache);
+
+    for (size_t i = 0; i < capacity; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response(name.c_str(), RR_TYPE_A, { 10 })));
+        ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(name.c_str()));
+    }
+
+    // Everything has expired, so it's replaced without counting as an eviction
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("new.example.com", RR_TYPE_A, { 300 }), 2000));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("new.example.com", RR_TYPE_A, 2000));
+    ASSERT_EQ(0u, stats().evictions);
+}
+
+TEST_F(Cache, churn) {
+    size_t capacity = tiny_dns_cache_capacity(&cache);
+    size_t total = capacity * 4;
+
+    for (size_t i = 0; i < total; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response(name.c_str(), RR_TYPE_A, { 300 })));
+    }
+
+    // Without lookups the CLOCK hand evicts in insertion order, so the newest entries remain
+    for (size_t i = 0; i < total; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        tiny_dns_err expect = i >= total - capacity ? TINY_DNS_ERR_NONE : TINY_DNS_ERR_NOT_FOUND;
+        ASSERT_EQ(expect, lookup(name.c_str())) << name;
+    }
+
+    ASSERT_EQ(total - capacity, stats().evictions);
+}
+
+TEST_F(Cache, snapshot_restore) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 300 })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("short.example.com", RR_TYPE_A, { 60 })));
+
+    // Saved 100s in, restored 30s later by a process whose clock started over
+    std::vector<uint64_t> snapshot(tiny_dns_cache_snapshot_size(&cache) / 8 + 1);
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_cache_snapshot(&cache, 1100, 5000, snapshot.data(), snapshot.size() * 8));
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_cache_restore(&cache, snapshot.data(), snapshot.size() * 8, 20, 5030));
+    ASSERT_EQ(reinterpret_cast<char *>(snapshot.data()) + 64, (char *)cache.region);
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com", RR_TYPE_A, 20));
+    ASSERT_EQ(170u, hit.ttl);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("short.example.com", RR_TYPE_A, 20));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com", RR_TYPE_A, 190));
+
+    // Still a working cache
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("new.example.com", RR_TYPE_A, { 300 }), 20));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("new.example.com", RR_TYPE_A, 20));
+    ASSERT_EQ(2u, stats().hits);
+}
+
+TEST_F(Cache, snapshot_invalid) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 300 })));
+    size_t size = tiny_dns_cache_snapshot_size(&cache);
+    std::vector<uint64_t> snapshot(size / 8 + 1);
+    char *data = reinterpret_cast<char *>(snapshot.data());
+    struct tiny_dns_cache restored;
+
+    ASSERT_EQ(TINY_DNS_ERR_NO_SPACE, tiny_dns_cache_snapshot(&cache, 1000, 0, data, size - 1));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_snapshot(&cache, 1000, 0, data, size));
+
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_cache_restore(&restored, data, 32, 1000, 0));
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_cache_restore(&restored, data, size - 1, 1000, 0));
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_cache_restore(&restored, data + 1, size, 1000, 0));
+
+    std::vector<uint64_t> copy = snapshot;
+    data[4] ^= 1;
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED, tiny_dns_cache_restore(&restored, data, size, 1000, 0));
+
+    // Point every bucket past the end of the entries. The image is laid out like the cache it
+    // was taken of, after the 64 byte snapshot header. Chains are only checked as they're walked,
+    // so the damage shows as misses, and the cache keeps working.
+    snapshot = copy;
+    size_t buckets_at =
+        reinterpret_cast<char *>(cache.buckets) - reinterpret_cast<char *>(cache.region);
+    uint32_t *buckets = reinterpret_cast<uint32_t *>(data + 64 + buckets_at);
+    for (size_t i = 0; i < tiny_dns_cache_capacity(&cache); i++) {
+        buckets[i] = UINT32_MAX;
+    }
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_restore(&restored, data, size, 1000, 0));
+    cache = restored;
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup("www.example.com"));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response("www.example.com", RR_TYPE_A, { 300 })));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com"));
+
+    // Every bucket leads to the one entry, which only belongs in one of them
+    snapshot = copy;
+    for (size_t i = 0; i < tiny_dns_cache_capacity(&cache); i++) {
+        buckets[i] = 1;
+    }
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_restore(&restored, data, size, 1000, 0));
+    cache = restored;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com"));
+    for (int i = 0; i < 50; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(name.c_str()));
+        ASSERT_EQ(TINY_DNS_ERR_NONE, insert(response(name.c_str(), RR_TYPE_A, { 300 })));
+        ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(name.c_str()));
+    }
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup("www.example.com"));
+
+    // A damaged header is still refused outright
+    snapshot = copy;
+    reinterpret_cast<uint32_t *>(data + 64)[0] += 1;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_cache_restore(&restored, data, size, 1000, 0));
+
+    snapshot = copy;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_restore(&restored, data, size, 1000, 0));
+}
+
+TEST(CacheInit, sizes) {
+    struct tiny_dns_cache cache;
+    std::vector<char> mem(4096);
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_cache_init(&cache, NULL, mem.size()));
+    ASSERT_EQ(TINY_DNS_ERR_NO_SPACE, tiny_dns_cache_init(&cache, mem.data(), 100));
+
+    // Unaligned memory is aligned internally
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_init(&cache, mem.data() + 1, mem.size() - 1));
+    ASSERT_GE(tiny_dns_cache_capacity(&cache), 6u);
+}
@@ -0,0 +1,165 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "responses.h"
+#include "tiny_dns.h"
+
+// Response with a single answer, whose rdata is given by the caller
+static std::string make_single(uint16_t atype, const std::string &rdata) {
+    std::string msg("\x12\x34\x81\x80\x00\x01\x00\x01\x00\x00\x00\x00", 12);
+    msg.append("\x03www\x07"
+               "example\x03"
+               "com",
+               16);
+    msg.push_back('\0');
+    msg.append("\x00\x01\x00\x01", 4);
+    msg.append("\xC0\x0C", 2);
+    msg.push_back((char)(atype >> 8));
+    msg.push_back((char)atype);
+    msg.append("\x00\x01\x00\x00\x01\x2C", 6);
+    msg.push_back((char)(rdata.size() >> 8));
+    msg.push_back((char)rdata.size());
+    msg.append(rdata);
+    return msg;
+}
+
+TEST(CompactRR, size) {
+    ASSERT_LE(sizeof(struct tiny_dns_rr_compact), 32);
+}
+
+TEST(CompactRR, yield) {
+    std::string msg = srv_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    struct tiny_dns_rr_compact rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    ASSERT_EQ(SECTION_ANSWER, section);
+    ASSERT_EQ(RR_TYPE_SRV, rr.atype);
+    ASSERT_EQ(CLASS_IN, rr.aclass);
+    ASSERT_EQ(60, rr.ttl);
+    ASSERT_EQ(10, rr.rdlength);
+    ASSERT_EQ(10, rr.rdata.rr_srv.priority);
+    ASSERT_EQ(5, rr.rdata.rr_srv.weight);
+    ASSERT_EQ(8080, rr.rdata.rr_srv.port);
+    ASSERT_EQ(57, rr.rdata.rr_srv.target);
+
+    struct tiny_dns_name_view owner = tiny_dns_iter_name(&iter, rr.owner);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&owner, "_svc._tcp.example.com"));
+    struct tiny_dns_name_view target = tiny_dns_iter_name(&iter, rr.rdata.rr_srv.target);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&target, "a.example.com"));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    ASSERT_EQ(20, rr.rdata.rr_srv.priority);
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    ASSERT_EQ(SECTION_AUTHORITY, section);
+    ASSERT_EQ(0x63, rr.atype);
+    ASSERT_EQ(0, rr.rdlength);
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    ASSERT_EQ(SECTION_ADDITIONAL, section);
+    ASSERT_EQ(RR_TYPE_A, rr.atype);
+    ASSERT_EQ(0, memcmp(rr.rdata.rr_a, "\xC0\x00\x02\x01", 4));
+    owner = tiny_dns_iter_name(&iter, rr.owner);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&owner, "a.example.com"));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    ASSERT_EQ(RR_TYPE_AAAA, rr.atype);
+    ASSERT_EQ(0x20, rr.rdata.rr_aaaa[0]);
+    ASSERT_EQ(0x01, rr.rdata.rr_aaaa[15]);
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    owner = tiny_dns_iter_name(&iter, rr.owner);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&owner, "b.example.com"));
+
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+}
+
+TEST(CompactRR, cname) {
+    std::string msg = make_single(RR_TYPE_CNAME, std::string("\x03"
+                                                             "cdn\xC0\x10",
+                                                             6));
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    struct tiny_dns_rr_compact rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    struct tiny_dns_name_view cname = tiny_dns_iter_name(&iter, rr.rdata.rr_cname);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&cname, "cdn.example.com"));
+}
+
+TEST(CompactRR, txt) {
+    std::string msg = make_single(RR_TYPE_TXT, std::string("\x05hello", 6));
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    struct tiny_dns_rr_compact rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    ASSERT_EQ(5, rr.rdata.rr_txt.len);
+    ASSERT_EQ("hello", msg.substr(rr.rdata.rr_txt.offset, rr.rdata.rr_txt.len));
+}
+
+TEST(CompactRR, soa) {
+    // ns.example.com host.example.com 1 7200 3600 1209600 300
+    std::string msg = make_single(RR_TYPE_SOA, std::string("\x02ns\xC0\x10\x04host\xC0\x10"
+                                                           "\x00\x00\x00\x01\x00\x00\x1C\x20"
+                                                           "\x00\x00\x0E\x10\x00\x12\x75\x00"
+                                                           "\x00\x00\x01\x2C",
+                                                           32));
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    struct tiny_dns_rr_compact rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_compact(&iter, &rr, &section));
+    struct tiny_dns_name_view mname = tiny_dns_iter_name(&iter, rr.rdata.rr_soa.mname);
+    struct tiny_dns_name_view rname = tiny_dns_iter_name(&iter, rr.rdata.rr_soa.rname);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&mname, "ns.example.com"));
+    ASSERT_TRUE(tiny_dns_name_view_eq(&rname, "host.example.com"));
+    ASSERT_EQ(1u, rr.rdata.rr_soa.serial);
+    ASSERT_EQ(300u, rr.rdata.rr_soa.minimum);
+}
+
+TEST(CompactRR, invalid_rdata) {
+    const struct {
+        uint16_t atype;
+        std::string rdata;
+    } cases[] = {
+        { RR_TYPE_A, std::string("\xC0\x00\x02", 3) },
+        { RR_TYPE_AAAA, std::string("\x20\x01\x0d\xb8", 4) },
+        // Target name runs past rdlength
+        { RR_TYPE_CNAME, std::string("\x03"
+                                     "cdn",
+                                     4) },
+        { RR_TYPE_SRV, std::string("\x00\x0A\x00\x05", 4) },
+        // Forward pointer
+        { RR_TYPE_CNAME, std::string("\xC0\x30", 2) },
+        // Two root names, then too few numbers
+        { RR_TYPE_SOA, std::string("\x00\x00\x00\x00\x00\x01", 6) },
+        { RR_TYPE_TXT, std::string("\x7F"
+                                   "a",
+                                   2) },
+    };
+
+    for (const auto &c : cases) {
+        std::string msg = make_single(c.atype, c.rdata);
+
+        struct tiny_dns_iter iter;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+        struct tiny_dns_rr_compact rr;
+        enum tiny_dns_section section;
+        tiny_dns_err err = tiny_dns_iter_yield_compact(&iter, &rr, &section);
+        ASSERT_LT(err, TINY_DNS_ERR_NONE) << "type " << c.atype;
+        ASSERT_NE(TINY_DNS_ERR_NO_BUF, err) << "type " << c.atype;
+    }
+}
@@ -0,0 +1,132 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "responses.h"
+#include "tiny_dns.h"
+
+TEST(Index, build) {
+    std::string msg = srv_response();
+
+    struct tiny_dns_index_entry entries[8];
+    struct tiny_dns_index index;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_index_build(&index, msg.data(), msg.size(), entries, 8));
+
+    ASSERT_EQ(6, index.count);
+    ASSERT_EQ(2, tiny_dns_index_count(&index, SECTION_ANSWER));
+    ASSERT_EQ(1, tiny_dns_index_count(&index, SECTION_AUTHORITY));
+    ASSERT_EQ(3, tiny_dns_index_count(&index, SECTION_ADDITIONAL));
+
+    ASSERT_EQ(SECTION_ANSWER, entries[0].section);
+    ASSERT_EQ(RR_TYPE_SRV, entries[0].atype);
+    ASSERT_EQ(60, entries[0].ttl);
+    ASSERT_EQ(10, entries[0].rdlength);
+    ASSERT_EQ(SECTION_AUTHORITY, entries[2].section);
+    ASSERT_EQ(0, entries[2].rdlength);
+    ASSERT_EQ(SECTION_ADDITIONAL, entries[5].section);
+}
+
+TEST(Index, get) {
+    std::string msg = srv_response();
+
+    struct tiny_dns_index_entry entries[8];
+    struct tiny_dns_index index;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_index_build(&index, msg.data(), msg.size(), entries, 8));
+
+    const struct tiny_dns_index_entry *entry = tiny_dns_index_get(&index, SECTION_ADDITIONAL, 2);
+    ASSERT_NE(nullptr, entry);
+    ASSERT_EQ(&entries[5], entry);
+
+    struct tiny_dns_rr rr;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_index_parse(&index, entry, &rr));
+    ASSERT_STREQ("b.example.com", rr.name.name);
+    ASSERT_EQ(RR_TYPE_A, rr.atype);
+    ASSERT_EQ(0, std::memcmp("\xC0\x00\x02\x02", rr.rdata.rr_a, 4));
+
+    ASSERT_EQ(nullptr, tiny_dns_index_get(&index, SECTION_ADDITIONAL, 3));
+    ASSERT_EQ(nullptr, tiny_dns_index_get(&index, SECTION_AUTHORITY, 1));
+}
+
+TEST(Index, find) {
+    std::string msg = srv_response();
+
+    struct tiny_dns_index_entry entries[8];
+    struct tiny_dns_index index;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_index_build(&index, msg.data(), msg.size(), entries, 8));
+
+    size_t pos = 0;
+    const struct tiny_dns_index_entry *entry;
+    int found = 0;
+    while ((entry = tiny_dns_index_find(&index, SECTION_ADDITIONAL, RR_TYPE_A, &pos))) {
+        ASSERT_EQ(RR_TYPE_A, entry->atype);
+        found++;
+    }
+    ASSERT_EQ(2, found);
+
+    pos = 0;
+    entry = tiny_dns_index_find(&index, SECTION_ANSWER, RR_TYPE_SRV, &pos);
+    ASSERT_NE(nullptr, entry);
+
+    struct tiny_dns_rr rr;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_index_parse(&index, entry, &rr));
+    ASSERT_EQ(10, rr.rdata.rr_srv.priority);
+    ASSERT_EQ(8080, rr.rdata.rr_srv.port);
+    ASSERT_STREQ("a.example.com", rr.rdata.rr_srv.target.name);
+
+    pos = 0;
+    ASSERT_EQ(nullptr, tiny_dns_index_find(&index, SECTION_ANSWER, RR_TYPE_AAAA, &pos));
+}
+
+TEST(Index, matches_iterator) {
+    std::string msg = srv_response();
+
+    struct tiny_dns_index_entry entries[8];
+    struct tiny_dns_index index;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_index_build(&index, msg.data(), msg.size(), entries, 8));
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    for (size_t i = 0; i < index.count; i++) {
+        struct tiny_dns_rr a;
+        struct tiny_dns_rr b;
+        enum tiny_dns_section section;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield(&iter, &a, &section));
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_index_parse(&index, &entries[i], &b));
+        ASSERT_EQ(section, entries[i].section);
+        ASSERT_STREQ(a.name.name, b.name.name);
+        ASSERT_EQ(a.atype, b.atype);
+        ASSERT_EQ(a.ttl, b.ttl);
+        ASSERT_EQ(a.rdlength, b.rdlength);
+    }
+}
+
+TEST(Index, capacity) {
+    std::string msg = srv_response();
+
+    struct tiny_dns_index_entry entries[5];
+    struct tiny_dns_index index;
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF,
+              tiny_dns_index_build(&index, msg.data(), msg.size(), entries, 5));
+}
+
+TEST(Index, truncated) {
+    std::string msg = srv_response();
+
+    struct tiny_dns_index_entry entries[8];
+    struct tiny_dns_index index;
+    for (size_t len : { msg.size() - 1, msg.size() - 16, (size_t)60 }) {
+        ASSERT_LT(tiny_dns_index_build(&index, msg.data(), len, entries, 8), TINY_DNS_ERR_NONE);
+    }
+}
+
+TEST(Index, bad_owner_pointer) {
+    std::string msg = srv_response();
+    // Point the first answer's owner at itself
+    msg[39] = '\xC0';
+    msg[40] = '\x27';
+
+    struct tiny_dns_index_entry entries[8];
+    struct tiny_dns_index index;
+    ASSERT_LT(tiny_dns_index_build(&index, msg.data(), msg.size(), entries, 8), TINY_DNS_ERR_NONE);
+}
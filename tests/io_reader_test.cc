@@ -97,6 +97,29 @@ TEST(IOReaderTest, get) {
     ASSERT_EQ(rdr.remaining, 0);
 }
 
+TEST(IOReaderTest, skip) {
+    std::string data = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+    IOReader rdr;
+    io_reader_init(&rdr, data.data(), data.size());
+
+    int err = io_reader_skip(&rdr, 3);
+    ASSERT_EQ(err, 3);
+    ASSERT_EQ(rdr.ptr, rdr.base + 3);
+    ASSERT_EQ(rdr.remaining, data.size() - 3);
+
+    // Skipping past the end consumes nothing
+    err = io_reader_skip(&rdr, data.size());
+    ASSERT_EQ(err, IO_BUF_EMPTY);
+    ASSERT_EQ(rdr.ptr, rdr.base + 3);
+
+    err = io_reader_skip(&rdr, data.size() - 3);
+    ASSERT_EQ(err, data.size() - 3);
+    ASSERT_EQ(rdr.remaining, 0);
+
+    err = io_reader_skip(&rdr, 0);
+    ASSERT_EQ(err, 0);
+}
+
 TEST(IOReaderTest, get_u16) {
     std::vector<uint8_t> data = { 0x00, 0x01 };
     IOReader rdr;
@@ -121,6 +144,21 @@ TEST(IOReaderTest, get_u32) {
     ASSERT_EQ(value, 0x00010203);
 }
 
+TEST(IOReaderTest, get_short) {
+    std::vector<uint8_t> data = { 0x00, 0x01, 0x02 };
+    IOReader rdr;
+    io_reader_init(&rdr, data.data(), data.size());
+
+    uint32_t value32;
+    ASSERT_EQ(IO_BUF_EMPTY, io_reader_get_u32(&rdr, &value32));
+    ASSERT_EQ(rdr.remaining, 3);
+
+    uint16_t value16;
+    ASSERT_EQ(io_reader_skip(&rdr, 2), 2);
+    ASSERT_EQ(IO_BUF_EMPTY, io_reader_get_u16(&rdr, &value16));
+    ASSERT_EQ(rdr.remaining, 1);
+}
+
 TEST(IOReaderTest, exhausted_buffer) {
     IOReader rdr;
     io_reader_init(&rdr, nullptr, 0);
@@ -0,0 +1,146 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "tiny_dns.h"
+
+// Answers: A, an AAAA with a truncated address, CNAME. Additional: A.
+static std::string make_response() {
+    std::string msg("\x12\x34\x81\x80\x00\x01\x00\x03\x00\x00\x00\x01", 12);
+    msg.append("\x03www\x07"
+               "example\x03"
+               "com",
+               16);
+    msg.push_back('\0');
+    msg.append("\x00\xFF\x00\x01", 4);
+    msg.append("\xC0\x0C\x00\x01\x00\x01\x00\x00\x01\x2C\x00\x04\xC0\x00\x02\x01", 16);
+    msg.append("\xC0\x0C\x00\x1C\x00\x01\x00\x00\x01\x2C\x00\x04\x20\x01\x0d\xb8", 16);
+    msg.append("\xC0\x0C\x00\x05\x00\x01\x00\x00\x01\x2C\x00\x06\x03"
+               "cdn\xC0\x10",
+               18);
+    msg.append("\xC0\x10\x00\x01\x00\x01\x00\x00\x01\x2C\x00\x04\xC0\x00\x02\x02", 16);
+    return msg;
+}
+
+struct seen {
+    std::vector<uint16_t> types;
+    std::vector<enum tiny_dns_section> sections;
+};
+
+static void collect(struct tiny_dns_iter *iter, const struct tiny_dns_rr *rr,
+                    enum tiny_dns_section section, void *context) {
+    struct seen *seen = static_cast<struct seen *>(context);
+    seen->types.push_back(rr->atype);
+    seen->sections.push_back(section);
+}
+
+static tiny_dns_err run(const struct tiny_dns_filter &filter, struct seen &seen) {
+    std::string msg = make_response();
+
+    struct tiny_dns_iter iter;
+    tiny_dns_err err = tiny_dns_iter_init(&iter, msg.data(), msg.size());
+    if (err != TINY_DNS_ERR_NONE) {
+        return err;
+    }
+
+    return tiny_dns_iter_foreach_filtered(&iter, &filter, collect, &seen);
+}
+
+TEST(IterFilter, type) {
+    const uint16_t types[] = { RR_TYPE_A };
+    struct tiny_dns_filter filter = { types, 1, 0 };
+    struct seen seen;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, run(filter, seen));
+
+    ASSERT_EQ(std::vector<uint16_t>({ RR_TYPE_A, RR_TYPE_A }), seen.types);
+    ASSERT_EQ(SECTION_ANSWER, seen.sections[0]);
+    ASSERT_EQ(SECTION_ADDITIONAL, seen.sections[1]);
+}
+
+TEST(IterFilter, type_and_section) {
+    const uint16_t types[] = { RR_TYPE_A, RR_TYPE_CNAME };
+    struct tiny_dns_filter filter = { types, 2, TINY_DNS_SECTION_BIT(SECTION_ANSWER) };
+    struct seen seen;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, run(filter, seen));
+
+    ASSERT_EQ(std::vector<uint16_t>({ RR_TYPE_A, RR_TYPE_CNAME }), seen.types);
+}
+
+TEST(IterFilter, section) {
+    struct tiny_dns_filter filter = { NULL, 0, TINY_DNS_SECTION_BIT(SECTION_ADDITIONAL) };
+    struct seen seen;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, run(filter, seen));
+
+    ASSERT_EQ(std::vector<uint16_t>({ RR_TYPE_A }), seen.types);
+    ASSERT_EQ(SECTION_ADDITIONAL, seen.sections[0]);
+}
+
+TEST(IterFilter, no_match) {
+    const uint16_t types[] = { RR_TYPE_SRV };
+    struct tiny_dns_filter filter = { types, 1, 0 };
+    struct seen seen;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, run(filter, seen));
+    ASSERT_TRUE(seen.types.empty());
+}
+
+TEST(IterFilter, skipped_rdata_not_parsed) {
+    // The zero filter selects everything, so iteration stops at the broken AAAA record
+    struct tiny_dns_filter all = { NULL, 0, 0 };
+    struct seen seen_all;
+    run(all, seen_all);
+    ASSERT_EQ(1, seen_all.types.size());
+
+    // Stepping over it only needs the rdlength, so the rest of the message is still reachable
+    const uint16_t types[] = { RR_TYPE_A, RR_TYPE_CNAME };
+    struct tiny_dns_filter filter = { types, 2, 0 };
+    struct seen seen;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, run(filter, seen));
+    ASSERT_EQ(std::vector<uint16_t>({ RR_TYPE_A, RR_TYPE_CNAME, RR_TYPE_A }), seen.types);
+}
+
+TEST(IterFilter, yield) {
+    std::string msg = make_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    const uint16_t types[] = { RR_TYPE_CNAME };
+    struct tiny_dns_filter filter = { types, 1, 0 };
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield_filtered(&iter, &filter, &rr, &section));
+    ASSERT_EQ(RR_TYPE_CNAME, rr.atype);
+    ASSERT_STREQ("www.example.com", rr.name.name);
+    ASSERT_STREQ("cdn.example.com", rr.rdata.rr_cname.name);
+
+    // Skipped records leave the caller's record alone
+    strcpy(rr.name.name, "untouched");
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_iter_yield_filtered(&iter, &filter, &rr, &section));
+    ASSERT_STREQ("untouched", rr.name.name);
+    ASSERT_EQ(RR_TYPE_CNAME, rr.atype);
+}
+
+TEST(IterFilter, high_type) {
+    // HTTPS (65) answer between two A records, followed by an AAAA
+    std::string msg("\x12\x34\x81\x80\x00\x00\x00\x04\x00\x00\x00\x00", 12);
+    msg.append("\x03www\x07"
+               "example\x03"
+               "com",
+               16);
+    msg.push_back('\0');
+    msg.append("\x00\x01\x00\x01\x00\x00\x01\x2C\x00\x04\xC0\x00\x02\x01", 14);
+    msg.append("\xC0\x0C\x00\x41\x00\x01\x00\x00\x01\x2C\x00\x03\x00\x01\x00", 15);
+    msg.append("\xC0\x0C\x00\x01\x00\x01\x00\x00\x01\x2C\x00\x04\xC0\x00\x02\x02", 16);
+    msg.append("\xC0\x0C\x00\x1C\x00\x01\x00\x00\x01\x2C\x00\x10", 12);
+    msg.append(16, '\x01');
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    const uint16_t types[] = { RR_TYPE_AAAA, 65 };
+    struct tiny_dns_filter filter = { types, 2, 0 };
+    struct seen seen;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_foreach_filtered(&iter, &filter, collect, &seen));
+    ASSERT_EQ(std::vector<uint16_t>({ 65, RR_TYPE_AAAA }), seen.types);
+}
@@ -0,0 +1,168 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "label.h"
+
+static int parse_at(const std::string &raw, size_t offset, std::vector<char> &out) {
+    IOReader rdr;
+    io_reader_init(&rdr, raw.data(), raw.size());
+    rdr.ptr += offset;
+    rdr.remaining -= offset;
+
+    out.assign(512, 0);
+    IOWriter wr;
+    io_writer_init(&wr, out.data(), out.size());
+
+    return tiny_dns_label_parse(&wr, &rdr);
+}
+
+static int cursor_walk(const std::string &raw, size_t offset) {
+    LabelCursor cur;
+    tiny_dns_label_cursor_init(&cur, raw.data(), raw.size(), offset);
+
+    const char *label;
+    int err;
+    while ((err = tiny_dns_label_next(&cur, &label)) > 0) {
+    }
+
+    return err;
+}
+
+static int skip_at(const std::string &raw, size_t offset) {
+    IOReader rdr;
+    io_reader_init(&rdr, raw.data(), raw.size());
+    rdr.ptr += offset;
+    rdr.remaining -= offset;
+
+    return tiny_dns_label_skip(&rdr);
+}
+
+// "x" label followed by pointers, each one pointing at the one before it
+static std::string make_chain(size_t hops) {
+    std::string raw("\x01x", 2);
+    raw.push_back('\0');
+    raw.append("\xC0\x00", 2);
+    for (size_t i = 1; i < hops; i++) {
+        size_t prev = raw.size() - 2;
+        raw.push_back((char)(0xC0 | (prev >> 8)));
+        raw.push_back((char)(prev & 0xFF));
+    }
+    return raw;
+}
+
+static std::string make_long_name(size_t labels, size_t last_len) {
+    std::string raw;
+    for (size_t i = 0; i < labels; i++) {
+        size_t len = (i + 1 == labels) ? last_len : LABEL_MAX_LEN;
+        raw.push_back((char)len);
+        raw.append(len, 'a');
+    }
+    raw.push_back('\0');
+    return raw;
+}
+
+TEST(LabelBounds, self_pointer) {
+    std::string raw("\xC0\x00", 2);
+    std::vector<char> out;
+
+    ASSERT_EQ(LABEL_INVALID_PTR, parse_at(raw, 0, out));
+    ASSERT_EQ(LABEL_INVALID_PTR, cursor_walk(raw, 0));
+}
+
+TEST(LabelBounds, mutual_pointers) {
+    std::string raw("\xC0\x02\xC0\x00", 4);
+    std::vector<char> out;
+
+    ASSERT_EQ(LABEL_INVALID_PTR, parse_at(raw, 0, out));
+    ASSERT_EQ(LABEL_INVALID_PTR, parse_at(raw, 2, out));
+    ASSERT_EQ(LABEL_INVALID_PTR, cursor_walk(raw, 0));
+    ASSERT_EQ(LABEL_INVALID_PTR, cursor_walk(raw, 2));
+}
+
+TEST(LabelBounds, forward_pointer) {
+    std::string raw("\x01"
+                    "a\xC0\x05\x00\x01"
+                    "b",
+                    7);
+    raw.push_back('\0');
+    std::vector<char> out;
+
+    ASSERT_EQ(LABEL_INVALID_PTR, parse_at(raw, 0, out));
+    ASSERT_EQ(LABEL_INVALID_PTR, cursor_walk(raw, 0));
+}
+
+TEST(LabelBounds, hop_limit) {
+    std::vector<char> out;
+
+    std::string raw = make_chain(LABEL_MAX_PTR_HOPS);
+    ASSERT_EQ(3, parse_at(raw, raw.size() - 2, out));
+    ASSERT_EQ(0, std::memcmp(".x\0", out.data(), 3));
+    ASSERT_EQ(0, cursor_walk(raw, raw.size() - 2));
+
+    raw = make_chain(LABEL_MAX_PTR_HOPS + 1);
+    ASSERT_EQ(LABEL_INVALID_PTR, parse_at(raw, raw.size() - 2, out));
+    ASSERT_EQ(LABEL_INVALID_PTR, cursor_walk(raw, raw.size() - 2));
+}
+
+TEST(LabelBounds, max_wire_len) {
+    std::vector<char> out;
+
+    // 3 * (1 + 63) + (1 + 61) + 1 == 255
+    std::string raw = make_long_name(4, 61);
+    ASSERT_EQ(NAME_MAX_WIRE_LEN, raw.size());
+    ASSERT_EQ(NAME_MAX_WIRE_LEN, parse_at(raw, 0, out));
+    ASSERT_EQ(0, cursor_walk(raw, 0));
+    ASSERT_EQ(NAME_MAX_WIRE_LEN, skip_at(raw, 0));
+
+    raw = make_long_name(4, 62);
+    ASSERT_EQ(LABEL_TOO_LONG, parse_at(raw, 0, out));
+    ASSERT_EQ(LABEL_TOO_LONG, cursor_walk(raw, 0));
+    ASSERT_EQ(LABEL_TOO_LONG, skip_at(raw, 0));
+}
+
+TEST(LabelBounds, reserved_label_types) {
+    std::vector<char> out;
+
+    for (char type : { '\x40', '\x80' }) {
+        std::string raw(1, type);
+        raw.append("\x01"
+                   "a",
+                   2);
+        raw.push_back('\0');
+
+        ASSERT_EQ(LABEL_INVALID, parse_at(raw, 0, out));
+        ASSERT_EQ(LABEL_INVALID, cursor_walk(raw, 0));
+        ASSERT_EQ(LABEL_INVALID, skip_at(raw, 0));
+    }
+}
+
+TEST(LabelBounds, truncated_label) {
+    std::string raw("\x05"
+                    "ab",
+                    3);
+    std::vector<char> out;
+
+    ASSERT_EQ(IO_BUF_EMPTY, parse_at(raw, 0, out));
+    ASSERT_EQ(IO_BUF_EMPTY, cursor_walk(raw, 0));
+    ASSERT_EQ(IO_BUF_EMPTY, skip_at(raw, 0));
+}
+
+TEST(LabelBounds, pointer_target_may_not_overlap_pointer) {
+    // The label at 0 claims to run into the pointer that refers to it
+    std::string raw("\x03"
+                    "ab\xC0\x00",
+                    5);
+    std::vector<char> out;
+
+    ASSERT_LT(parse_at(raw, 3, out), 0);
+
+    // Label then a pointer back to it: only the hop limit stops a walk that doesn't slice
+    raw.assign("\x01"
+               "a\xC0\x00",
+               4);
+    ASSERT_LT(parse_at(raw, 0, out), 0);
+    ASSERT_LT(cursor_walk(raw, 0), 0);
+    ASSERT_EQ(4, skip_at(raw, 0));
+}
@@ -0,0 +1,143 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "label.h"
+
+typedef int (*encode_fn)(IOWriter *wr, const char *text);
+
+// Encodes @name from every alignment a vector load can see, with @capacity bytes to write into.
+// Returns the result and wire form of the first alignment, after checking the others agree.
+static int encode(encode_fn fn, const std::string &name, std::string &wire, size_t capacity = 512) {
+    alignas(64) char text[64 + 512];
+    std::vector<char> out(capacity + 1);
+
+    int first = 0;
+    for (size_t align = 0; align < 64; align++) {
+        std::memcpy(&text[align], name.c_str(), name.size() + 1);
+        // Junk after the terminator must not be looked at
+        std::memset(&text[align + name.size() + 1], '.', sizeof(text) - align - name.size() - 1);
+
+        IOWriter wr;
+        io_writer_init(&wr, out.data(), capacity);
+        int err = fn(&wr, &text[align]);
+        std::string got = err > 0 ? std::string(out.data(), err) : "";
+
+        if (align == 0) {
+            first = err;
+            wire = got;
+        } else {
+            EXPECT_EQ(err, first) << name << " at alignment " << align;
+            EXPECT_EQ(got, wire) << name << " at alignment " << align;
+        }
+    }
+
+    return first;
+}
+
+static int encode_both(const std::string &name, std::string &wire, size_t capacity = 512) {
+    std::string scalar;
+    int expected = encode(tiny_dns_label_encode_scalar, name, scalar, capacity);
+    int err = encode(tiny_dns_label_encode, name, wire, capacity);
+    EXPECT_EQ(err, expected) << name;
+    EXPECT_EQ(wire, scalar) << name;
+    return err;
+}
+
+TEST(label_encode, simple) {
+    std::string wire;
+    EXPECT_EQ(encode_both("www.example.com", wire), 17);
+    EXPECT_EQ(wire, std::string("\x03www\x07" "example\x03" "com\x00", 17));
+}
+
+TEST(label_encode, trailing_dot) {
+    std::string wire;
+    EXPECT_EQ(encode_both("www.example.com.", wire), 17);
+    EXPECT_EQ(wire, std::string("\x03www\x07" "example\x03" "com\x00", 17));
+}
+
+TEST(label_encode, root) {
+    std::string wire;
+    EXPECT_EQ(encode_both("", wire), 1);
+    EXPECT_EQ(wire, std::string("\x00", 1));
+
+    EXPECT_EQ(encode_both(".", wire), 1);
+    EXPECT_EQ(wire, std::string("\x00", 1));
+}
+
+TEST(label_encode, empty_label) {
+    std::string wire;
+    for (const char *name : { "..", ".com", "www..com", "com..", "a...", "..." }) {
+        EXPECT_EQ(encode_both(name, wire), LABEL_INVALID) << name;
+    }
+}
+
+TEST(label_encode, label_limit) {
+    std::string wire;
+    std::string label(LABEL_MAX_LEN, 'a');
+
+    EXPECT_EQ(encode_both(label + ".com", wire), LABEL_MAX_LEN + 6);
+    EXPECT_EQ(wire[0], LABEL_MAX_LEN);
+    EXPECT_EQ(encode_both("www." + label, wire), LABEL_MAX_LEN + 6);
+
+    EXPECT_EQ(encode_both(label + "a.com", wire), LABEL_TOO_LONG);
+    EXPECT_EQ(encode_both("www." + label + "a", wire), LABEL_TOO_LONG);
+}
+
+TEST(label_encode, name_limit) {
+    // Four 63 byte labels with three dots is 255 bytes, 2 over the limit. Trim the last label.
+    std::string label(LABEL_MAX_LEN, 'a');
+    std::string longest = label + "." + label + "." + label + "." + label.substr(2);
+    ASSERT_EQ(longest.size(), NAME_MAX_LEN);
+
+    std::string wire;
+    EXPECT_EQ(encode_both(longest, wire), NAME_MAX_WIRE_LEN);
+    EXPECT_EQ(encode_both(longest + ".", wire), NAME_MAX_WIRE_LEN);
+    EXPECT_EQ(encode_both(longest + "a", wire), LABEL_TOO_LONG);
+    EXPECT_EQ(encode_both(longest + ".b", wire), LABEL_TOO_LONG);
+
+    // Way past the limit, the scan must give up rather than walk the whole string
+    std::string huge;
+    for (int i = 0; i < 64; i++) {
+        huge += "abcdefg.";
+    }
+    EXPECT_EQ(encode_both(huge, wire), LABEL_TOO_LONG);
+}
+
+TEST(label_encode, no_space) {
+    std::string wire;
+    EXPECT_EQ(encode_both("www.example.com", wire, 16), IO_BUF_TOO_SMALL);
+    EXPECT_EQ(encode_both("www.example.com", wire, 17), 17);
+}
+
+TEST(label_encode, lengths) {
+    // Every label length and position around the vector widths
+    for (size_t a = 1; a <= 40; a++) {
+        for (size_t b = 1; b <= 40; b++) {
+            std::string name = std::string(a, 'x') + "." + std::string(b, 'y');
+            std::string wire;
+            ASSERT_EQ(encode_both(name, wire), (int)(a + b + 3)) << name;
+            EXPECT_EQ((size_t)wire[0], a);
+            EXPECT_EQ((size_t)wire[a + 1], b);
+        }
+    }
+}
+
+TEST(label_encode, round_trip) {
+    for (const char *name :
+         { "a", "example.com", "_sip._tcp.example.com", "xn--bcher-kva.example" }) {
+        std::string wire;
+        int len = encode_both(name, wire);
+        ASSERT_GT(len, 0) << name;
+
+        IOReader rdr;
+        io_reader_init(&rdr, wire.data(), wire.size());
+        std::vector<char> out(512);
+        IOWriter wr;
+        io_writer_init(&wr, out.data(), out.size());
+
+        ASSERT_EQ(tiny_dns_label_parse(&wr, &rdr), len) << name;
+        EXPECT_EQ(std::string(out.data() + 1), name);
+    }
+}
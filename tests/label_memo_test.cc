@@ -0,0 +1,140 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "label.h"
+#include "tiny_dns.h"
+
+// "example.com" at offset 0, then "a" + ptr, "b" + ptr and a bare ptr, all sharing the suffix
+static std::string make_names() {
+    std::string raw("\x07"
+                    "example\x03"
+                    "com",
+                    12);
+    raw.push_back('\0');
+    raw.append("\x01"
+               "a\xC0\x00",
+               4);
+    raw.append("\x01"
+               "b\xC0\x00",
+               4);
+    raw.append("\xC0\x00", 2);
+    return raw;
+}
+
+static int parse_at(const std::string &raw, size_t offset, char *out, size_t out_len,
+                    struct tiny_dns_label_memo *memo) {
+    IOReader rdr;
+    io_reader_init(&rdr, raw.data(), raw.size());
+    rdr.ptr += offset;
+    rdr.remaining -= offset;
+
+    IOWriter wr;
+    io_writer_init(&wr, out, out_len);
+
+    return tiny_dns_label_parse_memo(&wr, &rdr, memo);
+}
+
+TEST(LabelMemo, miss_then_hit) {
+    std::string raw = make_names();
+
+    struct tiny_dns_label_memo memo;
+    tiny_dns_label_memo_init(&memo);
+
+    char out[64];
+    int err = parse_at(raw, 13, out, sizeof(out), &memo);
+    ASSERT_EQ(15, err);
+    ASSERT_EQ(0, std::memcmp(".a.example.com\0", out, err));
+    ASSERT_EQ(1, memo.count);
+    ASSERT_EQ(0, memo.slots[0].target);
+
+    err = parse_at(raw, 17, out, sizeof(out), &memo);
+    ASSERT_EQ(15, err);
+    ASSERT_EQ(0, std::memcmp(".b.example.com\0", out, err));
+    ASSERT_EQ(1, memo.count);
+
+    err = parse_at(raw, 21, out, sizeof(out), &memo);
+    ASSERT_EQ(13, err);
+    ASSERT_EQ(0, std::memcmp(".example.com\0", out, err));
+    ASSERT_EQ(1, memo.count);
+}
+
+TEST(LabelMemo, null_memo_matches_parse) {
+    std::string raw = make_names();
+
+    char with_memo[64];
+    char without[64];
+    for (size_t offset : { 0, 13, 17, 21 }) {
+        struct tiny_dns_label_memo memo;
+        tiny_dns_label_memo_init(&memo);
+
+        // Prime the memo, then compare a memoized parse against a plain one
+        parse_at(raw, 13, with_memo, sizeof(with_memo), &memo);
+        int a = parse_at(raw, offset, with_memo, sizeof(with_memo), &memo);
+        int b = parse_at(raw, offset, without, sizeof(without), nullptr);
+        ASSERT_EQ(a, b);
+        ASSERT_EQ(0, std::memcmp(with_memo, without, a));
+    }
+}
+
+TEST(LabelMemo, full_memo_starts_over) {
+    std::string raw = make_names();
+
+    struct tiny_dns_label_memo memo;
+    tiny_dns_label_memo_init(&memo);
+    memo.count = TINY_DNS_LABEL_MEMO_SLOTS;
+    for (auto &slot : memo.slots) {
+        slot.target = 0xFFFF;
+        slot.len = 0;
+    }
+
+    char out[64];
+    int err = parse_at(raw, 17, out, sizeof(out), &memo);
+    ASSERT_EQ(15, err);
+    ASSERT_EQ(0, std::memcmp(".b.example.com\0", out, err));
+    ASSERT_EQ(1, memo.count);
+    ASSERT_EQ(0, memo.slots[0].target);
+}
+
+TEST(LabelMemo, iterator_memo_matches_no_memo) {
+    std::string msg("\x12\x34\x81\x80\x00\x01\x00\x03\x00\x00\x00\x00", 12);
+    msg.append("\x03www\x07"
+               "example\x03"
+               "com",
+               16);
+    msg.push_back('\0');
+    msg.append("\x00\x05\x00\x01", 4);
+    // CNAME www.example.com -> cdn.example.com
+    msg.append("\xC0\x0C\x00\x05\x00\x01\x00\x00\x01\x2C\x00\x06\x03"
+               "cdn\xC0\x10",
+               18);
+    // CNAME cdn.example.com -> edge.example.com
+    msg.append("\xC0\x2D\x00\x05\x00\x01\x00\x00\x01\x2C\x00\x07\x04"
+               "edge\xC0\x10",
+               19);
+    // A edge.example.com
+    msg.append("\xC0\x3F\x00\x01\x00\x01\x00\x00\x01\x2C\x00\x04\xC0\x00\x02\x01", 16);
+
+    struct tiny_dns_iter memo_iter;
+    struct tiny_dns_iter plain_iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&memo_iter, msg.data(), msg.size()));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&plain_iter, msg.data(), msg.size()));
+    tiny_dns_iter_set_flags(&plain_iter, TINY_DNS_ITER_NO_MEMO);
+
+    const char *owners[] = { "www.example.com", "cdn.example.com", "edge.example.com" };
+    for (const char *owner : owners) {
+        struct tiny_dns_rr a;
+        struct tiny_dns_rr b;
+        enum tiny_dns_section section;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield(&memo_iter, &a, &section));
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield(&plain_iter, &b, &section));
+        ASSERT_STREQ(owner, a.name.name);
+        ASSERT_STREQ(a.name.name, b.name.name);
+        ASSERT_EQ(a.name.len, b.name.len);
+        if (a.atype == RR_TYPE_CNAME) {
+            ASSERT_STREQ(a.rdata.rr_cname.name, b.rdata.rr_cname.name);
+        }
+    }
+
+    ASSERT_GT(memo_iter.memo.count, 0);
+}
@@ -92,3 +92,41 @@ TEST(Label, label_rfc_1035_sec_414_ex) {
     ASSERT_EQ(wr.len, err);
     ASSERT_EQ(0, std::memcmp(".foo.f.isi.arpa\0", label_out.data(), wr.len));
 }
+
+TEST(LabelSkip, skip_uncompressed) {
+    std::string raw_data = "\x3"
+                           "www\x7"
+                           "example\x3"
+                           "com";
+    raw_data.push_back(0);
+    raw_data.append("\x00\x01", 2);
+
+    IOReader rdr;
+    io_reader_init(&rdr, raw_data.data(), raw_data.length());
+
+    int err = tiny_dns_label_skip(&rdr);
+    ASSERT_EQ(17, err);
+    ASSERT_EQ(2, rdr.remaining);
+    ASSERT_EQ(rdr.base + 17, rdr.ptr);
+}
+
+TEST(LabelSkip, skip_stops_after_pointer) {
+    std::string raw_data = "\x3"
+                           "com";
+    raw_data.push_back(0);
+    raw_data.append("\x4"
+                    "abcd");
+    raw_data.push_back('\xC0');
+    raw_data.push_back('\x00');
+    raw_data.push_back('\x7F');
+
+    IOReader rdr;
+    io_reader_init(&rdr, raw_data.data(), raw_data.length());
+    rdr.ptr += 5;
+    rdr.remaining -= 5;
+
+    int err = tiny_dns_label_skip(&rdr);
+    ASSERT_EQ(7, err);
+    ASSERT_EQ(1, rdr.remaining);
+    ASSERT_EQ('\x7F', *rdr.ptr);
+}
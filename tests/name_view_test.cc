@@ -0,0 +1,98 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "responses.h"
+#include "tiny_dns.h"
+
+static struct tiny_dns_name_view view_at(const std::string &msg, uint16_t offset) {
+    struct tiny_dns_name_view view = { msg.data(), msg.size(), offset };
+    return view;
+}
+
+TEST(NameView, decode) {
+    std::string msg = cname_response();
+    struct tiny_dns_name_view view = view_at(msg, 12);
+
+    struct tiny_dns_name name;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_name_view_decode(&view, &name));
+    ASSERT_STREQ("www.example.com", name.name);
+}
+
+TEST(NameView, len) {
+    std::string msg = cname_response();
+
+    struct tiny_dns_name_view view = view_at(msg, 12);
+    ASSERT_EQ(15, tiny_dns_name_view_len(&view));
+
+    // "example.com" suffix
+    view = view_at(msg, 16);
+    ASSERT_EQ(11, tiny_dns_name_view_len(&view));
+
+    // Root label terminating the question name
+    view = view_at(msg, 28);
+    ASSERT_EQ(0, tiny_dns_name_view_len(&view));
+}
+
+TEST(NameView, eq) {
+    std::string msg = cname_response();
+    struct tiny_dns_name_view view = view_at(msg, 12);
+
+    ASSERT_TRUE(tiny_dns_name_view_eq(&view, "www.example.com"));
+    ASSERT_TRUE(tiny_dns_name_view_eq(&view, "WWW.Example.COM"));
+    ASSERT_TRUE(tiny_dns_name_view_eq(&view, "www.example.com."));
+
+    ASSERT_FALSE(tiny_dns_name_view_eq(&view, "www.example"));
+    ASSERT_FALSE(tiny_dns_name_view_eq(&view, "www.example.co"));
+    ASSERT_FALSE(tiny_dns_name_view_eq(&view, "www.example.com.au"));
+    ASSERT_FALSE(tiny_dns_name_view_eq(&view, "wwwexample.com"));
+    ASSERT_FALSE(tiny_dns_name_view_eq(&view, ""));
+}
+
+TEST(NameView, forward_pointer_rejected) {
+    std::string msg("\xC0\x02\x03"
+                    "abc",
+                    6);
+    msg.push_back('\0');
+    struct tiny_dns_name_view view = view_at(msg, 0);
+
+    ASSERT_LT(tiny_dns_name_view_len(&view), 0);
+    ASSERT_FALSE(tiny_dns_name_view_eq(&view, "abc"));
+}
+
+TEST(NameView, lazy_iteration) {
+    std::string msg = cname_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+    tiny_dns_iter_set_flags(&iter, TINY_DNS_ITER_LAZY_NAMES);
+
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield(&iter, &rr, &section));
+    ASSERT_EQ(SECTION_ANSWER, section);
+    ASSERT_EQ(RR_TYPE_A, rr.atype);
+    ASSERT_EQ(0, rr.name.len);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&rr.owner, "www.example.com"));
+    ASSERT_EQ(0, std::memcmp("\xC0\x00\x02\x01", rr.rdata.rr_a, 4));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield(&iter, &rr, &section));
+    ASSERT_EQ(RR_TYPE_CNAME, rr.atype);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&rr.owner, "www.example.com"));
+    ASSERT_STREQ("cdn.example.com", rr.rdata.rr_cname.name);
+
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_iter_yield(&iter, &rr, &section));
+}
+
+TEST(NameView, eager_iteration_fills_both) {
+    std::string msg = cname_response();
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_init(&iter, msg.data(), msg.size()));
+
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield(&iter, &rr, &section));
+    ASSERT_STREQ("www.example.com", rr.name.name);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&rr.owner, rr.name.name));
+}
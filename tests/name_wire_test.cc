@@ -0,0 +1,178 @@
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "responses.h"
+#include "tiny_dns.h"
+
+// Uncompressed wire form of a dotted name, with a few bytes in front so offset 0 isn't special
+static std::string make_name(const std::string &dotted, uint16_t *offset) {
+    std::string msg("\xAA\xBB\xCC", 3);
+    *offset = (uint16_t)msg.size();
+
+    size_t start = 0;
+    while (start < dotted.size()) {
+        size_t dot = dotted.find('.', start);
+        if (dot == std::string::npos) {
+            dot = dotted.size();
+        }
+        msg.push_back((char)(dot - start));
+        msg.append(dotted, start, dot - start);
+        start = dot + 1;
+    }
+    msg.push_back('\0');
+    return msg;
+}
+
+static struct tiny_dns_name_view view_at(const std::string &msg, uint16_t offset) {
+    struct tiny_dns_name_view view = { msg.data(), msg.size(), offset };
+    return view;
+}
+
+static uint64_t hash_of(const struct tiny_dns_name_view &view) {
+    uint64_t hash = 0;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_name_wire_hash(&view, &hash));
+    return hash;
+}
+
+TEST(NameWire, eq_within_message) {
+    std::string msg = cname_response();
+    struct tiny_dns_name_view question = view_at(msg, 12);
+    // Owner of the A answer, a bare pointer to the question
+    struct tiny_dns_name_view owner = view_at(msg, 33);
+    // CNAME target cdn.example.com
+    struct tiny_dns_name_view target = view_at(msg, 61);
+    struct tiny_dns_name_view suffix = view_at(msg, 16);
+
+    ASSERT_TRUE(tiny_dns_name_wire_eq(&question, &owner));
+    ASSERT_TRUE(tiny_dns_name_wire_eq(&owner, &question));
+    ASSERT_FALSE(tiny_dns_name_wire_eq(&question, &target));
+    ASSERT_FALSE(tiny_dns_name_wire_eq(&question, &suffix));
+    ASSERT_FALSE(tiny_dns_name_wire_eq(&suffix, &question));
+
+    EXPECT_EQ(hash_of(question), hash_of(owner));
+    EXPECT_NE(hash_of(question), hash_of(target));
+}
+
+TEST(NameWire, eq_across_messages) {
+    std::string msg = cname_response();
+    struct tiny_dns_name_view owner = view_at(msg, 33);
+    struct tiny_dns_name_view target = view_at(msg, 61);
+
+    uint16_t offset;
+    std::string upper = make_name("WWW.Example.COM", &offset);
+    struct tiny_dns_name_view other = view_at(upper, offset);
+    std::string cdn = make_name("CDN.example.com", &offset);
+    struct tiny_dns_name_view other_cdn = view_at(cdn, offset);
+
+    ASSERT_TRUE(tiny_dns_name_wire_eq(&owner, &other));
+    ASSERT_TRUE(tiny_dns_name_wire_eq(&target, &other_cdn));
+    ASSERT_FALSE(tiny_dns_name_wire_eq(&owner, &other_cdn));
+
+    EXPECT_EQ(hash_of(owner), hash_of(other));
+    EXPECT_EQ(hash_of(target), hash_of(other_cdn));
+}
+
+TEST(NameWire, case_folding) {
+    // Labels long enough for the vector and word paths, with every letter in both cases
+    std::string lower = "abcdefghijklmnopqrstuvwxyz0123456789-abcdefghijklmnopqrstuvwxyz.example";
+    std::string upper = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-ABCDEFGHIJKLMNOPQRSTUVWXYZ.EXAMPLE";
+
+    uint16_t lower_offset;
+    uint16_t upper_offset;
+    std::string a = make_name(lower, &lower_offset);
+    std::string b = make_name(upper, &upper_offset);
+    struct tiny_dns_name_view va = view_at(a, lower_offset);
+    struct tiny_dns_name_view vb = view_at(b, upper_offset);
+
+    ASSERT_TRUE(tiny_dns_name_wire_eq(&va, &vb));
+    EXPECT_EQ(hash_of(va), hash_of(vb));
+
+    // Only letters fold: '@' and '[' sit right next to 'A' and 'Z', and 0xC1 is 'A' | 0x80
+    uint16_t abc_offset;
+    std::string abc = make_name("abc", &abc_offset);
+    struct tiny_dns_name_view vabc = view_at(abc, abc_offset);
+
+    for (const char *other : { "@bc", "[bc", "\xC1" "bc" }) {
+        uint16_t offset;
+        std::string msg = make_name(other, &offset);
+        struct tiny_dns_name_view view = view_at(msg, offset);
+        ASSERT_FALSE(tiny_dns_name_wire_eq(&vabc, &view)) << other;
+        EXPECT_NE(hash_of(vabc), hash_of(view)) << other;
+    }
+}
+
+TEST(NameWire, every_position) {
+    // A single differing byte is caught wherever it is in a label
+    for (size_t len = 1; len <= 63; len++) {
+        std::string label(len, 'q');
+        uint16_t offset;
+        std::string base = make_name(label + ".com", &offset);
+        struct tiny_dns_name_view vbase = view_at(base, offset);
+
+        for (size_t i = 0; i < len; i++) {
+            std::string changed = label;
+            changed[i] = 'Q';
+            std::string same = make_name(changed + ".com", &offset);
+            struct tiny_dns_name_view vsame = view_at(same, offset);
+            ASSERT_TRUE(tiny_dns_name_wire_eq(&vbase, &vsame)) << len << " " << i;
+            ASSERT_EQ(hash_of(vbase), hash_of(vsame));
+
+            changed[i] = 'r';
+            std::string diff = make_name(changed + ".com", &offset);
+            struct tiny_dns_name_view vdiff = view_at(diff, offset);
+            ASSERT_FALSE(tiny_dns_name_wire_eq(&vbase, &vdiff)) << len << " " << i;
+        }
+    }
+}
+
+TEST(NameWire, label_boundaries) {
+    uint16_t o1;
+    uint16_t o2;
+    std::string a = make_name("ab.c", &o1);
+    std::string b = make_name("a.bc", &o2);
+    struct tiny_dns_name_view va = view_at(a, o1);
+    struct tiny_dns_name_view vb = view_at(b, o2);
+
+    ASSERT_FALSE(tiny_dns_name_wire_eq(&va, &vb));
+    EXPECT_NE(hash_of(va), hash_of(vb));
+}
+
+TEST(NameWire, root) {
+    uint16_t o1;
+    uint16_t o2;
+    std::string root = make_name("", &o1);
+    std::string com = make_name("com", &o2);
+    struct tiny_dns_name_view vroot = view_at(root, o1);
+    struct tiny_dns_name_view vcom = view_at(com, o2);
+
+    ASSERT_TRUE(tiny_dns_name_wire_eq(&vroot, &vroot));
+    ASSERT_FALSE(tiny_dns_name_wire_eq(&vroot, &vcom));
+    ASSERT_FALSE(tiny_dns_name_wire_eq(&vcom, &vroot));
+    EXPECT_NE(hash_of(vroot), hash_of(vcom));
+}
+
+TEST(NameWire, malformed) {
+    // Forward pointer, and a label running off the end of the message
+    std::string forward("\xC0\x02\x03"
+                        "abc",
+                        6);
+    forward.push_back('\0');
+    std::string truncated("\x03"
+                          "ab",
+                          3);
+
+    uint16_t offset;
+    std::string abc = make_name("abc", &offset);
+    struct tiny_dns_name_view good = view_at(abc, offset);
+
+    for (const std::string *bad : { &forward, &truncated }) {
+        struct tiny_dns_name_view view = view_at(*bad, 0);
+        ASSERT_FALSE(tiny_dns_name_wire_eq(&view, &good));
+        ASSERT_FALSE(tiny_dns_name_wire_eq(&good, &view));
+
+        uint64_t hash = 42;
+        ASSERT_LT(tiny_dns_name_wire_hash(&view, &hash), TINY_DNS_ERR_NONE);
+        ASSERT_EQ(42u, hash);
+    }
+}
@@ -0,0 +1,169 @@
+#include <gtest/gtest.h>
+#include <set>
+#include <string>
+
+#include "pool.h"
+#include "upstream.h"
+
+class Pool : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        for (size_t i = 0; i < 2; i++) {
+            upstreams[i].addr = servers[i].addr();
+            upstreams[i].addr_len = servers[i].addr_len();
+        }
+    }
+
+    void TearDown() override {
+        if (started) {
+            tiny_dns_udp_pool_close(&pool);
+        }
+    }
+
+    void start(uint32_t max_uses = 0) {
+        struct tiny_dns_udp_pool_config config = {};
+        config.upstreams = upstreams;
+        config.upstream_count = 2;
+        config.max_uses = max_uses;
+        config.recv_timeout_ms = 1000;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_udp_pool_init(&pool, &config, sockets, 8));
+        started = true;
+    }
+
+    // Send a query on @sock and check it reaches @server from the socket's port
+    void roundtrip(struct tiny_dns_udp_pool_socket *sock, Upstream &server) {
+        uint8_t query[64];
+        size_t len = sizeof(query);
+        ASSERT_EQ(TINY_DNS_ERR_NONE,
+                  tiny_dns_build_query(query, &len, 0x1234, "www.example.com", RR_TYPE_A));
+        ASSERT_EQ((ssize_t)len, send(sock->fd, query, len, 0));
+
+        UpstreamQuery q;
+        ASSERT_TRUE(server.recv(q));
+        ASSERT_EQ(sock->port, ntohs(((struct sockaddr_in *)&q.from)->sin_port));
+        server.send(q, Upstream::answer(q.msg));
+
+        uint8_t response[512];
+        ASSERT_GT(recv(sock->fd, response, sizeof(response), 0), (ssize_t)len);
+        ASSERT_EQ(0x12, response[0]);
+        ASSERT_EQ(0x34, response[1]);
+    }
+
+    Upstream servers[2];
+    struct tiny_dns_udp_upstream upstreams[2] = {};
+    struct tiny_dns_udp_pool pool;
+    struct tiny_dns_udp_pool_socket sockets[8];
+    bool started = false;
+};
+
+TEST_F(Pool, lease_per_upstream) {
+    start();
+    ASSERT_EQ(8u, pool.stats.opened);
+
+    struct tiny_dns_udp_pool_socket *a = tiny_dns_udp_pool_lease(&pool, 0);
+    struct tiny_dns_udp_pool_socket *b = tiny_dns_udp_pool_lease(&pool, 1);
+    ASSERT_NE(nullptr, a);
+    ASSERT_NE(nullptr, b);
+    ASSERT_EQ(0, a->upstream);
+    ASSERT_EQ(1, b->upstream);
+
+    roundtrip(a, servers[0]);
+    roundtrip(b, servers[1]);
+
+    tiny_dns_udp_pool_release(&pool, a, true);
+    tiny_dns_udp_pool_release(&pool, b, true);
+    ASSERT_EQ(8u, pool.stats.opened);
+    ASSERT_EQ(2u, pool.stats.leases);
+}
+
+TEST_F(Pool, reused_without_reopening) {
+    start();
+
+    struct tiny_dns_udp_pool_socket *sock = tiny_dns_udp_pool_lease(&pool, 0);
+    ASSERT_NE(nullptr, sock);
+    int fd = sock->fd;
+    uint16_t port = sock->port;
+    tiny_dns_udp_pool_release(&pool, sock, true);
+
+    // The most recently returned socket is leased first, while it's warm
+    sock = tiny_dns_udp_pool_lease(&pool, 0);
+    ASSERT_EQ(fd, sock->fd);
+    ASSERT_EQ(port, sock->port);
+    roundtrip(sock, servers[0]);
+    tiny_dns_udp_pool_release(&pool, sock, true);
+}
+
+TEST_F(Pool, distinct_ports) {
+    start();
+
+    std::set<uint16_t> ports;
+    for (const auto &sock : sockets) {
+        ASSERT_GE(sock.fd, 0);
+        ports.insert(sock.port);
+    }
+    ASSERT_EQ(8u, ports.size());
+}
+
+TEST_F(Pool, exhausted) {
+    start();
+
+    struct tiny_dns_udp_pool_socket *leased[4];
+    for (auto &sock : leased) {
+        sock = tiny_dns_udp_pool_lease(&pool, 0);
+        ASSERT_NE(nullptr, sock);
+    }
+    ASSERT_EQ(nullptr, tiny_dns_udp_pool_lease(&pool, 0));
+    ASSERT_EQ(1u, pool.stats.exhausted);
+
+    // The other upstream's sockets aren't touched
+    ASSERT_NE(nullptr, tiny_dns_udp_pool_lease(&pool, 1));
+
+    tiny_dns_udp_pool_release(&pool, leased[2], true);
+    ASSERT_EQ(leased[2], tiny_dns_udp_pool_lease(&pool, 0));
+}
+
+TEST_F(Pool, unhealthy_reopened) {
+    start();
+
+    struct tiny_dns_udp_pool_socket *sock = tiny_dns_udp_pool_lease(&pool, 0);
+    ASSERT_NE(nullptr, sock);
+    uint16_t port = sock->port;
+    tiny_dns_udp_pool_release(&pool, sock, false);
+    ASSERT_EQ(1u, pool.stats.reopened);
+    ASSERT_EQ(9u, pool.stats.opened);
+
+    sock = tiny_dns_udp_pool_lease(&pool, 0);
+    ASSERT_NE(port, sock->port);
+    roundtrip(sock, servers[0]);
+    tiny_dns_udp_pool_release(&pool, sock, true);
+}
+
+TEST_F(Pool, max_uses) {
+    start(2);
+
+    struct tiny_dns_udp_pool_socket *sock = tiny_dns_udp_pool_lease(&pool, 1);
+    tiny_dns_udp_pool_release(&pool, sock, true);
+    ASSERT_EQ(0u, pool.stats.reopened);
+
+    sock = tiny_dns_udp_pool_lease(&pool, 1);
+    ASSERT_EQ(2u, sock->uses);
+    tiny_dns_udp_pool_release(&pool, sock, true);
+    ASSERT_EQ(1u, pool.stats.reopened);
+    ASSERT_EQ(0u, sock->uses);
+}
+
+TEST_F(Pool, invalid) {
+    struct tiny_dns_udp_pool_config config = {};
+    config.upstreams = upstreams;
+    config.upstream_count = 2;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_udp_pool_init(&pool, &config, sockets, 7));
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_udp_pool_init(&pool, &config, sockets, 0));
+
+    config.upstream_count = 0;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_udp_pool_init(&pool, &config, sockets, 8));
+
+    struct tiny_dns_udp_upstream bad = {};
+    config.upstreams = &bad;
+    config.upstream_count = 1;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_udp_pool_init(&pool, &config, sockets, 8));
+}
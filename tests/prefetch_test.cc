@@ -0,0 +1,164 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "prefetch.h"
+#include "upstream.h"
+
+class Prefetch : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        struct tiny_dns_resolver_config config = {};
+        config.server = upstream.addr();
+        config.server_len = upstream.addr_len();
+        config.timeout_ms = 100;
+        config.attempts = 1;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_init(&res, &config, buckets, 16));
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_init(&cache, mem.data(), mem.size()));
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_prefetcher_init(&pf, &res, &cache, slots, 2));
+
+        struct tiny_dns_cache_prefetch policy = { 1, 10 };
+        tiny_dns_cache_set_prefetch(&cache, &policy);
+    }
+
+    void TearDown() override { tiny_dns_resolver_close(&res); }
+
+    // Answer the next query the upstream gets with @addr, as the resolver would see it
+    void answer(const char *addr) {
+        UpstreamQuery q;
+        ASSERT_TRUE(upstream.recv(q));
+        upstream.send(q, Upstream::answer(q.msg, addr));
+    }
+
+    // Poll until no refresh is outstanding
+    void settle() {
+        for (int waited = 0; tiny_dns_prefetcher_in_flight(&pf) > 0 && waited < 2000;
+             waited += 10) {
+            ASSERT_GE(tiny_dns_resolver_poll(&res, 10), 0);
+        }
+    }
+
+    tiny_dns_err lookup(uint64_t now) {
+        struct tiny_dns_query_template tmpl;
+        EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, "www.example.com", RR_TYPE_A));
+        struct tiny_dns_name_view view = { reinterpret_cast<const char *>(tmpl.msg), tmpl.len,
+                                           12 };
+        len = sizeof(buffer);
+        return tiny_dns_cache_lookup(&cache, &view, RR_TYPE_A, CLASS_IN, now, buffer, &len, &hit);
+    }
+
+    Upstream upstream;
+    struct tiny_dns_resolver res;
+    struct tiny_dns_resolver_query *buckets[16];
+    std::vector<char> mem = std::vector<char>(64 * 1024);
+    struct tiny_dns_cache cache;
+    struct tiny_dns_prefetcher pf;
+    struct tiny_dns_prefetch_slot slots[2];
+    char buffer[TINY_DNS_CACHE_MSG_MAX];
+    size_t len;
+    struct tiny_dns_cache_hit hit;
+};
+
+TEST_F(Prefetch, refresh) {
+    // Cached at 1000 for 300 seconds
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_prefetcher_refresh(&pf, "www.example.com", RR_TYPE_A, 1000));
+    answer("\xC0\x00\x02\x01");
+    settle();
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(1000));
+    ASSERT_FALSE(hit.prefetch);
+
+    // Hot and close to expiry: the lookup is answered and a refresh started
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(1280));
+    ASSERT_TRUE(hit.prefetch);
+    ASSERT_EQ(20u, hit.ttl);
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_prefetcher_refresh(&pf, "www.example.com", RR_TYPE_A, 1280));
+    ASSERT_EQ(1u, tiny_dns_prefetcher_in_flight(&pf));
+
+    // Lookups keep hitting the old answer until the new one arrives
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(1281));
+    ASSERT_FALSE(hit.prefetch);
+    answer("\xC0\x00\x02\x02");
+    settle();
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(1310));
+    ASSERT_EQ(270u, hit.ttl);
+    // The address is the last thing in the response
+    ASSERT_EQ(std::string("\xC0\x00\x02\x02", 4), std::string(buffer + len - 4, 4));
+
+    ASSERT_EQ(2u, pf.stats.started);
+    ASSERT_EQ(2u, pf.stats.refreshed);
+    ASSERT_EQ(0u, pf.stats.failed);
+}
+
+// An expired entry is served while its refresh is outstanding, and while the upstream is down
+TEST_F(Prefetch, stale) {
+    struct tiny_dns_cache_stale policy = { 3600, 30 };
+    tiny_dns_cache_set_stale(&cache, &policy);
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_prefetcher_refresh(&pf, "www.example.com", RR_TYPE_A, 1000));
+    answer("\xC0\x00\x02\x01");
+    settle();
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(1400));
+    ASSERT_TRUE(hit.stale);
+    ASSERT_TRUE(hit.prefetch);
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_prefetcher_refresh(&pf, "www.example.com", RR_TYPE_A, 1400));
+
+    // Unanswered
+    UpstreamQuery q;
+    ASSERT_TRUE(upstream.recv(q));
+    settle();
+    ASSERT_EQ(1u, pf.stats.failed);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(1410));
+    ASSERT_TRUE(hit.stale);
+    ASSERT_FALSE(hit.prefetch);
+
+    // Asked again a stale TTL later, and answered this time
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(1430));
+    ASSERT_TRUE(hit.prefetch);
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_prefetcher_refresh(&pf, "www.example.com", RR_TYPE_A, 1430));
+    answer("\xC0\x00\x02\x02");
+    settle();
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(1430));
+    ASSERT_FALSE(hit.stale);
+    ASSERT_EQ(300u, hit.ttl);
+}
+
+TEST_F(Prefetch, failed) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_prefetcher_refresh(&pf, "www.example.com", RR_TYPE_A, 1000));
+    UpstreamQuery q;
+    ASSERT_TRUE(upstream.recv(q));
+    settle();
+
+    // No answers isn't worth caching either
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_prefetcher_refresh(&pf, "www.example.com", RR_TYPE_A, 1000));
+    answer(NULL);
+    settle();
+
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(1000));
+    ASSERT_EQ(2u, pf.stats.failed);
+    ASSERT_EQ(0u, pf.stats.refreshed);
+}
+
+TEST_F(Prefetch, busy) {
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_prefetcher_refresh(&pf, "a.example.com", RR_TYPE_A, 0));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_prefetcher_refresh(&pf, "b.example.com", RR_TYPE_A, 0));
+    ASSERT_EQ(TINY_DNS_ERR_NO_SPACE,
+              tiny_dns_prefetcher_refresh(&pf, "c.example.com", RR_TYPE_A, 0));
+    ASSERT_EQ(1u, pf.stats.busy);
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_prefetcher_refresh(&pf, NULL, RR_TYPE_A, 0));
+
+    // Cancelled refreshes free their slots and are never stored
+    tiny_dns_prefetcher_cancel(&pf);
+    ASSERT_EQ(0u, tiny_dns_prefetcher_in_flight(&pf));
+    ASSERT_EQ(0u, tiny_dns_resolver_in_flight(&res));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_prefetcher_refresh(&pf, "c.example.com", RR_TYPE_A, 0));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_prefetcher_refresh(&pf, "d.example.com", RR_TYPE_A, 0));
+}
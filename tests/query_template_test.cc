@@ -0,0 +1,91 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+
+#include "tiny_dns.h"
+
+static std::string build_query(uint16_t id, const char *name, enum tiny_dns_rr_type qtype) {
+    char buffer[TINY_DNS_QUERY_MAX_LEN];
+    size_t len = sizeof(buffer);
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_build_query(buffer, &len, id, name, qtype));
+    return std::string(buffer, len);
+}
+
+TEST(QueryTemplate, matches_build_query) {
+    struct tiny_dns_query_template tmpl;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, "www.example.com", RR_TYPE_A));
+
+    const uint16_t ids[] = { 0, 0xdb42, 0xFFFF };
+    for (uint16_t id : ids) {
+        char buffer[512];
+        size_t len = sizeof(buffer);
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_render(&tmpl, buffer, &len, id));
+        ASSERT_EQ(build_query(id, "www.example.com", RR_TYPE_A), std::string(buffer, len));
+    }
+}
+
+TEST(QueryTemplate, qtype) {
+    struct tiny_dns_query_template tmpl;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, "www.example.com", RR_TYPE_A));
+
+    char buffer[512];
+    size_t len = sizeof(buffer);
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_query_render_qtype(&tmpl, buffer, &len, 0x1234, RR_TYPE_AAAA));
+    ASSERT_EQ(build_query(0x1234, "www.example.com", RR_TYPE_AAAA), std::string(buffer, len));
+
+    // The template itself is unchanged
+    len = sizeof(buffer);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_render(&tmpl, buffer, &len, 0x1234));
+    ASSERT_EQ(build_query(0x1234, "www.example.com", RR_TYPE_A), std::string(buffer, len));
+}
+
+TEST(QueryTemplate, buffer_too_small) {
+    struct tiny_dns_query_template tmpl;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, "www.example.com", RR_TYPE_A));
+
+    char buffer[512];
+    size_t len = tmpl.len - 1;
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_query_render(&tmpl, buffer, &len, 1));
+
+    len = tmpl.len;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_render(&tmpl, buffer, &len, 1));
+}
+
+TEST(QueryTemplate, max_len) {
+    // Four labels of 63, 63, 63 and 61 characters make a 253 character name
+    std::string name = std::string(63, 'a') + "." + std::string(63, 'b') + "." +
+                       std::string(63, 'c') + "." + std::string(61, 'd');
+    ASSERT_EQ(253, name.size());
+
+    struct tiny_dns_query_template tmpl;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, name.c_str(), RR_TYPE_A));
+    ASSERT_EQ(12 + 255 + 4, tmpl.len);
+
+    name += "d";
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_query_prepare(&tmpl, name.c_str(), RR_TYPE_A));
+}
+
+TEST(QueryTemplate, trailing_dot) {
+    struct tiny_dns_query_template tmpl;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, "example.com.", RR_TYPE_A));
+
+    char buffer[512];
+    size_t len = sizeof(buffer);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_render(&tmpl, buffer, &len, 7));
+    ASSERT_EQ(build_query(7, "example.com", RR_TYPE_A), std::string(buffer, len));
+}
+
+TEST(QueryTemplate, invalid_names) {
+    const char *names[] = {
+        "..",
+        ".example.com",
+        "www..example.com",
+        "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa.com",
+    };
+
+    for (const char *name : names) {
+        struct tiny_dns_query_template tmpl;
+        ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_query_prepare(&tmpl, name, RR_TYPE_A)) << name;
+    }
+}
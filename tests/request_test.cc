@@ -0,0 +1,123 @@
+#include <gtest/gtest.h>
+#include <string>
+
+#include "tiny_dns.h"
+
+static std::string make_query(const char *name, enum tiny_dns_rr_type qtype) {
+    char buffer[TINY_DNS_QUERY_MAX_LEN];
+    size_t len = sizeof(buffer);
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_build_query(buffer, &len, 0xdb42, name, qtype));
+    return std::string(buffer, len);
+}
+
+TEST(Request, parse) {
+    std::string msg = make_query("www.example.com", RR_TYPE_AAAA);
+
+    struct tiny_dns_request req;
+    struct tiny_dns_question_view questions[2];
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_request_parse(&req, msg.data(), msg.size(), questions, 2));
+
+    ASSERT_EQ(0xdb42, req.header.id);
+    ASSERT_TRUE(req.header.flags.rd);
+    ASSERT_EQ(1, req.header.qdcount);
+    ASSERT_EQ(msg.size(), req.questions_end);
+
+    ASSERT_TRUE(tiny_dns_name_view_eq(&questions[0].qname, "www.example.com"));
+    ASSERT_EQ(12, questions[0].qname.offset);
+    ASSERT_EQ(17, questions[0].qname_wire_len);
+    ASSERT_EQ(RR_TYPE_AAAA, questions[0].qtype);
+    ASSERT_EQ(CLASS_IN, questions[0].qclass);
+}
+
+TEST(Request, compressed_question) {
+    // Two questions, the second pointing into the first
+    std::string msg("\x00\x01\x01\x00\x00\x02\x00\x00\x00\x00\x00\x00", 12);
+    msg.append("\x07"
+               "example\x03"
+               "com",
+               12);
+    msg.push_back('\0');
+    msg.append("\x00\x01\x00\x01", 4);
+    msg.append("\x03www\xC0\x0C\x00\x1C\x00\x01", 10);
+
+    struct tiny_dns_request req;
+    struct tiny_dns_question_view questions[2];
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_request_parse(&req, msg.data(), msg.size(), questions, 2));
+
+    ASSERT_TRUE(tiny_dns_name_view_eq(&questions[1].qname, "www.example.com"));
+    ASSERT_EQ(6, questions[1].qname_wire_len);
+    ASSERT_EQ(RR_TYPE_AAAA, questions[1].qtype);
+    ASSERT_EQ(msg.size(), req.questions_end);
+}
+
+TEST(Request, root_question) {
+    std::string msg("\x00\x01\x00\x00\x00\x01\x00\x00\x00\x00\x00\x00\x00\x00\x02\x00\x01", 17);
+
+    struct tiny_dns_request req;
+    struct tiny_dns_question_view q;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_request_parse(&req, msg.data(), msg.size(), &q, 1));
+    ASSERT_EQ(1, q.qname_wire_len);
+    ASSERT_EQ(2, q.qtype);
+    ASSERT_TRUE(tiny_dns_name_view_eq(&q.qname, "."));
+}
+
+TEST(Request, reject_response) {
+    std::string msg = make_query("www.example.com", RR_TYPE_A);
+    msg[2] |= '\x80';
+
+    struct tiny_dns_request req;
+    struct tiny_dns_question_view q;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_request_parse(&req, msg.data(), msg.size(), &q, 1));
+}
+
+TEST(Request, reject_opcode) {
+    // OPCODE_STATUS
+    std::string msg = make_query("www.example.com", RR_TYPE_A);
+    msg[2] |= '\x10';
+
+    struct tiny_dns_request req;
+    struct tiny_dns_question_view q;
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              tiny_dns_request_parse(&req, msg.data(), msg.size(), &q, 1));
+
+    // Enough to answer with NOTIMP
+    ASSERT_EQ(0xdb42, req.header.id);
+    ASSERT_EQ(OPCODE_STATUS, req.header.flags.opcode);
+}
+
+TEST(Request, too_many_questions) {
+    std::string msg = make_query("www.example.com", RR_TYPE_A);
+    msg[5] = 2;
+
+    struct tiny_dns_request req;
+    struct tiny_dns_question_view q;
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_request_parse(&req, msg.data(), msg.size(), &q, 1));
+}
+
+TEST(Request, malformed) {
+    std::string query = make_query("www.example.com", RR_TYPE_A);
+
+    struct tiny_dns_request req;
+    struct tiny_dns_question_view q;
+
+    // Shorter than a header
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_request_parse(&req, query.data(), 11, &q, 1));
+
+    // Truncated inside the name, and inside the qclass
+    ASSERT_LT(tiny_dns_request_parse(&req, query.data(), 20, &q, 1), TINY_DNS_ERR_NONE);
+    ASSERT_LT(tiny_dns_request_parse(&req, query.data(), query.size() - 1, &q, 1),
+              TINY_DNS_ERR_NONE);
+
+    // Claims a second question that isn't there
+    std::string msg = query;
+    msg[5] = 2;
+    ASSERT_LT(tiny_dns_request_parse(&req, msg.data(), msg.size(), &q, 2), TINY_DNS_ERR_NONE);
+
+    // Pointer to itself
+    msg = query;
+    msg[12] = '\xC0';
+    msg[13] = '\x0C';
+    ASSERT_LT(tiny_dns_request_parse(&req, msg.data(), msg.size(), &q, 1), TINY_DNS_ERR_NONE);
+}
@@ -0,0 +1,369 @@
+#include <gtest/gtest.h>
+#include <map>
+#include <sys/epoll.h>
+#include <thread>
+#include <string>
+#include <vector>
+
+#include "resolver.h"
+#include "upstream.h"
+
+struct Outcome {
+    int calls = 0;
+    tiny_dns_err err = TINY_DNS_ERR_NONE;
+    std::string response;
+};
+
+static void record(struct tiny_dns_resolver_query *query, tiny_dns_err err,
+                   const uint8_t *response, size_t len, void *context) {
+    (void)query;
+    Outcome *outcome = static_cast<Outcome *>(context);
+    outcome->calls++;
+    outcome->err = err;
+    outcome->response.assign(reinterpret_cast<const char *>(response), response ? len : 0);
+}
+
+// Every test runs against each backend. io_uring is skipped unless built in and supported.
+class Resolver : public ::testing::TestWithParam<enum tiny_dns_resolver_backend> {
+  protected:
+    void SetUp() override { start(200, 2); }
+
+    void TearDown() override {
+        if (started) {
+            tiny_dns_resolver_close(&res);
+        }
+    }
+
+    void start(uint32_t timeout_ms, uint8_t attempts) {
+        struct tiny_dns_resolver_config config = {};
+        config.server = upstream.addr();
+        config.server_len = upstream.addr_len();
+        config.timeout_ms = timeout_ms;
+        config.attempts = attempts;
+        config.rcvbuf = 4 << 20;
+        config.backend = GetParam();
+
+        tiny_dns_err err = tiny_dns_resolver_init(&res, &config, buckets, 1024);
+        if (err == TINY_DNS_ERR_UNSUPPORTED) {
+            started = false;
+            GTEST_SKIP() << "backend not available";
+        }
+        ASSERT_EQ(TINY_DNS_ERR_NONE, err);
+        started = true;
+    }
+
+    // Poll until @outcome is called back or @timeout_ms passes
+    void wait_for(const Outcome &outcome, int timeout_ms = 2000) {
+        for (int waited = 0; outcome.calls == 0 && waited < timeout_ms; waited += 10) {
+            ASSERT_GE(tiny_dns_resolver_poll(&res, 10), 0);
+        }
+    }
+
+    Upstream upstream;
+    bool started = false;
+    struct tiny_dns_resolver res;
+    struct tiny_dns_resolver_query *buckets[1024];
+};
+
+TEST_P(Resolver, answer) {
+    struct tiny_dns_resolver_query query = {};
+    Outcome outcome;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+    ASSERT_EQ(1u, tiny_dns_resolver_in_flight(&res));
+
+    UpstreamQuery q;
+    ASSERT_TRUE(upstream.recv(q));
+    ASSERT_EQ("www.example.com", Upstream::qname(q.msg));
+    upstream.send(q, Upstream::answer(q.msg));
+
+    wait_for(outcome);
+    ASSERT_EQ(1, outcome.calls);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, outcome.err);
+    ASSERT_EQ(0u, tiny_dns_resolver_in_flight(&res));
+
+    struct tiny_dns_iter iter;
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_iter_init(&iter, outcome.response.data(), outcome.response.size()));
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_iter_yield(&iter, &rr, &section));
+    ASSERT_EQ(RR_TYPE_A, rr.atype);
+    ASSERT_EQ(0, memcmp(rr.rdata.rr_a, "\xC0\x00\x02\x01", 4));
+}
+
+TEST_P(Resolver, external_epoll) {
+    struct tiny_dns_resolver_query query = {};
+    Outcome outcome;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+
+    int epfd = epoll_create1(0);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ASSERT_EQ(0, epoll_ctl(epfd, EPOLL_CTL_ADD, tiny_dns_resolver_fd(&res), &ev));
+
+    // Answered from another thread while this one sleeps in the caller's own epoll set, so
+    // nothing but the resolver's fd can wake it
+    UpstreamQuery q;
+    ASSERT_TRUE(upstream.recv(q));
+    std::thread answer([&] {
+        usleep(50000);
+        upstream.send(q, Upstream::answer(q.msg));
+    });
+    int ready;
+    do {
+        ready = epoll_wait(epfd, &ev, 1, 1000);
+    } while (ready < 0 && errno == EINTR);
+    answer.join();
+    close(epfd);
+
+    ASSERT_EQ(1, ready);
+    ASSERT_EQ(1, tiny_dns_resolver_process(&res));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, outcome.err);
+}
+
+TEST_P(Resolver, many_in_flight) {
+    // Generous timeout, answering thousands of queries takes a while under the sanitizers
+    tiny_dns_resolver_close(&res);
+    started = false;
+    start(5000, 1);
+
+    const size_t count = 2000;
+    std::vector<struct tiny_dns_resolver_query> queries(count);
+    std::vector<Outcome> outcomes(count);
+
+    for (size_t i = 0; i < count; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &queries[i], name.c_str(),
+                                                              RR_TYPE_A, record, &outcomes[i]));
+    }
+    ASSERT_EQ(count, tiny_dns_resolver_in_flight(&res));
+
+    std::vector<UpstreamQuery> received(count);
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_TRUE(upstream.recv(received[i]));
+    }
+
+    // Answer in reverse, and check every answer went to the query that asked for it
+    for (size_t i = count; i-- > 0;) {
+        upstream.send(received[i], Upstream::answer(received[i].msg));
+    }
+
+    for (int waited = 0; tiny_dns_resolver_in_flight(&res) > 0 && waited < 5000; waited += 10) {
+        ASSERT_GE(tiny_dns_resolver_poll(&res, 10), 0);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(1, outcomes[i].calls) << i;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, outcomes[i].err);
+        ASSERT_EQ("host" + std::to_string(i) + ".example.com",
+                  Upstream::qname(outcomes[i].response));
+    }
+    ASSERT_EQ(count, res.stats.answered);
+}
+
+TEST_P(Resolver, submit_batch) {
+    const size_t count = 300;
+    std::vector<struct tiny_dns_resolver_query> queries(count);
+    std::vector<Outcome> outcomes(count);
+    std::vector<std::string> names;
+    std::vector<const char *> name_ptrs;
+    std::vector<void *> contexts;
+    for (size_t i = 0; i < count; i++) {
+        names.push_back("batch" + std::to_string(i) + ".example.com");
+        contexts.push_back(&outcomes[i]);
+    }
+    for (const std::string &name : names) {
+        name_ptrs.push_back(name.c_str());
+    }
+
+    // One bad name and nothing is submitted
+    name_ptrs[count / 2] = "bad..name";
+    ASSERT_EQ(TINY_DNS_ERR_INVALID,
+              tiny_dns_resolver_submit_batch(&res, queries.data(), name_ptrs.data(), count,
+                                             RR_TYPE_A, record, contexts.data()));
+    ASSERT_EQ(0u, tiny_dns_resolver_in_flight(&res));
+    name_ptrs[count / 2] = names[count / 2].c_str();
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_resolver_submit_batch(&res, queries.data(), name_ptrs.data(), count,
+                                             RR_TYPE_A, record, contexts.data()));
+    ASSERT_EQ(count, tiny_dns_resolver_in_flight(&res));
+    ASSERT_EQ(count, res.stats.sent);
+
+    for (size_t i = 0; i < count; i++) {
+        UpstreamQuery q;
+        ASSERT_TRUE(upstream.recv(q));
+        upstream.send(q, Upstream::answer(q.msg));
+    }
+
+    for (int waited = 0; tiny_dns_resolver_in_flight(&res) > 0 && waited < 2000; waited += 10) {
+        ASSERT_GE(tiny_dns_resolver_poll(&res, 10), 0);
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        ASSERT_EQ(1, outcomes[i].calls) << i;
+        ASSERT_EQ(names[i], Upstream::qname(outcomes[i].response));
+    }
+}
+
+TEST_P(Resolver, submit_batch_send_fails) {
+    struct tiny_dns_resolver_query queries[2] = {};
+    const char *names[] = { "a.example.com", "b.example.com" };
+    Outcome outcomes[2];
+    void *contexts[] = { &outcomes[0], &outcomes[1] };
+
+    // Sends fail with EPIPE, so neither query is left waiting for a timeout
+    ASSERT_EQ(0, shutdown(res.fd, SHUT_WR));
+    tiny_dns_err err = tiny_dns_resolver_submit_batch(&res, queries, names, 2, RR_TYPE_A, record,
+                                                      contexts);
+    if (GetParam() == TINY_DNS_RESOLVER_IO_URING) {
+        // Sends complete asynchronously, so the failure reaches the callbacks instead
+        ASSERT_EQ(TINY_DNS_ERR_NONE, err);
+        wait_for(outcomes[1], 100);
+        ASSERT_EQ(TINY_DNS_ERR_IO, outcomes[0].err);
+        ASSERT_EQ(TINY_DNS_ERR_IO, outcomes[1].err);
+    } else {
+        ASSERT_EQ(TINY_DNS_ERR_IO, err);
+        ASSERT_EQ(0, outcomes[0].calls);
+    }
+    ASSERT_EQ(0u, tiny_dns_resolver_in_flight(&res));
+    ASSERT_EQ(-1, tiny_dns_resolver_timeout_ms(&res));
+}
+
+TEST_P(Resolver, mismatch_dropped) {
+    struct tiny_dns_resolver_query query = {};
+    Outcome outcome;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+
+    UpstreamQuery q;
+    ASSERT_TRUE(upstream.recv(q));
+
+    // Wrong ID, wrong question, the query itself echoed back, then the real answer
+    upstream.send(q, Upstream::answer(q.msg, "\x01\x02\x03\x04", 1));
+    std::string other = q.msg;
+    other[13] = 'x';
+    upstream.send(q, Upstream::answer(other));
+    upstream.send(q, q.msg);
+    upstream.send(q, Upstream::answer(q.msg));
+
+    wait_for(outcome);
+    ASSERT_EQ(1, outcome.calls);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, outcome.err);
+    ASSERT_EQ(Upstream::answer(q.msg), outcome.response);
+    ASSERT_EQ(3u, res.stats.dropped);
+}
+
+TEST_P(Resolver, retry_then_answer) {
+    struct tiny_dns_resolver_query query = {};
+    Outcome outcome;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+
+    // Drop the first attempt and answer the retry
+    UpstreamQuery first;
+    ASSERT_TRUE(upstream.recv(first));
+
+    UpstreamQuery second;
+    for (int waited = 0; waited < 1000 && !upstream.recv(second, 0); waited += 10) {
+        ASSERT_GE(tiny_dns_resolver_poll(&res, 10), 0);
+    }
+    ASSERT_EQ(first.msg, second.msg);
+    ASSERT_EQ(0, outcome.calls);
+
+    upstream.send(second, Upstream::answer(second.msg));
+    wait_for(outcome);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, outcome.err);
+    ASSERT_EQ(1u, res.stats.retries);
+}
+
+TEST_P(Resolver, timeout) {
+    struct tiny_dns_resolver_query query = {};
+    Outcome outcome;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+
+    // 2 attempts of 200ms each
+    ASSERT_GE(tiny_dns_resolver_timeout_ms(&res), 190);
+    wait_for(outcome);
+    ASSERT_EQ(1, outcome.calls);
+    ASSERT_EQ(TINY_DNS_ERR_TIMEOUT, outcome.err);
+    ASSERT_TRUE(outcome.response.empty());
+    ASSERT_EQ(0u, tiny_dns_resolver_in_flight(&res));
+    ASSERT_EQ(-1, tiny_dns_resolver_timeout_ms(&res));
+    ASSERT_EQ(1u, res.stats.timeouts);
+
+    // Both attempts reached the server; a late answer is dropped
+    UpstreamQuery q;
+    ASSERT_TRUE(upstream.recv(q, 0));
+    ASSERT_TRUE(upstream.recv(q, 0));
+    upstream.send(q, Upstream::answer(q.msg));
+    ASSERT_EQ(0, tiny_dns_resolver_poll(&res, 100));
+    ASSERT_EQ(1u, res.stats.dropped);
+}
+
+TEST_P(Resolver, retry_send_fails) {
+    struct tiny_dns_resolver_query query = {};
+    Outcome outcome;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+
+    // Sends fail with EPIPE from now on, so the retry can't go out
+    ASSERT_EQ(0, shutdown(res.fd, SHUT_WR));
+    wait_for(outcome);
+    ASSERT_EQ(1, outcome.calls);
+    ASSERT_EQ(TINY_DNS_ERR_IO, outcome.err);
+    ASSERT_EQ(0u, tiny_dns_resolver_in_flight(&res));
+    ASSERT_EQ(0u, res.stats.timeouts);
+}
+
+TEST_P(Resolver, cancel) {
+    struct tiny_dns_resolver_query query = {};
+    Outcome outcome;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+    tiny_dns_resolver_cancel(&res, &query);
+    tiny_dns_resolver_cancel(&res, &query);
+    ASSERT_EQ(0u, tiny_dns_resolver_in_flight(&res));
+
+    UpstreamQuery q;
+    ASSERT_TRUE(upstream.recv(q));
+    upstream.send(q, Upstream::answer(q.msg));
+    ASSERT_EQ(0, tiny_dns_resolver_poll(&res, 100));
+    ASSERT_EQ(0, outcome.calls);
+
+    // The slot can be reused
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+}
+
+TEST_P(Resolver, invalid) {
+    struct tiny_dns_resolver_query query = {};
+    Outcome outcome;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID,
+              tiny_dns_resolver_submit(&res, &query, "www..com", RR_TYPE_A, record, &outcome));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                          RR_TYPE_A, record, &outcome));
+    // Already outstanding
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_resolver_submit(&res, &query, "www.example.com",
+                                                             RR_TYPE_A, record, &outcome));
+
+    struct tiny_dns_resolver other;
+    struct tiny_dns_resolver_config config = {};
+    config.server = upstream.addr();
+    config.server_len = upstream.addr_len();
+    config.timeout_ms = 100;
+    config.attempts = 1;
+    config.backend = GetParam();
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_resolver_init(&other, &config, buckets, 1000));
+    config.attempts = 0;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_resolver_init(&other, &config, buckets, 1024));
+}
+
+INSTANTIATE_TEST_SUITE_P(Backends, Resolver,
+                         ::testing::Values(TINY_DNS_RESOLVER_EPOLL, TINY_DNS_RESOLVER_IO_URING),
+                         [](const ::testing::TestParamInfo<enum tiny_dns_resolver_backend> &info) {
+                             return info.param == TINY_DNS_RESOLVER_EPOLL ? "epoll" : "io_uring";
+                         });
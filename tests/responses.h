@@ -0,0 +1,98 @@
+// Responses shared by the tests. Those the parsers are tested on are built by hand, so tests can
+// refer to the offsets of their names and records; those for the caches go through the builder.
+
+#ifndef TINY_DNS_TESTS_RESPONSES_H
+#define TINY_DNS_TESTS_RESPONSES_H
+
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "tiny_dns.h"
+
+// SRV response for _svc._tcp.example.com: two SRV answers, one NS authority record with empty
+// rdata, and A and AAAA glue for the SRV targets in the additional section.
+inline std::string srv_response() {
+    std::string msg("\x12\x34\x81\x80\x00\x01\x00\x02\x00\x01\x00\x03", 12);
+    // Question at offset 12, "example.com" at offset 22
+    msg.append("\x04_svc\x04_tcp\x07"
+               "example\x03"
+               "com",
+               22);
+    msg.push_back('\0');
+    msg.append("\x00\x21\x00\x01", 4);
+    // SRV 10 5 8080 a.example.com, target at offset 57
+    msg.append("\xC0\x0C\x00\x21\x00\x01\x00\x00\x00\x3C\x00\x0A\x00\x0A\x00\x05\x1F\x90\x01"
+               "a\xC0\x16",
+               22);
+    // SRV 20 5 8080 b.example.com, target at offset 79
+    msg.append("\xC0\x0C\x00\x21\x00\x01\x00\x00\x00\x3C\x00\x0A\x00\x14\x00\x05\x1F\x90\x01"
+               "b\xC0\x16",
+               22);
+    // Authority record of an unknown type without rdata
+    msg.append("\xC0\x16\x00\x63\x00\x01\x00\x00\x00\x3C\x00\x00", 12);
+    // A a.example.com, AAAA a.example.com, A b.example.com
+    msg.append("\xC0\x39\x00\x01\x00\x01\x00\x00\x00\x3C\x00\x04\xC0\x00\x02\x01", 16);
+    msg.append("\xC0\x39\x00\x1C\x00\x01\x00\x00\x00\x3C\x00\x10"
+               "\x20\x01\x0d\xb8\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x00\x01",
+               28);
+    msg.append("\xC0\x4F\x00\x01\x00\x01\x00\x00\x00\x3C\x00\x04\xC0\x00\x02\x02", 16);
+    return msg;
+}
+
+// Response to www.example.com A with an A answer owned by the question name and a CNAME answer
+// to cdn.example.com, whose "example.com" suffix points at offset 16.
+inline std::string cname_response() {
+    std::string msg("\x12\x34\x81\x80\x00\x01\x00\x02\x00\x00\x00\x00", 12);
+    // Question at offset 12
+    msg.append("\x03www\x07"
+               "example\x03"
+               "com",
+               16);
+    msg.push_back('\0');
+    msg.append("\x00\x01\x00\x01", 4);
+    // A www.example.com 192.0.2.1
+    msg.append("\xC0\x0C\x00\x01\x00\x01\x00\x00\x01\x2C\x00\x04\xC0\x00\x02\x01", 16);
+    // CNAME www.example.com -> cdn.example.com
+    msg.append("\xC0\x0C\x00\x05\x00\x01\x00\x00\x01\x2C\x00\x06\x03"
+               "cdn\xC0\x10",
+               18);
+    return msg;
+}
+
+// Response to a question for @name with one A record per TTL in @ttls. Record i has the address
+// 10.<tag>.<i>, with @tag taking up the middle two octets, so tests can tell responses apart.
+inline std::string response(const char *name, uint16_t qtype, std::vector<uint32_t> ttls,
+                            enum tiny_dns_rcode rcode = RCODE_NOERROR, bool tc = false,
+                            uint16_t tag = 0) {
+    char buffer[1024];
+    struct tiny_dns_header header = {};
+    header.id = 0x1234;
+    header.flags.qr = true;
+    header.flags.tc = tc;
+    header.flags.rcode = rcode;
+
+    struct tiny_dns_builder builder;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header));
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_question(&builder, name, qtype, CLASS_IN));
+
+    for (size_t i = 0; i < ttls.size(); i++) {
+        struct tiny_dns_rr rr = {};
+        strcpy(rr.name.name, name);
+        rr.atype = RR_TYPE_A;
+        rr.aclass = CLASS_IN;
+        rr.ttl = ttls[i];
+        rr.rdata.rr_a[0] = 10;
+        rr.rdata.rr_a[1] = (uint8_t)(tag >> 8);
+        rr.rdata.rr_a[2] = (uint8_t)tag;
+        rr.rdata.rr_a[3] = (uint8_t)i;
+        EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_rr(&builder, SECTION_ANSWER, &rr));
+    }
+
+    size_t len;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_builder_finish(&builder, &len));
+    return std::string(buffer, len);
+}
+
+#endif  // TINY_DNS_TESTS_RESPONSES_H
@@ -0,0 +1,281 @@
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "responses.h"
+#include "tiny_dns.h"
+
+// Response for host<n>.example.com whose single A record is 10.<n>.0, so a reader can tell
+// whether what it got belongs to the name it asked for
+static std::string host_response(uint16_t n, uint32_t ttl = 300) {
+    std::string name = "host" + std::to_string(n) + ".example.com";
+    return response(name.c_str(), RR_TYPE_A, { ttl }, RCODE_NOERROR, false, n);
+}
+
+// Lookup key for host<n>.example.com
+struct Key {
+    explicit Key(uint16_t n) {
+        std::string name = "host" + std::to_string(n) + ".example.com";
+        EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, name.c_str(), RR_TYPE_A));
+    }
+
+    struct tiny_dns_name_view view() const {
+        return { reinterpret_cast<const char *>(tmpl.msg), tmpl.len, 12 };
+    }
+
+    struct tiny_dns_query_template tmpl;
+};
+
+// The tag in a response built by host_response(), or -1 if it doesn't parse
+static int answer_of(const char *msg, size_t len) {
+    struct tiny_dns_iter iter;
+    struct tiny_dns_rr rr;
+    enum tiny_dns_section section;
+    if (tiny_dns_iter_init(&iter, (void *)msg, len) != TINY_DNS_ERR_NONE ||
+        tiny_dns_iter_yield(&iter, &rr, &section) != TINY_DNS_ERR_NONE) {
+        return -1;
+    }
+    return rr.rdata.rr_a[1] << 8 | rr.rdata.rr_a[2];
+}
+
+class ShardCache : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_init(&cache, mem.data(), mem.size(), 8));
+    }
+
+    tiny_dns_err lookup(uint16_t n, uint64_t now = 1000) {
+        Key key(n);
+        struct tiny_dns_name_view view = key.view();
+        len = sizeof(buffer);
+        return tiny_dns_shard_cache_lookup(&cache, &view, RR_TYPE_A, CLASS_IN, now, buffer,
+                                           &len, &hit, &stats);
+    }
+
+    std::vector<char> mem = std::vector<char>(256 * 1024);
+    struct tiny_dns_shard_cache cache;
+    struct tiny_dns_cache_stats stats = {};
+    char buffer[TINY_DNS_CACHE_MSG_MAX];
+    size_t len;
+    struct tiny_dns_cache_hit hit;
+};
+
+TEST_F(ShardCache, hit) {
+    ASSERT_GE(tiny_dns_shard_cache_capacity(&cache), 400u);
+
+    for (uint16_t n = 0; n < 100; n++) {
+        std::string msg = host_response(n);
+        ASSERT_EQ(TINY_DNS_ERR_NONE,
+                  tiny_dns_shard_cache_insert(&cache, msg.data(), msg.size(), 1000));
+    }
+
+    for (uint16_t n = 0; n < 100; n++) {
+        ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(n, 1010));
+        ASSERT_EQ(host_response(n, 290), std::string(buffer, len));
+        ASSERT_EQ(290u, hit.ttl);
+    }
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(100));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(0, 1300));
+
+    ASSERT_EQ(100u, stats.hits);
+    ASSERT_EQ(2u, stats.misses);
+
+    struct tiny_dns_cache_stats shared;
+    tiny_dns_shard_cache_stats(&cache, &shared);
+    ASSERT_EQ(100u, shared.inserts);
+    ASSERT_EQ(0u, shared.hits);
+}
+
+TEST_F(ShardCache, remove) {
+    std::string msg = host_response(7);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_insert(&cache, msg.data(), msg.size(), 1000));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7));
+
+    Key key(7);
+    struct tiny_dns_name_view view = key.view();
+    tiny_dns_shard_cache_remove(&cache, &view, RR_TYPE_A, CLASS_IN);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(7));
+}
+
+TEST_F(ShardCache, small_buffer) {
+    std::string msg = host_response(7);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_insert(&cache, msg.data(), msg.size(), 1000));
+
+    Key key(7);
+    struct tiny_dns_name_view view = key.view();
+    len = 10;
+    ASSERT_EQ(TINY_DNS_ERR_NO_BUF, tiny_dns_shard_cache_lookup(&cache, &view, RR_TYPE_A,
+                                                               CLASS_IN, 1000, buffer, &len,
+                                                               NULL, NULL));
+}
+
+TEST_F(ShardCache, prefetch) {
+    struct tiny_dns_cache_prefetch policy = { 2, 20 };
+    tiny_dns_shard_cache_set_prefetch(&cache, &policy);
+    std::string msg = host_response(7, 100);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_insert(&cache, msg.data(), msg.size(), 1000));
+
+    for (int i = 0; i < 3; i++) {
+        ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7));
+        ASSERT_FALSE(hit.prefetch);
+    }
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7, 1085));
+    ASSERT_TRUE(hit.prefetch);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7, 1086));
+    ASSERT_FALSE(hit.prefetch);
+    ASSERT_EQ(1u, stats.prefetches);
+}
+
+TEST_F(ShardCache, stale) {
+    struct tiny_dns_cache_stale policy = { 60, 5 };
+    tiny_dns_shard_cache_set_stale(&cache, &policy);
+    std::string msg = host_response(7, 100);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_insert(&cache, msg.data(), msg.size(), 1000));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7, 1100));
+    ASSERT_TRUE(hit.stale);
+    ASSERT_TRUE(hit.prefetch);
+    ASSERT_EQ(5u, hit.ttl);
+    ASSERT_EQ(host_response(7, 5), std::string(buffer, len));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7, 1104));
+    ASSERT_FALSE(hit.prefetch);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(7, 1160));
+    ASSERT_EQ(2u, stats.stale);
+}
+
+TEST_F(ShardCache, invalid) {
+    struct tiny_dns_shard_cache other;
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_shard_cache_init(&other, mem.data(), mem.size(), 3));
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_shard_cache_init(&other, mem.data(), mem.size(), 0));
+    ASSERT_EQ(TINY_DNS_ERR_INVALID,
+              tiny_dns_shard_cache_init(&other, mem.data(), mem.size(),
+                                        TINY_DNS_CACHE_SHARDS_MAX * 2));
+    ASSERT_EQ(TINY_DNS_ERR_NO_SPACE, tiny_dns_shard_cache_init(&other, mem.data(), 4096, 8));
+}
+
+// Readers race writers that keep evicting and replacing entries. Every hit must be whole and
+// belong to the name that was looked up.
+TEST_F(ShardCache, concurrent) {
+    // Small enough that the writers evict constantly
+    std::vector<char> small(64 * 1024);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_init(&cache, small.data(), small.size(), 4));
+
+    const uint16_t names = 1000;
+    std::vector<std::string> responses;
+    std::vector<Key> keys;
+    for (uint16_t n = 0; n < names; n++) {
+        responses.push_back(host_response(n));
+        keys.emplace_back(n);
+    }
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> hits(0);
+    std::atomic<uint64_t> wrong(0);
+
+    std::vector<std::thread> threads;
+    for (int w = 0; w < 2; w++) {
+        threads.emplace_back([&, w] {
+            for (uint32_t i = w; !stop; i += 7) {
+                const std::string &msg = responses[i % names];
+                tiny_dns_shard_cache_insert(&cache, msg.data(), msg.size(), 1000);
+            }
+        });
+    }
+    for (int r = 0; r < 4; r++) {
+        threads.emplace_back([&, r] {
+            char out[TINY_DNS_CACHE_MSG_MAX];
+            for (uint32_t i = r; !stop; i += 3) {
+                uint16_t n = i % names;
+                size_t out_len = sizeof(out);
+                struct tiny_dns_name_view view = keys[n].view();
+                tiny_dns_err err = tiny_dns_shard_cache_lookup(&cache, &view, RR_TYPE_A,
+                                                               CLASS_IN, 1000, out, &out_len,
+                                                               NULL, NULL);
+                if (err == TINY_DNS_ERR_NONE) {
+                    hits++;
+                    if (std::string(out, out_len) != responses[n] || answer_of(out, out_len) != n) {
+                        wrong++;
+                    }
+                }
+            }
+        });
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+    stop = true;
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    ASSERT_GT(hits.load(), 0u);
+    ASSERT_EQ(0u, wrong.load());
+
+    struct tiny_dns_cache_stats shared;
+    tiny_dns_shard_cache_stats(&cache, &shared);
+    ASSERT_GT(shared.evictions, 0u);
+}
+
+TEST_F(ShardCache, dead_writer) {
+    std::string msg = host_response(7);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_insert(&cache, msg.data(), msg.size(), 1000));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7));
+
+    // A writer that died mid-update leaves its shard's sequence odd. Each shard's sync is a cache
+    // line after the header: the writers' lock, then the sequence.
+    char *header = mem.data() + (64 - (uintptr_t)mem.data() % 64) % 64;
+    for (size_t i = 0; i < 8; i++) {
+        uint32_t seq = 1;
+        memcpy(header + 64 + i * 64 + sizeof(pthread_mutex_t), &seq, sizeof(seq));
+    }
+
+    // Lookups give up on the shard rather than wait for it forever
+    auto start = std::chrono::steady_clock::now();
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(7));
+    ASSERT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(1));
+    ASSERT_EQ(1u, stats.misses);
+
+    for (size_t i = 0; i < 8; i++) {
+        uint32_t seq = 2;
+        memcpy(header + 64 + i * 64 + sizeof(pthread_mutex_t), &seq, sizeof(seq));
+    }
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7));
+}
+
+TEST_F(ShardCache, attach) {
+    std::string msg = host_response(7);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_insert(&cache, msg.data(), msg.size(), 1000));
+
+    // Another process mapping the same memory sees what was inserted, and vice versa
+    struct tiny_dns_shard_cache other;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_attach(&other, mem.data(), mem.size()));
+    ASSERT_EQ(tiny_dns_shard_cache_capacity(&cache), tiny_dns_shard_cache_capacity(&other));
+    msg = host_response(8);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shard_cache_insert(&other, msg.data(), msg.size(), 1000));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(7));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(8));
+}
+
+TEST_F(ShardCache, attach_invalid) {
+    struct tiny_dns_shard_cache other;
+    std::vector<char> zero(mem.size());
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND,
+              tiny_dns_shard_cache_attach(&other, zero.data(), zero.size()));
+
+    // Missing the last shard
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_shard_cache_attach(&other, mem.data(), 128 * 1024));
+
+    // The header starts at the first cache line, with the magic followed by the version
+    char *header = mem.data() + (64 - (uintptr_t)mem.data() % 64) % 64;
+    header[4] ^= 1;
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              tiny_dns_shard_cache_attach(&other, mem.data(), mem.size()));
+    header[0] ^= 1;
+    header[4] ^= 1;
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED,
+              tiny_dns_shard_cache_attach(&other, mem.data(), mem.size()));
+}
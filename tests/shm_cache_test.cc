@@ -0,0 +1,180 @@
+#include <cstring>
+#include <fcntl.h>
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "responses.h"
+#include "shm_cache.h"
+
+static tiny_dns_err lookup(struct tiny_dns_shm_cache *shm, const char *name) {
+    struct tiny_dns_query_template tmpl;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, name, RR_TYPE_A));
+    struct tiny_dns_name_view view = { reinterpret_cast<const char *>(tmpl.msg), tmpl.len, 12 };
+
+    char buffer[TINY_DNS_CACHE_MSG_MAX];
+    size_t len = sizeof(buffer);
+    return tiny_dns_shard_cache_lookup(&shm->cache, &view, RR_TYPE_A, CLASS_IN, 1000, buffer, &len,
+                                       NULL, NULL);
+}
+
+class ShmCache : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        char tmpl[] = "/tmp/tiny_dns_shm_cache_XXXXXX";
+        int fd = mkstemp(tmpl);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        path = tmpl;
+        // The cache creates the file itself
+        unlink(path.c_str());
+    }
+
+    void TearDown() override {
+        unlink(path.c_str());
+    }
+
+    std::string path;
+};
+
+TEST_F(ShmCache, shared_between_mappings) {
+    struct tiny_dns_shm_cache a = {};
+    struct tiny_dns_shm_cache b = {};
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shm_cache_open(&a, path.c_str(), 256 * 1024, 4));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shm_cache_open(&b, path.c_str(), 256 * 1024, 4));
+    ASSERT_NE(a.mem, b.mem);
+
+    std::string msg = response("www.example.com", RR_TYPE_A, { 300 });
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_shard_cache_insert(&a.cache, msg.data(), msg.size(), 1000));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(&b, "www.example.com"));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(&b, "mail.example.com"));
+
+    tiny_dns_shm_cache_close(&a);
+    tiny_dns_shm_cache_close(&b);
+}
+
+TEST_F(ShmCache, shared_across_processes) {
+    struct tiny_dns_shm_cache shm = {};
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shm_cache_open(&shm, path.c_str(), 256 * 1024, 4));
+
+    // The child maps the file on its own rather than inheriting the parent's mapping
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        struct tiny_dns_shm_cache child = {};
+        std::string msg = response("www.example.com", RR_TYPE_A, { 300 });
+        bool ok = tiny_dns_shm_cache_open(&child, path.c_str(), 4096, 1) == TINY_DNS_ERR_NONE &&
+                  tiny_dns_shard_cache_insert(&child.cache, msg.data(), msg.size(), 1000) ==
+                      TINY_DNS_ERR_NONE;
+        _exit(ok ? 0 : 1);
+    }
+
+    int status;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFEXITED(status));
+    ASSERT_EQ(0, WEXITSTATUS(status));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(&shm, "www.example.com"));
+    tiny_dns_shm_cache_close(&shm);
+}
+
+TEST_F(ShmCache, killed_writer) {
+    struct tiny_dns_shm_cache shm = {};
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shm_cache_open(&shm, path.c_str(), 256 * 1024, 4));
+    std::string msg = response("www.example.com", RR_TYPE_A, { 300 });
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_shard_cache_insert(&shm.cache, msg.data(), msg.size(), 1000));
+
+    // The child is killed halfway through changing every shard. Each shard's sync is a cache line
+    // after the header: the writers' lock, then the sequence.
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        struct tiny_dns_shm_cache child = {};
+        if (tiny_dns_shm_cache_open(&child, path.c_str(), 4096, 1) != TINY_DNS_ERR_NONE) {
+            _exit(1);
+        }
+        char *sync = static_cast<char *>(child.mem) + 64;
+        for (size_t i = 0; i < 4; i++) {
+            pthread_mutex_lock(reinterpret_cast<pthread_mutex_t *>(sync + i * 64));
+            uint32_t seq = 1;
+            memcpy(sync + i * 64 + sizeof(pthread_mutex_t), &seq, sizeof(seq));
+        }
+        raise(SIGKILL);
+    }
+
+    int status;
+    ASSERT_EQ(pid, waitpid(pid, &status, 0));
+    ASSERT_TRUE(WIFSIGNALED(status));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(&shm, "www.example.com"));
+
+    // Writers take the locks over, emptying the shards the child may have left half changed
+    alarm(10);
+    struct tiny_dns_cache_stats stats;
+    tiny_dns_shard_cache_stats(&shm.cache, &stats);
+    ASSERT_EQ(1u, stats.inserts);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(&shm, "www.example.com"));
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_shard_cache_insert(&shm.cache, msg.data(), msg.size(), 1000));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(&shm, "www.example.com"));
+
+    struct tiny_dns_query_template tmpl;
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, "www.example.com", RR_TYPE_A));
+    struct tiny_dns_name_view view = { reinterpret_cast<const char *>(tmpl.msg), tmpl.len, 12 };
+    tiny_dns_shard_cache_remove(&shm.cache, &view, RR_TYPE_A, CLASS_IN);
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(&shm, "www.example.com"));
+    alarm(0);
+
+    tiny_dns_shm_cache_close(&shm);
+}
+
+TEST_F(ShmCache, keeps_existing_layout) {
+    struct tiny_dns_shm_cache a = {};
+    struct tiny_dns_shm_cache b = {};
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shm_cache_open(&a, path.c_str(), 256 * 1024, 4));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shm_cache_open(&b, path.c_str(), 64 * 1024, 16));
+
+    ASSERT_EQ(a.size, b.size);
+    ASSERT_EQ(3u, b.cache.shard_mask);
+    ASSERT_EQ(tiny_dns_shard_cache_capacity(&a.cache), tiny_dns_shard_cache_capacity(&b.cache));
+
+    tiny_dns_shm_cache_close(&a);
+    tiny_dns_shm_cache_close(&b);
+}
+
+TEST_F(ShmCache, unfinished_layout) {
+    // As left by a creator that died before writing anything
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ(0, ftruncate(fd, 128 * 1024));
+    close(fd);
+
+    struct tiny_dns_shm_cache shm = {};
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_shm_cache_open(&shm, path.c_str(), 4096, 2));
+    ASSERT_EQ(128u * 1024, shm.size);
+    ASSERT_EQ(1u, shm.cache.shard_mask);
+    tiny_dns_shm_cache_close(&shm);
+}
+
+TEST_F(ShmCache, foreign_file) {
+    int fd = open(path.c_str(), O_RDWR | O_CREAT, 0600);
+    ASSERT_GE(fd, 0);
+    std::string text(4096, 'x');
+    ASSERT_EQ((ssize_t)text.size(), write(fd, text.data(), text.size()));
+    close(fd);
+
+    struct tiny_dns_shm_cache shm = {};
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED, tiny_dns_shm_cache_open(&shm, path.c_str(), 4096, 2));
+    ASSERT_EQ(nullptr, shm.mem);
+}
+
+TEST_F(ShmCache, invalid) {
+    struct tiny_dns_shm_cache shm = {};
+    ASSERT_EQ(TINY_DNS_ERR_INVALID, tiny_dns_shm_cache_open(&shm, path.c_str(), 0, 2));
+    ASSERT_EQ(TINY_DNS_ERR_IO, tiny_dns_shm_cache_open(&shm, "/nonexistent/cache", 4096, 2));
+}
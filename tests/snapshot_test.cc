@@ -0,0 +1,98 @@
+#include <cstring>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "responses.h"
+#include "snapshot.h"
+
+static tiny_dns_err lookup(struct tiny_dns_cache *cache, const char *name, uint64_t now,
+                           struct tiny_dns_cache_hit *hit) {
+    struct tiny_dns_query_template tmpl;
+    EXPECT_EQ(TINY_DNS_ERR_NONE, tiny_dns_query_prepare(&tmpl, name, RR_TYPE_A));
+    struct tiny_dns_name_view view = { reinterpret_cast<const char *>(tmpl.msg), tmpl.len, 12 };
+
+    char buffer[TINY_DNS_CACHE_MSG_MAX];
+    size_t len = sizeof(buffer);
+    return tiny_dns_cache_lookup(cache, &view, RR_TYPE_A, CLASS_IN, now, buffer, &len, hit);
+}
+
+class Snapshot : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        char tmpl[] = "/tmp/tiny_dns_snapshot_XXXXXX";
+        int fd = mkstemp(tmpl);
+        ASSERT_GE(fd, 0);
+        close(fd);
+        path = tmpl;
+
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_init(&cache, mem.data(), mem.size()));
+    }
+
+    void TearDown() override {
+        unlink(path.c_str());
+    }
+
+    std::string path;
+    std::vector<char> mem = std::vector<char>(64 * 1024);
+    struct tiny_dns_cache cache;
+};
+
+TEST_F(Snapshot, save_and_open) {
+    for (int i = 0; i < 50; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        std::string msg = response(name.c_str(), RR_TYPE_A, { 300 });
+        ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_insert(&cache, msg.data(), msg.size(), 1000));
+    }
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_save_file(&cache, path.c_str(), 1000, 7000));
+    ASSERT_NE(0, access((path + ".tmp").c_str(), F_OK));
+
+    struct tiny_dns_cache_file file = {};
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_open_file(&file, path.c_str(), 5, 7100));
+    ASSERT_EQ(tiny_dns_cache_capacity(&cache), tiny_dns_cache_capacity(&file.cache));
+
+    for (int i = 0; i < 50; i++) {
+        std::string name = "host" + std::to_string(i) + ".example.com";
+        struct tiny_dns_cache_hit hit;
+        ASSERT_EQ(TINY_DNS_ERR_NONE, lookup(&file.cache, name.c_str(), 5, &hit));
+        ASSERT_EQ(200u, hit.ttl);
+    }
+
+    // The mapping is private, so using the cache leaves the file as saved
+    std::string msg = response("new.example.com", RR_TYPE_A, { 300 });
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_insert(&file.cache, msg.data(), msg.size(), 5));
+    tiny_dns_cache_close_file(&file);
+
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_open_file(&file, path.c_str(), 5, 7100));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(&file.cache, "new.example.com", 5, NULL));
+    tiny_dns_cache_close_file(&file);
+}
+
+TEST_F(Snapshot, expired_while_down) {
+    std::string msg = response("www.example.com", RR_TYPE_A, { 300 });
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_insert(&cache, msg.data(), msg.size(), 1000));
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_save_file(&cache, path.c_str(), 1000, 7000));
+
+    struct tiny_dns_cache_file file = {};
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_cache_open_file(&file, path.c_str(), 5, 7300));
+    ASSERT_EQ(TINY_DNS_ERR_NOT_FOUND, lookup(&file.cache, "www.example.com", 5, NULL));
+    tiny_dns_cache_close_file(&file);
+}
+
+TEST_F(Snapshot, not_a_snapshot) {
+    struct tiny_dns_cache_file file = {};
+    ASSERT_EQ(TINY_DNS_ERR_IO, tiny_dns_cache_open_file(&file, path.c_str(), 0, 0));
+    ASSERT_EQ(TINY_DNS_ERR_IO, tiny_dns_cache_open_file(&file, "/nonexistent/snapshot", 0, 0));
+
+    FILE *f = fopen(path.c_str(), "w");
+    ASSERT_NE(nullptr, f);
+    std::string text(4096, 'x');
+    fwrite(text.data(), 1, text.size(), f);
+    fclose(f);
+    ASSERT_EQ(TINY_DNS_ERR_UNSUPPORTED, tiny_dns_cache_open_file(&file, path.c_str(), 0, 0));
+    ASSERT_EQ(nullptr, file.mem);
+
+    ASSERT_EQ(TINY_DNS_ERR_IO,
+              tiny_dns_cache_save_file(&cache, "/nonexistent/snapshot", 1000, 7000));
+}
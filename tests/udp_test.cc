@@ -0,0 +1,138 @@
+#include <arpa/inet.h>
+#include <gtest/gtest.h>
+#include <poll.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "udp.h"
+#include "upstream.h"
+
+// A client socket connected to a server socket, both on loopback
+class Udp : public ::testing::Test {
+  protected:
+    void SetUp() override {
+        client = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK, 0);
+        ASSERT_GE(client, 0);
+        ASSERT_EQ(0, connect(client, (const struct sockaddr *)&upstream.addr(),
+                             upstream.addr_len()));
+    }
+
+    void TearDown() override { close(client); }
+
+    // Wait for at least one datagram on fd
+    static void wait_readable(int fd) {
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        ASSERT_EQ(1, poll(&pfd, 1, 1000));
+    }
+
+    Upstream upstream;
+    int client;
+};
+
+struct Buffers {
+    explicit Buffers(size_t count, size_t capacity = 512)
+        : storage(count, std::vector<uint8_t>(capacity)), msgs(count) {
+        for (size_t i = 0; i < count; i++) {
+            msgs[i].data = storage[i].data();
+            msgs[i].capacity = capacity;
+            msgs[i].len = 0;
+            msgs[i].peer_len = 0;
+        }
+    }
+
+    std::vector<std::vector<uint8_t>> storage;
+    std::vector<struct tiny_dns_udp_msg> msgs;
+};
+
+TEST_F(Udp, build_send_parse) {
+    // More than one system call's worth
+    const size_t count = TINY_DNS_UDP_BATCH_MAX + 36;
+
+    std::vector<std::string> names;
+    std::vector<const char *> name_ptrs;
+    for (size_t i = 0; i < count; i++) {
+        names.push_back("host" + std::to_string(i) + ".example.com");
+    }
+    for (const std::string &name : names) {
+        name_ptrs.push_back(name.c_str());
+    }
+
+    Buffers queries(count);
+    ASSERT_EQ(TINY_DNS_ERR_NONE, tiny_dns_udp_build_queries(queries.msgs.data(), name_ptrs.data(),
+                                                            count, 0x100, RR_TYPE_AAAA));
+    ASSERT_EQ((int)count, tiny_dns_udp_send(client, queries.msgs.data(), count));
+
+    // The server answers each query, in order
+    std::vector<std::string> expected;
+    for (size_t i = 0; i < count; i++) {
+        UpstreamQuery q;
+        ASSERT_TRUE(upstream.recv(q));
+        ASSERT_EQ(names[i], Upstream::qname(q.msg));
+        ASSERT_EQ(0x100 + i, (size_t)((uint8_t)q.msg[0] << 8 | (uint8_t)q.msg[1]));
+        expected.push_back(Upstream::answer(q.msg));
+        upstream.send(q, expected.back());
+    }
+
+    Buffers responses(count);
+    size_t received = 0;
+    while (received < count) {
+        wait_readable(client);
+        int n = tiny_dns_udp_recv(client, &responses.msgs[received], count - received);
+        ASSERT_GT(n, 0);
+        received += (size_t)n;
+    }
+
+    std::vector<struct tiny_dns_iter> iters(count);
+    std::vector<tiny_dns_err> errs(count);
+    ASSERT_EQ(count, tiny_dns_udp_parse_responses(responses.msgs.data(), iters.data(), errs.data(),
+                                                  count));
+
+    for (size_t i = 0; i < count; i++) {
+        const struct tiny_dns_udp_msg &msg = responses.msgs[i];
+        ASSERT_EQ(expected[i], std::string((const char *)msg.data, msg.len));
+        ASSERT_EQ(TINY_DNS_ERR_NONE, errs[i]);
+        ASSERT_EQ(0x100 + i, iters[i].header.id);
+        ASSERT_EQ((socklen_t)sizeof(struct sockaddr_in), msg.peer_len);
+    }
+
+    // Nothing more to read
+    ASSERT_EQ(0, tiny_dns_udp_recv(client, responses.msgs.data(), count));
+}
+
+TEST_F(Udp, truncated_dropped) {
+    const char *names[] = { "a.example.com" };
+    Buffers query(1);
+    ASSERT_EQ(TINY_DNS_ERR_NONE,
+              tiny_dns_udp_build_queries(query.msgs.data(), names, 1, 1, RR_TYPE_A));
+    ASSERT_EQ(1, tiny_dns_udp_send(client, query.msgs.data(), 1));
+
+    UpstreamQuery q;
+    ASSERT_TRUE(upstream.recv(q));
+    std::string answer = Upstream::answer(q.msg);
+    upstream.send(q, answer);
+    upstream.send(q, answer);
+
+    // The first buffer is too small for the answer, the second is fine
+    Buffers responses(2);
+    responses.msgs[0].capacity = answer.size() - 1;
+    wait_readable(client);
+    usleep(10000);
+    ASSERT_EQ(2, tiny_dns_udp_recv(client, responses.msgs.data(), 2));
+    ASSERT_EQ(0u, responses.msgs[0].len);
+    ASSERT_EQ(answer.size(), responses.msgs[1].len);
+
+    std::vector<struct tiny_dns_iter> iters(2);
+    std::vector<tiny_dns_err> errs(2);
+    ASSERT_EQ(1u,
+              tiny_dns_udp_parse_responses(responses.msgs.data(), iters.data(), errs.data(), 2));
+    ASSERT_NE(TINY_DNS_ERR_NONE, errs[0]);
+}
+
+TEST_F(Udp, invalid_name) {
+    const char *names[] = { "ok.example.com", "bad..example.com" };
+    Buffers queries(2);
+    ASSERT_EQ(TINY_DNS_ERR_INVALID,
+              tiny_dns_udp_build_queries(queries.msgs.data(), names, 2, 1, RR_TYPE_A));
+    ASSERT_GT(queries.msgs[0].len, 0u);
+}
@@ -0,0 +1,124 @@
+// Stand-in nameserver on loopback for the transport tests. Answers are built by hand, so a test
+// can delay, drop, reorder or corrupt them at will.
+
+#ifndef TINY_DNS_TESTS_UPSTREAM_H
+#define TINY_DNS_TESTS_UPSTREAM_H
+
+#include <arpa/inet.h>
+#include <cstring>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "tiny_dns.h"
+
+struct UpstreamQuery {
+    std::string msg;
+    struct sockaddr_storage from;
+    socklen_t from_len;
+};
+
+class Upstream {
+  public:
+    Upstream() {
+        fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+
+        struct sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd_, (struct sockaddr *)&addr, sizeof(addr));
+
+        // Room for thousands of queries sent before the test gets to answer them
+        int rcvbuf = 4 << 20;
+        setsockopt(fd_, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+        addr_len_ = sizeof(addr_);
+        getsockname(fd_, (struct sockaddr *)&addr_, &addr_len_);
+    }
+
+    ~Upstream() { close(fd_); }
+
+    const struct sockaddr_storage &addr() const { return addr_; }
+    socklen_t addr_len() const { return addr_len_; }
+
+    // Wait up to timeout_ms for the next query
+    bool recv(UpstreamQuery &query, int timeout_ms = 1000) {
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        if (poll(&pfd, 1, timeout_ms) != 1) {
+            return false;
+        }
+
+        char buffer[512];
+        query.from_len = sizeof(query.from);
+        ssize_t len = recvfrom(fd_, buffer, sizeof(buffer), 0, (struct sockaddr *)&query.from,
+                               &query.from_len);
+        if (len < 0) {
+            return false;
+        }
+
+        query.msg.assign(buffer, (size_t)len);
+        return true;
+    }
+
+    void send(const UpstreamQuery &to, const std::string &msg) {
+        sendto(fd_, msg.data(), msg.size(), 0, (const struct sockaddr *)&to.from, to.from_len);
+    }
+
+    // Response to @query with one A record, or with no answers if @addr is null
+    static std::string answer(const std::string &query, const char *addr = "\xC0\x00\x02\x01",
+                              uint16_t id_delta = 0) {
+        struct tiny_dns_request req;
+        struct tiny_dns_question_view question;
+        if (tiny_dns_request_parse(&req, query.data(), query.size(), &question, 1) !=
+            TINY_DNS_ERR_NONE) {
+            return "";
+        }
+
+        struct tiny_dns_name qname;
+        tiny_dns_name_view_decode(&question.qname, &qname);
+
+        struct tiny_dns_header header = {};
+        header.id = (uint16_t)(req.header.id + id_delta);
+        header.flags.qr = true;
+        header.flags.rd = true;
+        header.flags.ra = true;
+
+        char buffer[512];
+        struct tiny_dns_builder builder;
+        tiny_dns_builder_init(&builder, buffer, sizeof(buffer), &header);
+        tiny_dns_builder_question(&builder, qname.name, question.qtype, question.qclass);
+
+        if (addr) {
+            struct tiny_dns_rr rr = {};
+            strcpy(rr.name.name, qname.name);
+            rr.atype = RR_TYPE_A;
+            rr.aclass = CLASS_IN;
+            rr.ttl = 300;
+            memcpy(rr.rdata.rr_a, addr, 4);
+            tiny_dns_builder_rr(&builder, SECTION_ANSWER, &rr);
+        }
+
+        size_t len = 0;
+        tiny_dns_builder_finish(&builder, &len);
+        return std::string(buffer, len);
+    }
+
+    // Name of the first question in @msg, query or response, dotted
+    static std::string qname(const std::string &msg) {
+        struct tiny_dns_name_view view = { msg.data(), msg.size(), 12 };
+        struct tiny_dns_name name;
+        if (tiny_dns_name_view_decode(&view, &name) != TINY_DNS_ERR_NONE) {
+            return "";
+        }
+        return name.name;
+    }
+
+  private:
+    int fd_;
+    struct sockaddr_storage addr_;
+    socklen_t addr_len_;
+};
+
+#endif  // TINY_DNS_TESTS_UPSTREAM_H